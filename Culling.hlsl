@@ -0,0 +1,60 @@
+//
+// GPU culling, see GpuIndirectCuller in gpuindirectdraw.h and CullIndirectCommandsReference in indirectdraw.h
+//
+
+struct CullObject
+{
+	float3 center;
+	float radius;
+	float3 extents;
+	uint commandIndex;
+};
+
+cbuffer CullConstants : register(b0)
+{
+	float4 planes[6]; //xyz inward normal, w distance
+	uint objectCount;
+	uint commandDwords;
+	uint maxCommands;
+	uint padding;
+};
+
+StructuredBuffer<CullObject> objects : register(t0);
+ByteAddressBuffer templates : register(t1); //a command record per object, written by the CPU
+RWByteAddressBuffer commands : register(u0); //records of the visible objects, read by ExecuteIndirect
+RWByteAddressBuffer drawCount : register(u1); //cleared to 0 before the dispatch
+
+[numthreads(64, 1, 1)]
+void CSCull(uint3 id : SV_DispatchThreadID)
+{
+	if (id.x >= objectCount)
+	{
+		return;
+	}
+	CullObject object = objects[id.x];
+
+	//outside when the sphere or the box is entirely behind a plane
+	[unroll]
+	for (uint p = 0; p < 6; ++p)
+	{
+		float distance = dot(planes[p].xyz, object.center) + planes[p].w;
+		float reach = min(dot(abs(planes[p].xyz), object.extents), object.radius);
+		if (distance < -reach)
+		{
+			return;
+		}
+	}
+
+	uint slot;
+	drawCount.InterlockedAdd(0, 1, slot);
+	if (slot >= maxCommands)
+	{
+		return;
+	}
+	uint source = object.commandIndex * commandDwords * 4;
+	uint destination = slot * commandDwords * 4;
+	for (uint i = 0; i < commandDwords; ++i)
+	{
+		commands.Store(destination + i * 4, templates.Load(source + i * 4));
+	}
+}
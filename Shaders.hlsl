@@ -2,6 +2,11 @@
 // Shaders
 //
 
+//feature axes, set per variant by ShaderPermutations. Defaults allow compiling the file without defines.
+#ifndef USE_TEXTURE
+#define USE_TEXTURE 1
+#endif
+
 struct Matrix
 {
 	matrix mat;
@@ -35,6 +40,15 @@ cbuffer projMatrix : register(b2)
 Texture2D<float4> tex0 : register(t0);
 SamplerState samp0 : register(s0);
 
+//normal of the packed vertex formats with two component normals, see VertexPacking::OctahedralDecode
+float3 OctDecode(float2 e)
+{
+	float3 n = float3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 struct VSOutput
 {
 	float4 pos : SV_POSITION;
@@ -54,7 +68,11 @@ VSOutput VSMain(float3 pos : POSITION, float2 tex : TEXCOORD)
 float4 PSMain(VSOutput vsOut) : SV_Target
 {
 	float4 outColor;
+#if USE_TEXTURE
 	outColor = tex0.Sample(samp0, vsOut.tex.xy);
+#else
+	outColor = float4(vsOut.tex.xy, 0.0, 1.0);
+#endif
 	return outColor;
 	//return vsOut.color;
 }
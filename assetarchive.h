@@ -0,0 +1,476 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "d3d12types.h"
+#include "hashing.h"
+#include "lz4block.h"
+#include "mappedfile.h"
+#include "workerpool.h"
+
+//many assets in one file, opened and mapped once instead of a file open per asset:
+//
+//  AssetArchiveHeader | AssetArchiveEntry[EntryCount] | slot[SlotCount] | AssetArchiveChunk[ChunkCount] | names | data
+//
+//Slots are an open addressing table of entry indices over the hash of the entry names, at most half full, so a
+//lookup is a hash and a probe or two. An entry's data is split into chunks of ChunkSize compressed on their own
+//with LZ4, which lets the chunks of a large asset decompress in parallel. Chunks LZ4 doesn't shrink are stored as
+//they are; an entry stored whole is one contiguous range starting on a page, readable in place from the mapping.
+//Names are normalized by NormalizeAssetName. The structs are read in place, little endian.
+const uint32_t AssetArchiveMagic = 0x4b434150; //"PACK"
+const uint32_t AssetArchiveVersion = 2;
+const uint32_t AssetArchiveDefaultChunkSize = 64 * 1024;
+const uint32_t AssetArchiveStoredAlignment = 4096;
+const uint32_t AssetArchiveEmptySlot = ~0u;
+
+struct AssetArchiveHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t FileSize;
+	uint32_t EntryCount;
+	uint32_t SlotCount; //a power of two
+	uint32_t ChunkCount;
+	uint32_t ChunkSize;
+	uint64_t EntriesOffset;
+	uint64_t SlotsOffset;
+	uint64_t ChunksOffset;
+	uint64_t NamesOffset;
+	uint32_t NamesSize;
+	uint32_t Reserved[3];
+};
+static_assert(sizeof(AssetArchiveHeader) == 80, "AssetArchiveHeader is read in place");
+
+struct AssetArchiveEntry
+{
+	uint64_t NameHash; //of the normalized name
+	uint32_t NameOffset; //into the names, not null terminated
+	uint32_t NameLength;
+	uint64_t Size; //uncompressed
+	uint32_t FirstChunk;
+	uint32_t ChunkCount;
+};
+static_assert(sizeof(AssetArchiveEntry) == 32, "AssetArchiveEntry is read in place");
+
+struct AssetArchiveChunk
+{
+	uint64_t Offset;
+	uint32_t CompressedSize; //equal to Size when the chunk is stored
+	uint32_t Size; //ChunkSize but for the last chunk of an entry
+};
+static_assert(sizeof(AssetArchiveChunk) == 16, "AssetArchiveChunk is read in place");
+
+//lower case, '/' separators and no leading "./", so "Textures\Sea.dds" and "./textures/sea.dds" are the same asset
+inline std::string NormalizeAssetName(const char* name)
+{
+	while (name[0] == '.' && (name[1] == '/' || name[1] == '\\'))
+	{
+		name += 2;
+	}
+	std::string normalized(name);
+	for (char& c : normalized)
+	{
+		c = c == '\\' ? '/' : (c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+	}
+	return normalized;
+}
+
+inline uint64_t HashAssetName(const std::string& normalized)
+{
+	return Hasher().AddBytes(normalized.data(), normalized.size()).Get();
+}
+
+struct AssetArchiveSource
+{
+	std::string Name;
+	const void* Data;
+	size_t Size;
+};
+
+//the complete archive of sources, written to image. Names must differ after normalization.
+inline HRESULT BuildAssetArchive(const std::vector<AssetArchiveSource>& sources, std::vector<uint8_t>& image, uint32_t chunkSize = AssetArchiveDefaultChunkSize, bool compress = true)
+{
+	if (!chunkSize || sources.size() >= AssetArchiveEmptySlot / 2)
+	{
+		return E_INVALIDARG;
+	}
+	const uint32_t entryCount = static_cast<uint32_t>(sources.size());
+	//at least two slots, which also keeps the chunks after the slots 8 byte aligned when there are no entries
+	uint32_t slotCount = 2;
+	while (slotCount < entryCount * 2)
+	{
+		slotCount *= 2;
+	}
+
+	std::vector<AssetArchiveEntry> entries(entryCount);
+	std::vector<uint32_t> slots(slotCount, AssetArchiveEmptySlot);
+	std::vector<AssetArchiveChunk> chunks;
+	std::string names;
+	for (uint32_t e = 0; e < entryCount; ++e)
+	{
+		std::string name = NormalizeAssetName(sources[e].Name.c_str());
+		AssetArchiveEntry& entry = entries[e];
+		entry.NameHash = HashAssetName(name);
+		entry.NameOffset = static_cast<uint32_t>(names.size());
+		entry.NameLength = static_cast<uint32_t>(name.size());
+		entry.Size = sources[e].Size;
+		entry.FirstChunk = static_cast<uint32_t>(chunks.size());
+		entry.ChunkCount = static_cast<uint32_t>((sources[e].Size + chunkSize - 1) / chunkSize);
+		names += name;
+
+		for (uint32_t slot = FoldHash(entry.NameHash) & (slotCount - 1);; slot = (slot + 1) & (slotCount - 1))
+		{
+			if (slots[slot] == AssetArchiveEmptySlot)
+			{
+				slots[slot] = e;
+				break;
+			}
+			const AssetArchiveEntry& other = entries[slots[slot]];
+			if (other.NameHash == entry.NameHash && !names.compare(other.NameOffset, other.NameLength, name))
+			{
+				return E_INVALIDARG;
+			}
+		}
+		for (uint32_t c = 0; c < entry.ChunkCount; ++c)
+		{
+			AssetArchiveChunk chunk = {};
+			chunk.Size = static_cast<uint32_t>(std::min<uint64_t>(chunkSize, entry.Size - uint64_t(c) * chunkSize));
+			chunks.push_back(chunk);
+		}
+	}
+
+	//data goes after the tables, compressed chunk by chunk; an entry none of whose chunks shrinks is stored whole
+	size_t base = image.size();
+	uint64_t offset = sizeof(AssetArchiveHeader) + entries.size() * sizeof(AssetArchiveEntry) + slots.size() * sizeof(uint32_t) + chunks.size() * sizeof(AssetArchiveChunk) + names.size();
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> scratch(Lz4::CompressBound(chunkSize));
+	for (uint32_t e = 0; e < entryCount; ++e)
+	{
+		const AssetArchiveEntry& entry = entries[e];
+		const uint8_t* source = static_cast<const uint8_t*>(sources[e].Data);
+		std::vector<size_t> compressedSizes(entry.ChunkCount, 0);
+		bool stored = true;
+		for (uint32_t c = 0; c < entry.ChunkCount && compress; ++c)
+		{
+			const AssetArchiveChunk& chunk = chunks[entry.FirstChunk + c];
+			size_t size = Lz4::Compress(source + size_t(c) * chunkSize, chunk.Size, scratch.data(), scratch.size());
+			//chunks that barely shrink aren't worth decompressing
+			compressedSizes[c] = size && size < chunk.Size - chunk.Size / 16 ? size : 0;
+			stored = stored && !compressedSizes[c];
+		}
+
+		uint64_t alignment = stored ? AssetArchiveStoredAlignment : 16;
+		uint64_t start = (offset + data.size() + alignment - 1) / alignment * alignment;
+		data.resize(static_cast<size_t>(start - offset), 0);
+		for (uint32_t c = 0; c < entry.ChunkCount; ++c)
+		{
+			AssetArchiveChunk& chunk = chunks[entry.FirstChunk + c];
+			const uint8_t* chunkSource = source + size_t(c) * chunkSize;
+			chunk.Offset = offset + data.size();
+			if (compressedSizes[c])
+			{
+				//compressed again rather than kept from the size pass, to keep only one chunk of scratch around
+				Lz4::Compress(chunkSource, chunk.Size, scratch.data(), scratch.size());
+				chunk.CompressedSize = static_cast<uint32_t>(compressedSizes[c]);
+				data.insert(data.end(), scratch.data(), scratch.data() + compressedSizes[c]);
+			}
+			else
+			{
+				chunk.CompressedSize = chunk.Size;
+				data.insert(data.end(), chunkSource, chunkSource + chunk.Size);
+			}
+		}
+	}
+
+	AssetArchiveHeader header = {};
+	header.Magic = AssetArchiveMagic;
+	header.Version = AssetArchiveVersion;
+	header.FileSize = offset + data.size();
+	header.EntryCount = entryCount;
+	header.SlotCount = slotCount;
+	header.ChunkCount = static_cast<uint32_t>(chunks.size());
+	header.ChunkSize = chunkSize;
+	header.EntriesOffset = sizeof(AssetArchiveHeader);
+	header.SlotsOffset = header.EntriesOffset + entries.size() * sizeof(AssetArchiveEntry);
+	header.ChunksOffset = header.SlotsOffset + slots.size() * sizeof(uint32_t);
+	header.NamesOffset = header.ChunksOffset + chunks.size() * sizeof(AssetArchiveChunk);
+	header.NamesSize = static_cast<uint32_t>(names.size());
+
+	image.resize(base + static_cast<size_t>(header.FileSize));
+	uint8_t* target = &image[base];
+	memcpy(target, &header, sizeof(header));
+	memcpy(target + header.EntriesOffset, entries.data(), entries.size() * sizeof(AssetArchiveEntry));
+	memcpy(target + header.SlotsOffset, slots.data(), slots.size() * sizeof(uint32_t));
+	memcpy(target + header.ChunksOffset, chunks.data(), chunks.size() * sizeof(AssetArchiveChunk));
+	memcpy(target + header.NamesOffset, names.data(), names.size());
+	memcpy(target + offset, data.data(), data.size());
+	return S_OK;
+}
+
+//an archive mapped by Open or already in memory through Attach. Loading checks the header and every table, so
+//lookups and reads trust them afterwards; chunk contents are checked as they decompress.
+class AssetArchive
+{
+public:
+	static const uint32_t NotFound = ~0u;
+
+	AssetArchive() { Close(); }
+
+	HRESULT Open(const char* fileName)
+	{
+		Close();
+		HRESULT hr = m_File.Open(fileName);
+		if (SUCCEEDED(hr))
+		{
+			hr = Attach(m_File.GetData(), m_File.GetSize());
+		}
+		if (FAILED(hr))
+		{
+			Close();
+		}
+		return hr;
+	}
+
+	//image must stay valid until Close
+	HRESULT Attach(const void* image, size_t size)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(image);
+		if (!data || size < sizeof(AssetArchiveHeader))
+		{
+			return E_FAIL;
+		}
+		const AssetArchiveHeader* header = reinterpret_cast<const AssetArchiveHeader*>(data);
+		auto inside = [size](uint64_t offset, uint64_t count, uint64_t elementSize)
+		{
+			return offset <= size && count <= (size - offset) / elementSize;
+		};
+		if (header->Magic != AssetArchiveMagic || header->Version != AssetArchiveVersion || header->FileSize != size ||
+			!header->ChunkSize || !header->SlotCount || (header->SlotCount & (header->SlotCount - 1)) || header->EntryCount >= header->SlotCount ||
+			!inside(header->EntriesOffset, header->EntryCount, sizeof(AssetArchiveEntry)) ||
+			!inside(header->SlotsOffset, header->SlotCount, sizeof(uint32_t)) ||
+			!inside(header->ChunksOffset, header->ChunkCount, sizeof(AssetArchiveChunk)) ||
+			!inside(header->NamesOffset, header->NamesSize, 1) ||
+			header->EntriesOffset % 8 || header->SlotsOffset % 4 || header->ChunksOffset % 8)
+		{
+			return E_FAIL;
+		}
+
+		const AssetArchiveEntry* entries = reinterpret_cast<const AssetArchiveEntry*>(data + header->EntriesOffset);
+		const uint32_t* slots = reinterpret_cast<const uint32_t*>(data + header->SlotsOffset);
+		const AssetArchiveChunk* chunks = reinterpret_cast<const AssetArchiveChunk*>(data + header->ChunksOffset);
+		for (uint32_t s = 0; s < header->SlotCount; ++s)
+		{
+			if (slots[s] != AssetArchiveEmptySlot && slots[s] >= header->EntryCount)
+			{
+				return E_FAIL;
+			}
+		}
+		for (uint32_t c = 0; c < header->ChunkCount; ++c)
+		{
+			if (chunks[c].Size > header->ChunkSize || chunks[c].CompressedSize > chunks[c].Size || !inside(chunks[c].Offset, chunks[c].CompressedSize, 1))
+			{
+				return E_FAIL;
+			}
+		}
+		for (uint32_t e = 0; e < header->EntryCount; ++e)
+		{
+			const AssetArchiveEntry& entry = entries[e];
+			if (!inside(entry.NameOffset, entry.NameLength, 1) || uint64_t(entry.NameOffset) + entry.NameLength > header->NamesSize ||
+				entry.FirstChunk > header->ChunkCount || entry.ChunkCount > header->ChunkCount - entry.FirstChunk ||
+				entry.ChunkCount != (entry.Size + header->ChunkSize - 1) / header->ChunkSize)
+			{
+				return E_FAIL;
+			}
+			for (uint32_t c = 0; c < entry.ChunkCount; ++c)
+			{
+				uint64_t expected = std::min<uint64_t>(header->ChunkSize, entry.Size - uint64_t(c) * header->ChunkSize);
+				if (chunks[entry.FirstChunk + c].Size != expected)
+				{
+					return E_FAIL;
+				}
+			}
+		}
+
+		m_Data = data;
+		m_Header = header;
+		m_Entries = entries;
+		m_Slots = slots;
+		m_Chunks = chunks;
+		m_Names = reinterpret_cast<const char*>(data + header->NamesOffset);
+		return S_OK;
+	}
+
+	void Close()
+	{
+		m_File.Close();
+		m_Data = nullptr;
+		m_Header = nullptr;
+		m_Entries = nullptr;
+		m_Slots = nullptr;
+		m_Chunks = nullptr;
+		m_Names = nullptr;
+	}
+
+	bool IsOpen() const { return m_Header != nullptr; }
+
+	//NotFound when the archive isn't open or has no such asset
+	uint32_t Find(const char* name) const
+	{
+		if (!m_Header || !m_Header->EntryCount)
+		{
+			return NotFound;
+		}
+		std::string normalized = NormalizeAssetName(name);
+		uint64_t hash = HashAssetName(normalized);
+		const uint32_t mask = m_Header->SlotCount - 1;
+		//at most half full, but a damaged archive could be full, so probe every slot at most once
+		for (uint32_t probe = 0, slot = FoldHash(hash) & mask; probe <= mask; ++probe, slot = (slot + 1) & mask)
+		{
+			uint32_t e = m_Slots[slot];
+			if (e == AssetArchiveEmptySlot)
+			{
+				return NotFound;
+			}
+			const AssetArchiveEntry& entry = m_Entries[e];
+			if (entry.NameHash == hash && entry.NameLength == normalized.size() && !memcmp(m_Names + entry.NameOffset, normalized.data(), normalized.size()))
+			{
+				return e;
+			}
+		}
+		return NotFound;
+	}
+
+	uint32_t GetEntryCount() const { return m_Header ? m_Header->EntryCount : 0; }
+	std::string GetName(uint32_t entry) const { return std::string(m_Names + m_Entries[entry].NameOffset, m_Entries[entry].NameLength); }
+	uint64_t GetSize(uint32_t entry) const { return m_Entries[entry].Size; }
+
+	//the entry in place in the mapping when it is stored whole, null when it has to be decompressed by Read
+	const void* GetStoredData(uint32_t entry) const
+	{
+		const AssetArchiveEntry& e = m_Entries[entry];
+		for (uint32_t c = 0; c < e.ChunkCount; ++c)
+		{
+			const AssetArchiveChunk& chunk = m_Chunks[e.FirstChunk + c];
+			if (chunk.CompressedSize != chunk.Size || (c && chunk.Offset != m_Chunks[e.FirstChunk + c - 1].Offset + m_Chunks[e.FirstChunk + c - 1].Size))
+			{
+				return nullptr;
+			}
+		}
+		return e.ChunkCount ? m_Data + m_Chunks[e.FirstChunk].Offset : m_Data;
+	}
+
+	//decompresses the entry into destination, which holds GetSize(entry) bytes. With a pool the chunks are split
+	//between its threads and the calling one, which returns once all of them are done.
+	HRESULT Read(uint32_t entry, void* destination, WorkerPool* pool = nullptr) const
+	{
+		if (!m_Header || entry >= m_Header->EntryCount)
+		{
+			return E_INVALIDARG;
+		}
+		const AssetArchiveEntry& e = m_Entries[entry];
+		if (e.ChunkCount)
+		{
+			const AssetArchiveChunk& first = m_Chunks[e.FirstChunk];
+			const AssetArchiveChunk& last = m_Chunks[e.FirstChunk + e.ChunkCount - 1];
+			m_File.Prefetch(static_cast<size_t>(first.Offset), static_cast<size_t>(last.Offset + last.CompressedSize - first.Offset));
+		}
+
+		uint8_t* target = static_cast<uint8_t*>(destination);
+		if (!pool || pool->GetThreadCount() == 0 || e.ChunkCount < 2)
+		{
+			for (uint32_t c = 0; c < e.ChunkCount; ++c)
+			{
+				if (!ReadChunk(e.FirstChunk + c, target + size_t(c) * m_Header->ChunkSize))
+				{
+					return E_FAIL;
+				}
+			}
+			return S_OK;
+		}
+
+		std::shared_ptr<ReadJobs> jobs(new ReadJobs(this, e.FirstChunk, e.ChunkCount, target));
+		uint32_t helpers = std::min(pool->GetThreadCount(), e.ChunkCount - 1);
+		for (uint32_t i = 0; i < helpers; ++i)
+		{
+			pool->Submit([jobs]() { jobs->Run(); });
+		}
+		jobs->Run();
+		while (jobs->Done.load(std::memory_order_acquire) != e.ChunkCount)
+		{
+			std::this_thread::yield();
+		}
+		return jobs->Failed.load(std::memory_order_relaxed) ? E_FAIL : S_OK;
+	}
+
+	HRESULT Read(uint32_t entry, std::vector<uint8_t>& data, WorkerPool* pool = nullptr) const
+	{
+		if (!m_Header || entry >= m_Header->EntryCount)
+		{
+			return E_INVALIDARG;
+		}
+		data.resize(static_cast<size_t>(m_Entries[entry].Size));
+		return Read(entry, data.data(), pool);
+	}
+
+private:
+	//the chunks of one Read, taken one at a time by whichever thread gets to them first
+	struct ReadJobs
+	{
+		ReadJobs(const AssetArchive* archive, uint32_t firstChunk, uint32_t chunkCount, uint8_t* target)
+			: Owner(archive), FirstChunk(firstChunk), ChunkCount(chunkCount), Target(target), Next(0), Done(0), Failed(false) {}
+
+		void Run()
+		{
+			for (;;)
+			{
+				uint32_t job = Next.fetch_add(1, std::memory_order_relaxed);
+				if (job >= ChunkCount)
+				{
+					return;
+				}
+				if (!Owner->ReadChunk(FirstChunk + job, Target + size_t(job) * Owner->m_Header->ChunkSize))
+				{
+					Failed.store(true, std::memory_order_relaxed);
+				}
+				Done.fetch_add(1, std::memory_order_release);
+			}
+		}
+
+		const AssetArchive* Owner;
+		uint32_t FirstChunk;
+		uint32_t ChunkCount;
+		uint8_t* Target;
+		std::atomic<uint32_t> Next;
+		std::atomic<uint32_t> Done;
+		std::atomic<bool> Failed;
+	};
+
+	bool ReadChunk(uint32_t chunkIndex, uint8_t* target) const
+	{
+		const AssetArchiveChunk& chunk = m_Chunks[chunkIndex];
+		const uint8_t* source = m_Data + chunk.Offset;
+		if (chunk.CompressedSize == chunk.Size)
+		{
+			memcpy(target, source, chunk.Size);
+			return true;
+		}
+		return Lz4::Decompress(source, chunk.CompressedSize, target, chunk.Size);
+	}
+
+	MappedFile m_File;
+	const uint8_t* m_Data;
+	const AssetArchiveHeader* m_Header;
+	const AssetArchiveEntry* m_Entries;
+	const uint32_t* m_Slots;
+	const AssetArchiveChunk* m_Chunks;
+	const char* m_Names;
+};
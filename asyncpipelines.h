@@ -0,0 +1,139 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <thread>
+
+#include "workerpool.h"
+
+//queues pipeline compiles to a worker pool and hands out a handle right away.
+//Resolve() returns the real pipeline once it is compiled and the designated fallback pipeline until then
+//(or forever if the compile failed); a null result means the draw should be skipped this frame.
+//
+//Submit, SetFallback and Resolve belong to the thread recording frames and must not be called concurrently;
+//workers only publish their result into the slot of their handle, so Resolve never takes a lock.
+//Descriptions are copied, but whatever they point at (shader bytecode, input layouts) has to stay
+//alive until the pipeline is ready.
+template<typename Description, typename Pipeline>
+class AsyncPipelineCompiler
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle InvalidHandle = ~0u;
+
+	//returns null on failure.
+	typedef std::function<Pipeline*(const Description&)> CompileFunc;
+
+	AsyncPipelineCompiler() : m_Pool(nullptr), m_Fallback(InvalidHandle) {}
+
+	//pool may be null, Submit then compiles inline.
+	void Create(CompileFunc compile, WorkerPool* pool)
+	{
+		m_Compile = compile;
+		m_Pool = pool;
+	}
+
+	Handle Submit(const Description& desc)
+	{
+		m_Slots.emplace_back();
+		Slot* slot = &m_Slots.back();
+		slot->Desc = desc;
+		Handle handle = static_cast<Handle>(m_Slots.size() - 1);
+
+		auto job = [this, slot]()
+		{
+			Pipeline* pipeline = m_Compile(slot->Desc);
+			slot->Result.store(pipeline, std::memory_order_release);
+			slot->State.store(pipeline ? Ready : Failed, std::memory_order_release);
+		};
+		if (m_Pool)
+		{
+			m_Pool->Submit(job);
+		}
+		else
+		{
+			job();
+		}
+		return handle;
+	}
+
+	//the pipeline substituted for every handle that isn't ready, normally submitted first and waited for at load.
+	void SetFallback(Handle handle) { m_Fallback = handle; }
+
+	Pipeline* Resolve(Handle handle) const
+	{
+		Pipeline* pipeline = GetIfReady(handle);
+		if (!pipeline && m_Fallback != InvalidHandle)
+		{
+			pipeline = GetIfReady(m_Fallback);
+		}
+		return pipeline;
+	}
+
+	//the handle whose pipeline Resolve returns, handle itself or the fallback, InvalidHandle when neither is ready.
+	//Resolving the result gives the same pipeline even if handle becomes ready in between.
+	Handle ResolveHandle(Handle handle) const
+	{
+		if (GetIfReady(handle))
+		{
+			return handle;
+		}
+		return (m_Fallback != InvalidHandle && GetIfReady(m_Fallback)) ? m_Fallback : InvalidHandle;
+	}
+
+	bool IsReady(Handle handle) const { return GetIfReady(handle) != nullptr; }
+
+	bool HasFailed(Handle handle) const
+	{
+		assert(handle < m_Slots.size());
+		return m_Slots[handle].State.load(std::memory_order_acquire) == Failed;
+	}
+
+	//blocks until the compile of handle has finished, successfully or not.
+	Pipeline* Wait(Handle handle)
+	{
+		assert(handle < m_Slots.size());
+		while (m_Slots[handle].State.load(std::memory_order_acquire) == Pending)
+		{
+			std::this_thread::yield();
+		}
+		return GetIfReady(handle);
+	}
+
+	uint32_t GetPendingCount() const
+	{
+		uint32_t count = 0;
+		for (const auto& slot : m_Slots)
+		{
+			count += (slot.State.load(std::memory_order_acquire) == Pending) ? 1 : 0;
+		}
+		return count;
+	}
+
+private:
+	enum SlotState { Pending, Ready, Failed };
+
+	struct Slot
+	{
+		Slot() : Result(nullptr), State(Pending) {}
+		Description Desc;
+		std::atomic<Pipeline*> Result;
+		std::atomic<int> State;
+	};
+
+	Pipeline* GetIfReady(Handle handle) const
+	{
+		assert(handle < m_Slots.size());
+		const Slot& slot = m_Slots[handle];
+		return slot.State.load(std::memory_order_acquire) == Ready ? slot.Result.load(std::memory_order_relaxed) : nullptr;
+	}
+
+	CompileFunc m_Compile;
+	WorkerPool* m_Pool;
+	Handle m_Fallback;
+	//deque so the slots captured by in-flight jobs never move when more are submitted
+	std::deque<Slot> m_Slots;
+};
@@ -0,0 +1,688 @@
+#pragma once
+
+//the D3D12 types used by the API-free parts of the renderer (draw packets, state tracking, pipeline hashing, the
+//null device). On Windows this is just d3d12.h. Elsewhere it declares the subset those headers need, with the
+//same names, layouts and values, so they build for headless CPU benchmarks against NullDevice. Interfaces are
+//left incomplete there: the headers only store and compare the pointers.
+
+#ifdef _WIN32
+
+#include <d3d12.h>
+
+#else
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef int32_t INT;
+typedef uint32_t UINT;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint64_t UINT64;
+typedef int32_t LONG;
+typedef int BOOL;
+typedef float FLOAT;
+typedef size_t SIZE_T;
+typedef int32_t HRESULT;
+
+#ifndef FALSE
+#define FALSE 0
+#define TRUE 1
+#endif
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_INVALIDARG ((HRESULT)0x80070057)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000E)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define ZeroMemory(destination, length) memset((destination), 0, (length))
+
+//bitwise operators for flag enums, as DEFINE_ENUM_FLAG_OPERATORS in winnt.h
+#define D3D12TYPES_FLAG_OPERATORS(Enum) \
+	inline Enum operator|(Enum a, Enum b) { return Enum(uint32_t(a) | uint32_t(b)); } \
+	inline Enum operator&(Enum a, Enum b) { return Enum(uint32_t(a) & uint32_t(b)); } \
+	inline Enum operator~(Enum a) { return Enum(~uint32_t(a)); } \
+	inline Enum& operator|=(Enum& a, Enum b) { return a = a | b; } \
+	inline Enum& operator&=(Enum& a, Enum b) { return a = a & b; }
+
+struct ID3D12Resource;
+struct ID3D12Heap;
+struct ID3D12PipelineState;
+struct ID3D12RootSignature;
+struct ID3D12DescriptorHeap;
+struct ID3D12CommandSignature;
+
+struct RECT
+{
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+};
+typedef RECT D3D12_RECT;
+
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+	DXGI_FORMAT_R32G32B32_FLOAT = 6,
+	DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+	DXGI_FORMAT_R16G16B16A16_UNORM = 11,
+	DXGI_FORMAT_R16G16B16A16_SNORM = 13,
+	DXGI_FORMAT_R32G32_FLOAT = 16,
+	DXGI_FORMAT_R10G10B10A2_UNORM = 24,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+	DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+	DXGI_FORMAT_R8G8B8A8_SNORM = 31,
+	DXGI_FORMAT_R16G16_FLOAT = 34,
+	DXGI_FORMAT_R16G16_UNORM = 35,
+	DXGI_FORMAT_R16G16_SNORM = 37,
+	DXGI_FORMAT_D32_FLOAT = 40,
+	DXGI_FORMAT_R32_FLOAT = 41,
+	DXGI_FORMAT_R32_UINT = 42,
+	DXGI_FORMAT_D24_UNORM_S8_UINT = 45,
+	DXGI_FORMAT_R8G8_UNORM = 49,
+	DXGI_FORMAT_R8G8_SNORM = 51,
+	DXGI_FORMAT_R16_UINT = 57,
+	DXGI_FORMAT_R8_UNORM = 61,
+	DXGI_FORMAT_BC1_UNORM = 71,
+	DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+	DXGI_FORMAT_BC2_UNORM = 74,
+	DXGI_FORMAT_BC2_UNORM_SRGB = 75,
+	DXGI_FORMAT_BC3_UNORM = 77,
+	DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+	DXGI_FORMAT_BC4_UNORM = 80,
+	DXGI_FORMAT_BC4_SNORM = 81,
+	DXGI_FORMAT_BC5_UNORM = 83,
+	DXGI_FORMAT_BC5_SNORM = 84,
+	DXGI_FORMAT_B8G8R8A8_UNORM = 87,
+	DXGI_FORMAT_B8G8R8X8_UNORM = 88,
+	DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
+	DXGI_FORMAT_B8G8R8X8_UNORM_SRGB = 93,
+	DXGI_FORMAT_BC6H_UF16 = 95,
+	DXGI_FORMAT_BC6H_SF16 = 96,
+	DXGI_FORMAT_BC7_UNORM = 98,
+	DXGI_FORMAT_BC7_UNORM_SRGB = 99
+};
+
+struct DXGI_SAMPLE_DESC
+{
+	UINT Count;
+	UINT Quality;
+};
+
+enum D3D_PRIMITIVE_TOPOLOGY
+{
+	D3D_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+	D3D_PRIMITIVE_TOPOLOGY_POINTLIST = 1,
+	D3D_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+	D3D_PRIMITIVE_TOPOLOGY_LINESTRIP = 3,
+	D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+	D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5
+};
+
+typedef UINT64 D3D12_GPU_VIRTUAL_ADDRESS;
+
+struct D3D12_CPU_DESCRIPTOR_HANDLE
+{
+	SIZE_T ptr;
+};
+
+struct D3D12_GPU_DESCRIPTOR_HANDLE
+{
+	UINT64 ptr;
+};
+
+struct D3D12_VERTEX_BUFFER_VIEW
+{
+	D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+	UINT SizeInBytes;
+	UINT StrideInBytes;
+};
+
+struct D3D12_INDEX_BUFFER_VIEW
+{
+	D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+	UINT SizeInBytes;
+	DXGI_FORMAT Format;
+};
+
+struct D3D12_VIEWPORT
+{
+	FLOAT TopLeftX;
+	FLOAT TopLeftY;
+	FLOAT Width;
+	FLOAT Height;
+	FLOAT MinDepth;
+	FLOAT MaxDepth;
+};
+
+enum D3D12_RESOURCE_STATES
+{
+	D3D12_RESOURCE_STATE_COMMON = 0,
+	D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER = 0x1,
+	D3D12_RESOURCE_STATE_INDEX_BUFFER = 0x2,
+	D3D12_RESOURCE_STATE_RENDER_TARGET = 0x4,
+	D3D12_RESOURCE_STATE_UNORDERED_ACCESS = 0x8,
+	D3D12_RESOURCE_STATE_DEPTH_WRITE = 0x10,
+	D3D12_RESOURCE_STATE_DEPTH_READ = 0x20,
+	D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE = 0x40,
+	D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE = 0x80,
+	D3D12_RESOURCE_STATE_STREAM_OUT = 0x100,
+	D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT = 0x200,
+	D3D12_RESOURCE_STATE_COPY_DEST = 0x400,
+	D3D12_RESOURCE_STATE_COPY_SOURCE = 0x800,
+	D3D12_RESOURCE_STATE_RESOLVE_DEST = 0x1000,
+	D3D12_RESOURCE_STATE_RESOLVE_SOURCE = 0x2000,
+	D3D12_RESOURCE_STATE_GENERIC_READ = 0x1 | 0x2 | 0x40 | 0x80 | 0x200 | 0x800,
+	D3D12_RESOURCE_STATE_PRESENT = 0,
+	D3D12_RESOURCE_STATE_PREDICATION = 0x200
+};
+D3D12TYPES_FLAG_OPERATORS(D3D12_RESOURCE_STATES)
+
+#define D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES 0xffffffff
+
+enum D3D12_RESOURCE_BARRIER_TYPE
+{
+	D3D12_RESOURCE_BARRIER_TYPE_TRANSITION = 0,
+	D3D12_RESOURCE_BARRIER_TYPE_ALIASING = 1,
+	D3D12_RESOURCE_BARRIER_TYPE_UAV = 2
+};
+
+enum D3D12_RESOURCE_BARRIER_FLAGS
+{
+	D3D12_RESOURCE_BARRIER_FLAG_NONE = 0,
+	D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY = 0x1,
+	D3D12_RESOURCE_BARRIER_FLAG_END_ONLY = 0x2
+};
+D3D12TYPES_FLAG_OPERATORS(D3D12_RESOURCE_BARRIER_FLAGS)
+
+struct D3D12_RESOURCE_TRANSITION_BARRIER
+{
+	ID3D12Resource* pResource;
+	UINT Subresource;
+	D3D12_RESOURCE_STATES StateBefore;
+	D3D12_RESOURCE_STATES StateAfter;
+};
+
+struct D3D12_RESOURCE_ALIASING_BARRIER
+{
+	ID3D12Resource* pResourceBefore;
+	ID3D12Resource* pResourceAfter;
+};
+
+struct D3D12_RESOURCE_UAV_BARRIER
+{
+	ID3D12Resource* pResource;
+};
+
+struct D3D12_RESOURCE_BARRIER
+{
+	D3D12_RESOURCE_BARRIER_TYPE Type;
+	D3D12_RESOURCE_BARRIER_FLAGS Flags;
+	union
+	{
+		D3D12_RESOURCE_TRANSITION_BARRIER Transition;
+		D3D12_RESOURCE_ALIASING_BARRIER Aliasing;
+		D3D12_RESOURCE_UAV_BARRIER UAV;
+	};
+};
+
+enum D3D12_HEAP_TYPE
+{
+	D3D12_HEAP_TYPE_DEFAULT = 1,
+	D3D12_HEAP_TYPE_UPLOAD = 2,
+	D3D12_HEAP_TYPE_READBACK = 3,
+	D3D12_HEAP_TYPE_CUSTOM = 4
+};
+
+enum D3D12_CPU_PAGE_PROPERTY
+{
+	D3D12_CPU_PAGE_PROPERTY_UNKNOWN = 0
+};
+
+enum D3D12_MEMORY_POOL
+{
+	D3D12_MEMORY_POOL_UNKNOWN = 0
+};
+
+enum D3D12_HEAP_FLAGS
+{
+	D3D12_HEAP_FLAG_NONE = 0
+};
+D3D12TYPES_FLAG_OPERATORS(D3D12_HEAP_FLAGS)
+
+struct D3D12_HEAP_PROPERTIES
+{
+	D3D12_HEAP_TYPE Type;
+	D3D12_CPU_PAGE_PROPERTY CPUPageProperty;
+	D3D12_MEMORY_POOL MemoryPoolPreference;
+	UINT CreationNodeMask;
+	UINT VisibleNodeMask;
+};
+
+enum D3D12_RESOURCE_DIMENSION
+{
+	D3D12_RESOURCE_DIMENSION_UNKNOWN = 0,
+	D3D12_RESOURCE_DIMENSION_BUFFER = 1,
+	D3D12_RESOURCE_DIMENSION_TEXTURE1D = 2,
+	D3D12_RESOURCE_DIMENSION_TEXTURE2D = 3,
+	D3D12_RESOURCE_DIMENSION_TEXTURE3D = 4
+};
+
+enum D3D12_TEXTURE_LAYOUT
+{
+	D3D12_TEXTURE_LAYOUT_UNKNOWN = 0,
+	D3D12_TEXTURE_LAYOUT_ROW_MAJOR = 1
+};
+
+enum D3D12_RESOURCE_FLAGS
+{
+	D3D12_RESOURCE_FLAG_NONE = 0,
+	D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET = 0x1,
+	D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL = 0x2,
+	D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS = 0x4
+};
+D3D12TYPES_FLAG_OPERATORS(D3D12_RESOURCE_FLAGS)
+
+struct D3D12_RESOURCE_DESC
+{
+	D3D12_RESOURCE_DIMENSION Dimension;
+	UINT64 Alignment;
+	UINT64 Width;
+	UINT Height;
+	UINT16 DepthOrArraySize;
+	UINT16 MipLevels;
+	DXGI_FORMAT Format;
+	DXGI_SAMPLE_DESC SampleDesc;
+	D3D12_TEXTURE_LAYOUT Layout;
+	D3D12_RESOURCE_FLAGS Flags;
+};
+
+#define D3D12_TEXTURE_DATA_PITCH_ALIGNMENT (256)
+#define D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT (512)
+
+struct D3D12_SUBRESOURCE_FOOTPRINT
+{
+	DXGI_FORMAT Format;
+	UINT Width;
+	UINT Height;
+	UINT Depth;
+	UINT RowPitch;
+};
+
+struct D3D12_PLACED_SUBRESOURCE_FOOTPRINT
+{
+	UINT64 Offset;
+	D3D12_SUBRESOURCE_FOOTPRINT Footprint;
+};
+
+struct D3D12_DEPTH_STENCIL_VALUE
+{
+	FLOAT Depth;
+	UINT8 Stencil;
+};
+
+struct D3D12_CLEAR_VALUE
+{
+	DXGI_FORMAT Format;
+	union
+	{
+		FLOAT Color[4];
+		D3D12_DEPTH_STENCIL_VALUE DepthStencil;
+	};
+};
+
+enum D3D12_DESCRIPTOR_HEAP_TYPE
+{
+	D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV = 0,
+	D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER = 1,
+	D3D12_DESCRIPTOR_HEAP_TYPE_RTV = 2,
+	D3D12_DESCRIPTOR_HEAP_TYPE_DSV = 3,
+	D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES = 4
+};
+
+enum D3D12_DESCRIPTOR_HEAP_FLAGS
+{
+	D3D12_DESCRIPTOR_HEAP_FLAG_NONE = 0,
+	D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE = 0x1
+};
+D3D12TYPES_FLAG_OPERATORS(D3D12_DESCRIPTOR_HEAP_FLAGS)
+
+struct D3D12_DESCRIPTOR_HEAP_DESC
+{
+	D3D12_DESCRIPTOR_HEAP_TYPE Type;
+	UINT NumDescriptors;
+	D3D12_DESCRIPTOR_HEAP_FLAGS Flags;
+	UINT NodeMask;
+};
+
+enum D3D12_COMMAND_LIST_TYPE
+{
+	D3D12_COMMAND_LIST_TYPE_DIRECT = 0,
+	D3D12_COMMAND_LIST_TYPE_BUNDLE = 1,
+	D3D12_COMMAND_LIST_TYPE_COMPUTE = 2,
+	D3D12_COMMAND_LIST_TYPE_COPY = 3
+};
+
+enum D3D12_INPUT_CLASSIFICATION
+{
+	D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA = 0,
+	D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA = 1
+};
+
+#define D3D12_APPEND_ALIGNED_ELEMENT (0xffffffff)
+
+struct D3D12_INPUT_ELEMENT_DESC
+{
+	const char* SemanticName;
+	UINT SemanticIndex;
+	DXGI_FORMAT Format;
+	UINT InputSlot;
+	UINT AlignedByteOffset;
+	D3D12_INPUT_CLASSIFICATION InputSlotClass;
+	UINT InstanceDataStepRate;
+};
+
+struct D3D12_INPUT_LAYOUT_DESC
+{
+	const D3D12_INPUT_ELEMENT_DESC* pInputElementDescs;
+	UINT NumElements;
+};
+
+enum D3D12_INDIRECT_ARGUMENT_TYPE
+{
+	D3D12_INDIRECT_ARGUMENT_TYPE_DRAW = 0,
+	D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED = 1,
+	D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH = 2,
+	D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW = 3,
+	D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW = 4,
+	D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT = 5,
+	D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW = 6,
+	D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW = 7,
+	D3D12_INDIRECT_ARGUMENT_TYPE_UNORDERED_ACCESS_VIEW = 8
+};
+
+struct D3D12_INDIRECT_ARGUMENT_DESC
+{
+	D3D12_INDIRECT_ARGUMENT_TYPE Type;
+	union
+	{
+		struct { UINT Slot; } VertexBuffer;
+		struct { UINT RootParameterIndex; UINT DestOffsetIn32BitValues; UINT Num32BitValuesToSet; } Constant;
+		struct { UINT RootParameterIndex; } ConstantBufferView;
+		struct { UINT RootParameterIndex; } ShaderResourceView;
+		struct { UINT RootParameterIndex; } UnorderedAccessView;
+	};
+};
+
+struct D3D12_COMMAND_SIGNATURE_DESC
+{
+	UINT ByteStride;
+	UINT NumArgumentDescs;
+	const D3D12_INDIRECT_ARGUMENT_DESC* pArgumentDescs;
+	UINT NodeMask;
+};
+
+struct D3D12_DRAW_ARGUMENTS
+{
+	UINT VertexCountPerInstance;
+	UINT InstanceCount;
+	UINT StartVertexLocation;
+	UINT StartInstanceLocation;
+};
+
+struct D3D12_DRAW_INDEXED_ARGUMENTS
+{
+	UINT IndexCountPerInstance;
+	UINT InstanceCount;
+	UINT StartIndexLocation;
+	INT BaseVertexLocation;
+	UINT StartInstanceLocation;
+};
+
+struct D3D12_DISPATCH_ARGUMENTS
+{
+	UINT ThreadGroupCountX;
+	UINT ThreadGroupCountY;
+	UINT ThreadGroupCountZ;
+};
+
+//the graphics pipeline description, for hashing pipelines without a device
+struct D3D12_SHADER_BYTECODE
+{
+	const void* pShaderBytecode;
+	SIZE_T BytecodeLength;
+};
+
+struct D3D12_SO_DECLARATION_ENTRY
+{
+	UINT Stream;
+	const char* SemanticName;
+	UINT SemanticIndex;
+	UINT8 StartComponent;
+	UINT8 ComponentCount;
+	UINT8 OutputSlot;
+};
+
+struct D3D12_STREAM_OUTPUT_DESC
+{
+	const D3D12_SO_DECLARATION_ENTRY* pSODeclaration;
+	UINT NumEntries;
+	const UINT* pBufferStrides;
+	UINT NumStrides;
+	UINT RasterizedStream;
+};
+
+enum D3D12_BLEND
+{
+	D3D12_BLEND_ZERO = 1,
+	D3D12_BLEND_ONE = 2,
+	D3D12_BLEND_SRC_COLOR = 3,
+	D3D12_BLEND_INV_SRC_COLOR = 4,
+	D3D12_BLEND_SRC_ALPHA = 5,
+	D3D12_BLEND_INV_SRC_ALPHA = 6,
+	D3D12_BLEND_DEST_ALPHA = 7,
+	D3D12_BLEND_INV_DEST_ALPHA = 8,
+	D3D12_BLEND_DEST_COLOR = 9,
+	D3D12_BLEND_INV_DEST_COLOR = 10
+};
+
+enum D3D12_BLEND_OP
+{
+	D3D12_BLEND_OP_ADD = 1,
+	D3D12_BLEND_OP_SUBTRACT = 2,
+	D3D12_BLEND_OP_REV_SUBTRACT = 3,
+	D3D12_BLEND_OP_MIN = 4,
+	D3D12_BLEND_OP_MAX = 5
+};
+
+enum D3D12_LOGIC_OP
+{
+	D3D12_LOGIC_OP_CLEAR = 0,
+	D3D12_LOGIC_OP_SET = 1,
+	D3D12_LOGIC_OP_COPY = 2,
+	D3D12_LOGIC_OP_COPY_INVERTED = 3,
+	D3D12_LOGIC_OP_NOOP = 4
+};
+
+enum D3D12_COLOR_WRITE_ENABLE
+{
+	D3D12_COLOR_WRITE_ENABLE_RED = 1,
+	D3D12_COLOR_WRITE_ENABLE_GREEN = 2,
+	D3D12_COLOR_WRITE_ENABLE_BLUE = 4,
+	D3D12_COLOR_WRITE_ENABLE_ALPHA = 8,
+	D3D12_COLOR_WRITE_ENABLE_ALL = 15
+};
+
+#define D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT (8)
+
+struct D3D12_RENDER_TARGET_BLEND_DESC
+{
+	BOOL BlendEnable;
+	BOOL LogicOpEnable;
+	D3D12_BLEND SrcBlend;
+	D3D12_BLEND DestBlend;
+	D3D12_BLEND_OP BlendOp;
+	D3D12_BLEND SrcBlendAlpha;
+	D3D12_BLEND DestBlendAlpha;
+	D3D12_BLEND_OP BlendOpAlpha;
+	D3D12_LOGIC_OP LogicOp;
+	UINT8 RenderTargetWriteMask;
+};
+
+struct D3D12_BLEND_DESC
+{
+	BOOL AlphaToCoverageEnable;
+	BOOL IndependentBlendEnable;
+	D3D12_RENDER_TARGET_BLEND_DESC RenderTarget[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT];
+};
+
+enum D3D12_FILL_MODE
+{
+	D3D12_FILL_MODE_WIREFRAME = 2,
+	D3D12_FILL_MODE_SOLID = 3
+};
+
+enum D3D12_CULL_MODE
+{
+	D3D12_CULL_MODE_NONE = 1,
+	D3D12_CULL_MODE_FRONT = 2,
+	D3D12_CULL_MODE_BACK = 3
+};
+
+enum D3D12_CONSERVATIVE_RASTERIZATION_MODE
+{
+	D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF = 0,
+	D3D12_CONSERVATIVE_RASTERIZATION_MODE_ON = 1
+};
+
+#define D3D12_DEFAULT_DEPTH_BIAS (0)
+#define D3D12_DEFAULT_DEPTH_BIAS_CLAMP (0.0f)
+#define D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS (0.0f)
+
+struct D3D12_RASTERIZER_DESC
+{
+	D3D12_FILL_MODE FillMode;
+	D3D12_CULL_MODE CullMode;
+	BOOL FrontCounterClockwise;
+	INT DepthBias;
+	FLOAT DepthBiasClamp;
+	FLOAT SlopeScaledDepthBias;
+	BOOL DepthClipEnable;
+	BOOL MultisampleEnable;
+	BOOL AntialiasedLineEnable;
+	UINT ForcedSampleCount;
+	D3D12_CONSERVATIVE_RASTERIZATION_MODE ConservativeRaster;
+};
+
+enum D3D12_DEPTH_WRITE_MASK
+{
+	D3D12_DEPTH_WRITE_MASK_ZERO = 0,
+	D3D12_DEPTH_WRITE_MASK_ALL = 1
+};
+
+enum D3D12_COMPARISON_FUNC
+{
+	D3D12_COMPARISON_FUNC_NEVER = 1,
+	D3D12_COMPARISON_FUNC_LESS = 2,
+	D3D12_COMPARISON_FUNC_EQUAL = 3,
+	D3D12_COMPARISON_FUNC_LESS_EQUAL = 4,
+	D3D12_COMPARISON_FUNC_GREATER = 5,
+	D3D12_COMPARISON_FUNC_NOT_EQUAL = 6,
+	D3D12_COMPARISON_FUNC_GREATER_EQUAL = 7,
+	D3D12_COMPARISON_FUNC_ALWAYS = 8
+};
+
+enum D3D12_STENCIL_OP
+{
+	D3D12_STENCIL_OP_KEEP = 1,
+	D3D12_STENCIL_OP_ZERO = 2,
+	D3D12_STENCIL_OP_REPLACE = 3,
+	D3D12_STENCIL_OP_INCR_SAT = 4,
+	D3D12_STENCIL_OP_DECR_SAT = 5,
+	D3D12_STENCIL_OP_INVERT = 6,
+	D3D12_STENCIL_OP_INCR = 7,
+	D3D12_STENCIL_OP_DECR = 8
+};
+
+struct D3D12_DEPTH_STENCILOP_DESC
+{
+	D3D12_STENCIL_OP StencilFailOp;
+	D3D12_STENCIL_OP StencilDepthFailOp;
+	D3D12_STENCIL_OP StencilPassOp;
+	D3D12_COMPARISON_FUNC StencilFunc;
+};
+
+struct D3D12_DEPTH_STENCIL_DESC
+{
+	BOOL DepthEnable;
+	D3D12_DEPTH_WRITE_MASK DepthWriteMask;
+	D3D12_COMPARISON_FUNC DepthFunc;
+	BOOL StencilEnable;
+	UINT8 StencilReadMask;
+	UINT8 StencilWriteMask;
+	D3D12_DEPTH_STENCILOP_DESC FrontFace;
+	D3D12_DEPTH_STENCILOP_DESC BackFace;
+};
+
+enum D3D12_INDEX_BUFFER_STRIP_CUT_VALUE
+{
+	D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED = 0,
+	D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_0xFFFF = 1,
+	D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_0xFFFFFFFF = 2
+};
+
+enum D3D12_PRIMITIVE_TOPOLOGY_TYPE
+{
+	D3D12_PRIMITIVE_TOPOLOGY_TYPE_UNDEFINED = 0,
+	D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT = 1,
+	D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE = 2,
+	D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE = 3,
+	D3D12_PRIMITIVE_TOPOLOGY_TYPE_PATCH = 4
+};
+
+struct D3D12_CACHED_PIPELINE_STATE
+{
+	const void* pCachedBlob;
+	SIZE_T CachedBlobSizeInBytes;
+};
+
+enum D3D12_PIPELINE_STATE_FLAGS
+{
+	D3D12_PIPELINE_STATE_FLAG_NONE = 0,
+	D3D12_PIPELINE_STATE_FLAG_TOOL_DEBUG = 0x1
+};
+D3D12TYPES_FLAG_OPERATORS(D3D12_PIPELINE_STATE_FLAGS)
+
+struct D3D12_GRAPHICS_PIPELINE_STATE_DESC
+{
+	ID3D12RootSignature* pRootSignature;
+	D3D12_SHADER_BYTECODE VS;
+	D3D12_SHADER_BYTECODE PS;
+	D3D12_SHADER_BYTECODE DS;
+	D3D12_SHADER_BYTECODE HS;
+	D3D12_SHADER_BYTECODE GS;
+	D3D12_STREAM_OUTPUT_DESC StreamOutput;
+	D3D12_BLEND_DESC BlendState;
+	UINT SampleMask;
+	D3D12_RASTERIZER_DESC RasterizerState;
+	D3D12_DEPTH_STENCIL_DESC DepthStencilState;
+	D3D12_INPUT_LAYOUT_DESC InputLayout;
+	D3D12_INDEX_BUFFER_STRIP_CUT_VALUE IBStripCutValue;
+	D3D12_PRIMITIVE_TOPOLOGY_TYPE PrimitiveTopologyType;
+	UINT NumRenderTargets;
+	DXGI_FORMAT RTVFormats[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT];
+	DXGI_FORMAT DSVFormat;
+	DXGI_SAMPLE_DESC SampleDesc;
+	UINT NodeMask;
+	D3D12_CACHED_PIPELINE_STATE CachedPSO;
+	D3D12_PIPELINE_STATE_FLAGS Flags;
+};
+
+#undef D3D12TYPES_FLAG_OPERATORS
+
+#endif
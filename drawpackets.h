@@ -0,0 +1,205 @@
+#pragma once
+
+#include "d3d12types.h"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "drawsort.h"
+
+//everything one draw needs bound, laid out for the root signature in helpers.h:
+//root CBV at parameter 0 followed by descriptor tables.
+struct DrawPacket
+{
+	static const UINT MaxDescriptorHeaps = 2;
+	static const UINT MaxRootTables = 3;
+
+	uint64_t SortKey; //see DrawSortKey::Make
+
+	ID3D12PipelineState* Pipeline;
+	ID3D12RootSignature* RootSignature;
+	UINT DescriptorHeapCount;
+	ID3D12DescriptorHeap* DescriptorHeaps[MaxDescriptorHeaps];
+	D3D12_GPU_VIRTUAL_ADDRESS RootConstantBuffer; //root parameter 0
+	UINT RootTableCount;
+	D3D12_GPU_DESCRIPTOR_HANDLE RootTables[MaxRootTables]; //root parameters 1..RootTableCount
+	D3D_PRIMITIVE_TOPOLOGY Topology;
+	D3D12_VERTEX_BUFFER_VIEW VertexBuffer;
+	D3D12_INDEX_BUFFER_VIEW IndexBuffer; //BufferLocation 0 for a non-indexed draw
+
+	UINT VertexCount; //non-indexed draws only
+	UINT IndexCount; //indexed draws only
+	UINT InstanceCount;
+	UINT StartVertex; //first vertex, or base vertex added to every index of an indexed draw
+	UINT StartIndex;
+	UINT StartInstance;
+
+	bool IsIndexed() const { return IndexBuffer.BufferLocation != 0; }
+};
+
+struct DrawSubmitStatistics
+{
+	enum Call
+	{
+		SetPipelineState,
+		SetGraphicsRootSignature,
+		SetDescriptorHeaps,
+		SetGraphicsRootConstantBufferView,
+		SetGraphicsRootDescriptorTable,
+		IASetPrimitiveTopology,
+		IASetVertexBuffers,
+		IASetIndexBuffer,
+		CallCount
+	};
+
+	UINT Draws;
+	UINT Skipped; //packets without a pipeline, not compiled yet and without a fallback
+	UINT Emitted[CallCount]; //calls that reached the command list
+	UINT Elided[CallCount]; //calls dropped because the state was already set
+
+	UINT GetTotalEmitted() const { UINT total = 0; for (UINT i = 0; i < CallCount; ++i) total += Emitted[i]; return total; }
+	UINT GetTotalElided() const { UINT total = 0; for (UINT i = 0; i < CallCount; ++i) total += Elided[i]; return total; }
+};
+
+//collects the draws of a pass, sorts them by key and records them with redundant state changes removed.
+//Submit is a template so it records into anything with the ID3D12GraphicsCommandList methods it uses.
+class DrawList
+{
+public:
+	void Reset()
+	{
+		m_Packets.clear();
+		m_Order.clear();
+	}
+
+	void Add(const DrawPacket& packet)
+	{
+		DrawSortEntry entry = { packet.SortKey, static_cast<uint32_t>(m_Packets.size()) };
+		m_Packets.push_back(packet);
+		m_Order.push_back(entry);
+	}
+
+	void Sort()
+	{
+		RadixSortDraws(m_Order, m_Scratch);
+	}
+
+	//the command list state is assumed unknown on entry, as it is after Reset on the command list.
+	//Packets without a pipeline are skipped, AsyncPipelineCompiler::Resolve hands out null for a draw to skip.
+	template<typename CommandList>
+	void Submit(CommandList* commandList)
+	{
+		memset(&m_Stats, 0, sizeof(m_Stats));
+
+		const DrawPacket* prev = nullptr;
+		bool cbvBound = false;
+		D3D12_GPU_VIRTUAL_ADDRESS boundCbv = 0;
+		bool tableBound[DrawPacket::MaxRootTables] = {};
+		D3D12_GPU_DESCRIPTOR_HANDLE boundTables[DrawPacket::MaxRootTables] = {};
+		const D3D12_INDEX_BUFFER_VIEW* boundIndexBuffer = nullptr; //kept across non-indexed draws, they don't unbind it
+
+		for (const DrawSortEntry& entry : m_Order)
+		{
+			const DrawPacket& p = m_Packets[entry.Index];
+			if (!p.Pipeline)
+			{
+				++m_Stats.Skipped;
+				continue;
+			}
+
+			if (Changed(prev && prev->Pipeline == p.Pipeline, DrawSubmitStatistics::SetPipelineState))
+			{
+				commandList->SetPipelineState(p.Pipeline);
+			}
+
+			//a new root signature invalidates every root argument bound so far
+			if (Changed(prev && prev->RootSignature == p.RootSignature, DrawSubmitStatistics::SetGraphicsRootSignature))
+			{
+				commandList->SetGraphicsRootSignature(p.RootSignature);
+				cbvBound = false;
+				memset(tableBound, 0, sizeof(tableBound));
+			}
+
+			//tables point into the bound heaps, so rebind them after the heaps change
+			bool sameHeaps = prev && prev->DescriptorHeapCount == p.DescriptorHeapCount &&
+				memcmp(prev->DescriptorHeaps, p.DescriptorHeaps, p.DescriptorHeapCount * sizeof(p.DescriptorHeaps[0])) == 0;
+			if (Changed(sameHeaps, DrawSubmitStatistics::SetDescriptorHeaps))
+			{
+				commandList->SetDescriptorHeaps(p.DescriptorHeapCount, p.DescriptorHeaps);
+				memset(tableBound, 0, sizeof(tableBound));
+			}
+
+			if (Changed(cbvBound && boundCbv == p.RootConstantBuffer, DrawSubmitStatistics::SetGraphicsRootConstantBufferView))
+			{
+				commandList->SetGraphicsRootConstantBufferView(0, p.RootConstantBuffer);
+				boundCbv = p.RootConstantBuffer;
+				cbvBound = true;
+			}
+
+			for (UINT i = 0; i < p.RootTableCount; ++i)
+			{
+				if (Changed(tableBound[i] && boundTables[i].ptr == p.RootTables[i].ptr, DrawSubmitStatistics::SetGraphicsRootDescriptorTable))
+				{
+					commandList->SetGraphicsRootDescriptorTable(1 + i, p.RootTables[i]);
+					boundTables[i] = p.RootTables[i];
+					tableBound[i] = true;
+				}
+			}
+
+			if (Changed(prev && prev->Topology == p.Topology, DrawSubmitStatistics::IASetPrimitiveTopology))
+			{
+				commandList->IASetPrimitiveTopology(p.Topology);
+			}
+
+			bool sameVertexBuffer = prev &&
+				prev->VertexBuffer.BufferLocation == p.VertexBuffer.BufferLocation &&
+				prev->VertexBuffer.SizeInBytes == p.VertexBuffer.SizeInBytes &&
+				prev->VertexBuffer.StrideInBytes == p.VertexBuffer.StrideInBytes;
+			if (Changed(sameVertexBuffer, DrawSubmitStatistics::IASetVertexBuffers))
+			{
+				commandList->IASetVertexBuffers(0, 1, &p.VertexBuffer);
+			}
+
+			if (p.IsIndexed())
+			{
+				bool sameIndexBuffer = boundIndexBuffer &&
+					boundIndexBuffer->BufferLocation == p.IndexBuffer.BufferLocation &&
+					boundIndexBuffer->SizeInBytes == p.IndexBuffer.SizeInBytes &&
+					boundIndexBuffer->Format == p.IndexBuffer.Format;
+				if (Changed(sameIndexBuffer, DrawSubmitStatistics::IASetIndexBuffer))
+				{
+					commandList->IASetIndexBuffer(&p.IndexBuffer);
+					boundIndexBuffer = &p.IndexBuffer;
+				}
+				commandList->DrawIndexedInstanced(p.IndexCount, p.InstanceCount, p.StartIndex, static_cast<INT>(p.StartVertex), p.StartInstance);
+			}
+			else
+			{
+				commandList->DrawInstanced(p.VertexCount, p.InstanceCount, p.StartVertex, p.StartInstance);
+			}
+			++m_Stats.Draws;
+			prev = &p;
+		}
+	}
+
+	const DrawSubmitStatistics& GetStatistics() const { return m_Stats; }
+	size_t GetCount() const { return m_Packets.size(); }
+
+private:
+	//counts the call as elided or emitted, returns true when it has to be emitted.
+	bool Changed(bool same, DrawSubmitStatistics::Call call)
+	{
+		if (same)
+		{
+			++m_Stats.Elided[call];
+			return false;
+		}
+		++m_Stats.Emitted[call];
+		return true;
+	}
+
+	std::vector<DrawPacket> m_Packets;
+	std::vector<DrawSortEntry> m_Order;
+	std::vector<DrawSortEntry> m_Scratch;
+	DrawSubmitStatistics m_Stats;
+};
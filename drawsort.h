@@ -0,0 +1,106 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+//draw sort key, most expensive state change in the highest bits so sorting groups draws by it first:
+//
+//  63      56 55            40 39                    16 15             0
+//  | rootsig | pipeline       | material               | depth          |
+//
+//ids are small indices handed out by the caller (handle of the pipeline, material slot...), not pointers.
+//depth is the normalized view depth in [0,1], front to back when sorted ascending.
+namespace DrawSortKey
+{
+	const uint32_t RootSignatureBits = 8;
+	const uint32_t PipelineBits = 16;
+	const uint32_t MaterialBits = 24;
+	const uint32_t DepthBits = 16;
+
+	const uint32_t DepthShift = 0;
+	const uint32_t MaterialShift = DepthShift + DepthBits;
+	const uint32_t PipelineShift = MaterialShift + MaterialBits;
+	const uint32_t RootSignatureShift = PipelineShift + PipelineBits;
+
+	inline uint64_t QuantizeDepth(float depth)
+	{
+		if (!(depth > 0.0f)) return 0; //also catches NaN
+		if (depth >= 1.0f) return (1u << DepthBits) - 1;
+		return static_cast<uint64_t>(depth * float((1u << DepthBits) - 1));
+	}
+
+	inline uint64_t Make(uint32_t rootSignatureId, uint32_t pipelineId, uint32_t materialId, float depth)
+	{
+		assert(rootSignatureId < (1u << RootSignatureBits));
+		assert(pipelineId < (1u << PipelineBits));
+		assert(materialId < (1u << MaterialBits));
+		return (uint64_t(rootSignatureId) << RootSignatureShift) |
+			(uint64_t(pipelineId) << PipelineShift) |
+			(uint64_t(materialId) << MaterialShift) |
+			(QuantizeDepth(depth) << DepthShift);
+	}
+}
+
+struct DrawSortEntry
+{
+	uint64_t Key;
+	uint32_t Index;
+};
+
+//stable LSD radix sort on the 64 bit key, 8 bits per pass. Passes over a byte that is the same in
+//every key are skipped, which is most of them when only a few pipelines and materials are in use.
+//scratch is resized as needed and can be kept between frames to avoid reallocating.
+inline void RadixSortDraws(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch)
+{
+	const size_t count = entries.size();
+	if (count < 2)
+	{
+		return;
+	}
+	scratch.resize(count);
+
+	//one histogram per byte, built in a single pass over the keys
+	uint32_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t key = entries[i].Key;
+		for (uint32_t pass = 0; pass < 8; ++pass)
+		{
+			++histograms[pass][(key >> (pass * 8)) & 0xff];
+		}
+	}
+
+	DrawSortEntry* src = entries.data();
+	DrawSortEntry* dst = scratch.data();
+	for (uint32_t pass = 0; pass < 8; ++pass)
+	{
+		uint32_t* histogram = histograms[pass];
+		if (histogram[(src[0].Key >> (pass * 8)) & 0xff] == count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (uint32_t b = 0; b < 256; ++b)
+		{
+			uint32_t bucketSize = histogram[b];
+			histogram[b] = offset;
+			offset += bucketSize;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			dst[histogram[(src[i].Key >> (pass * 8)) & 0xff]++] = src[i];
+		}
+
+		DrawSortEntry* tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	if (src != entries.data())
+	{
+		entries.swap(scratch);
+	}
+}
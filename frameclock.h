@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+//time source in seconds of the frame pacer, the frame profiler and the tools, so pacing decisions and reports can
+//be replayed against a simulated clock.
+class FrameClock
+{
+public:
+	virtual ~FrameClock() {}
+	virtual double Now() = 0;
+	virtual void SleepUntil(double time) = 0;
+};
+
+class SteadyFrameClock : public FrameClock
+{
+public:
+	SteadyFrameClock() : m_Start(std::chrono::steady_clock::now()) {}
+
+	double Now() override
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+	}
+
+	void SleepUntil(double time) override
+	{
+		std::this_thread::sleep_until(m_Start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time)));
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_Start;
+};
+
+//only moves when told to. Sleeping jumps straight to the wake-up time.
+class SimulatedFrameClock : public FrameClock
+{
+public:
+	SimulatedFrameClock() : m_Now(0.0) {}
+
+	double Now() override { return m_Now; }
+	void SleepUntil(double time) override { if (time > m_Now) m_Now = time; }
+	void Advance(double seconds) { m_Now += seconds; }
+
+private:
+	double m_Now;
+};
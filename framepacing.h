@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "frameclock.h"
+
+enum class PresentMode
+{
+	Default, //FLIP_SEQUENTIAL, DXGI queues up to 3 frames ahead
+	LowLatency //FLIP_DISCARD, frame latency waitable object, tearing when vsync is off and the system supports it
+};
+
+struct FramePacingSettings
+{
+	PresentMode Mode;
+	uint32_t MaxFrameLatency; //frames the CPU may queue ahead of the display in low latency mode, 1 for the lowest latency
+	bool VSync;
+	double FrameRateCap; //frames per second, 0 for none. Low latency mode sleeps before input is sampled rather than after present.
+};
+
+//frame pacing decisions, independent of DXGI so they can run against a SimulatedFrameClock:
+//which swapchain features to use, where the frame rate cap sleeps, and how long it takes from sampling input
+//to handing the frame to Present. The swapchain side waits on the latency object, then calls BeginFrame right
+//before sampling input and EndFrame right after Present.
+class FramePacer
+{
+public:
+	struct Statistics
+	{
+		uint64_t Frames;
+		double AverageWait; //seconds spent in the latency wait and the frame rate cap
+		double AverageInputToPresent; //seconds from BeginFrame to EndFrame, the part of input-to-photon the CPU controls
+		double MaxInputToPresent;
+		double LastInputToPresent;
+	};
+
+	static const uint32_t DefaultFrameLatency = 3; //DXGI's default maximum frame latency
+
+	void Create(const FramePacingSettings& settings, FrameClock* clock, bool tearingSupported)
+	{
+		m_Settings = settings;
+		if (m_Settings.MaxFrameLatency == 0)
+		{
+			m_Settings.MaxFrameLatency = 1;
+		}
+		m_Clock = clock;
+		m_TearingSupported = tearingSupported;
+		m_InputTime = 0.0;
+		m_NextFrameTime = 0.0;
+		m_WaitTotal = 0.0;
+		m_LatencyTotal = 0.0;
+		m_Stats = Statistics();
+	}
+
+	bool IsLowLatency() const { return m_Settings.Mode == PresentMode::LowLatency; }
+	bool UseWaitableObject() const { return IsLowLatency(); }
+	bool UseTearing() const { return IsLowLatency() && !m_Settings.VSync && m_TearingSupported; }
+	uint32_t GetMaximumFrameLatency() const { return IsLowLatency() ? m_Settings.MaxFrameLatency : DefaultFrameLatency; }
+	uint32_t GetSyncInterval() const { return m_Settings.VSync ? 1 : 0; }
+
+	//call after waiting on the latency object, latencyWait is how long that took. Applies the frame rate cap in
+	//low latency mode and returns the time input is sampled at.
+	double BeginFrame(double latencyWait)
+	{
+		double waited = latencyWait;
+		double now = m_Clock->Now();
+		if (m_Settings.FrameRateCap > 0.0)
+		{
+			double interval = 1.0 / m_Settings.FrameRateCap;
+			if (IsLowLatency() && now < m_NextFrameTime)
+			{
+				m_Clock->SleepUntil(m_NextFrameTime);
+				waited += m_Clock->Now() - now;
+				now = m_Clock->Now();
+			}
+			//a late frame starts a new schedule instead of rushing to catch up
+			m_NextFrameTime = (now > m_NextFrameTime + interval) ? now + interval : m_NextFrameTime + interval;
+		}
+		m_WaitTotal += waited;
+		m_InputTime = now;
+		return now;
+	}
+
+	//call right after Present. In default mode the frame rate cap sleeps here, after the frame is queued.
+	void EndFrame()
+	{
+		double now = m_Clock->Now();
+		double latency = now - m_InputTime;
+		++m_Stats.Frames;
+		m_LatencyTotal += latency;
+		m_Stats.LastInputToPresent = latency;
+		if (latency > m_Stats.MaxInputToPresent)
+		{
+			m_Stats.MaxInputToPresent = latency;
+		}
+
+		if (!IsLowLatency() && m_Settings.FrameRateCap > 0.0 && now < m_NextFrameTime)
+		{
+			m_Clock->SleepUntil(m_NextFrameTime);
+			m_WaitTotal += m_Clock->Now() - now;
+		}
+	}
+
+	Statistics GetStatistics() const
+	{
+		Statistics stats = m_Stats;
+		if (stats.Frames)
+		{
+			stats.AverageWait = m_WaitTotal / double(stats.Frames);
+			stats.AverageInputToPresent = m_LatencyTotal / double(stats.Frames);
+		}
+		return stats;
+	}
+
+	const FramePacingSettings& GetSettings() const { return m_Settings; }
+
+private:
+	FramePacingSettings m_Settings;
+	FrameClock* m_Clock;
+	bool m_TearingSupported;
+	double m_InputTime;
+	double m_NextFrameTime;
+	double m_WaitTotal;
+	double m_LatencyTotal;
+	Statistics m_Stats;
+};
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+
+#include "frameclock.h"
+
+//CPU timings of the frame loop: every frame is split into phases, the last historySize frames are kept in a ring
+//and reported as percentiles, since the tail (p99, max, hitches) is what makes a frame rate feel uneven.
+//A hitch is a frame taking more than hitchFactor times the median of the frames in the ring.
+//Times come from a FrameClock so reports can be checked against a SimulatedFrameClock.
+class FrameProfiler
+{
+public:
+	enum Phase
+	{
+		LatencyWait, //swapchain frame latency object and frame rate cap
+		EventPump,
+		ConstantUpdate,
+		Culling, //view frustum against the scene
+		Recording,
+		Submit,
+		Present,
+		FenceWait,
+		PhaseCount
+	};
+
+	typedef std::function<void(const char* line)> LogFunc;
+
+	//seconds
+	struct Percentiles
+	{
+		double P50;
+		double P95;
+		double P99;
+		double Max;
+		double Mean;
+	};
+
+	struct Report
+	{
+		uint32_t FrameCount;
+		Percentiles Frame;
+		Percentiles Phases[PhaseCount];
+		uint32_t Hitches;
+		double HitchThreshold;
+	};
+
+	void Create(FrameClock* clock, uint32_t historySize = 1024, double hitchFactor = 2.0)
+	{
+		assert(historySize > 0);
+		m_Clock = clock;
+		m_History.assign(historySize, Sample());
+		m_Next = 0;
+		m_Count = 0;
+		m_FrameIndex = 0;
+		m_HitchFactor = hitchFactor;
+		m_Phase = PhaseCount;
+		m_Log = nullptr;
+		m_ReportInterval = 0;
+		m_Current = Sample();
+	}
+
+	//a report goes to log every reportInterval frames, 0 to only report on request
+	void SetLog(LogFunc log, uint32_t reportInterval)
+	{
+		m_Log = log;
+		m_ReportInterval = reportInterval;
+	}
+
+	//periodic reports are also appended to a CSV file, one row each
+	bool OpenCsv(const char* fileName)
+	{
+		m_Csv.open(fileName, std::ios::trunc);
+		if (!m_Csv)
+		{
+			return false;
+		}
+		m_Csv << "frame,frames,p50_ms,p95_ms,p99_ms,max_ms,mean_ms,hitches";
+		for (uint32_t p = 0; p < PhaseCount; ++p)
+		{
+			m_Csv << "," << GetPhaseName(static_cast<Phase>(p)) << "_p50_ms," << GetPhaseName(static_cast<Phase>(p)) << "_p99_ms";
+		}
+		m_Csv << "\n";
+		return true;
+	}
+
+	void BeginFrame()
+	{
+		m_Current = Sample();
+		m_FrameStart = m_Clock->Now();
+		m_Phase = PhaseCount;
+	}
+
+	//ends the running phase, if any. A phase entered twice in a frame adds up.
+	void BeginPhase(Phase phase)
+	{
+		double now = m_Clock->Now();
+		CloseTimedPhase(now);
+		m_Phase = phase;
+		m_PhaseStart = now;
+	}
+
+	void EndPhase()
+	{
+		CloseTimedPhase(m_Clock->Now());
+	}
+
+	void EndFrame()
+	{
+		double now = m_Clock->Now();
+		CloseTimedPhase(now);
+		m_Current.Total = now - m_FrameStart;
+		m_History[m_Next] = m_Current;
+		m_Next = (m_Next + 1) % m_History.size();
+		m_Count = std::min<size_t>(m_Count + 1, m_History.size());
+		++m_FrameIndex;
+
+		if (m_ReportInterval && m_FrameIndex % m_ReportInterval == 0)
+		{
+			Report report = GetReport();
+			if (m_Log)
+			{
+				m_Log(FormatReport(report).c_str());
+			}
+			if (m_Csv)
+			{
+				WriteCsv(report);
+			}
+		}
+	}
+
+	Report GetReport() const
+	{
+		Report report = {};
+		report.FrameCount = static_cast<uint32_t>(m_Count);
+		if (!m_Count)
+		{
+			return report;
+		}
+
+		m_Scratch.resize(m_Count);
+		for (size_t i = 0; i < m_Count; ++i)
+		{
+			m_Scratch[i] = m_History[i].Total;
+		}
+		report.Frame = ComputePercentiles(m_Scratch);
+		report.HitchThreshold = report.Frame.P50 * m_HitchFactor;
+		for (size_t i = 0; i < m_Count; ++i)
+		{
+			report.Hitches += (m_History[i].Total > report.HitchThreshold) ? 1 : 0;
+		}
+
+		for (uint32_t p = 0; p < PhaseCount; ++p)
+		{
+			for (size_t i = 0; i < m_Count; ++i)
+			{
+				m_Scratch[i] = m_History[i].Phases[p];
+			}
+			report.Phases[p] = ComputePercentiles(m_Scratch);
+		}
+		return report;
+	}
+
+	//one line, milliseconds
+	static std::string FormatReport(const Report& report)
+	{
+		char buffer[160];
+		snprintf(buffer, sizeof(buffer), "frame ms p50 %.2f p95 %.2f p99 %.2f max %.2f, %u hitches over %.2f in %u frames |",
+			report.Frame.P50 * 1000.0, report.Frame.P95 * 1000.0, report.Frame.P99 * 1000.0, report.Frame.Max * 1000.0,
+			report.Hitches, report.HitchThreshold * 1000.0, report.FrameCount);
+		std::string line = buffer;
+		for (uint32_t p = 0; p < PhaseCount; ++p)
+		{
+			snprintf(buffer, sizeof(buffer), " %s %.2f/%.2f", GetPhaseName(static_cast<Phase>(p)),
+				report.Phases[p].P50 * 1000.0, report.Phases[p].P99 * 1000.0);
+			line += buffer;
+		}
+		line += "\n";
+		return line;
+	}
+
+	static const char* GetPhaseName(Phase phase)
+	{
+		static const char* names[PhaseCount] = { "LatencyWait", "EventPump", "ConstantUpdate", "Culling", "Recording", "Submit", "Present", "FenceWait" };
+		return names[phase];
+	}
+
+	uint64_t GetFrameIndex() const { return m_FrameIndex; }
+
+	//seconds the last recorded frame spent in a phase
+	double GetLastPhaseTime(Phase phase) const
+	{
+		return m_Count ? m_History[(m_Next + m_History.size() - 1) % m_History.size()].Phases[phase] : 0.0;
+	}
+
+private:
+	struct Sample
+	{
+		double Total;
+		double Phases[PhaseCount];
+	};
+
+	void CloseTimedPhase(double now)
+	{
+		if (m_Phase != PhaseCount)
+		{
+			m_Current.Phases[m_Phase] += now - m_PhaseStart;
+			m_Phase = PhaseCount;
+		}
+	}
+
+	//nearest rank, values is reordered
+	static Percentiles ComputePercentiles(std::vector<double>& values)
+	{
+		Percentiles result;
+		std::sort(values.begin(), values.end());
+		size_t count = values.size();
+		auto rank = [&](double p)
+		{
+			size_t index = static_cast<size_t>(p * double(count) + 0.999999);
+			return values[index ? std::min(index, count) - 1 : 0];
+		};
+		result.P50 = rank(0.50);
+		result.P95 = rank(0.95);
+		result.P99 = rank(0.99);
+		result.Max = values.back();
+		double sum = 0.0;
+		for (double v : values)
+		{
+			sum += v;
+		}
+		result.Mean = sum / double(count);
+		return result;
+	}
+
+	void WriteCsv(const Report& report)
+	{
+		m_Csv << m_FrameIndex << "," << report.FrameCount << ","
+			<< report.Frame.P50 * 1000.0 << "," << report.Frame.P95 * 1000.0 << "," << report.Frame.P99 * 1000.0 << ","
+			<< report.Frame.Max * 1000.0 << "," << report.Frame.Mean * 1000.0 << "," << report.Hitches;
+		for (uint32_t p = 0; p < PhaseCount; ++p)
+		{
+			m_Csv << "," << report.Phases[p].P50 * 1000.0 << "," << report.Phases[p].P99 * 1000.0;
+		}
+		m_Csv << "\n";
+		m_Csv.flush();
+	}
+
+	FrameClock* m_Clock;
+	std::vector<Sample> m_History;
+	size_t m_Next;
+	size_t m_Count;
+	uint64_t m_FrameIndex;
+	double m_HitchFactor;
+
+	Sample m_Current;
+	double m_FrameStart;
+	Phase m_Phase; //PhaseCount when no phase is running
+	double m_PhaseStart;
+
+	LogFunc m_Log;
+	uint32_t m_ReportInterval;
+	std::ofstream m_Csv;
+	mutable std::vector<double> m_Scratch;
+};
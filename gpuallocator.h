@@ -0,0 +1,308 @@
+#pragma once
+
+#include <assert.h>
+#include <wrl/client.h>
+#include <d3d12.h>
+#include <stdint.h>
+#include <vector>
+
+#include "tlsfallocator.h"
+
+//where a placed resource lives: which heap of which pool, and the range inside that heap.
+struct GpuAllocation
+{
+	uint32_t Pool;
+	uint32_t Heap;
+	TlsfAllocator::Allocation Range;
+};
+
+//places resources in large ID3D12Heap blocks instead of giving every resource its own implicit heap.
+//There is one pool per heap type and resource category, since resource heap tier 1 hardware can't mix
+//buffers, render target/depth textures and other textures in one heap. Each heap is sub-allocated with
+//a TlsfAllocator honouring the size and alignment reported by GetResourceAllocationInfo.
+//
+//Placed buffers still need 64KB alignment, so the savings come from textures (4KB small-resource
+//placement) and from packing many resources into few heaps. For lots of tiny buffers, place one large
+//buffer and hand out ranges of it with a TlsfAllocator directly.
+class GpuMemoryAllocator
+{
+public:
+	enum Category
+	{
+		Buffers,
+		Textures,
+		RenderTargets,
+		CategoryCount
+	};
+
+	struct Statistics
+	{
+		uint32_t HeapCount;
+		uint64_t ReservedBytes; //size of all ID3D12Heaps
+		uint64_t UsedBytes;
+		uint64_t LargestFreeBlock;
+		uint32_t AllocationCount;
+		uint32_t FreeBlockCount;
+		double Fragmentation; //free space weighted average over all heaps, see TlsfAllocator::Statistics
+	};
+
+	//resources bigger than heapSize get a heap of their own.
+	void Create(ID3D12Device* device, UINT64 heapSize = 64 * 1024 * 1024)
+	{
+		m_Device = device;
+		m_HeapSize = heapSize;
+		for (uint32_t i = 0; i < c_PoolCount; ++i)
+		{
+			m_Pools[i].Heaps.clear();
+		}
+	}
+
+	HRESULT CreatePlacedResource(
+		D3D12_HEAP_TYPE heapType,
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_RESOURCE_STATES initialState,
+		_In_opt_ const D3D12_CLEAR_VALUE* clearValue,
+		_Outptr_ ID3D12Resource** resourceOut,
+		_Out_ GpuAllocation* allocationOut)
+	{
+		Category category = GetCategory(desc);
+
+		//textures that fit in 64KB can use 4KB placement, the runtime tells us if this one does
+		D3D12_RESOURCE_DESC placedDesc = desc;
+		D3D12_RESOURCE_ALLOCATION_INFO info;
+		if (category == Textures && desc.Alignment == 0)
+		{
+			placedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+			info = m_Device->GetResourceAllocationInfo(0, 1, &placedDesc);
+			if (info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+			{
+				placedDesc.Alignment = 0;
+				info = m_Device->GetResourceAllocationInfo(0, 1, &placedDesc);
+			}
+		}
+		else
+		{
+			info = m_Device->GetResourceAllocationInfo(0, 1, &placedDesc);
+		}
+		if (info.SizeInBytes == UINT64_MAX)
+		{
+			return E_INVALIDARG;
+		}
+
+		uint32_t poolIndex = GetPoolIndex(heapType, category);
+		Pool& pool = m_Pools[poolIndex];
+
+		GpuAllocation allocation;
+		allocation.Pool = poolIndex;
+		allocation.Heap = UINT32_MAX;
+		for (uint32_t i = 0; i < pool.Heaps.size(); ++i)
+		{
+			if (pool.Heaps[i].Heap && pool.Heaps[i].Ranges.Allocate(info.SizeInBytes, info.Alignment, allocation.Range))
+			{
+				allocation.Heap = i;
+				break;
+			}
+		}
+		if (allocation.Heap == UINT32_MAX)
+		{
+			HRESULT hr = AddHeap(pool, heapType, category, info.SizeInBytes > m_HeapSize ? info.SizeInBytes : m_HeapSize, allocation.Heap);
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+			bool allocated = pool.Heaps[allocation.Heap].Ranges.Allocate(info.SizeInBytes, info.Alignment, allocation.Range);
+			assert(allocated);
+			(void)allocated;
+		}
+
+		HRESULT hr = m_Device->CreatePlacedResource(
+			pool.Heaps[allocation.Heap].Heap.Get(),
+			allocation.Range.Offset,
+			&placedDesc,
+			initialState,
+			clearValue,
+			IID_PPV_ARGS(resourceOut));
+		if (FAILED(hr))
+		{
+			pool.Heaps[allocation.Heap].Ranges.Free(allocation.Range);
+			return hr;
+		}
+
+		*allocationOut = allocation;
+		return hr;
+	}
+
+	//returns the memory of a placed resource. The resource must already be released and no longer in use by the GPU.
+	void Free(const GpuAllocation& allocation)
+	{
+		m_Pools[allocation.Pool].Heaps[allocation.Heap].Ranges.Free(allocation.Range);
+	}
+
+	//destroys heaps without any resource left in them, e.g. after a level unload.
+	void ReleaseEmptyHeaps()
+	{
+		for (uint32_t i = 0; i < c_PoolCount; ++i)
+		{
+			for (auto& heap : m_Pools[i].Heaps)
+			{
+				if (heap.Heap && heap.Ranges.IsEmpty())
+				{
+					heap.Heap.Reset();
+				}
+			}
+		}
+	}
+
+	//the heap a placed resource lives in, e.g. to mark it used with GpuResidencyManager.
+	ID3D12Heap* GetHeap(const GpuAllocation& allocation) const
+	{
+		return m_Pools[allocation.Pool].Heaps[allocation.Heap].Heap.Get();
+	}
+
+	//every heap in use, e.g. to register with GpuResidencyManager, which can only page whole heaps.
+	//Heaps are added while placing resources, so collect them again after creating more.
+	void GetHeaps(std::vector<ID3D12Heap*>& heaps) const
+	{
+		heaps.clear();
+		for (uint32_t i = 0; i < c_PoolCount; ++i)
+		{
+			for (const auto& heap : m_Pools[i].Heaps)
+			{
+				if (heap.Heap)
+				{
+					heaps.push_back(heap.Heap.Get());
+				}
+			}
+		}
+	}
+
+	Statistics GetStatistics(D3D12_HEAP_TYPE heapType, Category category) const
+	{
+		return GetStatistics(&m_Pools[GetPoolIndex(heapType, category)], 1);
+	}
+
+	Statistics GetStatistics() const
+	{
+		return GetStatistics(m_Pools, c_PoolCount);
+	}
+
+private:
+	static const uint32_t c_HeapTypeCount = 3; //default, upload, readback
+	static const uint32_t c_PoolCount = c_HeapTypeCount * CategoryCount;
+
+	struct HeapBlock
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Heap; //null once released, the slot is reused by AddHeap
+		TlsfAllocator Ranges;
+	};
+
+	struct Pool
+	{
+		std::vector<HeapBlock> Heaps;
+	};
+
+	static Category GetCategory(const D3D12_RESOURCE_DESC& desc)
+	{
+		if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		{
+			return Buffers;
+		}
+		if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		{
+			return RenderTargets;
+		}
+		return Textures;
+	}
+
+	static uint32_t GetPoolIndex(D3D12_HEAP_TYPE heapType, Category category)
+	{
+		uint32_t typeIndex = 0;
+		switch (heapType)
+		{
+		case D3D12_HEAP_TYPE_DEFAULT: typeIndex = 0; break;
+		case D3D12_HEAP_TYPE_UPLOAD: typeIndex = 1; break;
+		case D3D12_HEAP_TYPE_READBACK: typeIndex = 2; break;
+		default: assert(!"custom heaps are not pooled"); break;
+		}
+		return typeIndex * CategoryCount + category;
+	}
+
+	HRESULT AddHeap(Pool& pool, D3D12_HEAP_TYPE heapType, Category category, UINT64 size, uint32_t& indexOut)
+	{
+		static const D3D12_HEAP_FLAGS categoryFlags[CategoryCount] =
+		{
+			D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+		};
+
+		D3D12_HEAP_DESC heapDesc;
+		ZeroMemory(&heapDesc, sizeof(heapDesc));
+		heapDesc.SizeInBytes = size;
+		heapDesc.Properties.Type = heapType;
+		heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+		heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+		heapDesc.Properties.CreationNodeMask = 1;
+		heapDesc.Properties.VisibleNodeMask = 1;
+		//64KB covers every placement except MSAA render targets, which need 4MB
+		heapDesc.Alignment = (category == RenderTargets) ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		heapDesc.Flags = categoryFlags[category];
+
+		HeapBlock block;
+		HRESULT hr = m_Device->CreateHeap(&heapDesc, IID_PPV_ARGS(block.Heap.GetAddressOf()));
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+		block.Ranges.Create(size);
+
+		for (uint32_t i = 0; i < pool.Heaps.size(); ++i)
+		{
+			if (!pool.Heaps[i].Heap)
+			{
+				pool.Heaps[i] = block;
+				indexOut = i;
+				return hr;
+			}
+		}
+		pool.Heaps.push_back(block);
+		indexOut = static_cast<uint32_t>(pool.Heaps.size() - 1);
+		return hr;
+	}
+
+	static Statistics GetStatistics(const Pool* pools, uint32_t poolCount)
+	{
+		Statistics stats;
+		ZeroMemory(&stats, sizeof(stats));
+		uint64_t freeBytes = 0;
+		double weightedFragmentation = 0.0;
+		for (uint32_t p = 0; p < poolCount; ++p)
+		{
+			for (const auto& heap : pools[p].Heaps)
+			{
+				if (!heap.Heap)
+				{
+					continue;
+				}
+				TlsfAllocator::Statistics rangeStats = heap.Ranges.GetStatistics();
+				++stats.HeapCount;
+				stats.ReservedBytes += rangeStats.Capacity;
+				stats.UsedBytes += rangeStats.UsedBytes;
+				stats.AllocationCount += rangeStats.AllocationCount;
+				stats.FreeBlockCount += rangeStats.FreeBlockCount;
+				if (rangeStats.LargestFreeBlock > stats.LargestFreeBlock)
+				{
+					stats.LargestFreeBlock = rangeStats.LargestFreeBlock;
+				}
+				freeBytes += rangeStats.FreeBytes;
+				weightedFragmentation += rangeStats.GetFragmentation() * double(rangeStats.FreeBytes);
+			}
+		}
+		stats.Fragmentation = freeBytes ? weightedFragmentation / double(freeBytes) : 0.0;
+		return stats;
+	}
+
+	ID3D12Device* m_Device;
+	UINT64 m_HeapSize;
+	Pool m_Pools[c_PoolCount];
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <wrl/client.h>
+#include <d3d12.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "indirectdraw.h"
+
+//GPU driven drawing. The bounds of every object and a command record drawing it live in upload buffers.
+//A compute pass culls the objects against the frustum and appends the records of the visible ones to the
+//command buffer, and a single ExecuteIndirect draws them with the count the pass left in the count buffer.
+//The CPU records the same handful of calls however many objects there are.
+//Every frame on one command list: RecordClear with the count buffer in COPY_DEST, RecordCull with both buffers
+//in UNORDERED_ACCESS, then RecordDraw with both in INDIRECT_ARGUMENT after setting the graphics state the
+//records don't change. Both buffers are created in INDIRECT_ARGUMENT.
+//The objects are written in place, so the GPU must be done with the previous frame before they change.
+class GpuIndirectCuller
+{
+public:
+	enum RootParameter
+	{
+		RootConstants, //GpuCullConstants
+		RootObjects,
+		RootTemplates,
+		RootCommands,
+		RootCount,
+		RootParameterCount
+	};
+
+	static const uint32_t ThreadGroupSize = 64; //numthreads of CSCull
+
+	//layout describes the records; graphicsRootSignature is what they are drawn with, needed when the layout
+	//changes root arguments. cullShader is CSCull from Culling.hlsl.
+	void Create(
+		ID3D12Device* device,
+		const IndirectCommandLayout& layout,
+		_In_opt_ ID3D12RootSignature* graphicsRootSignature,
+		const Shader& cullShader,
+		uint32_t maxObjects)
+	{
+		ThrowIfFailed(layout.Validate());
+		m_Layout = layout;
+		m_MaxObjects = maxObjects;
+		m_ObjectCount = 0;
+
+		//root constants and root descriptors only, so the pass needs no descriptor heap. 28 + 4 * 2 = 36/64 dwords
+		D3D12_ROOT_PARAMETER rootParams[RootParameterCount];
+		ZeroMemory(rootParams, sizeof(rootParams));
+		rootParams[RootConstants].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+		rootParams[RootConstants].Constants.Num32BitValues = GpuCullConstants::Count;
+		rootParams[RootObjects].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+		rootParams[RootTemplates].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+		rootParams[RootTemplates].Descriptor.ShaderRegister = 1;
+		rootParams[RootCommands].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+		rootParams[RootCount].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+		rootParams[RootCount].Descriptor.ShaderRegister = 1;
+		for (auto& param : rootParams)
+		{
+			param.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+		}
+
+		D3D12_ROOT_SIGNATURE_DESC descRootSignature = D3D12_ROOT_SIGNATURE_DESC();
+		descRootSignature.NumParameters = RootParameterCount;
+		descRootSignature.pParameters = rootParams;
+		m_RootSignature.Create(device, descRootSignature);
+		m_Pipeline.Create(device, m_RootSignature, cullShader);
+
+		D3D12_COMMAND_SIGNATURE_DESC signatureDesc = m_Layout.GetDesc();
+		ThrowIfFailed(
+			device->CreateCommandSignature(
+				&signatureDesc, m_Layout.NeedsRootSignature() ? graphicsRootSignature : nullptr,
+				IID_PPV_ARGS(m_CommandSignature.ReleaseAndGetAddressOf()))
+			);
+
+		UINT64 commandBytes = UINT64(maxObjects) * m_Layout.GetByteStride();
+		ThrowIfFailed(m_Objects.Create(device, maxObjects * sizeof(GpuCullObject), D3D12_HEAP_TYPE_UPLOAD));
+		ThrowIfFailed(m_Templates.Create(device, static_cast<SIZE_T>(commandBytes), D3D12_HEAP_TYPE_UPLOAD));
+		ThrowIfFailed(m_Zero.Create(device, sizeof(uint32_t), D3D12_HEAP_TYPE_UPLOAD));
+		memset(m_Zero.pDataBegin, 0, sizeof(uint32_t));
+		ThrowIfFailed(CreateArgumentBuffer(device, commandBytes, m_Commands));
+		ThrowIfFailed(CreateArgumentBuffer(device, sizeof(uint32_t), m_Count));
+	}
+
+	//the object is drawn by its record, fill it in through GetLayout().Write(GetCommandRecord(object), ...)
+	uint32_t AddObject(const SceneBounds& bounds)
+	{
+		assert(m_ObjectCount < m_MaxObjects);
+		uint32_t object = m_ObjectCount++;
+		SetBounds(object, bounds);
+		return object;
+	}
+
+	void SetBounds(uint32_t object, const SceneBounds& bounds)
+	{
+		reinterpret_cast<GpuCullObject*>(m_Objects.pDataBegin)[object] = GpuCullObject::Make(bounds, object);
+	}
+
+	void* GetCommandRecord(uint32_t object) { return m_Templates.pDataBegin + size_t(object) * m_Layout.GetByteStride(); }
+
+	void RecordClear(ID3D12GraphicsCommandList* commandList)
+	{
+		commandList->CopyBufferRegion(m_Count.Get(), 0, m_Zero.pBuf.Get(), 0, sizeof(uint32_t));
+	}
+
+	void RecordCull(ID3D12GraphicsCommandList* commandList, const Frustum& frustum)
+	{
+		if (!m_ObjectCount)
+		{
+			return;
+		}
+		GpuCullConstants constants = GpuCullConstants::Make(frustum, m_ObjectCount, m_Layout, m_MaxObjects);
+		commandList->SetComputeRootSignature(m_RootSignature.Get());
+		commandList->SetPipelineState(m_Pipeline.Get());
+		commandList->SetComputeRoot32BitConstants(RootConstants, GpuCullConstants::Count, &constants, 0);
+		commandList->SetComputeRootShaderResourceView(RootObjects, m_Objects.pBuf->GetGPUVirtualAddress());
+		commandList->SetComputeRootShaderResourceView(RootTemplates, m_Templates.pBuf->GetGPUVirtualAddress());
+		commandList->SetComputeRootUnorderedAccessView(RootCommands, m_Commands->GetGPUVirtualAddress());
+		commandList->SetComputeRootUnorderedAccessView(RootCount, m_Count->GetGPUVirtualAddress());
+		commandList->Dispatch((m_ObjectCount + ThreadGroupSize - 1) / ThreadGroupSize, 1, 1);
+	}
+
+	void RecordDraw(ID3D12GraphicsCommandList* commandList)
+	{
+		if (!m_ObjectCount)
+		{
+			return;
+		}
+		commandList->ExecuteIndirect(m_CommandSignature.Get(), m_ObjectCount, m_Commands.Get(), 0, m_Count.Get(), 0);
+	}
+
+	const IndirectCommandLayout& GetLayout() const { return m_Layout; }
+	uint32_t GetObjectCount() const { return m_ObjectCount; }
+	ID3D12Resource* GetCommandBuffer() const { return m_Commands.Get(); }
+	ID3D12Resource* GetCountBuffer() const { return m_Count.Get(); }
+
+private:
+	static HRESULT CreateArgumentBuffer(ID3D12Device* device, UINT64 size, Microsoft::WRL::ComPtr<ID3D12Resource>& buffer)
+	{
+		D3D12_HEAP_PROPERTIES heapProps;
+		ZeroMemory(&heapProps, sizeof(heapProps));
+		heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+		heapProps.CreationNodeMask = 1;
+		heapProps.VisibleNodeMask = 1;
+
+		D3D12_RESOURCE_DESC bufferDesc;
+		ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+		bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		bufferDesc.Width = size;
+		bufferDesc.Height = 1;
+		bufferDesc.DepthOrArraySize = 1;
+		bufferDesc.MipLevels = 1;
+		bufferDesc.SampleDesc.Count = 1;
+		bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		bufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+		return device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, nullptr, IID_PPV_ARGS(buffer.ReleaseAndGetAddressOf()));
+	}
+
+	IndirectCommandLayout m_Layout;
+	uint32_t m_MaxObjects;
+	uint32_t m_ObjectCount;
+	RootSignature m_RootSignature;
+	ComputePipelineStateObject m_Pipeline;
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> m_CommandSignature;
+	CUploadBufferWrapper m_Objects; //GpuCullObject per object
+	CUploadBufferWrapper m_Templates; //command record per object
+	CUploadBufferWrapper m_Zero; //source of the count clear
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_Commands;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_Count;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <d3d12.h>
+#include <stdint.h>
+
+#include "helpers.h"
+#include "meshfile.h"
+#include "scene.h"
+
+//a mesh file's vertex and index buffers in video memory. The payloads go from the mapped file into the staging
+//buffer in one copy each, see BufferResource::_CreateStatic; nothing is parsed or converted per vertex.
+//The pipelines drawing it take the file's GetInputLayoutDesc, which is only valid while the file is open.
+class GpuMesh
+{
+public:
+	void Create(
+		ID3D12Device* device,
+		ID3D12GraphicsCommandList* cmdList,
+		CUploadBufferWrapper* uploadBuffer,
+		const MeshFile& file,
+		_In_opt_ GpuMemoryAllocator* allocator = nullptr)
+	{
+		const MeshFileHeader& header = file.GetHeader();
+		m_VB.CreateStatic(
+			device, cmdList, uploadBuffer,
+			static_cast<int32_t>(file.GetVertexBytes()), header.VertexStride, file.GetVertices(), allocator);
+		m_IB.CreateStatic(
+			device, cmdList, uploadBuffer,
+			static_cast<int32_t>(file.GetIndexBytes()), file.GetIndexFormat(), file.GetIndices(), allocator);
+		m_Quantization = file.GetQuantization();
+		m_Bounds = SceneBounds::FromBox(header.BoundsMin, header.BoundsMax);
+	}
+
+	void Release()
+	{
+		m_VB.Release();
+		m_IB.Release();
+	}
+
+	const VertexBufferResource& GetVertexBuffer() const { return m_VB; }
+	const IndexBufferResource& GetIndexBuffer() const { return m_IB; }
+	uint32_t GetIndexCount() const { return static_cast<uint32_t>(m_IB.GetIndexCount()); }
+	const PositionQuantization& GetQuantization() const { return m_Quantization; }
+	//of the positions in the mesh's own space, before any world transform
+	const SceneBounds& GetBounds() const { return m_Bounds; }
+
+private:
+	VertexBufferResource m_VB;
+	IndexBufferResource m_IB;
+	PositionQuantization m_Quantization;
+	SceneBounds m_Bounds;
+};
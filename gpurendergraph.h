@@ -0,0 +1,333 @@
+#pragma once
+
+#include <wrl/client.h>
+#include <d3d12.h>
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+#include "hashing.h"
+#include "rendergraph.h"
+#include "resourcestates.h"
+#include "gputimestamps.h"
+
+//records a RenderGraph on a D3D12 command list.
+//Build the graph every frame: Reset, Import the resources that live outside it, CreateTexture the intermediate
+//targets, AddPass with the function recording the pass and declare its reads and writes. Compile culls the unused
+//passes and places the transients in one heap per heap class; the placed resources are kept as long as the layout
+//doesn't change from frame to frame. Execute then records, before every pass, its aliasing barriers and state
+//transitions as one batch through the ResourceStateTracker, so imported resources keep their tracked state.
+//Split transitions become BEGIN_ONLY/END_ONLY barrier pairs.
+class GpuRenderGraph
+{
+public:
+	typedef RenderGraph::ResourceHandle ResourceHandle;
+	typedef RenderGraph::PassHandle PassHandle;
+	typedef std::function<void(ID3D12GraphicsCommandList* commandList)> ExecuteFunc;
+
+	static_assert(RenderGraph::UnorderedAccessState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS, "graph UAV state must match D3D12");
+
+	enum HeapClass
+	{
+		RenderTargetHeap, //render target and depth stencil textures
+		TextureHeap,
+		BufferHeap,
+		HeapClassCount
+	};
+
+	void Create(ID3D12Device* device, ResourceStateTracker* states)
+	{
+		m_Device = device;
+		m_States = states;
+		m_Timestamps = nullptr;
+		m_LayoutHash = 0;
+		Reset();
+	}
+
+	//starts declaring the next frame's graph
+	void Reset()
+	{
+		m_Graph.Reset();
+		m_Resources.clear();
+		m_Descs.clear();
+		m_ClearValues.clear();
+		m_HasClearValue.clear();
+		m_Execute.clear();
+	}
+
+	//resource must be registered with the state tracker, it is transitioned to finalState after the last pass.
+	ResourceHandle Import(ID3D12Resource* resource, D3D12_RESOURCE_STATES finalState)
+	{
+		AddResourceSlot(resource, nullptr, nullptr);
+		return m_Graph.Import(m_States->GetState(resource), finalState);
+	}
+
+	//the first pass writing a render target or depth texture must clear or discard it, the memory is shared
+	//with other transients. clearValue is required for render targets and depth stencils.
+	ResourceHandle CreateTexture(const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* clearValue = nullptr)
+	{
+		D3D12_RESOURCE_ALLOCATION_INFO info = m_Device->GetResourceAllocationInfo(0, 1, &desc);
+		RenderGraph::TransientDesc transient;
+		transient.Size = info.SizeInBytes;
+		transient.Alignment = info.Alignment;
+		transient.HeapClass = GetHeapClass(desc);
+		AddResourceSlot(nullptr, &desc, clearValue);
+		return m_Graph.CreateTransient(transient);
+	}
+
+	PassHandle AddPass(const char* name, ExecuteFunc execute)
+	{
+		m_Execute.push_back(execute);
+		return m_Graph.AddPass(name);
+	}
+
+	//every pass is then timed on the GPU under its name
+	void SetTimestampProfiler(GpuTimestampProfiler* timestamps) { m_Timestamps = timestamps; }
+
+	void SetNeverCull(PassHandle pass) { m_Graph.SetNeverCull(pass); }
+	void Read(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state) { m_Graph.Read(pass, resource, state); }
+	void Write(PassHandle pass, ResourceHandle resource, D3D12_RESOURCE_STATES state) { m_Graph.Write(pass, resource, state); }
+
+	//creates the heaps and placed resources when the transient layout differs from the last compile. The GPU must
+	//be done with the previous frame's transients at that point, as it is with the back buffers on a resize.
+	HRESULT Compile()
+	{
+		if (!m_Graph.Compile())
+		{
+			return E_INVALIDARG;
+		}
+
+		uint64_t layoutHash = HashLayout();
+		if (layoutHash != m_LayoutHash)
+		{
+			HRESULT hr = CreateTransients();
+			if (FAILED(hr))
+			{
+				m_LayoutHash = 0;
+				return hr;
+			}
+			m_LayoutHash = layoutHash;
+		}
+
+		//the graph's handles refer to this frame's declarations, point them at the placed resources
+		for (ResourceHandle r = 0; r < m_Graph.GetResourceCount(); ++r)
+		{
+			if (m_Graph.IsAllocated(r))
+			{
+				m_Resources[r] = m_Placed[r].Get();
+			}
+		}
+		return S_OK;
+	}
+
+	void Execute(ID3D12GraphicsCommandList* commandList)
+	{
+		for (const auto& pass : m_Graph.GetSchedule())
+		{
+			const RenderGraph::AliasingBarrier* aliasing = m_Graph.GetAliasingBarriers(pass);
+			for (uint32_t i = 0; i < pass.AliasingBarrierCount; ++i)
+			{
+				ID3D12Resource* before = (aliasing[i].Before == RenderGraph::InvalidResource) ? nullptr : m_Resources[aliasing[i].Before];
+				m_States->Alias(before, m_Resources[aliasing[i].After]);
+			}
+
+			//the tracker already knows the before-states, including where the last frame left the transients
+			const RenderGraph::Barrier* barriers = m_Graph.GetBarriers(pass);
+			for (uint32_t i = 0; i < pass.BarrierCount; ++i)
+			{
+				RecordBarrier(barriers[i]);
+			}
+			m_States->Flush(commandList);
+
+			GpuTimestampScope scope(m_Timestamps, commandList, m_Graph.GetPassName(pass.Pass));
+			m_Execute[pass.Pass](commandList);
+		}
+
+		for (const auto& barrier : m_Graph.GetFinalBarriers())
+		{
+			RecordBarrier(barrier);
+		}
+		m_States->Flush(commandList);
+	}
+
+	//valid after Compile, null for transients of culled passes
+	ID3D12Resource* GetResource(ResourceHandle resource) const { return m_Resources[resource]; }
+	const RenderGraph& GetGraph() const { return m_Graph; }
+
+private:
+	void RecordBarrier(const RenderGraph::Barrier& barrier)
+	{
+		ID3D12Resource* resource = m_Resources[barrier.Resource];
+		D3D12_RESOURCE_STATES after = static_cast<D3D12_RESOURCE_STATES>(barrier.After);
+		if (barrier.Before == barrier.After)
+		{
+			m_States->UavBarrier(resource);
+		}
+		else if (barrier.Split == RenderGraph::SplitBegin)
+		{
+			m_States->BeginTransition(resource, after);
+		}
+		else if (barrier.Split == RenderGraph::SplitEnd)
+		{
+			m_States->EndTransition(resource, after);
+		}
+		else
+		{
+			m_States->Transition(resource, after);
+		}
+	}
+
+	void AddResourceSlot(ID3D12Resource* resource, const D3D12_RESOURCE_DESC* desc, const D3D12_CLEAR_VALUE* clearValue)
+	{
+		D3D12_RESOURCE_DESC resourceDesc;
+		D3D12_CLEAR_VALUE clear;
+		ZeroMemory(&resourceDesc, sizeof(resourceDesc));
+		ZeroMemory(&clear, sizeof(clear));
+		if (desc)
+		{
+			resourceDesc = *desc;
+		}
+		if (clearValue)
+		{
+			clear = *clearValue;
+		}
+		m_Resources.push_back(resource);
+		m_Descs.push_back(resourceDesc);
+		m_ClearValues.push_back(clear);
+		m_HasClearValue.push_back(clearValue != nullptr);
+	}
+
+	static uint32_t GetHeapClass(const D3D12_RESOURCE_DESC& desc)
+	{
+		if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		{
+			return BufferHeap;
+		}
+		if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		{
+			return RenderTargetHeap;
+		}
+		return TextureHeap;
+	}
+
+	//everything that decides the heaps and placed resources, member by member since the descs contain padding
+	uint64_t HashLayout() const
+	{
+		Hasher hasher;
+		for (uint32_t heap = 0; heap < HeapClassCount; ++heap)
+		{
+			hasher.Add(m_Graph.GetHeapSize(heap));
+		}
+		for (ResourceHandle r = 0; r < m_Graph.GetResourceCount(); ++r)
+		{
+			if (!m_Graph.IsAllocated(r))
+			{
+				hasher.Add(uint8_t(0));
+				continue;
+			}
+			const D3D12_RESOURCE_DESC& desc = m_Descs[r];
+			hasher.Add(m_Graph.GetHeapOffset(r));
+			hasher.Add(m_Graph.GetFirstState(r));
+			hasher.Add(desc.Dimension).Add(desc.Alignment).Add(desc.Width).Add(desc.Height);
+			hasher.Add(desc.DepthOrArraySize).Add(desc.MipLevels).Add(desc.Format);
+			hasher.Add(desc.SampleDesc.Count).Add(desc.SampleDesc.Quality).Add(desc.Layout).Add(desc.Flags);
+
+			const D3D12_CLEAR_VALUE& clear = m_ClearValues[r];
+			hasher.Add(m_HasClearValue[r]).Add(clear.Format);
+			if (desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)
+			{
+				hasher.Add(clear.DepthStencil.Depth).Add(clear.DepthStencil.Stencil);
+			}
+			else
+			{
+				hasher.Add(clear.Color[0]).Add(clear.Color[1]).Add(clear.Color[2]).Add(clear.Color[3]);
+			}
+		}
+		return hasher.Get();
+	}
+
+	HRESULT CreateTransients()
+	{
+		for (auto& placed : m_Placed)
+		{
+			if (placed)
+			{
+				m_States->Unregister(placed.Get());
+			}
+		}
+		m_Placed.clear();
+
+		static const D3D12_HEAP_FLAGS heapFlags[HeapClassCount] =
+		{
+			D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+		};
+		for (uint32_t heap = 0; heap < HeapClassCount; ++heap)
+		{
+			m_Heaps[heap].Reset();
+			UINT64 size = m_Graph.GetHeapSize(heap);
+			if (!size)
+			{
+				continue;
+			}
+
+			D3D12_HEAP_DESC heapDesc;
+			ZeroMemory(&heapDesc, sizeof(heapDesc));
+			heapDesc.SizeInBytes = size;
+			heapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+			heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+			heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+			heapDesc.Properties.CreationNodeMask = 1;
+			heapDesc.Properties.VisibleNodeMask = 1;
+			heapDesc.Alignment = (heap == RenderTargetHeap) ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+			heapDesc.Flags = heapFlags[heap];
+			HRESULT hr = m_Device->CreateHeap(&heapDesc, IID_PPV_ARGS(m_Heaps[heap].GetAddressOf()));
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+		}
+
+		m_Placed.resize(m_Graph.GetResourceCount());
+		for (ResourceHandle r = 0; r < m_Graph.GetResourceCount(); ++r)
+		{
+			if (!m_Graph.IsAllocated(r))
+			{
+				continue;
+			}
+			//created in the state of its first use, so the first frame needs no transition
+			D3D12_RESOURCE_STATES state = static_cast<D3D12_RESOURCE_STATES>(m_Graph.GetFirstState(r));
+			HRESULT hr = m_Device->CreatePlacedResource(
+				m_Heaps[m_Graph.GetTransientDesc(r).HeapClass].Get(),
+				m_Graph.GetHeapOffset(r),
+				&m_Descs[r],
+				state,
+				m_HasClearValue[r] ? &m_ClearValues[r] : nullptr,
+				IID_PPV_ARGS(m_Placed[r].GetAddressOf()));
+			if (FAILED(hr))
+			{
+				return hr;
+			}
+			m_States->Register(m_Placed[r].Get(), state);
+		}
+		return S_OK;
+	}
+
+	ID3D12Device* m_Device;
+	ResourceStateTracker* m_States;
+	GpuTimestampProfiler* m_Timestamps;
+	RenderGraph m_Graph;
+
+	//per graph resource of the frame being declared
+	std::vector<ID3D12Resource*> m_Resources;
+	std::vector<D3D12_RESOURCE_DESC> m_Descs;
+	std::vector<D3D12_CLEAR_VALUE> m_ClearValues;
+	std::vector<bool> m_HasClearValue;
+	std::vector<ExecuteFunc> m_Execute;
+
+	//transients of the current layout, indexed like the graph resources of the frame that created them
+	uint64_t m_LayoutHash;
+	Microsoft::WRL::ComPtr<ID3D12Heap> m_Heaps[HeapClassCount];
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_Placed;
+};
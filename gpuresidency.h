@@ -0,0 +1,184 @@
+#pragma once
+
+#include <wrl/client.h>
+#include <d3d12.h>
+#include <dxgi1_4.h>
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+#include "residency.h"
+
+//applies ResidencyPolicy to D3D12 objects: queries the budget with QueryVideoMemoryInfo at the start of
+//every frame and turns the policy's decisions into ID3D12Device::Evict and MakeResident calls.
+//Only committed resources and heaps can be made resident or evicted on their own, so resources placed
+//in a shared heap (see GpuMemoryAllocator) are tracked through their heap with RegisterPageable.
+//Dropping top mips can't be done to an existing resource, those decisions go to the mip bias callback
+//so a texture streamer can re-create the texture at lower detail or clamp its SRV.
+class GpuResidencyManager
+{
+public:
+	typedef ResidencyPolicy::Handle Handle;
+	typedef std::function<void(Handle resource, uint32_t mipBias)> MipBiasCallback;
+
+	void Create(ID3D12Device* device, uint32_t framesInFlight, MipBiasCallback onMipBias = nullptr)
+	{
+		m_Device = device;
+		m_OnMipBias = onMipBias;
+		m_Frame = 0;
+		m_BudgetOverride = 0;
+		m_Policy.Create(framesInFlight);
+		m_Pageables.clear();
+
+		//find the adapter the device was created on to query its memory budget
+		Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
+		if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(factory.GetAddressOf()))))
+		{
+			factory->EnumAdapterByLuid(device->GetAdapterLuid(), IID_PPV_ARGS(m_Adapter.GetAddressOf()));
+		}
+	}
+
+	//maxMipBias is the number of top mips the streamer can drop, 0 if it can only be evicted whole.
+	Handle RegisterTexture(ID3D12Resource* resource, uint32_t maxMipBias = 0)
+	{
+		D3D12_RESOURCE_DESC desc = resource->GetDesc();
+		UINT mipCount = desc.MipLevels;
+		UINT arraySize = (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? 1 : desc.DepthOrArraySize;
+
+		//sizes of the mip chains as laid out for upload, scaled so their sum matches the real allocation size
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(mipCount * arraySize);
+		std::vector<UINT> rowCounts(mipCount * arraySize);
+		std::vector<UINT64> rowSizes(mipCount * arraySize);
+		UINT64 totalBytes = 0;
+		m_Device->GetCopyableFootprints(&desc, 0, mipCount * arraySize, 0,
+			footprints.data(), rowCounts.data(), rowSizes.data(), &totalBytes);
+		UINT64 allocationSize = m_Device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+
+		std::vector<uint64_t> mipSizes(mipCount, 0);
+		for (UINT slice = 0; slice < arraySize; ++slice)
+		{
+			for (UINT mip = 0; mip < mipCount; ++mip)
+			{
+				UINT i = slice * mipCount + mip;
+				mipSizes[mip] += uint64_t(footprints[i].Footprint.RowPitch) * rowCounts[i] * footprints[i].Footprint.Depth;
+			}
+		}
+		uint64_t footprintTotal = 0;
+		for (auto size : mipSizes)
+		{
+			footprintTotal += size;
+		}
+		for (auto& size : mipSizes)
+		{
+			size = footprintTotal ? size * allocationSize / footprintTotal : 0;
+		}
+
+		return Register(resource, m_Policy.Register(mipSizes.data(), mipCount, maxMipBias < mipCount ? maxMipBias : mipCount - 1, m_Frame));
+	}
+
+	//committed buffers and whole heaps
+	Handle RegisterPageable(ID3D12Pageable* pageable, UINT64 size)
+	{
+		return Register(pageable, m_Policy.Register(size, m_Frame));
+	}
+
+	void Unregister(Handle handle)
+	{
+		m_Policy.Unregister(handle);
+		m_Pageables[handle] = nullptr;
+	}
+
+	//every resource a frame reads has to be marked before BeginFrame, so an evicted one is brought back first.
+	void MarkUsed(Handle handle)
+	{
+		m_Policy.MarkUsed(handle, m_Frame + 1);
+	}
+
+	//replaces the driver's budget, e.g. to reproduce the behaviour of a smaller card. 0 queries the adapter again.
+	void SetBudgetOverride(uint64_t budget) { m_BudgetOverride = budget; }
+
+	void BeginFrame()
+	{
+		++m_Frame;
+		m_Policy.Update(m_Frame, QueryBudget(), m_Ops);
+
+		//MakeResident blocks until the memory is paged in, that is the price of a resource evicted too early
+		Apply(m_Ops.MakeResident, true);
+		Apply(m_Ops.Evict, false);
+
+		if (m_OnMipBias)
+		{
+			for (const auto& change : m_Ops.SetMipBias)
+			{
+				m_OnMipBias(change.Resource, change.MipBias);
+			}
+		}
+	}
+
+	ResidencyPolicy::Statistics GetStatistics() const { return m_Policy.GetStatistics(); }
+
+private:
+	Handle Register(ID3D12Pageable* pageable, Handle handle)
+	{
+		if (handle >= m_Pageables.size())
+		{
+			m_Pageables.resize(handle + 1, nullptr);
+		}
+		m_Pageables[handle] = pageable;
+		return handle;
+	}
+
+	//the budget left for the tracked resources: the OS budget minus what everything else uses
+	uint64_t QueryBudget()
+	{
+		if (m_BudgetOverride)
+		{
+			return m_BudgetOverride;
+		}
+		if (!m_Adapter)
+		{
+			return UINT64_MAX;
+		}
+
+		DXGI_QUERY_VIDEO_MEMORY_INFO info;
+		if (FAILED(m_Adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info)))
+		{
+			return UINT64_MAX;
+		}
+		uint64_t tracked = m_Policy.GetResidentBytes();
+		uint64_t untracked = info.CurrentUsage > tracked ? info.CurrentUsage - tracked : 0;
+		return info.Budget > untracked ? info.Budget - untracked : 0;
+	}
+
+	void Apply(const std::vector<Handle>& handles, bool makeResident)
+	{
+		if (handles.empty())
+		{
+			return;
+		}
+
+		m_Batch.clear();
+		for (Handle handle : handles)
+		{
+			m_Batch.push_back(m_Pageables[handle]);
+		}
+		if (makeResident)
+		{
+			m_Device->MakeResident(static_cast<UINT>(m_Batch.size()), m_Batch.data());
+		}
+		else
+		{
+			m_Device->Evict(static_cast<UINT>(m_Batch.size()), m_Batch.data());
+		}
+	}
+
+	ID3D12Device* m_Device;
+	Microsoft::WRL::ComPtr<IDXGIAdapter3> m_Adapter;
+	MipBiasCallback m_OnMipBias;
+	ResidencyPolicy m_Policy;
+	ResidencyPolicy::Operations m_Ops;
+	std::vector<ID3D12Pageable*> m_Pageables;
+	std::vector<ID3D12Pageable*> m_Batch;
+	uint64_t m_Frame;
+	uint64_t m_BudgetOverride;
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <wrl/client.h>
+#include <d3d12.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "timestamps.h"
+#include "tracing.h"
+
+//GPU timings of scopes on a direct queue: timestamp queries written with EndQuery around every scope, resolved
+//at the end of the frame into a readback buffer with a region per frame in flight, and read back once the
+//frame's fence has passed. See TimestampProfiler for the bookkeeping.
+class GpuTimestampProfiler
+{
+public:
+	//frameLatency as for TimestampProfiler::Create, frames in flight plus one
+	HRESULT Create(ID3D12Device* device, ID3D12CommandQueue* queue, uint32_t maxScopesPerFrame = 64, uint32_t frameLatency = 3)
+	{
+		m_Queue = queue;
+		UINT64 frequency = 0;
+		HRESULT hr = queue->GetTimestampFrequency(&frequency);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+		m_Timings.Create(maxScopesPerFrame, frameLatency, frequency);
+
+		D3D12_QUERY_HEAP_DESC queryHeapDesc;
+		ZeroMemory(&queryHeapDesc, sizeof(queryHeapDesc));
+		queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+		queryHeapDesc.Count = m_Timings.GetQueryCount();
+		hr = device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(m_QueryHeap.ReleaseAndGetAddressOf()));
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		D3D12_HEAP_PROPERTIES heapProps;
+		ZeroMemory(&heapProps, sizeof(heapProps));
+		heapProps.Type = D3D12_HEAP_TYPE_READBACK;
+		heapProps.CreationNodeMask = 1;
+		heapProps.VisibleNodeMask = 1;
+
+		D3D12_RESOURCE_DESC bufferDesc;
+		ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+		bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		bufferDesc.Width = UINT64(m_Timings.GetQueryCount()) * sizeof(uint64_t);
+		bufferDesc.Height = 1;
+		bufferDesc.DepthOrArraySize = 1;
+		bufferDesc.MipLevels = 1;
+		bufferDesc.SampleDesc.Count = 1;
+		bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		return device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(m_Readback.ReleaseAndGetAddressOf()));
+	}
+
+	//false when Create failed, everything else is then a no-op
+	bool IsEnabled() const { return m_QueryHeap && m_Readback; }
+
+	//frame numbers count up by one per frame and are what Collect is given once the GPU is done with them
+	void BeginFrame(uint64_t frame)
+	{
+		if (IsEnabled())
+		{
+			m_Timings.BeginFrame(frame);
+		}
+	}
+
+	uint32_t BeginScope(ID3D12GraphicsCommandList* commandList, const char* name)
+	{
+		if (!IsEnabled())
+		{
+			return TimestampProfiler::InvalidScope;
+		}
+		uint32_t scope = m_Timings.BeginScope(name);
+		if (scope != TimestampProfiler::InvalidScope)
+		{
+			commandList->EndQuery(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_Timings.GetBeginQuery(scope));
+		}
+		return scope;
+	}
+
+	void EndScope(ID3D12GraphicsCommandList* commandList, uint32_t scope)
+	{
+		if (scope != TimestampProfiler::InvalidScope)
+		{
+			commandList->EndQuery(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_Timings.GetEndQuery(scope));
+		}
+		m_Timings.EndScope(scope);
+	}
+
+	//resolves the frame's queries, record on the last command list of the frame
+	void EndFrame(ID3D12GraphicsCommandList* commandList)
+	{
+		if (!IsEnabled())
+		{
+			return;
+		}
+		uint32_t first, count;
+		m_Timings.GetFrameQueries(first, count);
+		if (count)
+		{
+			commandList->ResolveQueryData(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, first, count, m_Readback.Get(), UINT64(first) * sizeof(uint64_t));
+		}
+		m_Timings.EndFrame();
+	}
+
+	//reads the timings of every frame up to completedFrame, whose fence the GPU has already passed
+	void Collect(uint64_t completedFrame)
+	{
+		if (!IsEnabled())
+		{
+			return;
+		}
+#if ENABLE_TRACING
+		//GPU timestamps go on the trace timeline through a GPU/tracer clock pair taken now, so drift doesn't build up
+		UINT64 gpuNow = 0, cpuNow = 0;
+		bool trace = Tracer::Get().IsEnabled() && SUCCEEDED(m_Queue->GetClockCalibration(&gpuNow, &cpuNow));
+		uint64_t traceNow = Tracer::Get().Now();
+		double nsPerTick = 1e9 / double(m_Timings.GetFrequency());
+#endif
+		m_Timings.Collect(completedFrame, [this](uint32_t slot)
+		{
+			uint32_t first = m_Timings.GetSlotFirstQuery(slot);
+			uint32_t count = m_Timings.GetSlotQueryCount();
+			D3D12_RANGE readRange = { first * sizeof(uint64_t), (first + count) * sizeof(uint64_t) };
+			D3D12_RANGE writtenRange = { 0, 0 };
+			void* data = nullptr;
+			m_Slot.assign(count, 0);
+			if (SUCCEEDED(m_Readback->Map(0, &readRange, &data)))
+			{
+				memcpy(m_Slot.data(), static_cast<const uint64_t*>(data) + first, count * sizeof(uint64_t));
+				m_Readback->Unmap(0, &writtenRange);
+			}
+			return m_Slot.data();
+		}, [&](const std::vector<TimestampProfiler::ScopeTiming>& timings)
+		{
+#if ENABLE_TRACING
+			for (const auto& timing : timings)
+			{
+				if (trace && timing.EndTicks >= timing.BeginTicks && timing.BeginTicks <= gpuNow)
+				{
+					uint64_t ago = uint64_t(double(gpuNow - timing.BeginTicks) * nsPerTick);
+					if (ago <= traceNow)
+					{
+						Tracer::Get().RecordGpu(timing.Name, traceNow - ago, uint64_t(double(timing.EndTicks - timing.BeginTicks) * nsPerTick));
+					}
+				}
+			}
+#else
+			(void)timings;
+#endif
+		});
+	}
+
+	const TimestampProfiler& GetTimings() const { return m_Timings; }
+
+private:
+	TimestampProfiler m_Timings;
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_Queue;
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_QueryHeap;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_Readback;
+	std::vector<uint64_t> m_Slot; //copy of the slot being collected
+};
+
+//times the commands recorded while it is in scope
+class GpuTimestampScope
+{
+public:
+	GpuTimestampScope(GpuTimestampProfiler* profiler, ID3D12GraphicsCommandList* commandList, const char* name)
+		: m_Profiler(profiler), m_CommandList(commandList)
+	{
+		m_Scope = m_Profiler ? m_Profiler->BeginScope(m_CommandList, name) : TimestampProfiler::InvalidScope;
+	}
+
+	~GpuTimestampScope()
+	{
+		if (m_Profiler)
+		{
+			m_Profiler->EndScope(m_CommandList, m_Scope);
+		}
+	}
+
+private:
+	GpuTimestampScope(const GpuTimestampScope&);
+	GpuTimestampScope& operator=(const GpuTimestampScope&);
+
+	GpuTimestampProfiler* m_Profiler;
+	ID3D12GraphicsCommandList* m_CommandList;
+	uint32_t m_Scope;
+};
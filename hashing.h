@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+
+//64 bit FNV-1a hash built up incrementally from the fields of a description.
+//Add() is meant for scalars only, structs can contain padding bytes with undefined contents
+//so they have to be hashed member by member.
+class Hasher
+{
+public:
+	Hasher() : m_Hash(14695981039346656037ull) {}
+
+	Hasher& AddBytes(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_Hash ^= bytes[i];
+			m_Hash *= 1099511628211ull;
+		}
+		return *this;
+	}
+
+	template<typename T>
+	Hasher& Add(const T& value)
+	{
+		static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "hash structs member by member");
+		return AddBytes(&value, sizeof(value));
+	}
+
+	//strings are hashed with their terminator so "AB","C" and "A","BC" differ, null hashes as an empty marker.
+	Hasher& AddString(const char* str)
+	{
+		if (!str)
+		{
+			return Add(uint8_t(0xff));
+		}
+		const char* end = str;
+		while (*end)
+		{
+			++end;
+		}
+		return AddBytes(str, static_cast<size_t>(end - str) + 1);
+	}
+
+	uint64_t Get() const { return m_Hash; }
+
+private:
+	uint64_t m_Hash;
+};
+
+//the slot of a hash in a power of two table. FNV-1a carries differences up, not down, so the high bits are folded
+//into the low ones that pick the slot.
+inline uint32_t FoldHash(uint64_t hash)
+{
+	return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
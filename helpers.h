@@ -8,6 +8,18 @@
 #include <string>
 #include <stdint.h>
 #include <tuple>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <unordered_map>
+
+#include "hashing.h"
+#include "pipelinehash.h"
+#include "shaderpermutations.h"
+#include "asyncpipelines.h"
+#include "gpuallocator.h"
+#include "vertexformats.h"
 
 //#include "DDSTextureLoader\DDSTextureLoader.h"
 
@@ -99,6 +111,19 @@ void setResourceBarrier(ID3D12GraphicsCommandList* commandList, ID3D12Resource*
 	commandList->ResourceBarrier(1, &barrierDesc);
 }
 
+// Align uLocation to the next multiple of uAlign.
+UINT64 Align(UINT64 uLocation, UINT64 uAlign)
+{
+	bool valid = true;
+	if ((0 == uAlign) || (uAlign & (uAlign - 1)))
+	{
+		valid = false;
+	}
+	assert(valid);
+
+	return ((uLocation + (uAlign - 1)) & ~(uAlign - 1));
+}
+
 class CUploadBufferWrapper
 {
 public:
@@ -254,6 +279,12 @@ public:
 		rootParams[3].DescriptorTable.pDescriptorRanges = &descRange[2];
 		//end of root sig, 7/16 dwords used
 
+		Create(device, descRootSignature);
+	}
+
+	//any other layout, the compute root signature of GpuIndirectCuller for instance
+	void Create(ID3D12Device* device, const D3D12_ROOT_SIGNATURE_DESC& descRootSignature)
+	{
 		ThrowIfFailed(
 			D3D12SerializeRootSignature(
 				&descRootSignature, D3D_ROOT_SIGNATURE_VERSION_1,
@@ -264,14 +295,19 @@ public:
 				1, m_Blob->GetBufferPointer(), m_Blob->GetBufferSize(),
 				__uuidof(ID3D12RootSignature), (void**)m_RootSignature.GetAddressOf())
 			);
+
+		//the serialized blob identifies the root signature across runs, unlike the interface pointer.
+		m_Hash = Hasher().AddBytes(m_Blob->GetBufferPointer(), m_Blob->GetBufferSize()).Get();
 	}
 
 	auto Get() const { return m_RootSignature.Get(); }
 	auto GetBlob() const { return m_Blob.Get(); }
 	auto GetErrorBlob() const { return m_ErrorBlob.Get(); }
+	auto GetHash() const { return m_Hash; }
 
 private:
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_RootSignature;
+	uint64_t m_Hash;
 	Microsoft::WRL::ComPtr<ID3DBlob> m_Blob;
 	Microsoft::WRL::ComPtr<ID3DBlob> m_ErrorBlob;
 };
@@ -279,10 +315,16 @@ private:
 class Shader
 {
 public:
-	void Load(const char* filename, const char* entryPoint, const char* target)
+	void Load(const char* filename, const char* entryPoint, const char* target, _In_opt_ const D3D_SHADER_MACRO* defines = nullptr)
+	{
+		ThrowIfFailed(TryLoad(filename, entryPoint, target, defines));
+	}
+
+	//same as Load but hands the failure back to the caller, used for variants compiled off the main thread.
+	HRESULT TryLoad(const char* filename, const char* entryPoint, const char* target, _In_opt_ const D3D_SHADER_MACRO* defines = nullptr)
 	{
 		HRESULT hr = D3DCompileFromFile(
-			StringToWString(filename).c_str(), nullptr , nullptr,
+			StringToWString(filename).c_str(), defines, nullptr,
 			entryPoint, target, D3DCOMPILE_WARNINGS_ARE_ERRORS, 0,
 			m_Blob.GetAddressOf(), m_ErrorBlob.GetAddressOf());
 
@@ -292,8 +334,7 @@ public:
 				reinterpret_cast<LPCSTR>(m_ErrorBlob.Get()->GetBufferPointer())
 				);
 		}
-		ThrowIfFailed(hr);
-
+		return hr;
 	}
 
 	auto GetBlob() const { return m_Blob.Get(); }
@@ -304,22 +345,119 @@ private:
 	Microsoft::WRL::ComPtr<ID3DBlob> m_ErrorBlob;
 };
 
+//all variants of one shader entry point, compiled from the feature axes of keySpace on first use.
+//Request() never stalls the frame: it returns null until the variant has been compiled on the pool.
+class ShaderPermutations
+{
+public:
+	void Create(
+		const char* filename, const char* entryPoint, const char* target,
+		const ShaderPermutationKeySpace& keySpace,
+		_In_opt_ WorkerPool* pool)
+	{
+		m_Filename = filename;
+		m_EntryPoint = entryPoint;
+		m_Target = target;
+		m_KeySpace = keySpace;
+		m_Cache.Create([this](uint64_t key) { return CompileVariant(key); }, pool, &m_KeySpace);
+	}
+
+	std::shared_ptr<Shader> Request(uint64_t key) { return m_Cache.Request(key); }
+	std::shared_ptr<Shader> RequestBlocking(uint64_t key) { return m_Cache.RequestBlocking(key); }
+
+	const ShaderPermutationKeySpace& GetKeySpace() const { return m_KeySpace; }
+	const ShaderVariantCache<Shader>& GetCache() const { return m_Cache; }
+
+private:
+	std::shared_ptr<Shader> CompileVariant(uint64_t key)
+	{
+		//D3D_SHADER_MACRO only points at the strings, keep them alive until the compile is done.
+		auto defines = m_KeySpace.GetDefines(key);
+		std::vector<D3D_SHADER_MACRO> macros;
+		macros.reserve(defines.size() + 1);
+		for (const auto& define : defines)
+		{
+			macros.push_back({ define.first.c_str(), define.second.c_str() });
+		}
+		macros.push_back({ nullptr, nullptr });
+
+		auto shader = std::make_shared<Shader>();
+		if (FAILED(shader->TryLoad(m_Filename.c_str(), m_EntryPoint.c_str(), m_Target.c_str(), macros.data())))
+		{
+			OutputDebugStringA(("shader variant failed: " + m_EntryPoint + " " + m_KeySpace.GetKeyString(key) + "\n").c_str());
+			return nullptr;
+		}
+		return shader;
+	}
+
+	std::string m_Filename;
+	std::string m_EntryPoint;
+	std::string m_Target;
+	ShaderPermutationKeySpace m_KeySpace;
+	ShaderVariantCache<Shader> m_Cache;
+};
+
 struct PipelineStateObjectDescription : D3D12_GRAPHICS_PIPELINE_STATE_DESC
 {
+	//hash of the serialized root signature, set by Simple(). When left 0 the PSO cache falls back
+	//to the pRootSignature pointer, which still deduplicates within a run but never matches on disk.
+	uint64_t RootSignatureHash;
+
 	static PipelineStateObjectDescription Simple(
 		const D3D12_INPUT_LAYOUT_DESC& inputLayout,
 		const RootSignature& rootSig,
 		const Shader& vs, const Shader& ps
 		)
+	{
+		return Simple(inputLayout, rootSig, vs, &ps);
+	}
+
+	//depth prepass pipeline: no pixel shader and no render target, only the vertex shader runs and depth is written
+	static PipelineStateObjectDescription DepthOnly(
+		const D3D12_INPUT_LAYOUT_DESC& inputLayout,
+		const RootSignature& rootSig,
+		const Shader& vs,
+		DXGI_FORMAT depthFormat
+		)
+	{
+		PipelineStateObjectDescription psoDesc = Simple(inputLayout, rootSig, vs, nullptr);
+		psoDesc.NumRenderTargets = 0;
+		psoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+		return psoDesc.SetDepth(depthFormat, true);
+	}
+
+	//tests depth against a target of depthFormat. Written: nearer fragments replace the depth, as without a prepass
+	//and in the prepass itself. Not written: tests against what the prepass laid down, LESS_EQUAL so the fragments
+	//that made it into the depth buffer pass again and everything behind them is rejected before shading.
+	PipelineStateObjectDescription& SetDepth(DXGI_FORMAT depthFormat, bool write)
+	{
+		DepthStencilState.DepthEnable = TRUE;
+		DepthStencilState.DepthWriteMask = write ? D3D12_DEPTH_WRITE_MASK_ALL : D3D12_DEPTH_WRITE_MASK_ZERO;
+		DepthStencilState.DepthFunc = write ? D3D12_COMPARISON_FUNC_LESS : D3D12_COMPARISON_FUNC_LESS_EQUAL;
+		DepthStencilState.StencilEnable = FALSE;
+		DSVFormat = depthFormat;
+		return *this;
+	}
+
+private:
+	static PipelineStateObjectDescription Simple(
+		const D3D12_INPUT_LAYOUT_DESC& inputLayout,
+		const RootSignature& rootSig,
+		const Shader& vs, _In_opt_ const Shader* ps
+		)
 	{
 		ID3DBlob* vsBlob = vs.GetBlob();
-		ID3DBlob* psBlob = ps.GetBlob();
 		PipelineStateObjectDescription psoDesc;
 		ZeroMemory(&psoDesc, sizeof(psoDesc));
 		psoDesc.InputLayout = inputLayout;
 		psoDesc.pRootSignature = rootSig.Get();
+		psoDesc.RootSignatureHash = rootSig.GetHash();
 		psoDesc.VS = { reinterpret_cast<BYTE*>(vsBlob->GetBufferPointer()), vsBlob->GetBufferSize() };
-		psoDesc.PS = { reinterpret_cast<BYTE*>(psBlob->GetBufferPointer()), psBlob->GetBufferSize() };
+		if (ps)
+		{
+			ID3DBlob* psBlob = ps->GetBlob();
+			psoDesc.PS = { reinterpret_cast<BYTE*>(psBlob->GetBufferPointer()), psBlob->GetBufferSize() };
+		}
 
 		psoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
 		psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
@@ -362,6 +500,219 @@ struct PipelineStateObjectDescription : D3D12_GRAPHICS_PIPELINE_STATE_DESC
 	}
 };
 
+//deduplicates pipeline creation by description hash and keeps the driver's compiled form of every
+//pipeline (GetCachedBlob) in a file, so later runs hand it back through CachedPSO and skip the driver compile.
+//Blobs the driver rejects (new driver or adapter) are dropped and the pipeline is compiled from scratch.
+class PipelineStateCache
+{
+public:
+	struct Statistics
+	{
+		uint32_t MemoryHits; //identical description already created this run
+		uint32_t DiskHits; //created from a cached blob
+		uint32_t Misses; //full driver compile
+		uint32_t RejectedBlobs; //cached blob found but refused by the driver
+	};
+
+	void Create(ID3D12Device* device, const wchar_t* fileName)
+	{
+		m_Device = device;
+		m_FileName = fileName;
+		m_Dirty = false;
+		ZeroMemory(&m_Stats, sizeof(m_Stats));
+		Load();
+	}
+
+	//returns the pipeline for desc, creating it on first use. Safe to call from several threads.
+	ID3D12PipelineState* GetOrCreate(const PipelineStateObjectDescription& desc)
+	{
+		ID3D12PipelineState* pso = TryGetOrCreate(desc);
+		ThrowIfFailed(pso ? S_OK : E_FAIL);
+		return pso;
+	}
+
+	//same as GetOrCreate but returns null when the driver fails to compile the pipeline.
+	ID3D12PipelineState* TryGetOrCreate(const PipelineStateObjectDescription& desc)
+	{
+		uint64_t hash = HashPipelineStateDescription(desc, desc.RootSignatureHash);
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC createDesc = desc;
+		createDesc.CachedPSO.pCachedBlob = nullptr;
+		createDesc.CachedPSO.CachedBlobSizeInBytes = 0;
+		std::vector<uint8_t> cachedBlob;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			auto it = m_PSOs.find(hash);
+			if (it != m_PSOs.end())
+			{
+				++m_Stats.MemoryHits;
+				return it->second.Get();
+			}
+			auto blob = m_Blobs.find(hash);
+			if (blob != m_Blobs.end())
+			{
+				cachedBlob = blob->second;
+			}
+		}
+
+		//compile outside the lock so other threads can still hit the cache meanwhile
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pso;
+		bool fromBlob = false;
+		bool rejectedBlob = false;
+		if (!cachedBlob.empty())
+		{
+			createDesc.CachedPSO.pCachedBlob = cachedBlob.data();
+			createDesc.CachedPSO.CachedBlobSizeInBytes = cachedBlob.size();
+			fromBlob = SUCCEEDED(m_Device->CreateGraphicsPipelineState(&createDesc, IID_PPV_ARGS(pso.GetAddressOf())));
+			rejectedBlob = !fromBlob;
+			createDesc.CachedPSO.pCachedBlob = nullptr;
+			createDesc.CachedPSO.CachedBlobSizeInBytes = 0;
+		}
+		if (!fromBlob &&
+			FAILED(m_Device->CreateGraphicsPipelineState(&createDesc, IID_PPV_ARGS(pso.ReleaseAndGetAddressOf()))))
+		{
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_PSOs.find(hash);
+		if (it != m_PSOs.end())
+		{
+			//another thread created the same pipeline meanwhile, keep the first one
+			++m_Stats.MemoryHits;
+			return it->second.Get();
+		}
+		m_PSOs[hash] = pso;
+
+		if (fromBlob)
+		{
+			++m_Stats.DiskHits;
+		}
+		else
+		{
+			++m_Stats.Misses;
+			m_Stats.RejectedBlobs += rejectedBlob ? 1 : 0;
+
+			Microsoft::WRL::ComPtr<ID3DBlob> blob;
+			if (SUCCEEDED(pso->GetCachedBlob(blob.GetAddressOf())))
+			{
+				const uint8_t* data = reinterpret_cast<const uint8_t*>(blob->GetBufferPointer());
+				m_Blobs[hash].assign(data, data + blob->GetBufferSize());
+				m_Dirty = true;
+			}
+		}
+		return pso.Get();
+	}
+
+	//writes the cache file if new pipelines were compiled since it was loaded.
+	HRESULT Save()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!m_Dirty)
+		{
+			return S_FALSE;
+		}
+
+		std::ofstream file(m_FileName.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return E_FAIL;
+		}
+
+		FileHeader header = { c_Magic, c_Version, static_cast<uint32_t>(m_Blobs.size()), 0 };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const auto& entry : m_Blobs)
+		{
+			uint64_t hash = entry.first;
+			uint64_t size = entry.second.size();
+			file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+			file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			file.write(reinterpret_cast<const char*>(entry.second.data()), entry.second.size());
+		}
+		if (!file)
+		{
+			return E_FAIL;
+		}
+
+		m_Dirty = false;
+		return S_OK;
+	}
+
+	const Statistics& GetStatistics() const { return m_Stats; }
+
+private:
+	struct FileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t EntryCount;
+		uint32_t Reserved;
+	};
+	static const uint32_t c_Magic = 0x434f5350; // "PSOC"
+	static const uint32_t c_Version = 1;
+
+	//a missing, truncated or foreign file just means an empty cache.
+	void Load()
+	{
+		m_Blobs.clear();
+
+		std::ifstream file(m_FileName.c_str(), std::ios::binary);
+		if (!file)
+		{
+			return;
+		}
+
+		FileHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			header.Magic != c_Magic || header.Version != c_Version)
+		{
+			return;
+		}
+
+		for (uint32_t i = 0; i < header.EntryCount; ++i)
+		{
+			uint64_t hash = 0;
+			uint64_t size = 0;
+			file.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+			file.read(reinterpret_cast<char*>(&size), sizeof(size));
+			if (!file || size > (64ull << 20))
+			{
+				m_Blobs.clear();
+				return;
+			}
+			std::vector<uint8_t>& blob = m_Blobs[hash];
+			blob.resize(static_cast<size_t>(size));
+			if (!file.read(reinterpret_cast<char*>(blob.data()), blob.size()))
+			{
+				m_Blobs.clear();
+				return;
+			}
+		}
+	}
+
+	ID3D12Device* m_Device;
+	std::wstring m_FileName;
+	std::mutex m_Mutex;
+	std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_PSOs;
+	std::unordered_map<uint64_t, std::vector<uint8_t>> m_Blobs;
+	bool m_Dirty;
+	Statistics m_Stats;
+};
+
+//compiles pipelines through the cache on worker threads, see AsyncPipelineCompiler.
+//Pipelines are owned by the cache, so the handles stay valid for the lifetime of the cache.
+class AsyncGraphicsPipelineCompiler : public AsyncPipelineCompiler<PipelineStateObjectDescription, ID3D12PipelineState>
+{
+public:
+	void Create(PipelineStateCache& cache, _In_opt_ WorkerPool* pool)
+	{
+		PipelineStateCache* pCache = &cache;
+		AsyncPipelineCompiler::Create(
+			[pCache](const PipelineStateObjectDescription& desc) { return pCache->TryGetOrCreate(desc); },
+			pool);
+	}
+};
+
 class PipelineStateObject
 {
 public:
@@ -377,25 +728,152 @@ public:
 			);
 	}
 
+	//shares the pipeline with every other user of the same description through the cache.
+	void Create(
+		PipelineStateCache& cache,
+		const PipelineStateObjectDescription& desc)
+	{
+		m_PSO = cache.GetOrCreate(desc);
+	}
+
 	auto Get() const { return m_PSO.Get(); }
 
 private:
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_PSO;
 };
 
-class CommittedResource
+//compute pipelines are created directly, the PipelineStateCache only keeps graphics pipelines
+class ComputePipelineStateObject
 {
+public:
+	void Create(
+		ID3D12Device* device,
+		const RootSignature& rootSig,
+		const Shader& cs)
+	{
+		ID3DBlob* csBlob = cs.GetBlob();
+		D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc;
+		ZeroMemory(&psoDesc, sizeof(psoDesc));
+		psoDesc.pRootSignature = rootSig.Get();
+		psoDesc.CS = { reinterpret_cast<BYTE*>(csBlob->GetBufferPointer()), csBlob->GetBufferSize() };
+		ThrowIfFailed(
+			device->CreateComputePipelineState(
+				&psoDesc,
+				__uuidof(ID3D12PipelineState),
+				(void**)m_PSO.GetAddressOf())
+			);
+	}
+
+	auto Get() const { return m_PSO.Get(); }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_PSO;
+};
+
+//buffers live either on the upload heap, where the CPU can rewrite them but the GPU reads them across the bus
+//on every use (Dynamic), or on the default heap in video memory, filled once through a staging copy (Static).
+enum class BufferUsage
+{
+	Dynamic,
+	Static
+};
+
+//a buffer in a committed resource of its own, or placed in a heap of a GpuMemoryAllocator.
+class BufferResource
+{
+public:
+	BufferResource() : m_Allocator(nullptr) {}
+
 protected:
+	//dynamic buffer on its own upload heap, data is written through a map.
 	void _Create(
 		ID3D12Device* device, 
 		int64_t size,
 		_In_opt_ const void* data)
+	{
+		_CreateBuffer(device, size, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr);
+		
+		if (data)
+		{
+			UploadData(data, size);
+		}
+	}
+
+	//static buffer on the default heap. data is staged in uploadBuffer and a copy into the buffer is recorded
+	//on cmdList, followed by the transition to finalState. uploadBuffer must stay alive until cmdList has executed.
+	//With an allocator the buffer is placed in one of its heaps instead of getting a committed heap of its own.
+	void _CreateStatic(
+		ID3D12Device* device,
+		ID3D12GraphicsCommandList* cmdList,
+		CUploadBufferWrapper* uploadBuffer,
+		int64_t size,
+		const void* data,
+		D3D12_RESOURCE_STATES finalState,
+		_In_opt_ GpuMemoryAllocator* allocator)
+	{
+		//CopyBufferRegion has no placement requirement, align anyway so staged buffers don't share cache lines with textures
+		UINT8* staging = reinterpret_cast<UINT8*>(Align(reinterpret_cast<SIZE_T>(uploadBuffer->pDataCur), 16));
+		if (staging + size > uploadBuffer->pDataEnd)
+		{
+			ThrowIfFailed(E_OUTOFMEMORY);
+		}
+
+		_CreateBuffer(device, size, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COPY_DEST, allocator);
+
+		memcpy(staging, data, static_cast<size_t>(size));
+		cmdList->CopyBufferRegion(
+			m_Resource.Get(), 0,
+			uploadBuffer->pBuf.Get(), staging - uploadBuffer->pDataBegin,
+			static_cast<UINT64>(size));
+		uploadBuffer->pDataCur = staging + size;
+
+		setResourceBarrier(cmdList, m_Resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, finalState);
+	}
+
+public:
+	//only valid for dynamic buffers, static ones are not CPU visible.
+	void UploadData(const void* data, int64_t size)
+	{
+		assert(m_HeapType == D3D12_HEAP_TYPE_UPLOAD);
+		UINT8* dataBegin;
+		ThrowIfFailed(
+			m_Resource->Map(0, nullptr, reinterpret_cast<void**>(&dataBegin))
+			);
+		memcpy(dataBegin, data, static_cast<size_t>(size));
+		m_Resource->Unmap(0, nullptr);
+	}
+
+	auto Get() const { return m_Resource.Get(); }
+	auto GetSize() const { return m_Size; }
+	auto GetUsage() const { return m_HeapType == D3D12_HEAP_TYPE_UPLOAD ? BufferUsage::Dynamic : BufferUsage::Static; }
+	//where a placed buffer lives in its allocator's heaps, null for committed buffers.
+	const GpuAllocation* GetAllocation() const { return m_Allocator ? &m_Allocation : nullptr; }
+
+	//releases the buffer and gives placed memory back to its allocator. Only call once the GPU is done with it.
+	void Release()
+	{
+		m_Resource.Reset();
+		if (m_Allocator)
+		{
+			m_Allocator->Free(m_Allocation);
+			m_Allocator = nullptr;
+		}
+	}
+
+private:
+	//committed without an allocator, placed with one
+	void _CreateBuffer(
+		ID3D12Device* device,
+		int64_t size,
+		D3D12_HEAP_TYPE heapType,
+		D3D12_RESOURCE_STATES initialState,
+		_In_opt_ GpuMemoryAllocator* allocator)
 	{
 		D3D12_HEAP_PROPERTIES heapProps;
 		heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
 		heapProps.CreationNodeMask = 1;
 		heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-		heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+		heapProps.Type = heapType;
 		heapProps.VisibleNodeMask = 1;
 
 		D3D12_RESOURCE_DESC bufferDesc;
@@ -412,62 +890,121 @@ protected:
 		bufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
 		m_Size = size;
+		m_HeapType = heapType;
+		m_Allocator = allocator;
+		if (allocator)
+		{
+			ThrowIfFailed(
+				allocator->CreatePlacedResource(
+					heapType, bufferDesc, initialState, nullptr,
+					m_Resource.ReleaseAndGetAddressOf(), &m_Allocation)
+				);
+			return;
+		}
 		ThrowIfFailed(
 			device->CreateCommittedResource(
 				&heapProps,
 				D3D12_HEAP_FLAG_NONE,
 				&bufferDesc,
-				D3D12_RESOURCE_STATE_GENERIC_READ,
+				initialState,
 				nullptr,
-				IID_PPV_ARGS(m_Resource.GetAddressOf()))
+				IID_PPV_ARGS(m_Resource.ReleaseAndGetAddressOf()))
 			);
-		
-		if (data)
-		{
-			UploadData(data, size);
-		}
 	}
 
-public:
-	void UploadData(const void* data, int64_t size)
-	{
-		UINT8* dataBegin;
-		ThrowIfFailed(
-			m_Resource->Map(0, nullptr, reinterpret_cast<void**>(&dataBegin))
-			);
-		memcpy(dataBegin, data, static_cast<size_t>(size));
-		m_Resource->Unmap(0, nullptr);
-	}
-
-	auto Get() const { return m_Resource.Get(); }
-	auto GetSize() const { return m_Size; }
-
 protected:
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_Resource;
 	int64_t m_Size;
+	D3D12_HEAP_TYPE m_HeapType;
+	GpuMemoryAllocator* m_Allocator; //set for placed buffers
+	GpuAllocation m_Allocation;
 };
 
-class VertexBufferResource : public CommittedResource
+class VertexBufferResource : public BufferResource
 {
 public:
+	//dynamic vertex buffer, use for geometry rewritten by the CPU.
 	void Create(
 		ID3D12Device* device,
 		int32_t sizeInBytes,
 		int32_t strideInBytes,
 		_In_opt_ const void* data)
 	{
-		m_Stride = strideInBytes;
 		_Create(device, sizeInBytes, data);
-		m_View.BufferLocation = m_Resource->GetGPUVirtualAddress();
-		m_View.SizeInBytes = sizeInBytes;
-		m_View.StrideInBytes = strideInBytes;
+		_InitView(sizeInBytes, strideInBytes);
+	}
+
+	//static vertex buffer in video memory, see BufferResource::_CreateStatic.
+	void CreateStatic(
+		ID3D12Device* device,
+		ID3D12GraphicsCommandList* cmdList,
+		CUploadBufferWrapper* uploadBuffer,
+		int32_t sizeInBytes,
+		int32_t strideInBytes,
+		const void* data,
+		_In_opt_ GpuMemoryAllocator* allocator = nullptr)
+	{
+		_CreateStatic(device, cmdList, uploadBuffer, sizeInBytes, data, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, allocator);
+		_InitView(sizeInBytes, strideInBytes);
 	}
 
 	auto GetStride() const { return m_Stride; }
 	const auto& GetView() const { return m_View; }
 
 private:
+	void _InitView(int32_t sizeInBytes, int32_t strideInBytes)
+	{
+		m_Stride = strideInBytes;
+		m_View.BufferLocation = m_Resource->GetGPUVirtualAddress();
+		m_View.SizeInBytes = sizeInBytes;
+		m_View.StrideInBytes = strideInBytes;
+	}
+
 	int32_t m_Stride;
 	D3D12_VERTEX_BUFFER_VIEW m_View;
 };
 
+class IndexBufferResource : public BufferResource
+{
+public:
+	//dynamic index buffer, format is DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT.
+	void Create(
+		ID3D12Device* device,
+		int32_t sizeInBytes,
+		DXGI_FORMAT format,
+		_In_opt_ const void* data)
+	{
+		_Create(device, sizeInBytes, data);
+		_InitView(sizeInBytes, format);
+	}
+
+	//static index buffer in video memory, see BufferResource::_CreateStatic.
+	void CreateStatic(
+		ID3D12Device* device,
+		ID3D12GraphicsCommandList* cmdList,
+		CUploadBufferWrapper* uploadBuffer,
+		int32_t sizeInBytes,
+		DXGI_FORMAT format,
+		const void* data,
+		_In_opt_ GpuMemoryAllocator* allocator = nullptr)
+	{
+		_CreateStatic(device, cmdList, uploadBuffer, sizeInBytes, data, D3D12_RESOURCE_STATE_INDEX_BUFFER, allocator);
+		_InitView(sizeInBytes, format);
+	}
+
+	auto GetIndexCount() const { return m_IndexCount; }
+	const auto& GetView() const { return m_View; }
+
+private:
+	void _InitView(int32_t sizeInBytes, DXGI_FORMAT format)
+	{
+		assert(format == DXGI_FORMAT_R16_UINT || format == DXGI_FORMAT_R32_UINT);
+		m_IndexCount = sizeInBytes / (format == DXGI_FORMAT_R16_UINT ? 2 : 4);
+		m_View.BufferLocation = m_Resource->GetGPUVirtualAddress();
+		m_View.SizeInBytes = sizeInBytes;
+		m_View.Format = format;
+	}
+
+	int32_t m_IndexCount;
+	D3D12_INDEX_BUFFER_VIEW m_View;
+};
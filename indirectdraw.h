@@ -0,0 +1,269 @@
+#pragma once
+
+#include "d3d12types.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "scene.h"
+
+//layout of one command record read by ExecuteIndirect, and the command signature describing it.
+//Add the arguments in the order they sit in the record, the draw or dispatch last; every argument starts where
+//the previous one ends, D3D12 reads them packed. The Add functions return the argument's index for Write.
+class IndirectCommandLayout
+{
+public:
+	IndirectCommandLayout() { Reset(); }
+
+	void Reset()
+	{
+		m_Arguments.clear();
+		m_Offsets.clear();
+		m_Size = 0;
+	}
+
+	uint32_t AddConstants(UINT rootParameterIndex, UINT destOffsetIn32BitValues, UINT count)
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC argument = MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT);
+		argument.Constant.RootParameterIndex = rootParameterIndex;
+		argument.Constant.DestOffsetIn32BitValues = destOffsetIn32BitValues;
+		argument.Constant.Num32BitValuesToSet = count;
+		return Add(argument);
+	}
+
+	uint32_t AddConstantBufferView(UINT rootParameterIndex)
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC argument = MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW);
+		argument.ConstantBufferView.RootParameterIndex = rootParameterIndex;
+		return Add(argument);
+	}
+
+	uint32_t AddShaderResourceView(UINT rootParameterIndex)
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC argument = MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW);
+		argument.ShaderResourceView.RootParameterIndex = rootParameterIndex;
+		return Add(argument);
+	}
+
+	uint32_t AddUnorderedAccessView(UINT rootParameterIndex)
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC argument = MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE_UNORDERED_ACCESS_VIEW);
+		argument.UnorderedAccessView.RootParameterIndex = rootParameterIndex;
+		return Add(argument);
+	}
+
+	uint32_t AddVertexBufferView(UINT slot)
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC argument = MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW);
+		argument.VertexBuffer.Slot = slot;
+		return Add(argument);
+	}
+
+	uint32_t AddIndexBufferView() { return Add(MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW)); }
+	uint32_t AddDraw() { return Add(MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE_DRAW)); }
+	uint32_t AddDrawIndexed() { return Add(MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED)); }
+	uint32_t AddDispatch() { return Add(MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH)); }
+
+	//checks the rules CreateCommandSignature enforces: exactly one draw or dispatch and it comes last, vertex
+	//buffer slots and the index buffer set once at most, no input assembler state for dispatches, and no
+	//empty constant ranges. E_INVALIDARG when one is broken.
+	HRESULT Validate() const
+	{
+		if (m_Arguments.empty() || !IsDrawOrDispatch(m_Arguments.back().Type))
+		{
+			return E_INVALIDARG;
+		}
+		bool dispatch = m_Arguments.back().Type == D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+		bool indexBuffer = false;
+		std::vector<UINT> slots;
+		for (size_t i = 0; i + 1 < m_Arguments.size(); ++i)
+		{
+			const D3D12_INDIRECT_ARGUMENT_DESC& argument = m_Arguments[i];
+			switch (argument.Type)
+			{
+			case D3D12_INDIRECT_ARGUMENT_TYPE_DRAW:
+			case D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED:
+			case D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH:
+				return E_INVALIDARG;
+			case D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW:
+				for (UINT slot : slots)
+				{
+					if (slot == argument.VertexBuffer.Slot) return E_INVALIDARG;
+				}
+				if (dispatch) return E_INVALIDARG;
+				slots.push_back(argument.VertexBuffer.Slot);
+				break;
+			case D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW:
+				if (dispatch || indexBuffer) return E_INVALIDARG;
+				indexBuffer = true;
+				break;
+			case D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT:
+				if (!argument.Constant.Num32BitValuesToSet) return E_INVALIDARG;
+				break;
+			default:
+				break;
+			}
+		}
+		return S_OK;
+	}
+
+	//root arguments can only be set through a signature created against the root signature they change
+	bool NeedsRootSignature() const
+	{
+		for (const auto& argument : m_Arguments)
+		{
+			if (argument.Type >= D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//points at the layout's arguments, the layout must outlive the call creating the signature
+	D3D12_COMMAND_SIGNATURE_DESC GetDesc() const
+	{
+		D3D12_COMMAND_SIGNATURE_DESC desc;
+		ZeroMemory(&desc, sizeof(desc));
+		desc.ByteStride = GetByteStride();
+		desc.NumArgumentDescs = static_cast<UINT>(m_Arguments.size());
+		desc.pArgumentDescs = m_Arguments.data();
+		return desc;
+	}
+
+	//records are packed back to back at this stride, always a multiple of 4 bytes as D3D12 requires
+	UINT GetByteStride() const { return m_Size; }
+	uint32_t GetArgumentCount() const { return static_cast<uint32_t>(m_Arguments.size()); }
+	const D3D12_INDIRECT_ARGUMENT_DESC& GetArgument(uint32_t argument) const { return m_Arguments[argument]; }
+	UINT GetOffset(uint32_t argument) const { return m_Offsets[argument]; }
+	UINT GetSize(uint32_t argument) const { return GetArgumentSize(m_Arguments[argument]); }
+
+	//fills one argument of the record at record, size must be the argument's
+	void Write(void* record, uint32_t argument, const void* data, UINT size) const
+	{
+		assert(size == GetSize(argument));
+		memcpy(static_cast<uint8_t*>(record) + m_Offsets[argument], data, size);
+	}
+
+	template<typename T>
+	void Write(void* record, uint32_t argument, const T& value) const { Write(record, argument, &value, sizeof(value)); }
+
+	static UINT GetArgumentSize(const D3D12_INDIRECT_ARGUMENT_DESC& argument)
+	{
+		switch (argument.Type)
+		{
+		case D3D12_INDIRECT_ARGUMENT_TYPE_DRAW: return sizeof(D3D12_DRAW_ARGUMENTS);
+		case D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED: return sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+		case D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH: return sizeof(D3D12_DISPATCH_ARGUMENTS);
+		case D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW: return sizeof(D3D12_VERTEX_BUFFER_VIEW);
+		case D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW: return sizeof(D3D12_INDEX_BUFFER_VIEW);
+		case D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT: return argument.Constant.Num32BitValuesToSet * 4;
+		default: return sizeof(D3D12_GPU_VIRTUAL_ADDRESS); //root descriptors
+		}
+	}
+
+private:
+	static bool IsDrawOrDispatch(D3D12_INDIRECT_ARGUMENT_TYPE type)
+	{
+		return type == D3D12_INDIRECT_ARGUMENT_TYPE_DRAW || type == D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED || type == D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+	}
+
+	static D3D12_INDIRECT_ARGUMENT_DESC MakeArgument(D3D12_INDIRECT_ARGUMENT_TYPE type)
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC argument;
+		ZeroMemory(&argument, sizeof(argument));
+		argument.Type = type;
+		return argument;
+	}
+
+	uint32_t Add(const D3D12_INDIRECT_ARGUMENT_DESC& argument)
+	{
+		m_Arguments.push_back(argument);
+		m_Offsets.push_back(m_Size);
+		m_Size += GetArgumentSize(argument);
+		return static_cast<uint32_t>(m_Arguments.size() - 1);
+	}
+
+	std::vector<D3D12_INDIRECT_ARGUMENT_DESC> m_Arguments;
+	std::vector<UINT> m_Offsets; //byte offset of every argument in the record
+	UINT m_Size;
+};
+
+//one object of the GPU culling pass, as StructuredBuffer<CullObject> in Culling.hlsl
+struct GpuCullObject
+{
+	float Center[3];
+	float Radius;
+	float Extents[3];
+	uint32_t CommandIndex; //record in the template buffer drawing the object
+
+	static GpuCullObject Make(const SceneBounds& bounds, uint32_t commandIndex)
+	{
+		GpuCullObject object;
+		memcpy(object.Center, bounds.Center, sizeof(object.Center));
+		object.Radius = bounds.Radius;
+		memcpy(object.Extents, bounds.Extents, sizeof(object.Extents));
+		object.CommandIndex = commandIndex;
+		return object;
+	}
+};
+static_assert(sizeof(GpuCullObject) == 32, "GpuCullObject must match CullObject in Culling.hlsl");
+
+//root constants of the GPU culling pass, as the CullConstants cbuffer in Culling.hlsl
+struct GpuCullConstants
+{
+	float Planes[Frustum::PlaneCount][4]; //xyz inward normal, w distance
+	uint32_t ObjectCount;
+	uint32_t CommandDwords; //record size, the layout's byte stride / 4
+	uint32_t MaxCommands; //size of the output buffer in records
+	uint32_t Padding;
+
+	static const UINT Count = 28; //32 bit values
+
+	static GpuCullConstants Make(const Frustum& frustum, uint32_t objectCount, const IndirectCommandLayout& layout, uint32_t maxCommands)
+	{
+		GpuCullConstants constants;
+		for (int p = 0; p < Frustum::PlaneCount; ++p)
+		{
+			constants.Planes[p][0] = frustum.NX[p];
+			constants.Planes[p][1] = frustum.NY[p];
+			constants.Planes[p][2] = frustum.NZ[p];
+			constants.Planes[p][3] = frustum.D[p];
+		}
+		constants.ObjectCount = objectCount;
+		constants.CommandDwords = layout.GetByteStride() / 4;
+		constants.MaxCommands = maxCommands;
+		constants.Padding = 0;
+		return constants;
+	}
+};
+static_assert(sizeof(GpuCullConstants) == GpuCullConstants::Count * 4, "GpuCullConstants must match CullConstants in Culling.hlsl");
+
+//what CSCull in Culling.hlsl does, on the CPU: copies the template record of every object inside the frustum
+//to commands and returns how many were written, the value the GPU leaves in the count buffer clamped to
+//MaxCommands. The GPU appends in whatever order its threads get there, this appends in object order.
+inline uint32_t CullIndirectCommandsReference(const GpuCullConstants& constants, const GpuCullObject* objects, const void* templates, void* commands)
+{
+	uint32_t count = 0;
+	size_t recordSize = size_t(constants.CommandDwords) * 4;
+	for (uint32_t i = 0; i < constants.ObjectCount; ++i)
+	{
+		const GpuCullObject& object = objects[i];
+		bool outside = false;
+		for (int p = 0; p < Frustum::PlaneCount && !outside; ++p)
+		{
+			const float* plane = constants.Planes[p];
+			float distance = plane[0] * object.Center[0] + plane[1] * object.Center[1] + plane[2] * object.Center[2] + plane[3];
+			float reach = fabsf(plane[0]) * object.Extents[0] + fabsf(plane[1]) * object.Extents[1] + fabsf(plane[2]) * object.Extents[2];
+			outside = distance < -std::min(reach, object.Radius);
+		}
+		if (outside || count >= constants.MaxCommands)
+		{
+			continue;
+		}
+		memcpy(static_cast<uint8_t*>(commands) + count * recordSize, static_cast<const uint8_t*>(templates) + object.CommandIndex * recordSize, recordSize);
+		++count;
+	}
+	return count;
+}
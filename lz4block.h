@@ -0,0 +1,231 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+//LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), compatible with LZ4_compress_default
+//and LZ4_decompress_safe, so blocks written here decode with the library and the other way around. The compressor
+//is the single probe greedy one of LZ4's fast mode; decompression is what runs at load time and never reads or
+//writes outside the buffers it is given, whatever the input.
+namespace Lz4
+{
+	const size_t MinMatch = 4;
+	const size_t LastLiterals = 5; //the last bytes of a block are always literals
+	const size_t MatchFindLimit = 12; //and no match starts in the last 12
+	const size_t MaxOffset = 65535;
+
+	inline size_t CompressBound(size_t size) { return size + size / 255 + 16; }
+
+	inline uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	//length past the 4 bit field of the token, in bytes of 255 and a last one below it
+	inline uint8_t* WriteLength(uint8_t* out, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			*out++ = 255;
+		}
+		*out++ = static_cast<uint8_t>(length);
+		return out;
+	}
+
+	//returns the compressed size, 0 when it doesn't fit into capacity. CompressBound(size) always fits.
+	inline size_t Compress(const void* source, size_t size, void* destination, size_t capacity)
+	{
+		const uint8_t* const begin = static_cast<const uint8_t*>(source);
+		const uint8_t* const end = begin + size;
+		uint8_t* const outBegin = static_cast<uint8_t*>(destination);
+		uint8_t* const outEnd = outBegin + capacity;
+		uint8_t* out = outBegin;
+
+		const uint32_t HashBits = 12;
+		uint32_t table[1 << HashBits];
+		memset(table, 0, sizeof(table));
+
+		const uint8_t* anchor = begin;
+		if (size > MatchFindLimit)
+		{
+			const uint8_t* const matchLimit = end - LastLiterals;
+			const uint8_t* const findLimit = end - MatchFindLimit;
+			const uint8_t* in = begin + 1;
+			while (in < findLimit)
+			{
+				uint32_t sequence = Read32(in);
+				uint32_t hash = (sequence * 2654435761u) >> (32 - HashBits);
+				const uint8_t* candidate = begin + table[hash];
+				table[hash] = static_cast<uint32_t>(in - begin);
+				if (candidate >= in || size_t(in - candidate) > MaxOffset || Read32(candidate) != sequence)
+				{
+					++in;
+					continue;
+				}
+
+				while (in > anchor && candidate > begin && in[-1] == candidate[-1])
+				{
+					--in;
+					--candidate;
+				}
+				const uint8_t* matchEnd = in + MinMatch;
+				const uint8_t* reference = candidate + MinMatch;
+				while (matchEnd < matchLimit && *matchEnd == *reference)
+				{
+					++matchEnd;
+					++reference;
+				}
+
+				size_t literals = static_cast<size_t>(in - anchor);
+				size_t matchLength = static_cast<size_t>(matchEnd - in) - MinMatch;
+				if (size_t(outEnd - out) < 1 + literals / 255 + 1 + literals + 2 + matchLength / 255 + 1)
+				{
+					return 0;
+				}
+				uint8_t* token = out++;
+				*token = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4);
+				if (literals >= 15)
+				{
+					out = WriteLength(out, literals - 15);
+				}
+				memcpy(out, anchor, literals);
+				out += literals;
+				size_t offset = static_cast<size_t>(in - candidate);
+				*out++ = static_cast<uint8_t>(offset);
+				*out++ = static_cast<uint8_t>(offset >> 8);
+				*token |= static_cast<uint8_t>(matchLength < 15 ? matchLength : 15);
+				if (matchLength >= 15)
+				{
+					out = WriteLength(out, matchLength - 15);
+				}
+				in = anchor = matchEnd;
+			}
+		}
+
+		size_t literals = static_cast<size_t>(end - anchor);
+		if (size_t(outEnd - out) < 1 + literals / 255 + 1 + literals)
+		{
+			return 0;
+		}
+		*out++ = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4);
+		if (literals >= 15)
+		{
+			out = WriteLength(out, literals - 15);
+		}
+		memcpy(out, anchor, literals);
+		out += literals;
+		return static_cast<size_t>(out - outBegin);
+	}
+
+	//false unless source decodes to exactly size bytes
+	inline bool Decompress(const void* source, size_t sourceSize, void* destination, size_t size)
+	{
+		const uint8_t* in = static_cast<const uint8_t*>(source);
+		const uint8_t* const inEnd = in + sourceSize;
+		uint8_t* const outBegin = static_cast<uint8_t*>(destination);
+		uint8_t* out = outBegin;
+		uint8_t* const outEnd = outBegin + size;
+
+		auto readLength = [&](size_t& length)
+		{
+			uint8_t byte;
+			do
+			{
+				if (in >= inEnd)
+				{
+					return false;
+				}
+				byte = *in++;
+				length += byte;
+			} while (byte == 255);
+			return true;
+		};
+
+		while (in < inEnd)
+		{
+			uint8_t token = *in++;
+			size_t literals = token >> 4;
+
+			//most sequences are short: with room left in both buffers the literals and the match are copied in
+			//fixed 16 and 24 byte blocks, writing past the sequence into bytes the next ones overwrite
+			if (literals < 15 && (token & 15) < 15 && size_t(inEnd - in) >= 16 + 2 && size_t(outEnd - out) >= 16 + 24)
+			{
+				memcpy(out, in, 16);
+				out += literals;
+				in += literals;
+				size_t offset = in[0] | (size_t(in[1]) << 8);
+				if (offset >= 8 && offset <= size_t(out - outBegin))
+				{
+					in += 2;
+					const uint8_t* match = out - offset;
+					memcpy(out, match, 8);
+					memcpy(out + 8, match + 8, 8);
+					memcpy(out + 16, match + 16, 8);
+					out += (token & 15) + MinMatch;
+					continue;
+				}
+				//a short or invalid offset goes the checked way, with the literals already copied
+				literals = 0;
+			}
+			if (literals == 15 && !readLength(literals))
+			{
+				return false;
+			}
+			if (literals > size_t(inEnd - in) || literals > size_t(outEnd - out))
+			{
+				return false;
+			}
+			memcpy(out, in, literals);
+			out += literals;
+			in += literals;
+			if (in == inEnd)
+			{
+				break; //the last sequence has literals only
+			}
+
+			if (inEnd - in < 2)
+			{
+				return false;
+			}
+			size_t offset = in[0] | (size_t(in[1]) << 8);
+			in += 2;
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !readLength(matchLength))
+			{
+				return false;
+			}
+			matchLength += MinMatch;
+			if (!offset || offset > size_t(out - outBegin) || matchLength > size_t(outEnd - out))
+			{
+				return false;
+			}
+
+			//the match may overlap what it writes, a short offset repeats the bytes before it
+			const uint8_t* match = out - offset;
+			if (offset >= 8)
+			{
+				size_t copied = 0;
+				for (; copied + 8 <= matchLength; copied += 8)
+				{
+					memcpy(out + copied, match + copied, 8);
+				}
+				for (; copied < matchLength; ++copied)
+				{
+					out[copied] = match[copied];
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < matchLength; ++i)
+				{
+					out[i] = match[i];
+				}
+			}
+			out += matchLength;
+		}
+		return out == outEnd;
+	}
+}
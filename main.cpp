@@ -4,12 +4,27 @@
 #include <wrl/client.h>
 #include <d3d12.h>
 #include <dxgi1_4.h>
+#ifdef DXGI_PRESENT_ALLOW_TEARING //SDKs that know about tearing also have IDXGIFactory5 to check for it
+#include <dxgi1_5.h>
+#endif
 #include <DirectXMath.h>
 #include <vector>
+#include <thread>
+#include <unordered_map>
+#include <algorithm>
 
 //helper class/functions for D3D12 taken from documentation pages
 #include "helpers.h"
 #include "textureloader.h"
+#include "drawpackets.h"
+#include "gpuresidency.h"
+#include "gpurendergraph.h"
+#include "framepacing.h"
+#include "frameprofiler.h"
+#include "tracing.h"
+#include "triplebuffer.h"
+#include "scene.h"
+#include "gpuindirectdraw.h"
 
 #include <SDL.h>
 #undef main
@@ -30,10 +45,41 @@ D3D12_VIEWPORT mViewPort; //viewport, same as d3d11
 RECT mRectScissor;
 HANDLE mHandle; //fired by the fence when the GPU signals it, CPU waits on this event handle
 Shader g_VS;
-Shader g_PS;
+WorkerPool g_CompilePool; //compiles shader variants and pipelines requested mid-session off the frame thread
+ShaderPermutations g_PSPermutations;
+uint32_t g_PSUseTextureAxis;
+std::shared_ptr<Shader> g_PS;
+std::shared_ptr<Shader> g_PSUntextured;
 RootSignature g_RootSig;
-PipelineStateObject g_PSO;
+PipelineStateCache g_PSOCache; //pipelines compiled by the driver in earlier runs, saved by Frame once no compile is pending
+AssetArchive g_Assets; //assets.pack built by tools/assetpack.cpp, loose files are loaded when it is missing
+AsyncGraphicsPipelineCompiler g_Pipelines;
+AsyncGraphicsPipelineCompiler::Handle g_TexturedPipeline; //drawn with the untextured fallback until it is compiled
 VertexBufferResource g_VB;
+PositionQuantization g_TriangleQuantization; //positions of g_VB are SNORM16 over the triangle bounds, undone by the worldmatrix
+IndexBufferResource g_IB;
+DrawList g_DrawList; //draws of the frame, sorted and recorded without redundant state changes
+Scene g_Scene; //bounds of everything drawn, culled against the view frustum every frame
+Scene::ObjectId g_TriangleObject;
+std::vector<Scene::ObjectId> g_Visible; //objects of the frame inside the frustum
+
+//GPU driven path: a compute pass culls the objects and writes the draw arguments of the visible ones, drawn
+//with one ExecuteIndirect in the order the cull pass appends them. Off, the CPU culls the scene and records the
+//draws one by one through g_DrawList, sorted by state and front to back, which is what the depth prepass and
+//early Z are tuned for.
+bool g_GpuDrivenDraws = false;
+Shader g_CullCS;
+GpuIndirectCuller g_GpuCuller;
+
+//depth buffer, recreated with the swapchain buffers. With the prepass the opaque draws first lay down depth front to
+//back with the position only pipeline and the main pass only tests against it, so hidden fragments are rejected by
+//early Z before PSMain samples the texture. Read when the pipelines are created in InitD3D.
+bool g_DepthPrepass = true;
+const DXGI_FORMAT g_DepthFormat = DXGI_FORMAT_D32_FLOAT;
+Microsoft::WRL::ComPtr<ID3D12Resource> mDepthBuffer;
+CDescriptorHeapWrapper mDSVDescriptorHeap;
+AsyncGraphicsPipelineCompiler::Handle g_DepthPrepassPipeline = AsyncGraphicsPipelineCompiler::InvalidHandle;
+DrawList g_DepthDrawList; //the prepass draws, sorted front to back
 
 //Constant buffer resources, mapped pointers, and descriptor heap for view/proj CBVs
 CUploadBufferWrapper mWorldMatrix;
@@ -41,14 +87,63 @@ CUploadBufferWrapper mViewMatrix;
 CUploadBufferWrapper mProjMatrix;
 CDescriptorHeapWrapper mCBDescriptorHeap;
 
+//placed resource heaps shared by the texture and static geometry instead of one implicit heap each
+GpuMemoryAllocator g_GpuAllocator;
+
+//tracks video memory use against the budget and evicts heaps that haven't been drawn from for a while
+GpuResidencyManager g_Residency;
+
+//current state of the backbuffers and textures, transitions are queued against it and recorded in one batch
+ResourceStateTracker g_ResourceStates;
+
+//the frame's passes, rebuilt every frame; transitions and intermediate targets are worked out from what each pass reads and writes
+GpuRenderGraph g_RenderGraph;
+
 //texture support
 Microsoft::WRL::ComPtr<ID3D12Resource> mTexture2D; //default heap resource, GPU will copy texture resource to these from upload buffer
+GpuAllocation mTexture2DAllocation;
+std::unordered_map<ID3D12Heap*, GpuResidencyManager::Handle> g_HeapResidency; //the allocator's heaps, paged in and out as a whole
 CDescriptorHeapWrapper mSamplerHeap;
 
 //Fullscreen support
 HWND g_hWnd;
 BOOL g_requestResize = false;
 
+//presentation: low latency mode waits on the swapchain's frame latency object before sampling input,
+//so the frame shows the freshest input instead of sitting behind queued frames
+FramePacingSettings g_PacingSettings = { PresentMode::LowLatency, 1, false, 0.0 };
+SteadyFrameClock g_FrameClock;
+FramePacer g_FramePacer;
+UINT g_SwapChainFlags = 0; //creation flags, ResizeBuffers has to be passed the same ones
+HANDLE g_FrameLatencyWaitable = NULL;
+
+//CPU time per phase of the frame loop, percentiles and hitches are reported to the debug output
+FrameProfiler g_FrameProfiler;
+const UINT g_ProfileReportInterval = 600; //frames
+const char* g_ProfileCsvFile = nullptr; //also append the reports to this CSV file when set
+
+//GPU time of the frame and of each render graph pass, read back a frame after the GPU finished it
+GpuTimestampProfiler g_GpuProfiler;
+uint64_t g_FrameNumber = 0;
+
+//timeline of CPU and GPU scopes, only recorded in builds with ENABLE_TRACING; written on exit, open in chrome://tracing or ui.perfetto.dev
+const char* g_TraceFile = "trace.json";
+
+//the main thread only pumps SDL events and publishes what they add up to; the render thread picks up the newest
+//snapshot at the start of each frame, so a burst of events or a slow frame never holds up the other side.
+//Counts only go up, a snapshot skipped by the triple buffer loses nothing.
+struct InputSnapshot
+{
+	uint64_t Sequence; //published snapshots so far
+	double Time; //g_FrameClock time of publishing
+	uint64_t Events; //SDL events pumped so far
+	uint32_t Resizes; //window size changes so far
+	int32_t MouseX;
+	int32_t MouseY;
+	bool Quit;
+};
+TripleBuffer<InputSnapshot> g_Input;
+
 
 
 
@@ -58,7 +153,11 @@ void InitD3D(HWND hWnd);    // sets up and initializes Direct3D
 void CleanD3D(void);        // closes Direct3D and releases memory
 void Frame();				// called once per frame to build then execute command list, and then present frame
 void WaitForCommandQueueFence(); //function called by command queue after executing command list, blocks CPU thread until GPU signals mFence
-HRESULT ResizeSwapChain(); //resizes the swapchain buffers to the client window size, recreates the RTVs
+void WaitForNextFrame(); //blocks until the swapchain can take another frame, call before sampling input
+void RenderThreadMain(); //frame loop of the render thread, runs until a snapshot asks to quit
+bool CheckTearingSupport(); //whether windowed FLIP_DISCARD swapchains may tear when presenting without vsync
+HRESULT ResizeSwapChain(); //resizes the swapchain buffers to the client window size, recreates the RTVs and the depth buffer
+HRESULT CreateDepthBuffer(UINT width, UINT height); //depth buffer matching the back buffers and its DSV
 
 /*
 							// the WindowProc function prototype
@@ -162,6 +261,7 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPara
 // this function initializes and prepares Direct3D for use
 void InitD3D(HWND hWnd)
 {
+	TRACE_SCOPE("InitD3D");
 	//This example shows calling D3D12CreateDevice to create the device.
 	HRESULT hr = D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0,
 			__uuidof(ID3D12Device), (void**)&mDevice);
@@ -181,6 +281,31 @@ void InitD3D(HWND hWnd)
 	hr = mDevice->CreateCommandQueue(&commandQueueDesc, __uuidof(ID3D12CommandQueue), (void**)&mCommandQueue);
 
 	//Create the swap chain similarly to how it was done in Direct3D 11.
+	g_FramePacer.Create(g_PacingSettings, &g_FrameClock, CheckTearingSupport());
+	g_FrameProfiler.Create(&g_FrameClock);
+	g_FrameProfiler.SetLog([](const char* line)
+	{
+		OutputDebugStringA(line);
+		if (g_GpuProfiler.GetTimings().HasTimings())
+		{
+			OutputDebugStringA(g_GpuProfiler.GetTimings().Format().c_str());
+		}
+	}, g_ProfileReportInterval);
+	if (g_ProfileCsvFile)
+	{
+		g_FrameProfiler.OpenCsv(g_ProfileCsvFile);
+	}
+	g_SwapChainFlags = 0;
+	if (g_FramePacer.UseWaitableObject())
+	{
+		g_SwapChainFlags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+	}
+#ifdef DXGI_PRESENT_ALLOW_TEARING
+	if (g_FramePacer.UseTearing())
+	{
+		g_SwapChainFlags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+	}
+#endif
 
 	// Create the swap chain descriptor.
 	DXGI_SWAP_CHAIN_DESC swapChainDesc;
@@ -191,9 +316,8 @@ void InitD3D(HWND hWnd)
 	swapChainDesc.OutputWindow = hWnd;
 	swapChainDesc.SampleDesc.Count = 1;
 	swapChainDesc.Windowed = TRUE;
-	swapChainDesc.Flags = 0; //DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
-	//swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-	swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+	swapChainDesc.Flags = g_SwapChainFlags;
+	swapChainDesc.SwapEffect = g_FramePacer.IsLowLatency() ? DXGI_SWAP_EFFECT_FLIP_DISCARD : DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
 
 	
 	// Get the DXGI factory used to create the swap chain.
@@ -204,10 +328,11 @@ void InitD3D(HWND hWnd)
 	// Create the swap chain using the command queue, NOT using the device.  Thanks Killeak!
 	hr = dxgiFactory->CreateSwapChain(mCommandQueue.Get(), &swapChainDesc, (IDXGISwapChain**)mSwapChain.GetAddressOf());
 
-	//increase max frame latency when required
+	//limit how many frames can be queued, the waitable object is signalled whenever the queue has room for another
 	if (swapChainDesc.Flags & DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT)
 	{
-		mSwapChain->SetMaximumFrameLatency(g_bbCount);
+		mSwapChain->SetMaximumFrameLatency(g_FramePacer.GetMaximumFrameLatency());
+		g_FrameLatencyWaitable = mSwapChain->GetFrameLatencyWaitableObject();
 	}
 
 	dxgiFactory->Release();
@@ -215,6 +340,7 @@ void InitD3D(HWND hWnd)
 	//Create the RTV descriptor heap with g_bbCount entries (front and back buffer since swapchain resource rotation is no longer automatic).
 	//Documentation recommends flip_sequential for D3D12, see - https://msdn.microsoft.com/en-us/library/windows/desktop/dn903945
 	mRTVDescriptorHeap.Create(mDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV, g_bbCount);
+	mDSVDescriptorHeap.Create(mDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 2); //writable and read only view of the depth buffer
 
 	//RTV descriptor and viewport/scissor initialization moved to seperate function
 	hr = ResizeSwapChain();
@@ -247,37 +373,57 @@ void InitD3D(HWND hWnd)
 	
 	//changed shader compile target to HLSL 5.0
 	g_VS.Load("Shaders.hlsl", "VSMain", "vs_5_0");
-	g_PS.Load("Shaders.hlsl", "PSMain", "ps_5_0");
+	//the pixel shader is built from permutations, the variant drawn with is needed before the first frame so compile it now.
+	ShaderPermutationKeySpace psKeySpace;
+	g_PSUseTextureAxis = psKeySpace.AddBoolAxis("USE_TEXTURE");
+	g_CompilePool.Start(1);
+	g_PSPermutations.Create("Shaders.hlsl", "PSMain", "ps_5_0", psKeySpace, &g_CompilePool);
+	g_PS = g_PSPermutations.RequestBlocking(psKeySpace.Set(0, g_PSUseTextureAxis, 1));
+	g_PSUntextured = g_PSPermutations.RequestBlocking(psKeySpace.Set(0, g_PSUseTextureAxis, 0));
+	if (!g_PS || !g_PSUntextured) throw;
 	//changed root sig function to include 2 root parameters: A root CBV of worldmatrix, 
 	//and a two entry descriptor table for view and proj matrix CBVs
 	g_RootSig.Create(mDevice.Get());
 
 	
-	VertexTypes::P3F_T2F triangleVerts[] =
-	{
-		{ 0.0f, 0.5f, 0.0f, { 0.5f, 0.0f } },
-		{ 0.45f, -0.5, 0.0f, { 1.0f, 1.0f } },
-		{ -0.45f, -0.5f, 0.0f, { 0.0f, 1.0f } }
-	};
-
-	g_VB.Create(
-		mDevice.Get(), sizeof(triangleVerts), 
-		sizeof(VertexTypes::P3F_T2F), triangleVerts);
+	g_PSOCache.Create(mDevice.Get(), L"pipelines.cache");
+	g_Pipelines.Create(g_PSOCache, &g_CompilePool);
 
+	//the fallback has to exist before the first frame, everything else is compiled in the background.
+	//After a prepass the color pipelines only test depth, without one they write it.
+	AsyncGraphicsPipelineCompiler::Handle fallbackPipeline = g_Pipelines.Submit(
+		PipelineStateObjectDescription::Simple(
+			VertexTypes::P3S16_T2U16::GetInputLayoutDesc(),
+			g_RootSig,
+			g_VS, *g_PSUntextured
+		).SetDepth(g_DepthFormat, !g_DepthPrepass));
+	if (!g_Pipelines.Wait(fallbackPipeline)) throw;
+	g_Pipelines.SetFallback(fallbackPipeline);
 
-	g_PSO.Create(
-		mDevice.Get(),
+	g_TexturedPipeline = g_Pipelines.Submit(
 		PipelineStateObjectDescription::Simple(
-			VertexTypes::P3F_T2F::GetInputLayoutDesc(),
+			VertexTypes::P3S16_T2U16::GetInputLayoutDesc(),
 			g_RootSig,
-			g_VS, g_PS
-		));
+			g_VS, *g_PS
+		).SetDepth(g_DepthFormat, !g_DepthPrepass));
+
+	//the fallback can't stand in for the prepass pipeline, it writes a render target the prepass doesn't bind
+	if (g_DepthPrepass)
+	{
+		g_DepthPrepassPipeline = g_Pipelines.Submit(
+			PipelineStateObjectDescription::DepthOnly(
+				VertexTypes::P3S16_T2U16::GetInputLayoutDesc(),
+				g_RootSig,
+				g_VS, g_DepthFormat
+			));
+		if (!g_Pipelines.Wait(g_DepthPrepassPipeline)) throw;
+	}
 
 	//With the command list allocator and a PSO, you can create the actual command list, which will be executed at a later time.
 	//This example shows calling ID3D12Device::CreateCommandList.
 	hr = mDevice->CreateCommandList(
 		1, D3D12_COMMAND_LIST_TYPE_DIRECT, 
-		mCommandListAllocator.Get(), g_PSO.Get(), 
+		mCommandListAllocator.Get(), g_Pipelines.Resolve(fallbackPipeline), 
 		__uuidof(ID3D12CommandList), (void**)&mCommandList);
 	ThrowIfFailed(hr);
 
@@ -313,14 +459,48 @@ void InitD3D(HWND hWnd)
 
 	//loads dds texture file into an upload buffer then issues a command for the GPU to copy it to a default resource. 
 	//See CreateD3DResources in textureloader.h for the details.
-	hr = CreateTexture2D(mDevice.Get(), mCommandList.Get(), &textureUploadBuffer, L"seafloor2.dds", mTexture2D.GetAddressOf());
+	g_GpuAllocator.Create(mDevice.Get());
+	g_RenderGraph.Create(mDevice.Get(), &g_ResourceStates);
+	g_GpuProfiler.Create(mDevice.Get(), mCommandQueue.Get());
+	g_RenderGraph.SetTimestampProfiler(&g_GpuProfiler);
+	if (SUCCEEDED(g_Assets.Open("assets.pack")))
+	{
+		SetTextureArchive(&g_Assets);
+	}
+	//the cooked texture from tools/texturecook.cpp when there is one, it goes to the upload buffer without re-pitching
+	hr = CreateTexture2DFromTextureFile(mDevice.Get(), mCommandList.Get(), &textureUploadBuffer, "seafloor2.tex", mTexture2D.GetAddressOf(),
+		&g_GpuAllocator, &mTexture2DAllocation);
+	if (FAILED(hr))
+	{
+		hr = CreateTexture2D(mDevice.Get(), mCommandList.Get(), &textureUploadBuffer, L"seafloor2.dds", mTexture2D.GetAddressOf(),
+			&g_GpuAllocator, &mTexture2DAllocation);
+	}
 	
 	// Transition the texture resource to a generic read state.
-	setResourceBarrier(mCommandList.Get(), mTexture2D.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
-
-	//The commandlist now contains the uploadbuffer-to-default-resource copy command, as well as the barrier
-	//to transition the default resource to a generic read state.  Those operations must be executed before the resource
-	//is ready for use in the render loop.
+	g_ResourceStates.Register(mTexture2D.Get(), D3D12_RESOURCE_STATE_COPY_DEST, GetSubresourceCount(mTexture2D->GetDesc()));
+	g_ResourceStates.Transition(mTexture2D.Get(), D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	//the triangle never changes, so stage it through the same upload buffer into default heap vertex and index buffers.
+	//it is authored in floats and packed into 12 byte vertices, 20 in floats.
+	float trianglePositions[] = { 0.0f, 0.5f, 0.0f, 0.45f, -0.5, 0.0f, -0.45f, -0.5f, 0.0f };
+	float triangleTexCoords[] = { 0.5f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+	VertexStreams triangleStreams = { 3, trianglePositions, nullptr, triangleTexCoords, nullptr };
+	g_TriangleQuantization = PositionQuantization::FromPositions(trianglePositions, 3);
+	VertexTypes::P3S16_T2U16 triangleVerts[3];
+	VertexTypes::P3S16_T2U16::Layout::Encode(triangleStreams, g_TriangleQuantization, triangleVerts);
+	uint16_t triangleIndices[] = { 0, 1, 2 };
+
+	g_VB.CreateStatic(
+		mDevice.Get(), mCommandList.Get(), &textureUploadBuffer,
+		sizeof(triangleVerts), sizeof(VertexTypes::P3S16_T2U16), triangleVerts, &g_GpuAllocator);
+	g_IB.CreateStatic(
+		mDevice.Get(), mCommandList.Get(), &textureUploadBuffer,
+		sizeof(triangleIndices), DXGI_FORMAT_R16_UINT, triangleIndices, &g_GpuAllocator);
+
+	//The commandlist now contains the uploadbuffer-to-default-resource copy commands, as well as the barriers
+	//to transition the default resources to their read states.  Those operations must be executed before the resources
+	//are ready for use in the render loop.
+	g_ResourceStates.Flush(mCommandList.Get());
 	mCommandList->Close();
 	mCommandQueue->ExecuteCommandLists(1, (ID3D12CommandList* const*)mCommandList.GetAddressOf());
 
@@ -340,6 +520,43 @@ void InitD3D(HWND hWnd)
 	//wait for GPU to signal it has finished processing the queued command list(s).
 	WaitForCommandQueueFence();
 
+	//every frame waits for the GPU before the next one starts, so one frame is in flight at most.
+	//the texture and geometry are placed, so the residency manager pages the heaps holding them. A heap is paged
+	//as a whole, the texture can't drop mips on its own, so there is no mip bias callback.
+	g_Residency.Create(mDevice.Get(), 1);
+	std::vector<ID3D12Heap*> heaps;
+	g_GpuAllocator.GetHeaps(heaps);
+	for (ID3D12Heap* heap : heaps)
+	{
+		g_HeapResidency[heap] = g_Residency.RegisterPageable(heap, heap->GetDesc().SizeInBytes);
+	}
+
+	//the triangle spins around Y, so its bounds cover every rotation of it
+	float triangleMin[3] = { -0.45f, -0.5f, -0.45f };
+	float triangleMax[3] = { 0.45f, 0.5f, 0.45f };
+	g_TriangleObject = g_Scene.Add(SceneBounds::FromBox(triangleMin, triangleMax), 0);
+	g_Scene.Build();
+
+	//the records drawing the objects on the GPU driven path change the worldmatrix CBV, the vertex and index
+	//buffers and the draw; the pipeline, descriptor tables and topology are set once for all of them
+	g_CullCS.Load("Culling.hlsl", "CSCull", "cs_5_0");
+	IndirectCommandLayout drawLayout;
+	uint32_t worldMatrixArgument = drawLayout.AddConstantBufferView(0);
+	uint32_t vertexBufferArgument = drawLayout.AddVertexBufferView(0);
+	uint32_t indexBufferArgument = drawLayout.AddIndexBufferView();
+	uint32_t drawArgument = drawLayout.AddDrawIndexed();
+	g_GpuCuller.Create(mDevice.Get(), drawLayout, g_RootSig.Get(), g_CullCS, 1024);
+
+	uint32_t triangleCommand = g_GpuCuller.AddObject(SceneBounds::FromBox(triangleMin, triangleMax));
+	D3D12_DRAW_INDEXED_ARGUMENTS triangleDraw = { UINT(g_IB.GetIndexCount()), 1, 0, 0, 0 };
+	void* record = g_GpuCuller.GetCommandRecord(triangleCommand);
+	drawLayout.Write(record, worldMatrixArgument, mWorldMatrix.pBuf->GetGPUVirtualAddress());
+	drawLayout.Write(record, vertexBufferArgument, g_VB.GetView());
+	drawLayout.Write(record, indexBufferArgument, g_IB.GetView());
+	drawLayout.Write(record, drawArgument, triangleDraw);
+	g_ResourceStates.Register(g_GpuCuller.GetCommandBuffer(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+	g_ResourceStates.Register(g_GpuCuller.GetCountBuffer(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+
 	// Command list allocators can be only be reset when the associated command lists have finished execution on the GPU; 
 	// apps should use fences to determine GPU execution progress.
 	hr = mCommandListAllocator->Reset();
@@ -347,12 +564,29 @@ void InitD3D(HWND hWnd)
 
 }
 
+//marks the heap a placed resource lives in as read by this frame, committed resources (null) aren't paged
+void MarkHeapUsed(const GpuAllocation* allocation)
+{
+	if (!allocation)
+	{
+		return;
+	}
+	auto heap = g_HeapResidency.find(g_GpuAllocator.GetHeap(*allocation));
+	if (heap != g_HeapResidency.end())
+	{
+		g_Residency.MarkUsed(heap->second);
+	}
+}
+
 void Frame()
 {
+	TRACE_SCOPE("Frame");
 	using namespace DirectX;
 
 	HRESULT hr;
 
+	g_FrameProfiler.BeginPhase(FrameProfiler::ConstantUpdate);
+
 	if (g_requestResize) ResizeSwapChain();
 
 	//rotation in radians of 0-90, 270-360 degrees (skip backfacing angles)
@@ -361,9 +595,11 @@ void Frame()
 	if ((angle > XM_PI * 0.5f) && (angle < XM_PI * 1.5f)) angle = XM_PI * 1.5f;
 	if (angle > XM_2PI) angle = 0.0f;
 
-	//rotate worldmatrix around Y, transpose, and copy to the persistently mapped upload heap resource of the worldmatrix buffer
-	XMMATRIX rotated = XMMatrixIdentity();
-	rotated = XMMatrixRotationY(angle);
+	//dequantize the triangle positions, rotate around Y, transpose, and copy to the persistently mapped upload heap
+	//resource of the worldmatrix buffer
+	XMFLOAT4X4 dequantize;
+	g_TriangleQuantization.GetMatrix(&dequantize.m[0][0]);
+	XMMATRIX rotated = XMLoadFloat4x4(&dequantize) * XMMatrixRotationY(angle);
 	rotated = XMMatrixTranspose(rotated);
 	memcpy(mWorldMatrix.pDataBegin, &rotated, sizeof(rotated));
 
@@ -373,14 +609,36 @@ void Frame()
 	XMVECTOR eyedir { 0.0f, 0.0f, 0.0f, 0.0f };
 	XMVECTOR updir { 0.0f, 1.0f, 0.0f, 0.0f };
 	XMMATRIX view = XMMatrixLookAtLH(eye, eyedir, updir);
-	view = XMMatrixTranspose(view);
-	memcpy(mViewMatrix.pDataBegin, &view, sizeof(view));
+	XMMATRIX viewT = XMMatrixTranspose(view);
+	memcpy(mViewMatrix.pDataBegin, &viewT, sizeof(viewT));
 
 	//build and copy projection matrix to the persistently mapped projmatrix buffer
 	XMMATRIX proj = XMMatrixPerspectiveFovLH((XM_PI / 4.0f), (6.0f / 8.0f), 0.1f, 100.0f);
-	proj = XMMatrixTranspose(proj);
-	memcpy(mProjMatrix.pDataBegin, &proj, sizeof(proj));
+	XMMATRIX projT = XMMatrixTranspose(proj);
+	memcpy(mProjMatrix.pDataBegin, &projT, sizeof(projT));
+
+	//only objects inside the view frustum become draw packets
+	g_FrameProfiler.BeginPhase(FrameProfiler::Culling);
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, view * proj);
+	Frustum frustum = Frustum::FromViewProjection(&viewProjection.m[0][0]);
+	if (!g_GpuDrivenDraws)
+	{
+		g_Scene.Cull(frustum, g_Visible);
+	}
+
+	//mark the heaps this frame draws from, then let the residency manager page in or evict against the budget.
+	//The GPU driven path only finds out on the GPU what is visible, so everything it culls counts as drawn.
+	if (g_GpuDrivenDraws || std::find(g_Visible.begin(), g_Visible.end(), g_TriangleObject) != g_Visible.end())
+	{
+		MarkHeapUsed(&mTexture2DAllocation);
+		MarkHeapUsed(g_VB.GetAllocation());
+		MarkHeapUsed(g_IB.GetAllocation());
+	}
+	g_Residency.BeginFrame();
 	
+	g_FrameProfiler.BeginPhase(FrameProfiler::Recording);
+
 	//Get the index of the active back buffer from the swapchain
 	UINT backBufferIndex = 0;
 	backBufferIndex = mSwapChain->GetCurrentBackBufferIndex();
@@ -390,66 +648,239 @@ void Frame()
 	D3D12_CPU_DESCRIPTOR_HANDLE rtv = mRTVDescriptorHeap.hCPU(backBufferIndex);
 	
 
+	//describe the draw as a packet: the root CBV of the worldmatrix, the root descriptor table containing the view
+	//and proj matrices' view descriptors, then the SRV and sampler tables. The draw lists sort the packets and only
+	//record the state that actually changes between them.
+	//The sort key uses the pipeline actually bound, the fallback while the textured one compiles.
+	AsyncGraphicsPipelineCompiler::Handle trianglePipeline = g_Pipelines.ResolveHandle(g_TexturedPipeline);
+	DrawPacket triangle;
+	ZeroMemory(&triangle, sizeof(triangle));
+	triangle.Pipeline = g_Pipelines.Resolve(trianglePipeline);
+	triangle.RootSignature = g_RootSig.Get();
+	triangle.DescriptorHeapCount = 2;
+	triangle.DescriptorHeaps[0] = mCBDescriptorHeap.pDH.Get();
+	triangle.DescriptorHeaps[1] = mSamplerHeap.pDH.Get();
+	triangle.RootConstantBuffer = mWorldMatrix.pBuf->GetGPUVirtualAddress();
+	triangle.RootTableCount = 3;
+	triangle.RootTables[0] = mCBDescriptorHeap.hGPUHeapStart;
+	triangle.RootTables[1] = mCBDescriptorHeap.hGPU(2); //the single SRV was put on the end of the CB heap
+	triangle.RootTables[2] = mSamplerHeap.hGPUHeapStart;
+	triangle.Topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	triangle.VertexBuffer = g_VB.GetView();
+	triangle.IndexBuffer = g_IB.GetView();
+	triangle.IndexCount = g_IB.GetIndexCount();
+	triangle.InstanceCount = 1;
+
+	//the keys end in the view depth of the object, so draws sharing a pipeline and material go front to back.
+	//The prepass draws all share the depth only pipeline, its list is front to back as a whole.
+	g_DrawList.Reset();
+	g_DepthDrawList.Reset();
+	if (!g_GpuDrivenDraws)
+	{
+		for (Scene::ObjectId object : g_Visible)
+		{
+			if (object != g_TriangleObject)
+			{
+				continue;
+			}
+			float depth = frustum.GetNormalizedDepth(g_Scene.GetBounds(object).Center);
+			DrawPacket draw = triangle;
+			draw.SortKey = DrawSortKey::Make(0, trianglePipeline, 0, depth);
+			g_DrawList.Add(draw);
+			if (g_DepthPrepass)
+			{
+				draw.Pipeline = g_Pipelines.Resolve(g_DepthPrepassPipeline);
+				draw.SortKey = DrawSortKey::Make(0, g_DepthPrepassPipeline, 0, depth);
+				g_DepthDrawList.Add(draw);
+			}
+		}
+		g_DrawList.Sort();
+		g_DepthDrawList.Sort();
+	}
+
+	//the GPU driven path draws with the state the records don't change set once
+	auto drawIndirect = [&](ID3D12GraphicsCommandList* commandList, ID3D12PipelineState* pipeline)
+	{
+		//not compiled yet and nothing to stand in for it, the draws are skipped this frame
+		if (!pipeline)
+		{
+			return;
+		}
+		commandList->SetPipelineState(pipeline);
+		commandList->SetGraphicsRootSignature(triangle.RootSignature);
+		commandList->SetDescriptorHeaps(triangle.DescriptorHeapCount, triangle.DescriptorHeaps);
+		for (UINT t = 0; t < triangle.RootTableCount; ++t)
+		{
+			commandList->SetGraphicsRootDescriptorTable(1 + t, triangle.RootTables[t]);
+		}
+		commandList->IASetPrimitiveTopology(triangle.Topology);
+		g_GpuCuller.RecordDraw(commandList);
+	};
+
 	//Now, reuse the command list for the current frame.
-	//Reattach the viewport to the command list, indicate that the resource will be in use as a render target, record commands, and then 
-	//indicate that the render target will be used to present when the command list is done executing.
-
-	//This example shows calling ID3D12GraphicsCommandList::ResourceBarrier to indicate to the system that you are about to use a resource.
-	//Resource barriers are used to handle multiple accesses to a resource(refer to the Remarks for ResourceBarrier).
-	//You have to explicitly state that mRenderTarget is about to be changed from being "used to present" to being "used as a render target".
-	mCommandList->RSSetViewports(1, &mViewPort);
-	mCommandList->RSSetScissorRects(1, &mRectScissor);
-	mCommandList->SetPipelineState(g_PSO.Get());
-	mCommandList->SetGraphicsRootSignature(g_RootSig.Get());
-
-	//set the root CBV of the worldmatrix and the root descriptor table containing the view and proj matrices' view descriptors
-	mCommandList->SetGraphicsRootConstantBufferView(0, mWorldMatrix.pBuf->GetGPUVirtualAddress());
-	ID3D12DescriptorHeap* pHeaps[2] = { mCBDescriptorHeap.pDH.Get(), mSamplerHeap.pDH.Get() };
-	mCommandList->SetDescriptorHeaps(2, pHeaps); //this call IS necessary
-	mCommandList->SetGraphicsRootDescriptorTable(1, mCBDescriptorHeap.hGPUHeapStart);
-	//set the SRV and sampler tables
-	mCommandList->SetGraphicsRootDescriptorTable(2, mCBDescriptorHeap.hGPU(2)); //the single SRV was put on the end of the CB heap
-	mCommandList->SetGraphicsRootDescriptorTable(3, mSamplerHeap.hGPUHeapStart);
-
-	// Indicate that this resource will be in use as a render target.
-	setResourceBarrier(mCommandList.Get(), mRenderTarget[backBufferIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-	
-	// Record commands.
-	float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-	mCommandList->ClearRenderTargetView(rtv, clearColor, NULL, 0);
-	mCommandList->OMSetRenderTargets(1, &rtv, TRUE, nullptr);
-	mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	mCommandList->IASetVertexBuffers(0, 1, &g_VB.GetView());
-	mCommandList->DrawInstanced(3, 1, 0, 0);
+	//The frame is a render graph: the optional depth prepass, then the main pass drawing to the backbuffer. The graph
+	//transitions the backbuffer from "used to present" to "used as a render target" before the main pass and back to
+	//present after it, and the depth buffer from written to read between the two, batched through the resource state
+	//tracker; passes rendering to intermediate targets would be added the same way.
+	g_RenderGraph.Reset();
+	GpuRenderGraph::ResourceHandle backBuffer = g_RenderGraph.Import(mRenderTarget[backBufferIndex].Get(), D3D12_RESOURCE_STATE_PRESENT);
+	GpuRenderGraph::ResourceHandle depthBuffer = g_RenderGraph.Import(mDepthBuffer.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE);
+	D3D12_CPU_DESCRIPTOR_HANDLE dsv = mDSVDescriptorHeap.hCPU(0);
+	D3D12_CPU_DESCRIPTOR_HANDLE readOnlyDsv = mDSVDescriptorHeap.hCPU(1);
+
+	//on the GPU driven path the draw count is cleared, then the cull pass appends the visible objects' records
+	//for the passes drawing them; the graph transitions the argument buffers in between
+	GpuRenderGraph::ResourceHandle drawCommands = 0, drawCount = 0;
+	if (g_GpuDrivenDraws)
+	{
+		drawCommands = g_RenderGraph.Import(g_GpuCuller.GetCommandBuffer(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+		drawCount = g_RenderGraph.Import(g_GpuCuller.GetCountBuffer(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+
+		GpuRenderGraph::PassHandle clearPass = g_RenderGraph.AddPass("clear draw count", [](ID3D12GraphicsCommandList* commandList)
+		{
+			g_GpuCuller.RecordClear(commandList);
+		});
+		g_RenderGraph.Write(clearPass, drawCount, D3D12_RESOURCE_STATE_COPY_DEST);
+
+		GpuRenderGraph::PassHandle cullPass = g_RenderGraph.AddPass("cull", [&](ID3D12GraphicsCommandList* commandList)
+		{
+			g_GpuCuller.RecordCull(commandList, frustum);
+		});
+		g_RenderGraph.Write(cullPass, drawCount, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		g_RenderGraph.Write(cullPass, drawCommands, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	}
 
-	// Indicate that the render target will now be used to present when the command list is done executing.
-	setResourceBarrier(mCommandList.Get(), mRenderTarget[backBufferIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+	if (g_DepthPrepass)
+	{
+		GpuRenderGraph::PassHandle depthPass = g_RenderGraph.AddPass("depth prepass", [&](ID3D12GraphicsCommandList* commandList)
+		{
+			commandList->RSSetViewports(1, &mViewPort);
+			commandList->RSSetScissorRects(1, &mRectScissor);
+			commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+			commandList->OMSetRenderTargets(0, nullptr, FALSE, &dsv);
+			if (g_GpuDrivenDraws)
+			{
+				drawIndirect(commandList, g_Pipelines.Resolve(g_DepthPrepassPipeline));
+				return;
+			}
+			g_DepthDrawList.Submit(commandList);
+		});
+		g_RenderGraph.Write(depthPass, depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+		if (g_GpuDrivenDraws)
+		{
+			g_RenderGraph.Read(depthPass, drawCommands, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+			g_RenderGraph.Read(depthPass, drawCount, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+		}
+	}
+
+	GpuRenderGraph::PassHandle mainPass = g_RenderGraph.AddPass("main", [&](ID3D12GraphicsCommandList* commandList)
+	{
+		commandList->RSSetViewports(1, &mViewPort);
+		commandList->RSSetScissorRects(1, &mRectScissor);
+
+		// Record commands.
+		float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
+		commandList->ClearRenderTargetView(rtv, clearColor, NULL, 0);
+		if (g_DepthPrepass)
+		{
+			//the prepass filled the depth buffer, it is only tested here
+			commandList->OMSetRenderTargets(1, &rtv, TRUE, &readOnlyDsv);
+		}
+		else
+		{
+			commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+			commandList->OMSetRenderTargets(1, &rtv, TRUE, &dsv);
+		}
+
+		if (g_GpuDrivenDraws)
+		{
+			drawIndirect(commandList, triangle.Pipeline);
+			return;
+		}
+		g_DrawList.Submit(commandList);
+	});
+	g_RenderGraph.Write(mainPass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	if (g_DepthPrepass)
+	{
+		g_RenderGraph.Read(mainPass, depthBuffer, D3D12_RESOURCE_STATE_DEPTH_READ);
+	}
+	else
+	{
+		g_RenderGraph.Write(mainPass, depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+	}
+	if (g_GpuDrivenDraws)
+	{
+		g_RenderGraph.Read(mainPass, drawCommands, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+		g_RenderGraph.Read(mainPass, drawCount, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+	}
+
+	{
+		TRACE_SCOPE("RenderGraph.Compile");
+		hr = g_RenderGraph.Compile();
+	}
+	g_GpuProfiler.BeginFrame(g_FrameNumber);
+	if (SUCCEEDED(hr))
+	{
+		GpuTimestampScope frameScope(&g_GpuProfiler, mCommandList.Get(), "frame");
+		g_RenderGraph.Execute(mCommandList.Get());
+	}
+	else
+	{
+		//a pass reads a transient nothing wrote, or the heaps couldn't be created. Nothing is recorded, the back
+		//buffer is still in the present state the tracker left it in, so the frame presents what was there.
+		OutputDebugStringA("RenderGraph.Compile failed, the frame is skipped\n");
+	}
+	g_GpuProfiler.EndFrame(mCommandList.Get());
 
 	// Execute the command list.
+	g_FrameProfiler.BeginPhase(FrameProfiler::Submit);
 	hr = mCommandList->Close();
 	mCommandQueue->ExecuteCommandLists(1, (ID3D12CommandList* const*)mCommandList.GetAddressOf());
 
+	//persist the blobs of the pipelines the driver had to compile so the next launch skips them. Only once the
+	//background compiles are done, Save does nothing when no new pipeline came in since the last one.
+	if (!g_Pipelines.GetPendingCount())
+	{
+		g_PSOCache.Save();
+	}
+
 
 	// Swap the back and front buffers.
+	g_FrameProfiler.BeginPhase(FrameProfiler::Present);
 	DXGI_PRESENT_PARAMETERS params;
 	ZeroMemory(&params, sizeof(params));
 	//hr = mSwapChain->Present1(0, DXGI_PRESENT_DO_NOT_WAIT, &params);
-	hr = mSwapChain->Present(0, 0);
+	UINT presentFlags = 0;
+#ifdef DXGI_PRESENT_ALLOW_TEARING
+	if (g_FramePacer.UseTearing())
+	{
+		presentFlags |= DXGI_PRESENT_ALLOW_TEARING;
+	}
+#endif
+	{
+		TRACE_SCOPE("Present");
+		hr = mSwapChain->Present(g_FramePacer.GetSyncInterval(), presentFlags);
+	}
+	g_FramePacer.EndFrame();
 
 	//wait for GPU to signal it has finished processing the queued command list(s).
+	g_FrameProfiler.BeginPhase(FrameProfiler::FenceWait);
 	WaitForCommandQueueFence();
+	g_GpuProfiler.Collect(g_FrameNumber++); //the fence wait means this frame's timestamps are already resolved
 
 
 	// Command list allocators can be only be reset when the associated command lists have finished execution on the GPU; 
 	// apps should use fences to determine GPU execution progress.
 	hr = mCommandListAllocator->Reset();
 	hr = mCommandList->Reset(mCommandListAllocator.Get(), NULL);
+	g_FrameProfiler.EndPhase();
 }
 
 //Assigns an event to mFence, and sets the fence's completion signal value. 
 //Then asks the GPU to signal that fence, and asks the CPU to wait for the event handle.
 void WaitForCommandQueueFence()
 {
+	TRACE_SCOPE("WaitForCommandQueueFence");
 	//reset the fence signal
 	mFence->Signal(0);
 	//set the event to be fired once the signal value is 1
@@ -462,6 +893,35 @@ void WaitForCommandQueueFence()
 	WaitForSingleObject(mHandle, INFINITE);
 }
 
+void WaitForNextFrame()
+{
+	TRACE_SCOPE("WaitForNextFrame");
+	double waited = 0.0;
+	if (g_FrameLatencyWaitable)
+	{
+		double start = g_FrameClock.Now();
+		WaitForSingleObjectEx(g_FrameLatencyWaitable, 1000, TRUE);
+		waited = g_FrameClock.Now() - start;
+	}
+	g_FramePacer.BeginFrame(waited);
+}
+
+bool CheckTearingSupport()
+{
+	BOOL allowTearing = FALSE;
+#ifdef DXGI_PRESENT_ALLOW_TEARING
+	Microsoft::WRL::ComPtr<IDXGIFactory5> factory;
+	if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(factory.GetAddressOf()))))
+	{
+		if (FAILED(factory->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allowTearing, sizeof(allowTearing))))
+		{
+			allowTearing = FALSE;
+		}
+	}
+#endif
+	return allowTearing == TRUE;
+}
+
 HRESULT ResizeSwapChain()
 {
 	HRESULT hr = S_OK;
@@ -481,11 +941,15 @@ HRESULT ResizeSwapChain()
 		//release existing backbuffer resources pointers (use reset for ComPtr rather than release, or just assign nullptr).
 		for (UINT i = 0; i < g_bbCount; ++i)
 		{
+			if (mRenderTarget[i])
+			{
+				g_ResourceStates.Unregister(mRenderTarget[i].Get());
+			}
 			mRenderTarget[i].Reset();
 		}
 
 		//resize the swapchain buffers
-		mSwapChain->ResizeBuffers(g_bbCount, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0); //DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT);
+		mSwapChain->ResizeBuffers(g_bbCount, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, g_SwapChainFlags);
 
 		//A buffer is required to render to.This example shows how to create that buffer by using the swap chain and device.
 		//This example shows calling ID3D12Device::CreateRenderTargetView.
@@ -500,8 +964,11 @@ HRESULT ResizeSwapChain()
 			hr = mSwapChain->GetBuffer(i, __uuidof(ID3D12Resource), (LPVOID*)&mRenderTarget[i]);
 			mRenderTarget[0]->SetName(L"mRenderTarget" + i);  //set debug name 
 			mDevice->CreateRenderTargetView(mRenderTarget[i].Get(), &rtvDesc, mRTVDescriptorHeap.hCPU(i));
+			g_ResourceStates.Register(mRenderTarget[i].Get(), D3D12_RESOURCE_STATE_PRESENT);
 		}
 
+		hr = CreateDepthBuffer(width, height);
+
 		//fill out a viewport struct
 		ZeroMemory(&mViewPort, sizeof(D3D12_VIEWPORT));
 		mViewPort.TopLeftX = 0;
@@ -518,6 +985,59 @@ HRESULT ResizeSwapChain()
 }
 
 
+HRESULT CreateDepthBuffer(UINT width, UINT height)
+{
+	if (mDepthBuffer)
+	{
+		g_ResourceStates.Unregister(mDepthBuffer.Get());
+		mDepthBuffer.Reset();
+	}
+
+	D3D12_HEAP_PROPERTIES heapProps;
+	ZeroMemory(&heapProps, sizeof(heapProps));
+	heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+	heapProps.CreationNodeMask = 1;
+	heapProps.VisibleNodeMask = 1;
+
+	D3D12_RESOURCE_DESC depthDesc;
+	ZeroMemory(&depthDesc, sizeof(depthDesc));
+	depthDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	depthDesc.Width = width;
+	depthDesc.Height = height;
+	depthDesc.DepthOrArraySize = 1;
+	depthDesc.MipLevels = 1;
+	depthDesc.Format = g_DepthFormat;
+	depthDesc.SampleDesc.Count = 1;
+	depthDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	depthDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL | D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
+
+	//clears to the far plane are then the fast clears
+	D3D12_CLEAR_VALUE clearValue;
+	ZeroMemory(&clearValue, sizeof(clearValue));
+	clearValue.Format = g_DepthFormat;
+	clearValue.DepthStencil.Depth = 1.0f;
+
+	HRESULT hr = mDevice->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &depthDesc,
+		D3D12_RESOURCE_STATE_DEPTH_WRITE, &clearValue, IID_PPV_ARGS(mDepthBuffer.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+	mDepthBuffer->SetName(L"mDepthBuffer");
+
+	D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
+	ZeroMemory(&dsvDesc, sizeof(dsvDesc));
+	dsvDesc.Format = g_DepthFormat;
+	dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+	mDevice->CreateDepthStencilView(mDepthBuffer.Get(), &dsvDesc, mDSVDescriptorHeap.hCPU(0));
+	dsvDesc.Flags = D3D12_DSV_FLAG_READ_ONLY_DEPTH;
+	mDevice->CreateDepthStencilView(mDepthBuffer.Get(), &dsvDesc, mDSVDescriptorHeap.hCPU(1));
+
+	g_ResourceStates.Register(mDepthBuffer.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE);
+	return S_OK;
+}
+
+
 // this is the function that cleans up Direct3D and COM
 void CleanD3D(void)
 {
@@ -526,23 +1046,85 @@ void CleanD3D(void)
 
 	//close the event handle so that mFence can actually release()
 	CloseHandle(mHandle);
+	if (g_FrameLatencyWaitable)
+	{
+		CloseHandle(g_FrameLatencyWaitable);
+	}
+
+	g_CompilePool.Stop();
+	g_PSOCache.Save();
+	SetTextureArchive(nullptr);
+	g_Assets.Close();
+	TRACE_FLUSH(g_TraceFile);
+}
+
+void RenderThreadMain()
+{
+	TRACE_THREAD_NAME("Render");
+	uint32_t resizes = 0;
+	for (;;)
+	{
+		//wait for the swapchain first, then take the input, so the frame is built from the latest snapshot
+		TRACE_SCOPE("FrameLoop");
+		g_FrameProfiler.BeginFrame();
+		g_FrameProfiler.BeginPhase(FrameProfiler::LatencyWait);
+		WaitForNextFrame();
+
+		g_FrameProfiler.BeginPhase(FrameProfiler::EventPump);
+		TRACE_COLLECT(); //keeps the thread buffers from filling up over a long run
+		g_Input.Consume();
+		const InputSnapshot& input = g_Input.GetReadBuffer();
+		if (input.Quit) break;
+		if (input.Resizes != resizes)
+		{
+			resizes = input.Resizes;
+			g_requestResize = true;
+		}
+
+		Frame();
+		g_FrameProfiler.EndFrame();
+	}
 }
 
 void main(int argc, char *args[]) {
 	SDL_Window* window = SDL_CreateWindow("DirectX 12 Test", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 800, 600, 0);
 
+	TRACE_ENABLE(true);
+	TRACE_THREAD_NAME("Main");
+
 	g_hWnd = GetActiveWindow();
 	InitD3D(g_hWnd);
 
-	while (TRUE)
+	std::thread renderThread(RenderThreadMain);
+
+	InputSnapshot input = {};
+	while (!input.Quit)
 	{
+		//sleeps until the first event, then drains the rest before publishing them together
 		SDL_Event windowEvent;
-		if (SDL_PollEvent(&windowEvent)) {
-			if (windowEvent.type == SDL_QUIT) break;
+		if (!SDL_WaitEventTimeout(&windowEvent, 100))
+		{
+			continue;
 		}
-
-		Frame();
+		TRACE_SCOPE("EventPump");
+		do
+		{
+			++input.Events;
+			if (windowEvent.type == SDL_QUIT) input.Quit = true;
+			if (windowEvent.type == SDL_WINDOWEVENT && windowEvent.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) ++input.Resizes;
+			if (windowEvent.type == SDL_MOUSEMOTION)
+			{
+				input.MouseX = windowEvent.motion.x;
+				input.MouseY = windowEvent.motion.y;
+			}
+		} while (SDL_PollEvent(&windowEvent));
+
+		++input.Sequence;
+		input.Time = g_FrameClock.Now();
+		g_Input.GetWriteBuffer() = input;
+		g_Input.Publish();
 	}
 
+	renderThread.join();
 	CleanD3D();
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "d3d12types.h"
+
+//read only mapping of a whole file. Pages are read in by the OS as they are first touched and shared with its file
+//cache, so loading costs no read into a buffer of our own and nothing until the data is used. Pointers into the
+//view stay valid until Close.
+class MappedFile
+{
+public:
+	MappedFile() : m_Data(nullptr), m_Size(0)
+#ifdef _WIN32
+		, m_File(INVALID_HANDLE_VALUE), m_Mapping(nullptr)
+#endif
+	{
+	}
+
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//an empty file opens with a null view
+	HRESULT Open(const char* fileName)
+	{
+		Close();
+#ifdef _WIN32
+		m_File = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_File, &size))
+		{
+			HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+			Close();
+			return hr;
+		}
+		m_Size = static_cast<size_t>(size.QuadPart);
+		if (!m_Size)
+		{
+			return S_OK;
+		}
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_Mapping)
+		{
+			m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+		if (!m_Data)
+		{
+			HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+			Close();
+			return hr;
+		}
+#else
+		int file = open(fileName, O_RDONLY);
+		if (file < 0)
+		{
+			return E_FAIL;
+		}
+		struct stat status;
+		if (fstat(file, &status) != 0)
+		{
+			close(file);
+			return E_FAIL;
+		}
+		m_Size = static_cast<size_t>(status.st_size);
+		if (m_Size)
+		{
+			void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (data == MAP_FAILED)
+			{
+				close(file);
+				m_Size = 0;
+				return E_FAIL;
+			}
+			m_Data = static_cast<const uint8_t*>(data);
+		}
+		//the mapping keeps the file alive
+		close(file);
+#endif
+		return S_OK;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (m_Data)
+		{
+			UnmapViewOfFile(m_Data);
+		}
+		if (m_Mapping)
+		{
+			CloseHandle(m_Mapping);
+			m_Mapping = nullptr;
+		}
+		if (m_File != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_File);
+			m_File = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (m_Data)
+		{
+			munmap(const_cast<uint8_t*>(m_Data), m_Size);
+		}
+#endif
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+
+	//asks the OS to read the range in ahead of its use, so a copy out of it streams instead of faulting page by page
+	void Prefetch(size_t offset, size_t size) const
+	{
+		if (!m_Data || offset >= m_Size)
+		{
+			return;
+		}
+		size = offset + size > m_Size ? m_Size - offset : size;
+#ifdef _WIN32
+		WIN32_MEMORY_RANGE_ENTRY range = { const_cast<uint8_t*>(m_Data + offset), size };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+		//madvise wants a page aligned start
+		size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		size_t start = offset / page * page;
+		madvise(const_cast<uint8_t*>(m_Data + start), size + offset - start, MADV_WILLNEED);
+#endif
+	}
+
+	const uint8_t* GetData() const { return m_Data; }
+	size_t GetSize() const { return m_Size; }
+
+private:
+	const uint8_t* m_Data;
+	size_t m_Size;
+#ifdef _WIN32
+	HANDLE m_File;
+	HANDLE m_Mapping;
+#endif
+};
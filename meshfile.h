@@ -0,0 +1,339 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "d3d12types.h"
+#include "mappedfile.h"
+#include "vertexformats.h"
+
+//binary mesh container, laid out so loading is mapping the file and pointing into it:
+//
+//  MeshFileHeader | MeshFileSection[SectionCount] | payloads
+//
+//Every payload starts at a multiple of MeshFileSectionAlignment, a page, so it can be copied into staging or handed
+//to a DMA straight from the mapped file. The vertex and index payloads are exactly what the GPU reads, in the
+//format of the input layout section, and the structs are read in place: little endian, no pointers, no padding.
+//A reader rejects any other Version; changes that move fields bump it.
+const uint32_t MeshFileMagic = 0x4853454d; //"MESH"
+const uint32_t MeshFileVersion = 1;
+const uint32_t MeshFileSectionAlignment = 4096;
+
+struct MeshFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t FileSize; //of the whole file, so a truncated copy is caught before anything points past its end
+	uint32_t SectionCount;
+	uint32_t VertexCount;
+	uint32_t VertexStride;
+	uint32_t IndexCount;
+	uint32_t IndexFormat; //DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT
+	float BoundsMin[3]; //of the positions before quantization, for SceneBounds
+	float BoundsMax[3];
+	uint32_t Reserved;
+};
+static_assert(sizeof(MeshFileHeader) == 64, "MeshFileHeader is read in place");
+
+enum MeshFileSectionType : uint32_t
+{
+	MeshFileSectionVertices = 1,
+	MeshFileSectionIndices = 2,
+	MeshFileSectionInputLayout = 3, //MeshFileElement per element
+	MeshFileSectionQuantization = 4, //PositionQuantization, absent for float positions
+};
+
+struct MeshFileSection
+{
+	uint32_t Type;
+	uint32_t Count; //of elements, vertices or indices
+	uint64_t Offset;
+	uint64_t Size;
+};
+static_assert(sizeof(MeshFileSection) == 24, "MeshFileSection is read in place");
+
+//a D3D12_INPUT_ELEMENT_DESC of input slot 0 and per vertex data
+struct MeshFileElement
+{
+	char SemanticName[16]; //null terminated
+	uint32_t SemanticIndex;
+	uint32_t Format;
+	uint32_t AlignedByteOffset;
+	uint32_t Reserved;
+};
+static_assert(sizeof(MeshFileElement) == 32, "MeshFileElement is read in place");
+static_assert(sizeof(PositionQuantization) == 24, "PositionQuantization is read in place");
+
+//what a converter writes, the vertices already in the format of InputLayout
+struct MeshFileContents
+{
+	const void* Vertices;
+	uint32_t VertexCount;
+	uint32_t VertexStride;
+	const void* Indices;
+	uint32_t IndexCount;
+	DXGI_FORMAT IndexFormat;
+	D3D12_INPUT_LAYOUT_DESC InputLayout;
+	const PositionQuantization* Quantization; //null for float positions
+	float BoundsMin[3];
+	float BoundsMax[3];
+};
+
+//the complete file for contents, appended to image
+inline HRESULT BuildMeshFile(const MeshFileContents& contents, std::vector<uint8_t>& image)
+{
+	if (!contents.Vertices || !contents.VertexCount || !contents.VertexStride || !contents.Indices || !contents.IndexCount ||
+		(contents.IndexFormat != DXGI_FORMAT_R16_UINT && contents.IndexFormat != DXGI_FORMAT_R32_UINT))
+	{
+		return E_INVALIDARG;
+	}
+	std::vector<MeshFileElement> elements(contents.InputLayout.NumElements);
+	for (UINT e = 0; e < contents.InputLayout.NumElements; ++e)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& desc = contents.InputLayout.pInputElementDescs[e];
+		if (strlen(desc.SemanticName) >= sizeof(elements[e].SemanticName) || desc.InputSlot != 0 ||
+			desc.InputSlotClass != D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA || desc.AlignedByteOffset == D3D12_APPEND_ALIGNED_ELEMENT)
+		{
+			return E_INVALIDARG;
+		}
+		memset(&elements[e], 0, sizeof(elements[e]));
+		strcpy(elements[e].SemanticName, desc.SemanticName);
+		elements[e].SemanticIndex = desc.SemanticIndex;
+		elements[e].Format = desc.Format;
+		elements[e].AlignedByteOffset = desc.AlignedByteOffset;
+	}
+
+	struct Payload
+	{
+		MeshFileSectionType Type;
+		uint32_t Count;
+		const void* Data;
+		uint64_t Size;
+	};
+	const Payload payloads[] =
+	{
+		{ MeshFileSectionVertices, contents.VertexCount, contents.Vertices, uint64_t(contents.VertexCount) * contents.VertexStride },
+		{ MeshFileSectionIndices, contents.IndexCount, contents.Indices, uint64_t(contents.IndexCount) * (contents.IndexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4) },
+		{ MeshFileSectionInputLayout, uint32_t(elements.size()), elements.data(), elements.size() * sizeof(MeshFileElement) },
+		{ MeshFileSectionQuantization, 1, contents.Quantization, contents.Quantization ? sizeof(PositionQuantization) : 0 },
+	};
+	const uint32_t sectionCount = contents.Quantization ? 4 : 3;
+
+	size_t base = image.size();
+	uint64_t offset = sizeof(MeshFileHeader) + sectionCount * sizeof(MeshFileSection);
+	std::vector<MeshFileSection> sections(sectionCount);
+	for (uint32_t s = 0; s < sectionCount; ++s)
+	{
+		offset = (offset + MeshFileSectionAlignment - 1) / MeshFileSectionAlignment * MeshFileSectionAlignment;
+		sections[s].Type = payloads[s].Type;
+		sections[s].Count = payloads[s].Count;
+		sections[s].Offset = offset;
+		sections[s].Size = payloads[s].Size;
+		offset += payloads[s].Size;
+	}
+
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Magic = MeshFileMagic;
+	header.Version = MeshFileVersion;
+	header.FileSize = offset;
+	header.SectionCount = sectionCount;
+	header.VertexCount = contents.VertexCount;
+	header.VertexStride = contents.VertexStride;
+	header.IndexCount = contents.IndexCount;
+	header.IndexFormat = contents.IndexFormat;
+	memcpy(header.BoundsMin, contents.BoundsMin, sizeof(header.BoundsMin));
+	memcpy(header.BoundsMax, contents.BoundsMax, sizeof(header.BoundsMax));
+
+	image.resize(base + static_cast<size_t>(offset), 0);
+	memcpy(&image[base], &header, sizeof(header));
+	memcpy(&image[base + sizeof(header)], sections.data(), sectionCount * sizeof(MeshFileSection));
+	for (uint32_t s = 0; s < sectionCount; ++s)
+	{
+		memcpy(&image[base + static_cast<size_t>(sections[s].Offset)], payloads[s].Data, static_cast<size_t>(payloads[s].Size));
+	}
+	return S_OK;
+}
+
+inline HRESULT SaveMeshFile(const char* fileName, const MeshFileContents& contents)
+{
+	std::vector<uint8_t> image;
+	HRESULT hr = BuildMeshFile(contents, image);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+	FILE* file = fopen(fileName, "wb");
+	if (!file)
+	{
+		return E_FAIL;
+	}
+	bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+	written = fclose(file) == 0 && written;
+	return written ? S_OK : E_FAIL;
+}
+
+//a mesh file, mapped by Open or already in memory through Attach. Loading checks the header and the section table
+//and points into the image; the payloads are never parsed or copied. Everything returned points into the image,
+//the input layout's semantic names included, so it is valid until Close.
+class MeshFile
+{
+public:
+	MeshFile() { Close(); }
+
+	HRESULT Open(const char* fileName)
+	{
+		Close();
+		HRESULT hr = m_File.Open(fileName);
+		if (SUCCEEDED(hr))
+		{
+			hr = Attach(m_File.GetData(), m_File.GetSize());
+		}
+		if (SUCCEEDED(hr))
+		{
+			//the payloads are about to be copied to staging, have the OS read them in ahead of the copy
+			m_File.Prefetch(static_cast<size_t>(m_Vertices - m_File.GetData()), m_File.GetSize());
+		}
+		else
+		{
+			Close();
+		}
+		return hr;
+	}
+
+	//image must stay valid until Close, and be aligned to at least 16 bytes for the payloads to be
+	HRESULT Attach(const void* image, size_t size)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(image);
+		if (!data || size < sizeof(MeshFileHeader))
+		{
+			return E_FAIL;
+		}
+		const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(data);
+		if (header->Magic != MeshFileMagic || header->Version != MeshFileVersion || header->FileSize != size ||
+			header->SectionCount > (size - sizeof(MeshFileHeader)) / sizeof(MeshFileSection))
+		{
+			return E_FAIL;
+		}
+		UINT indexSize = header->IndexFormat == DXGI_FORMAT_R16_UINT ? 2 : header->IndexFormat == DXGI_FORMAT_R32_UINT ? 4 : 0;
+		if (!indexSize || !header->VertexStride)
+		{
+			return E_FAIL;
+		}
+
+		const MeshFileSection* sections = reinterpret_cast<const MeshFileSection*>(data + sizeof(MeshFileHeader));
+		const uint8_t* vertices = nullptr;
+		const uint8_t* indices = nullptr;
+		const MeshFileElement* elements = nullptr;
+		uint32_t elementCount = 0;
+		const PositionQuantization* quantization = nullptr;
+		for (uint32_t s = 0; s < header->SectionCount; ++s)
+		{
+			const MeshFileSection& section = sections[s];
+			if (section.Offset % MeshFileSectionAlignment || section.Offset > size || section.Size > size - section.Offset)
+			{
+				return E_FAIL;
+			}
+			const uint8_t* payload = data + section.Offset;
+			switch (section.Type)
+			{
+			case MeshFileSectionVertices:
+				if (section.Count != header->VertexCount || section.Size != uint64_t(header->VertexCount) * header->VertexStride)
+				{
+					return E_FAIL;
+				}
+				vertices = payload;
+				break;
+			case MeshFileSectionIndices:
+				if (section.Count != header->IndexCount || section.Size != uint64_t(header->IndexCount) * indexSize)
+				{
+					return E_FAIL;
+				}
+				indices = payload;
+				break;
+			case MeshFileSectionInputLayout:
+				if (!section.Count || section.Size != uint64_t(section.Count) * sizeof(MeshFileElement))
+				{
+					return E_FAIL;
+				}
+				elements = reinterpret_cast<const MeshFileElement*>(payload);
+				elementCount = section.Count;
+				break;
+			case MeshFileSectionQuantization:
+				if (section.Size != sizeof(PositionQuantization))
+				{
+					return E_FAIL;
+				}
+				quantization = reinterpret_cast<const PositionQuantization*>(payload);
+				break;
+			default:
+				//sections of later tools this version doesn't know are skipped
+				break;
+			}
+		}
+		if (!vertices || !indices || !elements)
+		{
+			return E_FAIL;
+		}
+
+		m_Elements.resize(elementCount);
+		for (uint32_t e = 0; e < elementCount; ++e)
+		{
+			const MeshFileElement& element = elements[e];
+			if (!memchr(element.SemanticName, 0, sizeof(element.SemanticName)) || element.AlignedByteOffset >= header->VertexStride)
+			{
+				return E_FAIL;
+			}
+			D3D12_INPUT_ELEMENT_DESC& desc = m_Elements[e];
+			desc.SemanticName = element.SemanticName;
+			desc.SemanticIndex = element.SemanticIndex;
+			desc.Format = static_cast<DXGI_FORMAT>(element.Format);
+			desc.InputSlot = 0;
+			desc.AlignedByteOffset = element.AlignedByteOffset;
+			desc.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+			desc.InstanceDataStepRate = 0;
+		}
+
+		m_Header = header;
+		m_Vertices = vertices;
+		m_Indices = indices;
+		m_InputLayout.pInputElementDescs = m_Elements.data();
+		m_InputLayout.NumElements = elementCount;
+		m_Quantization = quantization ? *quantization : PositionQuantization::Identity();
+		return S_OK;
+	}
+
+	void Close()
+	{
+		m_File.Close();
+		m_Header = nullptr;
+		m_Vertices = nullptr;
+		m_Indices = nullptr;
+		m_Elements.clear();
+		m_InputLayout.pInputElementDescs = nullptr;
+		m_InputLayout.NumElements = 0;
+		m_Quantization = PositionQuantization::Identity();
+	}
+
+	const MeshFileHeader& GetHeader() const { return *m_Header; }
+	const void* GetVertices() const { return m_Vertices; }
+	uint64_t GetVertexBytes() const { return uint64_t(m_Header->VertexCount) * m_Header->VertexStride; }
+	const void* GetIndices() const { return m_Indices; }
+	DXGI_FORMAT GetIndexFormat() const { return static_cast<DXGI_FORMAT>(m_Header->IndexFormat); }
+	uint64_t GetIndexBytes() const { return uint64_t(m_Header->IndexCount) * (m_Header->IndexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4); }
+	const D3D12_INPUT_LAYOUT_DESC& GetInputLayoutDesc() const { return m_InputLayout; }
+	//identity when the file has none, multiply it in front of the world matrix
+	const PositionQuantization& GetQuantization() const { return m_Quantization; }
+
+private:
+	MappedFile m_File;
+	const MeshFileHeader* m_Header;
+	const uint8_t* m_Vertices;
+	const uint8_t* m_Indices;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> m_Elements;
+	D3D12_INPUT_LAYOUT_DESC m_InputLayout;
+	PositionQuantization m_Quantization;
+};
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "d3d12types.h"
+#include "hashing.h"
+#include "mappedfile.h"
+#include "meshfile.h"
+#include "meshoptimizer.h"
+#include "vertexformats.h"
+
+//text mesh import for the asset pipeline: Wavefront OBJ into float streams, and from there into a mesh file, see
+//ConvertToMeshFile. The renderer itself only loads the mesh files.
+
+//vertices of an OBJ file, one per distinct position/texcoord/normal corner, with a triangle list over them
+struct ObjMesh
+{
+	std::vector<float> Positions; //3 per vertex
+	std::vector<float> Normals; //3 per vertex, empty when the file has none
+	std::vector<float> TexCoords; //2 per vertex, empty when the file has none
+	std::vector<uint32_t> Indices;
+
+	size_t GetVertexCount() const { return Positions.size() / 3; }
+
+	VertexStreams GetStreams() const
+	{
+		VertexStreams streams = { GetVertexCount(), Positions.data(), Normals.empty() ? nullptr : Normals.data(), TexCoords.empty() ? nullptr : TexCoords.data(), nullptr };
+		return streams;
+	}
+};
+
+//v, vt, vn and f lines, polygons are split into fans and everything else is skipped. OBJ is right handed with V
+//up: z and the winding are flipped into the left handed space of the renderer, and V into D3D's texture space.
+inline HRESULT ParseObj(const char* text, size_t size, ObjMesh& mesh)
+{
+	struct Corner
+	{
+		int32_t Position, TexCoord, Normal;
+		bool operator==(const Corner& other) const { return Position == other.Position && TexCoord == other.TexCoord && Normal == other.Normal; }
+	};
+	struct CornerHash
+	{
+		size_t operator()(const Corner& corner) const
+		{
+			return static_cast<size_t>(Hasher().Add(corner.Position).Add(corner.TexCoord).Add(corner.Normal).Get());
+		}
+	};
+
+	std::vector<float> positions, texCoords, normals;
+	std::vector<Corner> corners;
+	std::unordered_map<Corner, uint32_t, CornerHash> vertices;
+	mesh = ObjMesh();
+
+	const char* end = text + size;
+	//strtof stops at the end of the number, so the fields are read in place. The line is copied first when it is
+	//the last of the buffer so a number can't run off the end of a mapped file.
+	char lastLine[256];
+	for (const char* line = text; line < end;)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(line, '\n', static_cast<size_t>(end - line)));
+		const char* next = lineEnd ? lineEnd + 1 : end;
+		if (!lineEnd)
+		{
+			size_t length = std::min(static_cast<size_t>(end - line), sizeof(lastLine) - 1);
+			memcpy(lastLine, line, length);
+			lastLine[length] = '\0';
+			line = lastLine;
+			lineEnd = lastLine + length;
+		}
+
+		auto readFloats = [&](const char* cursor, int count, std::vector<float>& target)
+		{
+			for (int c = 0; c < count; ++c)
+			{
+				char* after;
+				float value = strtof(cursor, &after);
+				target.push_back(after == cursor ? 0.0f : value);
+				cursor = after;
+			}
+		};
+		if (line[0] == 'v' && line[1] == ' ')
+		{
+			readFloats(line + 2, 3, positions);
+		}
+		else if (line[0] == 'v' && line[1] == 't' && line[2] == ' ')
+		{
+			readFloats(line + 3, 2, texCoords);
+		}
+		else if (line[0] == 'v' && line[1] == 'n' && line[2] == ' ')
+		{
+			readFloats(line + 3, 3, normals);
+		}
+		else if (line[0] == 'f' && line[1] == ' ')
+		{
+			corners.clear();
+			const char* cursor = line + 2;
+			while (cursor < lineEnd)
+			{
+				char* after;
+				long indices[3] = { 0, 0, 0 };
+				indices[0] = strtol(cursor, &after, 10);
+				if (after == cursor)
+				{
+					break;
+				}
+				cursor = after;
+				for (int i = 1; i < 3 && *cursor == '/'; ++i)
+				{
+					++cursor;
+					indices[i] = strtol(cursor, &after, 10);
+					cursor = after;
+				}
+				//1 based, negative ones count back from the last element read so far
+				const size_t counts[3] = { positions.size() / 3, texCoords.size() / 2, normals.size() / 3 };
+				int32_t resolved[3];
+				for (int i = 0; i < 3; ++i)
+				{
+					long index = indices[i] < 0 ? long(counts[i]) + indices[i] : indices[i] - 1;
+					if (indices[i] != 0 && (index < 0 || size_t(index) >= counts[i]))
+					{
+						return E_FAIL;
+					}
+					resolved[i] = indices[i] ? int32_t(index) : -1;
+				}
+				if (resolved[0] < 0)
+				{
+					return E_FAIL;
+				}
+				Corner corner = { resolved[0], resolved[1], resolved[2] };
+				corners.push_back(corner);
+			}
+
+			uint32_t first = 0, previous = 0;
+			for (size_t c = 0; c < corners.size(); ++c)
+			{
+				auto inserted = vertices.insert(std::make_pair(corners[c], static_cast<uint32_t>(vertices.size())));
+				uint32_t vertex = inserted.first->second;
+				if (inserted.second)
+				{
+					const Corner& corner = corners[c];
+					const float* p = &positions[size_t(corner.Position) * 3];
+					mesh.Positions.insert(mesh.Positions.end(), { p[0], p[1], -p[2] });
+					if (corner.TexCoord >= 0)
+					{
+						const float* t = &texCoords[size_t(corner.TexCoord) * 2];
+						mesh.TexCoords.insert(mesh.TexCoords.end(), { t[0], 1.0f - t[1] });
+					}
+					else
+					{
+						mesh.TexCoords.insert(mesh.TexCoords.end(), { 0.0f, 0.0f });
+					}
+					if (corner.Normal >= 0)
+					{
+						const float* n = &normals[size_t(corner.Normal) * 3];
+						float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+						float scale = length > 0.0f ? 1.0f / length : 0.0f;
+						mesh.Normals.insert(mesh.Normals.end(), { n[0] * scale, n[1] * scale, -n[2] * scale });
+					}
+					else
+					{
+						mesh.Normals.insert(mesh.Normals.end(), { 0.0f, 0.0f, 0.0f });
+					}
+				}
+				if (c == 0)
+				{
+					first = vertex;
+				}
+				else if (c >= 2)
+				{
+					mesh.Indices.insert(mesh.Indices.end(), { first, vertex, previous });
+				}
+				previous = vertex;
+			}
+		}
+		line = next;
+	}
+
+	if (texCoords.empty())
+	{
+		mesh.TexCoords.clear();
+	}
+	if (normals.empty())
+	{
+		mesh.Normals.clear();
+	}
+	return mesh.Indices.empty() ? E_FAIL : S_OK;
+}
+
+inline HRESULT LoadObj(const char* fileName, ObjMesh& mesh)
+{
+	MappedFile file;
+	HRESULT hr = file.Open(fileName);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+	return ParseObj(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), mesh);
+}
+
+//vertex formats a converter can write
+enum class MeshFileVertexFormat
+{
+	Packed, //VertexTypes::P3S16_N2S16_T2H16, 16 bytes
+	Float, //P3F_N3F_T2F, 32 bytes
+};
+
+namespace VertexTypes
+{
+	//the full float vertex a packed one is measured against, and what --float converts to
+	struct P3F_N3F_T2F
+	{
+		float pos[3];
+		float normal[3];
+		float tex[2];
+
+		typedef VertexLayout<
+			VertexAttribute<VertexSemantic::Position, DXGI_FORMAT_R32G32B32_FLOAT>,
+			VertexAttribute<VertexSemantic::Normal, DXGI_FORMAT_R32G32B32_FLOAT>,
+			VertexAttribute<VertexSemantic::TexCoord, DXGI_FORMAT_R32G32_FLOAT>
+		> Layout;
+		static const D3D12_INPUT_LAYOUT_DESC& GetInputLayoutDesc() { return Layout::GetInputLayoutDesc(); }
+	};
+	static_assert(sizeof(P3F_N3F_T2F) == P3F_N3F_T2F::Layout::Stride, "P3F_N3F_T2F must match its layout");
+}
+
+struct MeshConvertOptions
+{
+	MeshFileVertexFormat Format;
+	bool Optimize; //vertex cache, overdraw and fetch order, see meshoptimizer.h
+};
+
+//encodes mesh into the vertex format, merges the vertices that became identical, optimizes the order and builds
+//the mesh file. 16 bit indices when the vertices allow.
+inline HRESULT ConvertToMeshFile(const ObjMesh& mesh, const MeshConvertOptions& options, std::vector<uint8_t>& image, MeshOptimizer::MeshOptimizeReport* report = nullptr)
+{
+	const size_t vertexCount = mesh.GetVertexCount();
+	if (!vertexCount || mesh.Indices.empty() || vertexCount > UINT32_MAX)
+	{
+		return E_INVALIDARG;
+	}
+	VertexStreams streams = mesh.GetStreams();
+	//the encoders read every attribute of the format, the ones the file doesn't have are written as zero
+	std::vector<float> zeros;
+	if (!streams.Normals || !streams.TexCoords)
+	{
+		zeros.assign(vertexCount * 3, 0.0f);
+		streams.Normals = streams.Normals ? streams.Normals : zeros.data();
+		streams.TexCoords = streams.TexCoords ? streams.TexCoords : zeros.data();
+	}
+
+	PositionQuantization quantization = PositionQuantization::Identity();
+	size_t stride;
+	D3D12_INPUT_LAYOUT_DESC layout;
+	std::vector<uint8_t> vertices;
+	if (options.Format == MeshFileVertexFormat::Packed)
+	{
+		typedef VertexTypes::P3S16_N2S16_T2H16 Vertex;
+		quantization = PositionQuantization::FromPositions(streams.Positions, vertexCount);
+		stride = sizeof(Vertex);
+		layout = Vertex::GetInputLayoutDesc();
+		vertices.resize(vertexCount * stride);
+		Vertex::Layout::Encode(streams, quantization, vertices.data());
+	}
+	else
+	{
+		typedef VertexTypes::P3F_N3F_T2F Vertex;
+		stride = sizeof(Vertex);
+		layout = Vertex::GetInputLayoutDesc();
+		vertices.resize(vertexCount * stride);
+		Vertex::Layout::Encode(streams, quantization, vertices.data());
+	}
+
+	//quantization can make neighbouring vertices identical
+	std::vector<uint32_t> indices = mesh.Indices;
+	std::vector<uint32_t> remap(vertexCount);
+	size_t uniqueCount = MeshOptimizer::GenerateVertexRemap(remap.data(), indices.data(), indices.size(), vertices.data(), vertexCount, stride);
+	std::vector<uint8_t> unique(uniqueCount * stride);
+	std::vector<float> positions(uniqueCount * 3);
+	MeshOptimizer::RemapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+	MeshOptimizer::RemapVertexBuffer(unique.data(), vertices.data(), vertexCount, stride, remap.data());
+	MeshOptimizer::RemapVertexBuffer(positions.data(), streams.Positions, vertexCount, 3 * sizeof(float), remap.data());
+
+	if (report)
+	{
+		report->VerticesBefore = vertexCount;
+		report->CacheBefore = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), uniqueCount);
+		report->FetchBefore = MeshOptimizer::AnalyzeVertexFetch(indices.data(), indices.size(), uniqueCount, stride);
+	}
+	if (options.Optimize)
+	{
+		MeshOptimizer::OptimizeVertexCache(indices.data(), indices.data(), indices.size(), uniqueCount);
+		MeshOptimizer::OptimizeOverdraw(indices.data(), indices.data(), indices.size(), positions.data(), 3 * sizeof(float), uniqueCount);
+		vertices.resize(uniqueCount * stride);
+		uniqueCount = MeshOptimizer::OptimizeVertexFetch(vertices.data(), indices.data(), indices.size(), unique.data(), uniqueCount, stride);
+		vertices.resize(uniqueCount * stride);
+	}
+	else
+	{
+		vertices.swap(unique);
+	}
+	if (report)
+	{
+		report->VerticesAfter = uniqueCount;
+		report->CacheAfter = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), uniqueCount);
+		report->FetchAfter = MeshOptimizer::AnalyzeVertexFetch(indices.data(), indices.size(), uniqueCount, stride);
+	}
+
+	MeshFileContents contents;
+	contents.Vertices = vertices.data();
+	contents.VertexCount = static_cast<uint32_t>(uniqueCount);
+	contents.VertexStride = static_cast<uint32_t>(stride);
+	contents.IndexCount = static_cast<uint32_t>(indices.size());
+	contents.InputLayout = layout;
+	contents.Quantization = options.Format == MeshFileVertexFormat::Packed ? &quantization : nullptr;
+	std::vector<uint16_t> shortIndices;
+	if (uniqueCount <= 0x10000)
+	{
+		shortIndices.assign(indices.begin(), indices.end());
+		contents.Indices = shortIndices.data();
+		contents.IndexFormat = DXGI_FORMAT_R16_UINT;
+	}
+	else
+	{
+		contents.Indices = indices.data();
+		contents.IndexFormat = DXGI_FORMAT_R32_UINT;
+	}
+	for (int a = 0; a < 3; ++a)
+	{
+		contents.BoundsMin[a] = contents.BoundsMax[a] = streams.Positions[a];
+	}
+	for (size_t v = 1; v < vertexCount; ++v)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			contents.BoundsMin[a] = std::min(contents.BoundsMin[a], streams.Positions[v * 3 + a]);
+			contents.BoundsMax[a] = std::max(contents.BoundsMax[a], streams.Positions[v * 3 + a]);
+		}
+	}
+	return BuildMeshFile(contents, image);
+}
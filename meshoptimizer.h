@@ -0,0 +1,515 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "hashing.h"
+
+//import time mesh optimization of indexed triangle lists with 32 bit indices, CPU only so the asset pipeline can
+//run it on Linux as well. In order: GenerateVertexRemap with RemapIndexBuffer and RemapVertexBuffer merge
+//duplicate vertices, OptimizeVertexCache reorders the triangles for the post transform cache, OptimizeOverdraw
+//optionally moves groups of them so occluders draw first, and OptimizeVertexFetch renumbers the vertices in the
+//order the triangles now use them. OptimizeMesh runs all of it. Meant for float meshes before they are packed
+//into the formats of vertexformats.h, duplicates are found by comparing bytes.
+namespace MeshOptimizer
+{
+	const uint32_t Unused = ~0u; //remap entry of a vertex no index refers to
+
+	//FIFO entries of the post transform cache the statistics simulate, in the range of current hardware
+	const uint32_t DefaultCacheSize = 16;
+
+	struct VertexCacheStatistics
+	{
+		uint32_t Misses; //vertices transformed
+		float Acmr; //average cache miss ratio, vertices transformed per triangle: 3 at worst, about 0.6 for a good order
+		float Atvr; //average transformed vertex ratio, vertices transformed per vertex used: 1 at best
+	};
+
+	struct VertexFetchStatistics
+	{
+		uint64_t BytesFetched; //64 byte lines read for the vertices the shader transforms
+		float Overfetch; //bytes fetched per byte of the vertices used: 1 at best
+	};
+
+	//remap[v] is what vertex v becomes once vertices with identical bytes are merged, numbered in order of first
+	//use by indices and Unused for the vertices nothing refers to. With indices null the mesh is unindexed and its
+	//vertices are used in order. Returns the number of vertices left.
+	inline size_t GenerateVertexRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+		std::fill(remap, remap + vertexCount, Unused);
+
+		//first vertex seen with some contents, open addressing with linear probing and at most half full
+		size_t tableSize = 1;
+		while (tableSize < vertexCount * 2)
+		{
+			tableSize *= 2;
+		}
+		std::vector<uint32_t> table(tableSize, Unused);
+
+		uint32_t next = 0;
+		const size_t count = indices ? indexCount : vertexCount;
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t vertex = indices ? indices[i] : static_cast<uint32_t>(i);
+			assert(vertex < vertexCount);
+			if (remap[vertex] != Unused)
+			{
+				continue;
+			}
+			const uint8_t* data = bytes + size_t(vertex) * vertexSize;
+			size_t slot = FoldHash(Hasher().AddBytes(data, vertexSize).Get()) & (tableSize - 1);
+			for (;;)
+			{
+				uint32_t existing = table[slot];
+				if (existing == Unused)
+				{
+					table[slot] = vertex;
+					remap[vertex] = next++;
+					break;
+				}
+				if (!memcmp(bytes + size_t(existing) * vertexSize, data, vertexSize))
+				{
+					remap[vertex] = remap[existing];
+					break;
+				}
+				slot = (slot + 1) & (tableSize - 1);
+			}
+		}
+		return next;
+	}
+
+	//destination may be indices. With indices null the mesh is unindexed, as for GenerateVertexRemap.
+	inline void RemapIndexBuffer(uint32_t* destination, const uint32_t* indices, size_t indexCount, const uint32_t* remap)
+	{
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			uint32_t vertex = remap[indices ? indices[i] : i];
+			assert(vertex != Unused);
+			destination[i] = vertex;
+		}
+	}
+
+	//destination holds the vertex count GenerateVertexRemap returned and must not overlap vertices
+	inline void RemapVertexBuffer(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* remap)
+	{
+		uint8_t* target = static_cast<uint8_t*>(destination);
+		const uint8_t* source = static_cast<const uint8_t*>(vertices);
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			if (remap[v] != Unused)
+			{
+				memcpy(target + size_t(remap[v]) * vertexSize, source + v * vertexSize, vertexSize);
+			}
+		}
+	}
+
+	inline VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = DefaultCacheSize)
+	{
+		//a vertex is still cached while fewer than cacheSize misses happened since it went in
+		std::vector<uint32_t> entered(vertexCount, 0);
+		std::vector<uint8_t> used(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+		size_t usedCount = 0;
+		VertexCacheStatistics statistics = {};
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			uint32_t vertex = indices[i];
+			assert(vertex < vertexCount);
+			if (time - entered[vertex] > cacheSize)
+			{
+				entered[vertex] = time++;
+				++statistics.Misses;
+			}
+			usedCount += !used[vertex];
+			used[vertex] = 1;
+		}
+		statistics.Acmr = indexCount ? float(statistics.Misses) / float(indexCount / 3) : 0.0f;
+		statistics.Atvr = usedCount ? float(statistics.Misses) / float(usedCount) : 0.0f;
+		return statistics;
+	}
+
+	//the vertices missing the post transform cache are read through a direct mapped 16KB cache of 64 byte lines
+	inline VertexFetchStatistics AnalyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexSize, uint32_t cacheSize = DefaultCacheSize)
+	{
+		const size_t LineSize = 64;
+		const size_t LineCount = 256;
+		std::vector<uint64_t> lines(LineCount, ~0ull);
+		std::vector<uint32_t> entered(vertexCount, 0);
+		std::vector<uint8_t> used(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+		size_t usedCount = 0;
+		VertexFetchStatistics statistics = {};
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			uint32_t vertex = indices[i];
+			assert(vertex < vertexCount);
+			usedCount += !used[vertex];
+			used[vertex] = 1;
+			if (time - entered[vertex] <= cacheSize)
+			{
+				continue;
+			}
+			entered[vertex] = time++;
+			uint64_t first = uint64_t(vertex) * vertexSize / LineSize;
+			uint64_t last = (uint64_t(vertex) * vertexSize + vertexSize - 1) / LineSize;
+			for (uint64_t line = first; line <= last; ++line)
+			{
+				if (lines[line % LineCount] != line)
+				{
+					lines[line % LineCount] = line;
+					statistics.BytesFetched += LineSize;
+				}
+			}
+		}
+		statistics.Overfetch = usedCount ? float(double(statistics.BytesFetched) / double(usedCount * vertexSize)) : 0.0f;
+		return statistics;
+	}
+
+	//Forsyth's linear speed vertex cache optimization. Triangles are emitted greedily by the score of their
+	//vertices, high for the ones used last and for the ones with few triangles left, so the mesh is drawn as a
+	//growing front of neighbouring triangles that suits any cache size. destination may be indices.
+	inline void OptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		const size_t triangleCount = indexCount / 3;
+		if (!triangleCount)
+		{
+			return;
+		}
+		std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+
+		//scores of the position in an LRU cache of CacheSize, and of the number of triangles a vertex has left
+		const uint32_t CacheSize = 32;
+		const uint32_t MaxValence = 64;
+		float cacheScores[CacheSize];
+		float valenceScores[MaxValence];
+		for (uint32_t p = 0; p < CacheSize; ++p)
+		{
+			//the last triangle's vertices get a fixed score so the front doesn't turn back on itself
+			cacheScores[p] = p < 3 ? 0.75f : powf(1.0f - float(p - 3) / float(CacheSize - 3), 1.5f);
+		}
+		valenceScores[0] = 0.0f;
+		for (uint32_t v = 1; v < MaxValence; ++v)
+		{
+			valenceScores[v] = 2.0f / sqrtf(float(v));
+		}
+
+		//triangles of every vertex; the first remaining[v] of a vertex's list are not emitted yet
+		std::vector<uint32_t> remaining(vertexCount, 0);
+		for (uint32_t index : source)
+		{
+			assert(index < vertexCount);
+			++remaining[index];
+		}
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			offsets[v + 1] = offsets[v] + remaining[v];
+		}
+		std::vector<uint32_t> adjacency(source.size());
+		std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < source.size(); ++i)
+		{
+			adjacency[filled[source[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<int32_t> cachePositions(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		auto scoreVertex = [&](uint32_t vertex)
+		{
+			uint32_t valence = remaining[vertex];
+			if (!valence)
+			{
+				return -1.0f;
+			}
+			int32_t position = cachePositions[vertex];
+			float score = position < 0 ? 0.0f : cacheScores[position];
+			return score + (valence < MaxValence ? valenceScores[valence] : 2.0f / sqrtf(float(valence)));
+		};
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			vertexScores[v] = scoreVertex(static_cast<uint32_t>(v));
+		}
+
+		std::vector<float> triangleScores(triangleCount);
+		uint32_t best = 0;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32_t* triangle = &source[t * 3];
+			triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+			if (triangleScores[t] > triangleScores[best])
+			{
+				best = static_cast<uint32_t>(t);
+			}
+		}
+
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		uint32_t cache[CacheSize + 3];
+		uint32_t nextCache[CacheSize + 3];
+		uint32_t cacheCount = 0;
+		size_t cursor = 0;
+		for (size_t written = 0; written < triangleCount; ++written)
+		{
+			//nothing in the cache has triangles left, restart at the next triangle in the input order
+			if (best == Unused)
+			{
+				while (emitted[cursor])
+				{
+					++cursor;
+				}
+				best = static_cast<uint32_t>(cursor);
+			}
+			const uint32_t triangle[3] = { source[best * 3], source[best * 3 + 1], source[best * 3 + 2] };
+			memcpy(&destination[written * 3], triangle, sizeof(triangle));
+			emitted[best] = 1;
+
+			//the vertices of the triangle go to the front of the cache, the rest move down and the last fall out
+			uint32_t nextCount = 0;
+			for (uint32_t vertex : triangle)
+			{
+				uint32_t* list = &adjacency[offsets[vertex]];
+				uint32_t* end = list + remaining[vertex];
+				std::swap(*std::find(list, end, best), end[-1]);
+				--remaining[vertex];
+				if (std::find(nextCache, nextCache + nextCount, vertex) == nextCache + nextCount)
+				{
+					nextCache[nextCount++] = vertex;
+				}
+			}
+			for (uint32_t c = 0; c < cacheCount; ++c)
+			{
+				if (std::find(triangle, triangle + 3, cache[c]) == triangle + 3)
+				{
+					nextCache[nextCount++] = cache[c];
+				}
+			}
+			for (uint32_t c = 0; c < nextCount; ++c)
+			{
+				cachePositions[nextCache[c]] = c < CacheSize ? int32_t(c) : -1;
+				vertexScores[nextCache[c]] = scoreVertex(nextCache[c]);
+			}
+
+			//only the triangles of vertices whose score changed need scoring again; the next one is the best of them
+			best = Unused;
+			float bestScore = -1.0f;
+			for (uint32_t c = 0; c < nextCount; ++c)
+			{
+				uint32_t vertex = nextCache[c];
+				const uint32_t* list = &adjacency[offsets[vertex]];
+				for (uint32_t a = 0; a < remaining[vertex]; ++a)
+				{
+					uint32_t t = list[a];
+					const uint32_t* other = &source[t * 3];
+					float score = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+					triangleScores[t] = score;
+					if (c < CacheSize && score > bestScore)
+					{
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+			cacheCount = std::min(nextCount, CacheSize);
+			memcpy(cache, nextCache, cacheCount * sizeof(uint32_t));
+		}
+	}
+
+	//moves groups of triangles of an index buffer already optimized by OptimizeVertexCache so the ones facing away
+	//from the center of the mesh, likely to hide the rest, draw first (Sander, Nehab, Barczak: "Fast Triangle
+	//Reordering for Vertex Locality and Reduced Overdraw"). The buffer is cut where the cache simulation restarts
+	//anyway, and within those runs where the ACMR of the part so far is within threshold of the run's, so the
+	//vertex transforms grow by about threshold at most: 1.05 trades 5% of them for more freedom of order.
+	//positions are 3 floats every positionStride bytes. destination may be indices.
+	inline void OptimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const void* positions, size_t positionStride, size_t vertexCount, float threshold = 1.05f)
+	{
+		const size_t triangleCount = indexCount / 3;
+		if (!triangleCount)
+		{
+			return;
+		}
+		std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+		auto position = [&](uint32_t vertex) { return reinterpret_cast<const float*>(static_cast<const uint8_t*>(positions) + size_t(vertex) * positionStride); };
+
+		//vertices missed by every triangle in a fresh FIFO from its start
+		std::vector<uint32_t> entered(vertexCount, 0);
+		uint32_t time = DefaultCacheSize + 1;
+		auto miss = [&](uint32_t vertex)
+		{
+			assert(vertex < vertexCount);
+			if (time - entered[vertex] > DefaultCacheSize)
+			{
+				entered[vertex] = time++;
+				return 1u;
+			}
+			return 0u;
+		};
+		auto flush = [&]() { time += DefaultCacheSize + 1; };
+		std::vector<uint32_t> misses(triangleCount);
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			misses[t] = miss(source[t * 3]) + miss(source[t * 3 + 1]) + miss(source[t * 3 + 2]);
+		}
+
+		//runs start at triangles missing all three vertices, they begin from a cold cache whatever comes before
+		std::vector<size_t> clusters;
+		for (size_t start = 0; start < triangleCount;)
+		{
+			size_t end = start + 1;
+			uint32_t runMisses = misses[start];
+			while (end < triangleCount && misses[end] != 3)
+			{
+				runMisses += misses[end++];
+			}
+			float runAcmr = float(runMisses) / float(end - start);
+
+			flush();
+			clusters.push_back(start);
+			uint32_t partMisses = 0;
+			size_t partStart = start;
+			for (size_t t = start; t + 1 < end; ++t)
+			{
+				partMisses += miss(source[t * 3]) + miss(source[t * 3 + 1]) + miss(source[t * 3 + 2]);
+				if (float(partMisses) <= runAcmr * threshold * float(t + 1 - partStart))
+				{
+					flush();
+					clusters.push_back(t + 1);
+					partStart = t + 1;
+					partMisses = 0;
+				}
+			}
+			start = end;
+		}
+		clusters.push_back(triangleCount);
+
+		//area weighted center and normal of every cluster; the normal sums the cross products, which are twice the area
+		struct Cluster
+		{
+			size_t Start, End;
+			float Center[3];
+			float Normal[3];
+			float Area;
+			float Key;
+		};
+		std::vector<Cluster> sorted(clusters.size() - 1);
+		double meshCenter[3] = {};
+		double meshArea = 0.0;
+		for (size_t c = 0; c + 1 < clusters.size(); ++c)
+		{
+			Cluster& cluster = sorted[c];
+			cluster = Cluster();
+			cluster.Start = clusters[c];
+			cluster.End = clusters[c + 1];
+			for (size_t t = cluster.Start; t < cluster.End; ++t)
+			{
+				const float* p0 = position(source[t * 3]);
+				const float* p1 = position(source[t * 3 + 1]);
+				const float* p2 = position(source[t * 3 + 2]);
+				float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * 0.5f;
+				for (int a = 0; a < 3; ++a)
+				{
+					cluster.Center[a] += (p0[a] + p1[a] + p2[a]) * (area / 3.0f);
+					cluster.Normal[a] += n[a];
+				}
+				cluster.Area += area;
+			}
+			for (int a = 0; a < 3; ++a)
+			{
+				meshCenter[a] += cluster.Center[a];
+				cluster.Center[a] = cluster.Area > 0.0f ? cluster.Center[a] / cluster.Area : 0.0f;
+			}
+			meshArea += cluster.Area;
+		}
+		for (int a = 0; a < 3; ++a)
+		{
+			meshCenter[a] = meshArea > 0.0 ? meshCenter[a] / meshArea : 0.0;
+		}
+
+		//the further a cluster's center lies out along its own normal, the earlier it draws
+		for (Cluster& cluster : sorted)
+		{
+			float length = sqrtf(cluster.Normal[0] * cluster.Normal[0] + cluster.Normal[1] * cluster.Normal[1] + cluster.Normal[2] * cluster.Normal[2]);
+			cluster.Key = 0.0f;
+			for (int a = 0; a < 3; ++a)
+			{
+				cluster.Key += (cluster.Center[a] - float(meshCenter[a])) * (length > 0.0f ? cluster.Normal[a] / length : 0.0f);
+			}
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.Key > b.Key; });
+
+		size_t written = 0;
+		for (const Cluster& cluster : sorted)
+		{
+			size_t count = (cluster.End - cluster.Start) * 3;
+			memcpy(&destination[written], &source[cluster.Start * 3], count * sizeof(uint32_t));
+			written += count;
+		}
+	}
+
+	//renumbers the vertices in the order the index buffer first uses them so the fetches stream through memory,
+	//and drops the ones nothing refers to. indices are rewritten in place, destination must not overlap vertices.
+	//Returns the number of vertices left.
+	inline size_t OptimizeVertexFetch(void* destination, uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize)
+	{
+		uint8_t* target = static_cast<uint8_t*>(destination);
+		const uint8_t* source = static_cast<const uint8_t*>(vertices);
+		std::vector<uint32_t> remap(vertexCount, Unused);
+		uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			uint32_t vertex = indices[i];
+			assert(vertex < vertexCount);
+			if (remap[vertex] == Unused)
+			{
+				memcpy(target + size_t(next) * vertexSize, source + size_t(vertex) * vertexSize, vertexSize);
+				remap[vertex] = next++;
+			}
+			indices[i] = remap[vertex];
+		}
+		return next;
+	}
+
+	struct MeshOptimizeReport
+	{
+		size_t VerticesBefore, VerticesAfter;
+		VertexCacheStatistics CacheBefore, CacheAfter;
+		VertexFetchStatistics FetchBefore, FetchAfter;
+	};
+
+	//every step above on an indexed mesh, rewriting both buffers. The overdraw step reads the 3 float position at
+	//positionOffset of every vertex and is skipped when overdrawThreshold is 0.
+	inline MeshOptimizeReport OptimizeMesh(std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices, size_t vertexSize, size_t positionOffset = 0, float overdrawThreshold = 1.05f)
+	{
+		MeshOptimizeReport report;
+		size_t vertexCount = vertices.size() / vertexSize;
+		report.VerticesBefore = vertexCount;
+		report.CacheBefore = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+		report.FetchBefore = AnalyzeVertexFetch(indices.data(), indices.size(), vertexCount, vertexSize);
+
+		std::vector<uint32_t> remap(vertexCount);
+		size_t uniqueCount = GenerateVertexRemap(remap.data(), indices.data(), indices.size(), vertices.data(), vertexCount, vertexSize);
+		std::vector<uint8_t> unique(uniqueCount * vertexSize);
+		RemapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+		RemapVertexBuffer(unique.data(), vertices.data(), vertexCount, vertexSize, remap.data());
+
+		OptimizeVertexCache(indices.data(), indices.data(), indices.size(), uniqueCount);
+		if (overdrawThreshold > 0.0f)
+		{
+			OptimizeOverdraw(indices.data(), indices.data(), indices.size(), unique.data() + positionOffset, vertexSize, uniqueCount, overdrawThreshold);
+		}
+		vertices.resize(uniqueCount * vertexSize);
+		report.VerticesAfter = OptimizeVertexFetch(vertices.data(), indices.data(), indices.size(), unique.data(), uniqueCount, vertexSize);
+		vertices.resize(report.VerticesAfter * vertexSize);
+
+		report.CacheAfter = AnalyzeVertexCache(indices.data(), indices.size(), report.VerticesAfter);
+		report.FetchAfter = AnalyzeVertexFetch(indices.data(), indices.size(), report.VerticesAfter, vertexSize);
+		return report;
+	}
+}
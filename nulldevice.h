@@ -0,0 +1,794 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "d3d12types.h"
+
+//a device, queue and command list that do no GPU work: they validate what is recorded the way the debug layer
+//would, count every call and optionally keep the command stream, so the CPU side of building and submitting
+//frames can be measured and checked headless (Linux CI included, see d3d12types.h).
+//
+//Objects the renderer calls methods on (command lists, allocators, queues, fences) are Null* classes with the
+//ID3D12 method names and argument lists, so templated code such as DrawList::Submit and
+//ResourceStateTracker::Flush records into them unchanged. Objects that are only created and bound (resources,
+//descriptor heaps, root signatures, pipelines) are handed out as the usual ID3D12 interface pointers, which
+//point at the device's own bookkeeping and must only be passed back to it. Their methods live on NullDevice
+//(GetGPUVirtualAddress etc.). Everything is owned by the device and lives as long as it does.
+//
+//Resource states are checked in recording order, as if every command list ran on one queue in the order it
+//was recorded. Fences complete as soon as the queue signals them.
+
+struct NullCallCounts
+{
+	enum Call
+	{
+		Reset,
+		Close,
+		SetPipelineState,
+		SetGraphicsRootSignature,
+		SetDescriptorHeaps,
+		SetGraphicsRootConstantBufferView,
+		SetGraphicsRootDescriptorTable,
+		SetGraphicsRoot32BitConstants,
+		IASetPrimitiveTopology,
+		IASetVertexBuffers,
+		IASetIndexBuffer,
+		RSSetViewports,
+		RSSetScissorRects,
+		OMSetRenderTargets,
+		ClearRenderTargetView,
+		DrawInstanced,
+		DrawIndexedInstanced,
+		ResourceBarrier,
+		ExecuteCommandLists,
+		Signal,
+		CallCount
+	};
+
+	UINT64 Calls[CallCount];
+	UINT64 Barriers; //barriers passed to ResourceBarrier, a call can carry many
+
+	NullCallCounts() { Clear(); }
+	void Clear() { memset(this, 0, sizeof(*this)); }
+
+	void Add(const NullCallCounts& other)
+	{
+		for (UINT i = 0; i < CallCount; ++i)
+		{
+			Calls[i] += other.Calls[i];
+		}
+		Barriers += other.Barriers;
+	}
+
+	UINT64 GetDraws() const { return Calls[DrawInstanced] + Calls[DrawIndexedInstanced]; }
+
+	//everything but draws, Reset and Close
+	UINT64 GetStateChanges() const
+	{
+		UINT64 total = 0;
+		for (UINT i = SetPipelineState; i <= ClearRenderTargetView; ++i)
+		{
+			total += Calls[i];
+		}
+		return total;
+	}
+
+	static const char* GetName(Call call)
+	{
+		static const char* names[CallCount] = { "Reset", "Close", "SetPipelineState", "SetGraphicsRootSignature", "SetDescriptorHeaps",
+			"SetGraphicsRootConstantBufferView", "SetGraphicsRootDescriptorTable", "SetGraphicsRoot32BitConstants", "IASetPrimitiveTopology",
+			"IASetVertexBuffers", "IASetIndexBuffer", "RSSetViewports", "RSSetScissorRects", "OMSetRenderTargets", "ClearRenderTargetView",
+			"DrawInstanced", "DrawIndexedInstanced", "ResourceBarrier", "ExecuteCommandLists", "Signal" };
+		return names[call];
+	}
+};
+
+//a recorded call with its main arguments, pointers and handles as integers
+struct NullCommand
+{
+	NullCallCounts::Call Call;
+	UINT64 Args[3];
+};
+
+class NullDevice;
+class NullCommandList;
+class NullCommandQueue;
+
+class NullCommandAllocator
+{
+public:
+	NullCommandAllocator(NullDevice* device) : m_Device(device), m_OpenLists(0) {}
+
+	HRESULT Reset();
+
+private:
+	friend class NullCommandList;
+
+	NullDevice* m_Device;
+	UINT m_OpenLists; //lists recording into the allocator, it can't be reset while there are any
+};
+
+class NullFence
+{
+public:
+	NullFence(UINT64 initialValue) : m_Value(initialValue) {}
+
+	UINT64 GetCompletedValue() const { return m_Value; }
+	HRESULT Signal(UINT64 value) { m_Value = value; return S_OK; }
+
+private:
+	UINT64 m_Value;
+};
+
+class NullDevice
+{
+public:
+	static const UINT DescriptorSize = 32; //GetDescriptorHandleIncrementSize for every heap type
+	static const UINT MaxRootParameters = 64;
+	static const UINT MaxMessages = 64; //validation messages kept, the rest are only counted
+
+	NullDevice() : m_NextAddress(0x10000), m_NextCpuDescriptor(0x1000), m_NextGpuDescriptor(0x1000), m_Errors(0) {}
+
+	HRESULT CreateCommittedResource(const D3D12_HEAP_PROPERTIES* heapProperties, D3D12_HEAP_FLAGS heapFlags, const D3D12_RESOURCE_DESC* desc,
+		D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, ID3D12Resource** resource)
+	{
+		(void)heapFlags;
+		(void)clearValue;
+		if (!heapProperties || !desc || !resource)
+		{
+			return E_INVALIDARG;
+		}
+		std::unique_ptr<Resource> created(new Resource());
+		created->Desc = *desc;
+		created->HeapType = heapProperties->Type;
+		created->Address = m_NextAddress;
+		created->SplitPending = false;
+		UINT subresources = (desc->Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) ? 1 :
+			UINT(desc->MipLevels ? desc->MipLevels : 1) * ((desc->Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? 1u : UINT(desc->DepthOrArraySize));
+		created->States.assign(subresources ? subresources : 1, initialState);
+		//64KB apart like placed resources, so an address identifies its resource
+		m_NextAddress += (desc->Width * (desc->Height ? desc->Height : 1) + 0xffff) & ~UINT64(0xffff);
+		*resource = reinterpret_cast<ID3D12Resource*>(created.get());
+		m_Resources.push_back(std::move(created));
+		return S_OK;
+	}
+
+	HRESULT CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC* desc, ID3D12DescriptorHeap** heap)
+	{
+		if (!desc || !heap || desc->NumDescriptors == 0)
+		{
+			return E_INVALIDARG;
+		}
+		std::unique_ptr<DescriptorHeap> created(new DescriptorHeap());
+		created->Desc = *desc;
+		created->CpuStart = m_NextCpuDescriptor;
+		m_NextCpuDescriptor += SIZE_T(desc->NumDescriptors) * DescriptorSize;
+		created->GpuStart = 0;
+		if (desc->Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
+		{
+			created->GpuStart = m_NextGpuDescriptor;
+			m_NextGpuDescriptor += UINT64(desc->NumDescriptors) * DescriptorSize;
+		}
+		*heap = reinterpret_cast<ID3D12DescriptorHeap*>(created.get());
+		m_DescriptorHeaps.push_back(std::move(created));
+		return S_OK;
+	}
+
+	UINT GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE) const { return DescriptorSize; }
+
+	//stands in for the root signature blob, only the parameter count is validated
+	HRESULT CreateRootSignature(UINT parameterCount, ID3D12RootSignature** rootSignature)
+	{
+		if (!rootSignature || parameterCount > MaxRootParameters)
+		{
+			return E_INVALIDARG;
+		}
+		std::unique_ptr<RootSignature> created(new RootSignature());
+		created->ParameterCount = parameterCount;
+		*rootSignature = reinterpret_cast<ID3D12RootSignature*>(created.get());
+		m_RootSignatures.push_back(std::move(created));
+		return S_OK;
+	}
+
+	//stands in for D3D12_GRAPHICS_PIPELINE_STATE_DESC. vertexInput is false for pipelines without an input layout.
+	HRESULT CreateGraphicsPipelineState(ID3D12RootSignature* rootSignature, bool vertexInput, ID3D12PipelineState** pipeline)
+	{
+		if (!rootSignature || !pipeline)
+		{
+			return E_INVALIDARG;
+		}
+		std::unique_ptr<PipelineState> created(new PipelineState());
+		created->Signature = rootSignature;
+		created->VertexInput = vertexInput;
+		*pipeline = reinterpret_cast<ID3D12PipelineState*>(created.get());
+		m_Pipelines.push_back(std::move(created));
+		return S_OK;
+	}
+
+	HRESULT CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE type, NullCommandAllocator** allocator)
+	{
+		(void)type;
+		m_Allocators.emplace_back(new NullCommandAllocator(this));
+		*allocator = m_Allocators.back().get();
+		return S_OK;
+	}
+
+	HRESULT CreateCommandList(UINT nodeMask, D3D12_COMMAND_LIST_TYPE type, NullCommandAllocator* allocator, ID3D12PipelineState* initialState, NullCommandList** commandList);
+	HRESULT CreateCommandQueue(NullCommandQueue** queue);
+
+	HRESULT CreateFence(UINT64 initialValue, NullFence** fence)
+	{
+		m_Fences.emplace_back(new NullFence(initialValue));
+		*fence = m_Fences.back().get();
+		return S_OK;
+	}
+
+	//ID3D12Resource::GetGPUVirtualAddress and ID3D12DescriptorHeap::Get*DescriptorHandleForHeapStart
+	D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress(ID3D12Resource* resource) const
+	{
+		return reinterpret_cast<const Resource*>(resource)->Address;
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandleForHeapStart(ID3D12DescriptorHeap* heap) const
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE handle = { reinterpret_cast<const DescriptorHeap*>(heap)->CpuStart };
+		return handle;
+	}
+
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptorHandleForHeapStart(ID3D12DescriptorHeap* heap) const
+	{
+		D3D12_GPU_DESCRIPTOR_HANDLE handle = { reinterpret_cast<const DescriptorHeap*>(heap)->GpuStart };
+		return handle;
+	}
+
+	//state of a subresource as of the last recorded barrier
+	D3D12_RESOURCE_STATES GetResourceState(ID3D12Resource* resource, UINT subresource = 0) const
+	{
+		return reinterpret_cast<const Resource*>(resource)->States[subresource];
+	}
+
+	UINT GetErrorCount() const { return m_Errors; }
+	const std::vector<std::string>& GetMessages() const { return m_Messages; }
+	void ClearErrors() { m_Errors = 0; m_Messages.clear(); }
+
+	//calls of every command list executed so far
+	const NullCallCounts& GetExecutedCounts() const { return m_Executed; }
+
+private:
+	friend class NullCommandList;
+	friend class NullCommandQueue;
+	friend class NullCommandAllocator;
+
+	struct Resource
+	{
+		D3D12_RESOURCE_DESC Desc;
+		D3D12_HEAP_TYPE HeapType;
+		D3D12_GPU_VIRTUAL_ADDRESS Address;
+		std::vector<D3D12_RESOURCE_STATES> States; //per subresource
+		bool SplitPending; //between the BEGIN_ONLY and END_ONLY halves of a split barrier
+	};
+
+	struct DescriptorHeap
+	{
+		D3D12_DESCRIPTOR_HEAP_DESC Desc;
+		SIZE_T CpuStart;
+		UINT64 GpuStart; //0 when not shader visible
+	};
+
+	struct RootSignature
+	{
+		UINT ParameterCount;
+	};
+
+	struct PipelineState
+	{
+		ID3D12RootSignature* Signature;
+		bool VertexInput;
+	};
+
+	void Error(const char* format, ...)
+#if defined(__GNUC__)
+		__attribute__((format(printf, 2, 3)))
+#endif
+	;
+
+	void ValidateBarrier(const D3D12_RESOURCE_BARRIER& barrier)
+	{
+		if (barrier.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+		{
+			return;
+		}
+		const D3D12_RESOURCE_TRANSITION_BARRIER& transition = barrier.Transition;
+		if (!transition.pResource)
+		{
+			Error("ResourceBarrier: transition of a null resource");
+			return;
+		}
+		Resource* resource = reinterpret_cast<Resource*>(transition.pResource);
+		UINT first = transition.Subresource, last = transition.Subresource + 1;
+		if (transition.Subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+		{
+			first = 0;
+			last = static_cast<UINT>(resource->States.size());
+		}
+		else if (transition.Subresource >= resource->States.size())
+		{
+			Error("ResourceBarrier: subresource %u out of range", transition.Subresource);
+			return;
+		}
+		if (transition.StateBefore == transition.StateAfter)
+		{
+			Error("ResourceBarrier: transition from and to 0x%x", unsigned(transition.StateBefore));
+		}
+		for (UINT i = first; i < last; ++i)
+		{
+			if (resource->States[i] != transition.StateBefore)
+			{
+				Error("ResourceBarrier: subresource %u is in 0x%x, not StateBefore 0x%x", i, unsigned(resource->States[i]), unsigned(transition.StateBefore));
+				break;
+			}
+		}
+
+		if (barrier.Flags & D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY)
+		{
+			if (resource->SplitPending)
+			{
+				Error("ResourceBarrier: split barrier begun twice");
+			}
+			resource->SplitPending = true;
+			return;
+		}
+		if (barrier.Flags & D3D12_RESOURCE_BARRIER_FLAG_END_ONLY)
+		{
+			if (!resource->SplitPending)
+			{
+				Error("ResourceBarrier: END_ONLY without a BEGIN_ONLY");
+			}
+			resource->SplitPending = false;
+		}
+		else if (resource->SplitPending)
+		{
+			Error("ResourceBarrier: transition of a resource in the middle of a split barrier");
+		}
+		for (UINT i = first; i < last; ++i)
+		{
+			resource->States[i] = transition.StateAfter;
+		}
+	}
+
+	//the shader visible heap a GPU descriptor handle points into, nullptr if none
+	const DescriptorHeap* FindHeap(D3D12_GPU_DESCRIPTOR_HANDLE handle) const
+	{
+		for (const auto& heap : m_DescriptorHeaps)
+		{
+			if (heap->GpuStart && handle.ptr >= heap->GpuStart && handle.ptr < heap->GpuStart + UINT64(heap->Desc.NumDescriptors) * DescriptorSize)
+			{
+				return heap.get();
+			}
+		}
+		return nullptr;
+	}
+
+	UINT64 m_NextAddress;
+	SIZE_T m_NextCpuDescriptor;
+	UINT64 m_NextGpuDescriptor;
+	std::vector<std::unique_ptr<Resource>> m_Resources;
+	std::vector<std::unique_ptr<DescriptorHeap>> m_DescriptorHeaps;
+	std::vector<std::unique_ptr<RootSignature>> m_RootSignatures;
+	std::vector<std::unique_ptr<PipelineState>> m_Pipelines;
+	std::vector<std::unique_ptr<NullCommandAllocator>> m_Allocators;
+	std::vector<std::unique_ptr<NullCommandList>> m_CommandLists;
+	std::vector<std::unique_ptr<NullCommandQueue>> m_Queues;
+	std::vector<std::unique_ptr<NullFence>> m_Fences;
+
+	UINT m_Errors;
+	std::vector<std::string> m_Messages;
+	NullCallCounts m_Executed;
+};
+
+class NullCommandList
+{
+public:
+	NullCommandList(NullDevice* device, NullCommandAllocator* allocator)
+		: m_Device(device), m_Allocator(allocator), m_Open(false), m_Recording(false)
+	{
+		ClearState();
+	}
+
+	//keep every call in GetCommands(), off by default so benchmarks only pay for the counting
+	void SetRecording(bool recording) { m_Recording = recording; }
+
+	HRESULT Reset(NullCommandAllocator* allocator, ID3D12PipelineState* initialState)
+	{
+		if (m_Open)
+		{
+			m_Device->Error("Reset: command list is still open");
+			return E_FAIL;
+		}
+		m_Allocator = allocator;
+		++m_Allocator->m_OpenLists;
+		m_Open = true;
+		m_Counts.Clear();
+		m_Commands.clear();
+		m_Barriers.clear();
+		ClearState();
+		Count(NullCallCounts::Reset, 0);
+		if (initialState)
+		{
+			m_Pipeline = reinterpret_cast<const NullDevice::PipelineState*>(initialState);
+		}
+		return S_OK;
+	}
+
+	HRESULT Close()
+	{
+		if (!Open("Close"))
+		{
+			return E_FAIL;
+		}
+		Count(NullCallCounts::Close, 0);
+		--m_Allocator->m_OpenLists;
+		m_Open = false;
+		return S_OK;
+	}
+
+	void SetPipelineState(ID3D12PipelineState* pipeline)
+	{
+		Count(NullCallCounts::SetPipelineState, UINT64(uintptr_t(pipeline)));
+		Open("SetPipelineState");
+		m_Pipeline = reinterpret_cast<const NullDevice::PipelineState*>(pipeline);
+	}
+
+	//also unbinds every root argument, as on the GPU
+	void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+	{
+		Count(NullCallCounts::SetGraphicsRootSignature, UINT64(uintptr_t(rootSignature)));
+		Open("SetGraphicsRootSignature");
+		m_RootSignature = rootSignature;
+		m_RootArgumentsSet = 0;
+	}
+
+	void SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps)
+	{
+		Count(NullCallCounts::SetDescriptorHeaps, count, count ? UINT64(uintptr_t(heaps[0])) : 0);
+		Open("SetDescriptorHeaps");
+		m_BoundHeapCount = 0;
+		for (UINT i = 0; i < count && i < MaxBoundHeaps; ++i)
+		{
+			const NullDevice::DescriptorHeap* heap = reinterpret_cast<const NullDevice::DescriptorHeap*>(heaps[i]);
+			if (!(heap->Desc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE))
+			{
+				m_Device->Error("SetDescriptorHeaps: heap %u is not shader visible", i);
+			}
+			m_BoundHeaps[m_BoundHeapCount++] = heap;
+		}
+	}
+
+	void SetGraphicsRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+	{
+		Count(NullCallCounts::SetGraphicsRootConstantBufferView, parameter, address);
+		Open("SetGraphicsRootConstantBufferView");
+		if (!address)
+		{
+			m_Device->Error("SetGraphicsRootConstantBufferView: null address for parameter %u", parameter);
+		}
+		SetRootArgument(parameter, "SetGraphicsRootConstantBufferView");
+	}
+
+	void SetGraphicsRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+	{
+		Count(NullCallCounts::SetGraphicsRootDescriptorTable, parameter, baseDescriptor.ptr);
+		Open("SetGraphicsRootDescriptorTable");
+		const NullDevice::DescriptorHeap* heap = m_Device->FindHeap(baseDescriptor);
+		bool bound = false;
+		for (UINT i = 0; i < m_BoundHeapCount; ++i)
+		{
+			bound = bound || m_BoundHeaps[i] == heap;
+		}
+		if (!bound)
+		{
+			m_Device->Error("SetGraphicsRootDescriptorTable: parameter %u doesn't point into a bound heap", parameter);
+		}
+		SetRootArgument(parameter, "SetGraphicsRootDescriptorTable");
+	}
+
+	void SetGraphicsRoot32BitConstants(UINT parameter, UINT count, const void* data, UINT destOffset)
+	{
+		(void)data;
+		Count(NullCallCounts::SetGraphicsRoot32BitConstants, parameter, count, destOffset);
+		Open("SetGraphicsRoot32BitConstants");
+		SetRootArgument(parameter, "SetGraphicsRoot32BitConstants");
+	}
+
+	void IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY topology)
+	{
+		Count(NullCallCounts::IASetPrimitiveTopology, UINT64(topology));
+		Open("IASetPrimitiveTopology");
+		m_Topology = topology;
+	}
+
+	void IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views)
+	{
+		Count(NullCallCounts::IASetVertexBuffers, startSlot, count, (views && count) ? views[0].BufferLocation : 0);
+		Open("IASetVertexBuffers");
+		if (startSlot == 0 && count > 0)
+		{
+			m_VertexBufferSet = views && views[0].BufferLocation != 0 && views[0].StrideInBytes != 0;
+		}
+	}
+
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view)
+	{
+		Count(NullCallCounts::IASetIndexBuffer, view ? view->BufferLocation : 0, view ? UINT64(view->Format) : 0);
+		Open("IASetIndexBuffer");
+		m_IndexBufferSet = view && view->BufferLocation != 0;
+		if (m_IndexBufferSet && view->Format != DXGI_FORMAT_R16_UINT && view->Format != DXGI_FORMAT_R32_UINT)
+		{
+			m_Device->Error("IASetIndexBuffer: format %u is not R16_UINT or R32_UINT", unsigned(view->Format));
+		}
+	}
+
+	void RSSetViewports(UINT count, const D3D12_VIEWPORT* viewports)
+	{
+		(void)viewports;
+		Count(NullCallCounts::RSSetViewports, count);
+		Open("RSSetViewports");
+		m_ViewportSet = count > 0;
+	}
+
+	void RSSetScissorRects(UINT count, const D3D12_RECT* rects)
+	{
+		(void)rects;
+		Count(NullCallCounts::RSSetScissorRects, count);
+		Open("RSSetScissorRects");
+		m_ScissorSet = count > 0;
+	}
+
+	void OMSetRenderTargets(UINT count, const D3D12_CPU_DESCRIPTOR_HANDLE* renderTargets, BOOL singleHandle, const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencil)
+	{
+		(void)singleHandle;
+		Count(NullCallCounts::OMSetRenderTargets, count, (renderTargets && count) ? renderTargets[0].ptr : 0, depthStencil ? depthStencil->ptr : 0);
+		Open("OMSetRenderTargets");
+		m_RenderTargetSet = count > 0 || depthStencil;
+	}
+
+	void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const FLOAT color[4], UINT rectCount, const D3D12_RECT* rects)
+	{
+		(void)color;
+		(void)rects;
+		Count(NullCallCounts::ClearRenderTargetView, renderTarget.ptr, rectCount);
+		Open("ClearRenderTargetView");
+	}
+
+	void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT startVertex, UINT startInstance)
+	{
+		(void)startInstance;
+		Count(NullCallCounts::DrawInstanced, vertexCount, instanceCount, startVertex);
+		ValidateDraw("DrawInstanced", false);
+	}
+
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+	{
+		(void)baseVertex;
+		(void)startInstance;
+		Count(NullCallCounts::DrawIndexedInstanced, indexCount, instanceCount, startIndex);
+		ValidateDraw("DrawIndexedInstanced", true);
+	}
+
+	//recorded with the count and the index of its first barrier in GetBarriers()
+	void ResourceBarrier(UINT count, const D3D12_RESOURCE_BARRIER* barriers)
+	{
+		Count(NullCallCounts::ResourceBarrier, count, m_Barriers.size());
+		m_Counts.Barriers += count;
+		Open("ResourceBarrier");
+		for (UINT i = 0; i < count; ++i)
+		{
+			m_Device->ValidateBarrier(barriers[i]);
+		}
+		if (m_Recording)
+		{
+			m_Barriers.insert(m_Barriers.end(), barriers, barriers + count);
+		}
+	}
+
+	bool IsOpen() const { return m_Open; }
+
+	//calls since the last Reset
+	const NullCallCounts& GetCounts() const { return m_Counts; }
+	const std::vector<NullCommand>& GetCommands() const { return m_Commands; }
+	const std::vector<D3D12_RESOURCE_BARRIER>& GetBarriers() const { return m_Barriers; }
+
+private:
+	static const UINT MaxBoundHeaps = 2; //one CBV/SRV/UAV and one sampler heap
+
+	void ClearState()
+	{
+		m_Pipeline = nullptr;
+		m_RootSignature = nullptr;
+		m_RootArgumentsSet = 0;
+		m_BoundHeapCount = 0;
+		m_Topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+		m_VertexBufferSet = false;
+		m_IndexBufferSet = false;
+		m_ViewportSet = false;
+		m_ScissorSet = false;
+		m_RenderTargetSet = false;
+	}
+
+	void Count(NullCallCounts::Call call, UINT64 a, UINT64 b = 0, UINT64 c = 0)
+	{
+		++m_Counts.Calls[call];
+		if (m_Recording)
+		{
+			NullCommand command = { call, { a, b, c } };
+			m_Commands.push_back(command);
+		}
+	}
+
+	bool Open(const char* call)
+	{
+		if (!m_Open)
+		{
+			m_Device->Error("%s: command list is closed", call);
+		}
+		return m_Open;
+	}
+
+	void SetRootArgument(UINT parameter, const char* call)
+	{
+		if (!m_RootSignature)
+		{
+			m_Device->Error("%s: no root signature set", call);
+			return;
+		}
+		if (parameter >= reinterpret_cast<const NullDevice::RootSignature*>(m_RootSignature)->ParameterCount)
+		{
+			m_Device->Error("%s: parameter %u out of range", call, parameter);
+			return;
+		}
+		m_RootArgumentsSet |= UINT64(1) << parameter;
+	}
+
+	void ValidateDraw(const char* call, bool indexed)
+	{
+		if (!Open(call))
+		{
+			return;
+		}
+		if (!m_Pipeline || !m_RootSignature)
+		{
+			m_Device->Error("%s: no %s set", call, m_Pipeline ? "root signature" : "pipeline");
+			return;
+		}
+		if (m_Pipeline->Signature != m_RootSignature)
+		{
+			m_Device->Error("%s: pipeline was created with another root signature", call);
+		}
+		UINT parameters = reinterpret_cast<const NullDevice::RootSignature*>(m_RootSignature)->ParameterCount;
+		UINT64 required = (parameters >= 64) ? ~UINT64(0) : ((UINT64(1) << parameters) - 1);
+		if ((m_RootArgumentsSet & required) != required)
+		{
+			m_Device->Error("%s: root arguments 0x%llx of 0x%llx set", call, (unsigned long long)m_RootArgumentsSet, (unsigned long long)required);
+		}
+		if (m_Topology == D3D_PRIMITIVE_TOPOLOGY_UNDEFINED)
+		{
+			m_Device->Error("%s: no primitive topology set", call);
+		}
+		if (m_Pipeline->VertexInput && !m_VertexBufferSet)
+		{
+			m_Device->Error("%s: no vertex buffer set", call);
+		}
+		if (indexed && !m_IndexBufferSet)
+		{
+			m_Device->Error("%s: no index buffer set", call);
+		}
+		if (!m_ViewportSet || !m_ScissorSet || !m_RenderTargetSet)
+		{
+			m_Device->Error("%s: viewport, scissor or render target missing", call);
+		}
+	}
+
+	friend class NullCommandQueue;
+
+	NullDevice* m_Device;
+	NullCommandAllocator* m_Allocator;
+	bool m_Open;
+	bool m_Recording;
+	NullCallCounts m_Counts;
+	std::vector<NullCommand> m_Commands;
+	std::vector<D3D12_RESOURCE_BARRIER> m_Barriers; //contents of the recorded ResourceBarrier calls
+
+	const NullDevice::PipelineState* m_Pipeline;
+	ID3D12RootSignature* m_RootSignature;
+	UINT64 m_RootArgumentsSet; //bit per root parameter
+	const NullDevice::DescriptorHeap* m_BoundHeaps[MaxBoundHeaps];
+	UINT m_BoundHeapCount;
+	D3D_PRIMITIVE_TOPOLOGY m_Topology;
+	bool m_VertexBufferSet;
+	bool m_IndexBufferSet;
+	bool m_ViewportSet;
+	bool m_ScissorSet;
+	bool m_RenderTargetSet;
+};
+
+class NullCommandQueue
+{
+public:
+	NullCommandQueue(NullDevice* device) : m_Device(device) {}
+
+	void ExecuteCommandLists(UINT count, NullCommandList* const* commandLists)
+	{
+		++m_Device->m_Executed.Calls[NullCallCounts::ExecuteCommandLists];
+		for (UINT i = 0; i < count; ++i)
+		{
+			if (commandLists[i]->IsOpen())
+			{
+				m_Device->Error("ExecuteCommandLists: command list %u is still open", i);
+				continue;
+			}
+			m_Device->m_Executed.Add(commandLists[i]->GetCounts());
+		}
+	}
+
+	//there's no GPU work to wait for, the fence completes right away
+	HRESULT Signal(NullFence* fence, UINT64 value)
+	{
+		++m_Device->m_Executed.Calls[NullCallCounts::Signal];
+		return fence->Signal(value);
+	}
+
+private:
+	NullDevice* m_Device;
+};
+
+inline HRESULT NullCommandAllocator::Reset()
+{
+	if (m_OpenLists)
+	{
+		m_Device->Error("Reset: command allocator has %u open command lists", m_OpenLists);
+		return E_FAIL;
+	}
+	return S_OK;
+}
+
+inline HRESULT NullDevice::CreateCommandList(UINT nodeMask, D3D12_COMMAND_LIST_TYPE type, NullCommandAllocator* allocator, ID3D12PipelineState* initialState, NullCommandList** commandList)
+{
+	(void)nodeMask;
+	(void)type;
+	if (!allocator || !commandList)
+	{
+		return E_INVALIDARG;
+	}
+	m_CommandLists.emplace_back(new NullCommandList(this, allocator));
+	*commandList = m_CommandLists.back().get();
+	//command lists are created open, as in D3D12
+	return (*commandList)->Reset(allocator, initialState);
+}
+
+inline HRESULT NullDevice::CreateCommandQueue(NullCommandQueue** queue)
+{
+	m_Queues.emplace_back(new NullCommandQueue(this));
+	*queue = m_Queues.back().get();
+	return S_OK;
+}
+
+inline void NullDevice::Error(const char* format, ...)
+{
+	++m_Errors;
+	if (m_Messages.size() < MaxMessages)
+	{
+		char buffer[256];
+		va_list args;
+		va_start(args, format);
+		vsnprintf(buffer, sizeof(buffer), format, args);
+		va_end(args);
+		m_Messages.push_back(buffer);
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "d3d12types.h"
+#include "hashing.h"
+
+//hashes everything that affects the compiled pipeline. The description is canonicalized on the fly:
+//shaders and input layouts are hashed by content rather than by pointer, and state that is disabled
+//(blend factors of a target with blending off, stencil ops with stencil off, unused render targets...)
+//is skipped so descriptions that only differ in dead fields share one pipeline.
+//rootSignatureHash is the hash of the serialized root signature. When it is 0 the pRootSignature pointer is
+//hashed instead, which still deduplicates within a run but never matches a hash saved by an earlier one.
+inline uint64_t HashPipelineStateDescription(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+{
+	Hasher h;
+
+	if (rootSignatureHash)
+	{
+		h.Add(rootSignatureHash);
+	}
+	else
+	{
+		h.Add(reinterpret_cast<uintptr_t>(desc.pRootSignature));
+	}
+
+	const D3D12_SHADER_BYTECODE* shaders[] = { &desc.VS, &desc.PS, &desc.DS, &desc.HS, &desc.GS };
+	for (auto shader : shaders)
+	{
+		h.Add(static_cast<uint64_t>(shader->pShaderBytecode ? shader->BytecodeLength : 0));
+		if (shader->pShaderBytecode)
+		{
+			h.AddBytes(shader->pShaderBytecode, shader->BytecodeLength);
+		}
+	}
+
+	h.Add(desc.StreamOutput.NumEntries);
+	for (UINT i = 0; i < desc.StreamOutput.NumEntries; ++i)
+	{
+		const D3D12_SO_DECLARATION_ENTRY& entry = desc.StreamOutput.pSODeclaration[i];
+		h.Add(entry.Stream).AddString(entry.SemanticName).Add(entry.SemanticIndex);
+		h.Add(entry.StartComponent).Add(entry.ComponentCount).Add(entry.OutputSlot);
+	}
+	h.Add(desc.StreamOutput.NumStrides);
+	for (UINT i = 0; i < desc.StreamOutput.NumStrides; ++i)
+	{
+		h.Add(desc.StreamOutput.pBufferStrides[i]);
+	}
+	if (desc.StreamOutput.NumEntries)
+	{
+		h.Add(desc.StreamOutput.RasterizedStream);
+	}
+
+	//without independent blend only the first target's blend state is used
+	h.Add(desc.BlendState.AlphaToCoverageEnable).Add(desc.BlendState.IndependentBlendEnable);
+	UINT blendCount = desc.BlendState.IndependentBlendEnable ? desc.NumRenderTargets : (desc.NumRenderTargets ? 1 : 0);
+	for (UINT i = 0; i < blendCount; ++i)
+	{
+		const D3D12_RENDER_TARGET_BLEND_DESC& rt = desc.BlendState.RenderTarget[i];
+		h.Add(rt.BlendEnable).Add(rt.LogicOpEnable).Add(rt.RenderTargetWriteMask);
+		if (rt.BlendEnable)
+		{
+			h.Add(rt.SrcBlend).Add(rt.DestBlend).Add(rt.BlendOp);
+			h.Add(rt.SrcBlendAlpha).Add(rt.DestBlendAlpha).Add(rt.BlendOpAlpha);
+		}
+		if (rt.LogicOpEnable)
+		{
+			h.Add(rt.LogicOp);
+		}
+	}
+	h.Add(desc.SampleMask);
+
+	const D3D12_RASTERIZER_DESC& rs = desc.RasterizerState;
+	h.Add(rs.FillMode).Add(rs.CullMode).Add(rs.FrontCounterClockwise);
+	h.Add(rs.DepthBias).Add(rs.DepthBiasClamp).Add(rs.SlopeScaledDepthBias);
+	h.Add(rs.DepthClipEnable).Add(rs.MultisampleEnable).Add(rs.AntialiasedLineEnable);
+	h.Add(rs.ForcedSampleCount).Add(rs.ConservativeRaster);
+
+	const D3D12_DEPTH_STENCIL_DESC& ds = desc.DepthStencilState;
+	h.Add(ds.DepthEnable).Add(ds.StencilEnable);
+	if (ds.DepthEnable)
+	{
+		h.Add(ds.DepthWriteMask).Add(ds.DepthFunc);
+	}
+	if (ds.StencilEnable)
+	{
+		h.Add(ds.StencilReadMask).Add(ds.StencilWriteMask);
+		const D3D12_DEPTH_STENCILOP_DESC* faces[] = { &ds.FrontFace, &ds.BackFace };
+		for (auto face : faces)
+		{
+			h.Add(face->StencilFailOp).Add(face->StencilDepthFailOp).Add(face->StencilPassOp).Add(face->StencilFunc);
+		}
+	}
+
+	h.Add(desc.InputLayout.NumElements);
+	for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+		h.AddString(element.SemanticName).Add(element.SemanticIndex).Add(element.Format);
+		h.Add(element.InputSlot).Add(element.AlignedByteOffset).Add(element.InputSlotClass).Add(element.InstanceDataStepRate);
+	}
+
+	h.Add(desc.IBStripCutValue).Add(desc.PrimitiveTopologyType);
+	h.Add(desc.NumRenderTargets);
+	for (UINT i = 0; i < desc.NumRenderTargets; ++i)
+	{
+		h.Add(desc.RTVFormats[i]);
+	}
+	h.Add(desc.DSVFormat);
+	h.Add(desc.SampleDesc.Count).Add(desc.SampleDesc.Quality);
+	h.Add(desc.NodeMask).Add(desc.Flags);
+	//CachedPSO is deliberately not hashed, it is an input to creation and not part of the pipeline.
+
+	return h.Get();
+}
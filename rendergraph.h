@@ -0,0 +1,632 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+//frame graph core: passes declare the resources they read and write, Compile() then works out what the frame
+//needs without touching the graphics API:
+//- passes whose results nobody uses are culled, a pass is kept when it writes an imported resource, is marked
+//  with SetNeverCull, or writes something a kept pass reads later
+//- the kept passes run in the order they were added
+//- transient resources get a lifetime (first to last kept pass using them) and an offset in a heap shared with
+//  other transients of the same heap class; resources whose lifetimes don't overlap share memory
+//- the state transitions each pass needs, consecutive readers of a resource merged into one combined read state,
+//  plus the aliasing barriers for transients whose memory was used by another one
+//- transitions that could start earlier than the pass needing them are split, the begin is placed right after
+//  the previous access of the resource and the end right before the pass, so the GPU can overlap the transition
+//  (decompression, cache flushes) with the passes in between
+//States are D3D12_RESOURCE_STATES values, the graph only compares and combines them. See GpuRenderGraph for the
+//D3D12 side that creates the heaps and records the barriers.
+class RenderGraph
+{
+public:
+	typedef uint32_t ResourceHandle;
+	typedef uint32_t PassHandle;
+	typedef uint32_t State;
+
+	static const ResourceHandle InvalidResource = ~0u;
+	static const State UnknownState = ~0u; //before-state of a transient's first use, whatever the last frame left it in
+	static const State UnorderedAccessState = 0x8; //D3D12_RESOURCE_STATE_UNORDERED_ACCESS, writes in it need a UAV barrier between passes
+	static const uint32_t MaxHeapClasses = 4;
+	static const uint32_t NoAccess = ~0u;
+
+	struct TransientDesc
+	{
+		uint64_t Size; //as reported by GetResourceAllocationInfo
+		uint64_t Alignment;
+		uint32_t HeapClass; //transients only alias others of the same class, e.g. render targets vs other textures
+	};
+
+	enum SplitType
+	{
+		NotSplit,
+		SplitBegin, //D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY, a matching SplitEnd follows in a later batch
+		SplitEnd //D3D12_RESOURCE_BARRIER_FLAG_END_ONLY
+	};
+
+	//Before == After is a UAV barrier between two passes writing the resource as unordered access
+	struct Barrier
+	{
+		ResourceHandle Resource;
+		State Before;
+		State After;
+		SplitType Split;
+	};
+
+	//Before is InvalidResource when no other transient used the memory earlier in the frame
+	struct AliasingBarrier
+	{
+		ResourceHandle Before;
+		ResourceHandle After;
+	};
+
+	//barriers to record before the pass, as ranges of GetBarriers() and GetAliasingBarriers(). The barriers of a
+	//pass also contain the begins of split transitions ending at a later pass.
+	struct CompiledPass
+	{
+		PassHandle Pass;
+		uint32_t FirstAliasingBarrier;
+		uint32_t AliasingBarrierCount;
+		uint32_t FirstBarrier;
+		uint32_t BarrierCount;
+	};
+
+	struct Statistics
+	{
+		uint32_t PassCount;
+		uint32_t CulledPassCount;
+		uint32_t TransientCount; //used by kept passes
+		uint32_t BarrierCount; //the begin and end of a split transition count as two
+		uint32_t SplitBarrierCount; //transitions that were split
+		uint32_t AliasingBarrierCount;
+		uint64_t TransientBytes; //what the transients would take without aliasing
+		uint64_t HeapBytes; //what they take in the heaps
+	};
+
+	void Reset()
+	{
+		m_Resources.clear();
+		m_Passes.clear();
+		m_Accesses.clear();
+		m_Schedule.clear();
+		m_Barriers.clear();
+		m_AliasingBarriers.clear();
+		m_FinalBarriers.clear();
+		for (uint32_t i = 0; i < MaxHeapClasses; ++i)
+		{
+			m_HeapSizes[i] = 0;
+		}
+	}
+
+	//resource that lives outside the graph, e.g. the back buffer. Its contents are a result of the frame, so passes
+	//writing it are never culled, and it is transitioned to finalState after the last pass.
+	ResourceHandle Import(State currentState, State finalState)
+	{
+		Resource r = {};
+		r.Imported = true;
+		r.InitialState = currentState;
+		r.FinalState = finalState;
+		return AddResource(r);
+	}
+
+	//resource only used within the frame, its memory may be shared with transients used at other times.
+	ResourceHandle CreateTransient(const TransientDesc& desc)
+	{
+		assert(desc.HeapClass < MaxHeapClasses && desc.Alignment && !(desc.Alignment & (desc.Alignment - 1)));
+		Resource r = {};
+		r.Imported = false;
+		r.Desc = desc;
+		r.InitialState = UnknownState;
+		r.FinalState = UnknownState;
+		return AddResource(r);
+	}
+
+	PassHandle AddPass(const char* name)
+	{
+		Pass p;
+		p.Name = name;
+		p.NeverCull = false;
+		m_Passes.push_back(p);
+		return static_cast<PassHandle>(m_Passes.size() - 1);
+	}
+
+	//for passes with effects outside the graph, like readbacks or queries
+	void SetNeverCull(PassHandle pass) { m_Passes[pass].NeverCull = true; }
+
+	void Read(PassHandle pass, ResourceHandle resource, State state) { AddAccess(pass, resource, state, false); }
+	void Write(PassHandle pass, ResourceHandle resource, State state) { AddAccess(pass, resource, state, true); }
+
+	//returns false when a kept pass reads a transient nothing wrote before it.
+	bool Compile()
+	{
+		m_Schedule.clear();
+		m_Barriers.clear();
+		m_AliasingBarriers.clear();
+		m_FinalBarriers.clear();
+		for (uint32_t i = 0; i < MaxHeapClasses; ++i)
+		{
+			m_HeapSizes[i] = 0;
+		}
+		for (auto& r : m_Resources)
+		{
+			r.FirstState = UnknownState;
+			r.FirstUse = ~0u;
+			r.LastUse = 0;
+			r.Offset = 0;
+		}
+
+		SortAccesses();
+		Cull();
+
+		m_ScheduleIndex.assign(m_Passes.size(), ~0u);
+		for (PassHandle p = 0; p < m_Passes.size(); ++p)
+		{
+			if (m_Passes[p].Kept)
+			{
+				m_ScheduleIndex[p] = static_cast<uint32_t>(m_Schedule.size());
+				CompiledPass compiled = {};
+				compiled.Pass = p;
+				m_Schedule.push_back(compiled);
+			}
+		}
+
+		if (!ComputeLifetimes())
+		{
+			return false;
+		}
+		PlaceTransients();
+		BuildBarriers();
+		return true;
+	}
+
+	const std::vector<CompiledPass>& GetSchedule() const { return m_Schedule; }
+	const Barrier* GetBarriers(const CompiledPass& pass) const { return m_Barriers.data() + pass.FirstBarrier; }
+	const AliasingBarrier* GetAliasingBarriers(const CompiledPass& pass) const { return m_AliasingBarriers.data() + pass.FirstAliasingBarrier; }
+	const std::vector<Barrier>& GetFinalBarriers() const { return m_FinalBarriers; } //imported resources back to their final state, recorded after the last pass
+
+	const char* GetPassName(PassHandle pass) const { return m_Passes[pass].Name; }
+	bool IsCulled(PassHandle pass) const { return !m_Passes[pass].Kept; }
+	uint32_t GetResourceCount() const { return static_cast<uint32_t>(m_Resources.size()); }
+	bool IsImported(ResourceHandle resource) const { return m_Resources[resource].Imported; }
+	const TransientDesc& GetTransientDesc(ResourceHandle resource) const { return m_Resources[resource].Desc; }
+
+	//transients not used by any kept pass have no memory
+	bool IsAllocated(ResourceHandle resource) const { return !m_Resources[resource].Imported && m_Resources[resource].FirstUse != ~0u; }
+	uint64_t GetHeapOffset(ResourceHandle resource) const { return m_Resources[resource].Offset; }
+	uint64_t GetHeapSize(uint32_t heapClass) const { return m_HeapSizes[heapClass]; }
+
+	//state the resource has to be in when it is first used in the frame
+	State GetFirstState(ResourceHandle resource) const { return m_Resources[resource].FirstState; }
+
+	Statistics GetStatistics() const
+	{
+		Statistics stats = {};
+		stats.PassCount = static_cast<uint32_t>(m_Passes.size());
+		stats.CulledPassCount = stats.PassCount - static_cast<uint32_t>(m_Schedule.size());
+		stats.BarrierCount = static_cast<uint32_t>(m_Barriers.size() + m_FinalBarriers.size());
+		stats.AliasingBarrierCount = static_cast<uint32_t>(m_AliasingBarriers.size());
+		for (const auto& barrier : m_Barriers)
+		{
+			stats.SplitBarrierCount += (barrier.Split == SplitBegin) ? 1 : 0;
+		}
+		for (ResourceHandle r = 0; r < m_Resources.size(); ++r)
+		{
+			if (IsAllocated(r))
+			{
+				++stats.TransientCount;
+				stats.TransientBytes += m_Resources[r].Desc.Size;
+			}
+		}
+		for (uint32_t i = 0; i < MaxHeapClasses; ++i)
+		{
+			stats.HeapBytes += m_HeapSizes[i];
+		}
+		return stats;
+	}
+
+private:
+	struct Resource
+	{
+		bool Imported;
+		TransientDesc Desc;
+		State InitialState;
+		State FinalState;
+		State FirstState;
+		uint32_t FirstUse; //schedule indices, ~0u when no kept pass uses it
+		uint32_t LastUse;
+		uint64_t Offset;
+	};
+
+	struct Pass
+	{
+		const char* Name;
+		bool NeverCull;
+		bool Kept;
+	};
+
+	//one per pass and resource, a pass reading and writing a resource has a single access with both states
+	struct Access
+	{
+		PassHandle Pass;
+		ResourceHandle Resource;
+		State Required;
+		bool IsRead;
+		bool IsWrite;
+	};
+
+	ResourceHandle AddResource(Resource& r)
+	{
+		r.FirstState = UnknownState;
+		r.FirstUse = ~0u;
+		r.LastUse = 0;
+		r.Offset = 0;
+		m_Resources.push_back(r);
+		return static_cast<ResourceHandle>(m_Resources.size() - 1);
+	}
+
+	void AddAccess(PassHandle pass, ResourceHandle resource, State state, bool isWrite)
+	{
+		assert(pass < m_Passes.size() && resource < m_Resources.size());
+		//passes declare their accesses right after AddPass, so a repeated resource is near the end
+		for (size_t i = m_Accesses.size(); i-- > 0 && m_Accesses[i].Pass == pass;)
+		{
+			Access& existing = m_Accesses[i];
+			if (existing.Resource == resource)
+			{
+				existing.Required |= state;
+				existing.IsRead |= !isWrite;
+				existing.IsWrite |= isWrite;
+				return;
+			}
+		}
+		Access access = { pass, resource, state, !isWrite, isWrite };
+		m_Accesses.push_back(access);
+	}
+
+	//accesses grouped by pass in declaration order, also when they were declared out of order
+	void SortAccesses()
+	{
+		std::stable_sort(m_Accesses.begin(), m_Accesses.end(), [](const Access& a, const Access& b)
+		{
+			return a.Pass < b.Pass;
+		});
+		m_PassAccessStart.assign(m_Passes.size() + 1, 0);
+		for (const auto& access : m_Accesses)
+		{
+			++m_PassAccessStart[access.Pass + 1];
+		}
+		for (size_t p = 0; p < m_Passes.size(); ++p)
+		{
+			m_PassAccessStart[p + 1] += m_PassAccessStart[p];
+		}
+	}
+
+	//walks the passes backwards keeping track of which resources a kept pass still needs
+	void Cull()
+	{
+		m_Needed.assign(m_Resources.size(), false);
+		for (PassHandle p = static_cast<PassHandle>(m_Passes.size()); p-- > 0;)
+		{
+			Pass& pass = m_Passes[p];
+			pass.Kept = pass.NeverCull;
+			for (uint32_t a = m_PassAccessStart[p]; a < m_PassAccessStart[p + 1] && !pass.Kept; ++a)
+			{
+				const Access& access = m_Accesses[a];
+				pass.Kept = access.IsWrite && (m_Resources[access.Resource].Imported || m_Needed[access.Resource]);
+			}
+			if (!pass.Kept)
+			{
+				continue;
+			}
+
+			//this pass provides what later passes read, unless it also reads it itself
+			for (uint32_t a = m_PassAccessStart[p]; a < m_PassAccessStart[p + 1]; ++a)
+			{
+				if (m_Accesses[a].IsWrite)
+				{
+					m_Needed[m_Accesses[a].Resource] = false;
+				}
+			}
+			for (uint32_t a = m_PassAccessStart[p]; a < m_PassAccessStart[p + 1]; ++a)
+			{
+				if (m_Accesses[a].IsRead)
+				{
+					m_Needed[m_Accesses[a].Resource] = true;
+				}
+			}
+		}
+	}
+
+	bool ComputeLifetimes()
+	{
+		for (const auto& compiled : m_Schedule)
+		{
+			uint32_t index = m_ScheduleIndex[compiled.Pass];
+			for (uint32_t a = m_PassAccessStart[compiled.Pass]; a < m_PassAccessStart[compiled.Pass + 1]; ++a)
+			{
+				const Access& access = m_Accesses[a];
+				Resource& r = m_Resources[access.Resource];
+				if (r.FirstUse == ~0u)
+				{
+					if (!r.Imported && access.IsRead)
+					{
+						return false;
+					}
+					r.FirstUse = index;
+					r.FirstState = access.Required;
+				}
+				r.LastUse = index;
+			}
+		}
+		return true;
+	}
+
+	bool LifetimesOverlap(const Resource& a, const Resource& b) const
+	{
+		return a.FirstUse <= b.LastUse && b.FirstUse <= a.LastUse;
+	}
+
+	static bool RangesOverlap(const Resource& a, const Resource& b)
+	{
+		return a.Offset < b.Offset + b.Desc.Size && b.Offset < a.Offset + a.Desc.Size;
+	}
+
+	//largest first, each at the lowest offset that doesn't collide with an already placed transient that is
+	//alive at the same time
+	void PlaceTransients()
+	{
+		m_Order.clear();
+		for (ResourceHandle r = 0; r < m_Resources.size(); ++r)
+		{
+			if (IsAllocated(r))
+			{
+				m_Order.push_back(r);
+			}
+		}
+		std::sort(m_Order.begin(), m_Order.end(), [this](ResourceHandle a, ResourceHandle b)
+		{
+			const Resource& ra = m_Resources[a];
+			const Resource& rb = m_Resources[b];
+			if (ra.Desc.Size != rb.Desc.Size)
+			{
+				return ra.Desc.Size > rb.Desc.Size;
+			}
+			return ra.FirstUse < rb.FirstUse;
+		});
+
+		for (size_t i = 0; i < m_Order.size(); ++i)
+		{
+			Resource& r = m_Resources[m_Order[i]];
+
+			//candidate offsets are the start of the heap and the end of every placed transient in the way
+			m_Candidates.clear();
+			m_Candidates.push_back(0);
+			for (size_t j = 0; j < i; ++j)
+			{
+				const Resource& placed = m_Resources[m_Order[j]];
+				if (placed.Desc.HeapClass == r.Desc.HeapClass && LifetimesOverlap(placed, r))
+				{
+					m_Candidates.push_back(placed.Offset + placed.Desc.Size);
+				}
+			}
+			std::sort(m_Candidates.begin(), m_Candidates.end());
+
+			for (uint64_t candidate : m_Candidates)
+			{
+				r.Offset = (candidate + r.Desc.Alignment - 1) & ~(r.Desc.Alignment - 1);
+				bool fits = true;
+				for (size_t j = 0; j < i && fits; ++j)
+				{
+					const Resource& placed = m_Resources[m_Order[j]];
+					fits = placed.Desc.HeapClass != r.Desc.HeapClass || !LifetimesOverlap(placed, r) || !RangesOverlap(placed, r);
+				}
+				if (fits)
+				{
+					break;
+				}
+			}
+
+			uint64_t& heapSize = m_HeapSizes[r.Desc.HeapClass];
+			heapSize = std::max(heapSize, r.Offset + r.Desc.Size);
+		}
+	}
+
+	//previousAccess is the schedule index of the last pass using the resource, NoAccess at the start of the frame.
+	//Splitting only pays off with at least one pass between the begin and the end. A transient's first transition
+	//comes right after its aliasing barrier and isn't split.
+	void AddTransition(uint32_t scheduleIndex, ResourceHandle resource, State before, State after, uint32_t previousAccess)
+	{
+		uint32_t begin = (previousAccess == NoAccess) ? 0 : previousAccess + 1;
+		if (before != UnknownState && before != after && begin < scheduleIndex)
+		{
+			m_PendingBarriers.push_back({ begin, { resource, before, after, SplitBegin } });
+			m_PendingBarriers.push_back({ scheduleIndex, { resource, before, after, SplitEnd } });
+			return;
+		}
+		m_PendingBarriers.push_back({ scheduleIndex, { resource, before, after, NotSplit } });
+	}
+
+	void BuildBarriers()
+	{
+		m_PendingBarriers.clear();
+
+		//the memory of a transient also holds others, either earlier in this frame or in the last one. Before its
+		//first use it needs an aliasing barrier, naming the transient that last used the memory if there is one.
+		m_PendingAliasing.clear();
+		for (ResourceHandle r : m_Order)
+		{
+			const Resource& res = m_Resources[r];
+			bool shared = false;
+			ResourceHandle before = InvalidResource;
+			for (ResourceHandle other : m_Order)
+			{
+				const Resource& o = m_Resources[other];
+				if (other == r || o.Desc.HeapClass != res.Desc.HeapClass || !RangesOverlap(o, res))
+				{
+					continue;
+				}
+				shared = true;
+				if (o.LastUse < res.FirstUse && (before == InvalidResource || o.LastUse > m_Resources[before].LastUse))
+				{
+					before = other;
+				}
+			}
+			if (shared)
+			{
+				m_PendingAliasing.push_back({ res.FirstUse, { before, r } });
+			}
+		}
+
+		//resources in the order their accesses happen
+		m_Current.resize(m_Resources.size());
+		for (ResourceHandle r = 0; r < m_Resources.size(); ++r)
+		{
+			m_Current[r] = m_Resources[r].InitialState;
+		}
+		m_ReadRunEnd.assign(m_Resources.size(), 0);
+		m_LastAccess.assign(m_Resources.size(), uint32_t(NoAccess));
+		for (uint32_t s = 0; s < m_Schedule.size(); ++s)
+		{
+			PassHandle p = m_Schedule[s].Pass;
+			for (uint32_t a = m_PassAccessStart[p]; a < m_PassAccessStart[p + 1]; ++a)
+			{
+				const Access& access = m_Accesses[a];
+				State& current = m_Current[access.Resource];
+				uint32_t previousAccess = m_LastAccess[access.Resource];
+				m_LastAccess[access.Resource] = s;
+				if (access.IsWrite)
+				{
+					if (current != access.Required)
+					{
+						AddTransition(s, access.Resource, current, access.Required, previousAccess);
+					}
+					else if (access.Required & UnorderedAccessState)
+					{
+						AddTransition(s, access.Resource, current, current, previousAccess);
+					}
+					current = access.Required;
+					continue;
+				}
+
+				//one transition to what this and the following readers need together
+				if (s < m_ReadRunEnd[access.Resource] && (current & access.Required) == access.Required)
+				{
+					continue;
+				}
+				State combined = CombineReads(s, access.Resource, m_ReadRunEnd[access.Resource]);
+				if (current != combined)
+				{
+					AddTransition(s, access.Resource, current, combined, previousAccess);
+				}
+				current = combined;
+			}
+		}
+
+		for (ResourceHandle r = 0; r < m_Resources.size(); ++r)
+		{
+			const Resource& res = m_Resources[r];
+			if (!res.Imported || m_Current[r] == res.FinalState)
+			{
+				continue;
+			}
+			uint32_t begin = (m_LastAccess[r] == NoAccess) ? 0 : m_LastAccess[r] + 1;
+			if (begin < m_Schedule.size())
+			{
+				m_PendingBarriers.push_back({ begin, { r, m_Current[r], res.FinalState, SplitBegin } });
+				m_FinalBarriers.push_back({ r, m_Current[r], res.FinalState, SplitEnd });
+			}
+			else
+			{
+				m_FinalBarriers.push_back({ r, m_Current[r], res.FinalState, NotSplit });
+			}
+		}
+
+		//bucket by pass, keeping the order they were added in
+		std::stable_sort(m_PendingBarriers.begin(), m_PendingBarriers.end(), [](const PendingBarrier& a, const PendingBarrier& b)
+		{
+			return a.ScheduleIndex < b.ScheduleIndex;
+		});
+		std::stable_sort(m_PendingAliasing.begin(), m_PendingAliasing.end(), [](const PendingAliasing& a, const PendingAliasing& b)
+		{
+			return a.ScheduleIndex < b.ScheduleIndex;
+		});
+		size_t barrier = 0, aliasing = 0;
+		for (uint32_t s = 0; s < m_Schedule.size(); ++s)
+		{
+			CompiledPass& compiled = m_Schedule[s];
+			compiled.FirstBarrier = static_cast<uint32_t>(m_Barriers.size());
+			for (; barrier < m_PendingBarriers.size() && m_PendingBarriers[barrier].ScheduleIndex == s; ++barrier)
+			{
+				m_Barriers.push_back(m_PendingBarriers[barrier].Value);
+			}
+			compiled.BarrierCount = static_cast<uint32_t>(m_Barriers.size()) - compiled.FirstBarrier;
+
+			compiled.FirstAliasingBarrier = static_cast<uint32_t>(m_AliasingBarriers.size());
+			for (; aliasing < m_PendingAliasing.size() && m_PendingAliasing[aliasing].ScheduleIndex == s; ++aliasing)
+			{
+				m_AliasingBarriers.push_back(m_PendingAliasing[aliasing].Value);
+			}
+			compiled.AliasingBarrierCount = static_cast<uint32_t>(m_AliasingBarriers.size()) - compiled.FirstAliasingBarrier;
+		}
+	}
+
+	//combined state of the reads of resource from schedule index s until the next write, runEnd is set to the
+	//schedule index of that write (or the end of the schedule)
+	State CombineReads(uint32_t s, ResourceHandle resource, uint32_t& runEnd) const
+	{
+		State combined = 0;
+		for (runEnd = s; runEnd < m_Schedule.size(); ++runEnd)
+		{
+			PassHandle p = m_Schedule[runEnd].Pass;
+			for (uint32_t a = m_PassAccessStart[p]; a < m_PassAccessStart[p + 1]; ++a)
+			{
+				const Access& access = m_Accesses[a];
+				if (access.Resource != resource)
+				{
+					continue;
+				}
+				if (access.IsWrite)
+				{
+					return combined;
+				}
+				combined |= access.Required;
+			}
+		}
+		return combined;
+	}
+
+	struct PendingBarrier
+	{
+		uint32_t ScheduleIndex;
+		RenderGraph::Barrier Value;
+	};
+
+	struct PendingAliasing
+	{
+		uint32_t ScheduleIndex;
+		RenderGraph::AliasingBarrier Value;
+	};
+
+	std::vector<Resource> m_Resources;
+	std::vector<Pass> m_Passes;
+	std::vector<Access> m_Accesses;
+	std::vector<CompiledPass> m_Schedule;
+	std::vector<Barrier> m_Barriers;
+	std::vector<AliasingBarrier> m_AliasingBarriers;
+	std::vector<Barrier> m_FinalBarriers;
+	uint64_t m_HeapSizes[MaxHeapClasses];
+
+	//scratch kept between compiles to avoid reallocating
+	std::vector<uint32_t> m_PassAccessStart;
+	std::vector<uint32_t> m_ScheduleIndex;
+	std::vector<bool> m_Needed;
+	std::vector<ResourceHandle> m_Order;
+	std::vector<uint64_t> m_Candidates;
+	std::vector<State> m_Current;
+	std::vector<uint32_t> m_ReadRunEnd;
+	std::vector<uint32_t> m_LastAccess;
+	std::vector<PendingBarrier> m_PendingBarriers;
+	std::vector<PendingAliasing> m_PendingAliasing;
+};
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+//decides which GPU resources stay resident under a video memory budget.
+//Resources are registered with the size of each of their mips and marked as used every frame they are
+//drawn with. Update() compares the resident bytes against the budget (as reported by QueryVideoMemoryInfo,
+//or a simulated number) and returns the operations to apply: evictions of the least recently used resources,
+//or for textures that allow it, dropping their top mips first; and residency requests for evicted resources
+//that are needed again. It has no knowledge of the graphics API, see GpuResidencyManager for the D3D12 side.
+class ResidencyPolicy
+{
+public:
+	typedef uint32_t Handle;
+
+	struct MipBiasChange
+	{
+		Handle Resource;
+		uint32_t MipBias; //number of top mips that are not resident, 0 is the full texture
+	};
+
+	struct Operations
+	{
+		std::vector<Handle> Evict;
+		std::vector<Handle> MakeResident;
+		std::vector<MipBiasChange> SetMipBias;
+
+		void Clear() { Evict.clear(); MakeResident.clear(); SetMipBias.clear(); }
+		bool IsEmpty() const { return Evict.empty() && MakeResident.empty() && SetMipBias.empty(); }
+	};
+
+	struct Statistics
+	{
+		uint64_t Budget;
+		uint64_t ResidentBytes;
+		uint64_t EvictedBytes; //full size of evicted resources plus dropped mips
+		uint32_t ResidentCount;
+		uint32_t EvictedCount;
+		uint32_t Evictions; //totals since Create
+		uint32_t MipDrops;
+		uint32_t Restores;
+	};
+
+	//framesInFlight: resources used in that many recent frames may still be read by the GPU and are never evicted.
+	//headroom: fraction of the budget kept free after trimming, so usage doesn't oscillate around the budget.
+	void Create(uint32_t framesInFlight, float headroom = 0.05f)
+	{
+		m_FramesInFlight = framesInFlight;
+		m_Headroom = headroom;
+		m_Resources.clear();
+		m_FreeHandles.clear();
+		m_ResidentBytes = 0;
+		m_Evictions = 0;
+		m_MipDrops = 0;
+		m_Restores = 0;
+		m_Budget = 0;
+	}
+
+	//mipSizes[0] is the most detailed mip. maxMipBias is how many top mips may be dropped before the
+	//resource is evicted as a whole, 0 for buffers and textures without streaming.
+	Handle Register(const uint64_t* mipSizes, uint32_t mipCount, uint32_t maxMipBias, uint64_t frame)
+	{
+		assert(mipCount > 0 && maxMipBias < mipCount);
+
+		Handle handle;
+		if (!m_FreeHandles.empty())
+		{
+			handle = m_FreeHandles.back();
+			m_FreeHandles.pop_back();
+		}
+		else
+		{
+			handle = static_cast<Handle>(m_Resources.size());
+			m_Resources.emplace_back();
+		}
+
+		Resource& r = m_Resources[handle];
+		r.MipSizes.assign(mipSizes, mipSizes + mipCount);
+		r.MaxMipBias = maxMipBias;
+		r.MipBias = 0;
+		r.LastUsedFrame = frame;
+		r.Resident = true;
+		r.Registered = true;
+		m_ResidentBytes += r.GetResidentSize();
+		return handle;
+	}
+
+	Handle Register(uint64_t size, uint64_t frame)
+	{
+		return Register(&size, 1, 0, frame);
+	}
+
+	void Unregister(Handle handle)
+	{
+		Resource& r = m_Resources[handle];
+		assert(r.Registered);
+		if (r.Resident)
+		{
+			m_ResidentBytes -= r.GetResidentSize();
+		}
+		r.Registered = false;
+		r.MipSizes.clear();
+		m_FreeHandles.push_back(handle);
+	}
+
+	void MarkUsed(Handle handle, uint64_t frame)
+	{
+		assert(m_Resources[handle].Registered);
+		if (frame > m_Resources[handle].LastUsedFrame)
+		{
+			m_Resources[handle].LastUsedFrame = frame;
+		}
+	}
+
+	//call once per frame after marking this frame's resources as used and before recording.
+	void Update(uint64_t frame, uint64_t budget, Operations& ops)
+	{
+		ops.Clear();
+		m_Budget = budget;
+		uint64_t target = static_cast<uint64_t>(double(budget) * (1.0 - m_Headroom));
+
+		//anything drawn this frame has to be resident before the frame executes, whatever the budget says
+		for (Handle h = 0; h < m_Resources.size(); ++h)
+		{
+			Resource& r = m_Resources[h];
+			if (r.Registered && !r.Resident && r.LastUsedFrame == frame)
+			{
+				r.Resident = true;
+				r.MipBias = r.MaxMipBias; //come back at the lowest detail, the restore pass below adds mips if there is room
+				m_ResidentBytes += r.GetResidentSize();
+				ops.MakeResident.push_back(h);
+				if (r.MipBias)
+				{
+					ops.SetMipBias.push_back({ h, r.MipBias });
+				}
+				++m_Restores;
+			}
+		}
+
+		if (m_ResidentBytes > target)
+		{
+			Trim(frame, target, ops);
+		}
+		else
+		{
+			RestoreMips(frame, target, ops);
+		}
+	}
+
+	bool IsResident(Handle handle) const { return m_Resources[handle].Resident; }
+	uint32_t GetMipBias(Handle handle) const { return m_Resources[handle].MipBias; }
+	uint64_t GetResidentBytes() const { return m_ResidentBytes; }
+
+	Statistics GetStatistics() const
+	{
+		Statistics stats = {};
+		stats.Budget = m_Budget;
+		stats.ResidentBytes = m_ResidentBytes;
+		for (const auto& r : m_Resources)
+		{
+			if (!r.Registered)
+			{
+				continue;
+			}
+			if (r.Resident)
+			{
+				++stats.ResidentCount;
+				stats.EvictedBytes += r.GetFullSize() - r.GetResidentSize();
+			}
+			else
+			{
+				++stats.EvictedCount;
+				stats.EvictedBytes += r.GetFullSize();
+			}
+		}
+		stats.Evictions = m_Evictions;
+		stats.MipDrops = m_MipDrops;
+		stats.Restores = m_Restores;
+		return stats;
+	}
+
+private:
+	struct Resource
+	{
+		std::vector<uint64_t> MipSizes;
+		uint32_t MaxMipBias;
+		uint32_t MipBias;
+		uint64_t LastUsedFrame;
+		bool Resident;
+		bool Registered;
+
+		uint64_t GetResidentSize() const
+		{
+			uint64_t size = 0;
+			for (size_t i = MipBias; i < MipSizes.size(); ++i)
+			{
+				size += MipSizes[i];
+			}
+			return size;
+		}
+
+		uint64_t GetFullSize() const
+		{
+			uint64_t size = 0;
+			for (auto mip : MipSizes)
+			{
+				size += mip;
+			}
+			return size;
+		}
+	};
+
+	//resources the GPU may still be reading can't be touched
+	bool IsEvictable(const Resource& r, uint64_t frame) const
+	{
+		return r.Registered && r.Resident && r.LastUsedFrame + m_FramesInFlight <= frame;
+	}
+
+	//least recently used first. A resource only loses top mips when that alone gets usage under the target,
+	//otherwise it is evicted completely and the next oldest is visited.
+	void Trim(uint64_t frame, uint64_t target, Operations& ops)
+	{
+		m_Candidates.clear();
+		for (Handle h = 0; h < m_Resources.size(); ++h)
+		{
+			if (IsEvictable(m_Resources[h], frame))
+			{
+				m_Candidates.push_back(h);
+			}
+		}
+		std::sort(m_Candidates.begin(), m_Candidates.end(), [this](Handle a, Handle b)
+		{
+			return m_Resources[a].LastUsedFrame < m_Resources[b].LastUsedFrame;
+		});
+
+		for (Handle h : m_Candidates)
+		{
+			if (m_ResidentBytes <= target)
+			{
+				break;
+			}
+
+			Resource& r = m_Resources[h];
+			uint64_t droppable = 0;
+			for (uint32_t mip = r.MipBias; mip < r.MaxMipBias; ++mip)
+			{
+				droppable += r.MipSizes[mip];
+			}
+
+			if (m_ResidentBytes - droppable > target)
+			{
+				m_ResidentBytes -= r.GetResidentSize();
+				r.Resident = false;
+				ops.Evict.push_back(h);
+				++m_Evictions;
+			}
+			else
+			{
+				while (m_ResidentBytes > target)
+				{
+					m_ResidentBytes -= r.MipSizes[r.MipBias];
+					++r.MipBias;
+					++m_MipDrops;
+				}
+				ops.SetMipBias.push_back({ h, r.MipBias });
+			}
+		}
+	}
+
+	//most recently used first, give back the mips dropped earlier while there is room under the target.
+	void RestoreMips(uint64_t frame, uint64_t target, Operations& ops)
+	{
+		m_Candidates.clear();
+		for (Handle h = 0; h < m_Resources.size(); ++h)
+		{
+			const Resource& r = m_Resources[h];
+			if (r.Registered && r.Resident && r.MipBias > 0 && r.LastUsedFrame + m_FramesInFlight > frame)
+			{
+				m_Candidates.push_back(h);
+			}
+		}
+		std::sort(m_Candidates.begin(), m_Candidates.end(), [this](Handle a, Handle b)
+		{
+			return m_Resources[a].LastUsedFrame > m_Resources[b].LastUsedFrame;
+		});
+
+		for (Handle h : m_Candidates)
+		{
+			Resource& r = m_Resources[h];
+			uint32_t oldBias = r.MipBias;
+			while (r.MipBias > 0 && m_ResidentBytes + r.MipSizes[r.MipBias - 1] <= target)
+			{
+				--r.MipBias;
+				m_ResidentBytes += r.MipSizes[r.MipBias];
+			}
+			if (r.MipBias != oldBias)
+			{
+				//the operations for this frame may already contain this resource, the last entry wins
+				ops.SetMipBias.push_back({ h, r.MipBias });
+			}
+		}
+	}
+
+	std::vector<Resource> m_Resources;
+	std::vector<Handle> m_FreeHandles;
+	std::vector<Handle> m_Candidates;
+	uint32_t m_FramesInFlight;
+	float m_Headroom;
+	uint64_t m_ResidentBytes;
+	uint64_t m_Budget;
+	uint32_t m_Evictions;
+	uint32_t m_MipDrops;
+	uint32_t m_Restores;
+};
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <assert.h>
+#include "d3d12types.h"
+#include <vector>
+#include <unordered_map>
+
+//subresources of a resource, one per mip of every array slice. Planes of planar formats aren't counted.
+inline UINT GetSubresourceCount(const D3D12_RESOURCE_DESC& desc)
+{
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		return 1;
+	}
+	UINT arraySize = (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? 1 : desc.DepthOrArraySize;
+	return UINT(desc.MipLevels ? desc.MipLevels : 1) * arraySize;
+}
+
+//remembers the current state of every registered resource so callers only say which state they need next.
+//Transition() works out the before-state itself, drops requests for a state the resource is already in,
+//and queues the rest. Flush() then records everything queued with a single ResourceBarrier call; call it
+//right before the draw, dispatch, clear or copy that depends on the transitions.
+//A resource transitioned twice before a flush ends up as one barrier from its first to its last state.
+//
+//States are tracked per resource until a single subresource is transitioned, after that per subresource
+//until the whole resource is transitioned to one state again.
+//
+//A UAV or aliasing barrier ends the batch of transitions queued before it as a flush would: later transitions
+//are queued behind it and never fold into earlier ones, which would move them ahead of the barrier.
+class ResourceStateTracker
+{
+public:
+	struct Statistics
+	{
+		UINT Requested; //Transition calls, one per subresource
+		UINT Elided; //already in the requested state, or cancelled out before the flush
+		UINT Emitted; //barriers that reached a command list
+		UINT Flushes; //ResourceBarrier calls
+		UINT Splits; //transitions recorded as a begin/end pair
+	};
+
+	ResourceStateTracker() : m_FoldStart(0) { ZeroMemory(&m_Stats, sizeof(m_Stats)); }
+
+	void Register(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresourceCount = 1)
+	{
+		Entry& entry = m_Resources[resource];
+		entry.State = state;
+		entry.SubresourceCount = subresourceCount;
+		entry.SubresourceStates.clear();
+		entry.InSplit = false;
+	}
+
+	//pending transitions of the resource are dropped, flush first if they still matter.
+	void Unregister(ID3D12Resource* resource)
+	{
+		m_Resources.erase(resource);
+		for (size_t i = 0; i < m_Pending.size();)
+		{
+			const D3D12_RESOURCE_BARRIER& pending = m_Pending[i];
+			if ((pending.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION && pending.Transition.pResource == resource) ||
+				(pending.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV && pending.UAV.pResource == resource) ||
+				(pending.Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING && (pending.Aliasing.pResourceBefore == resource || pending.Aliasing.pResourceAfter == resource)))
+			{
+				m_Pending.erase(m_Pending.begin() + i);
+				if (i < m_FoldStart)
+				{
+					--m_FoldStart;
+				}
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES after, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		auto it = m_Resources.find(resource);
+		assert(it != m_Resources.end());
+		Entry& entry = it->second;
+		assert(!entry.InSplit);
+
+		if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+		{
+			if (entry.SubresourceStates.empty())
+			{
+				entry.State = Queue(resource, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, entry.State, after, true);
+				return;
+			}
+
+			//subresources have diverged, bring each one over on its own then track the resource as a whole again
+			for (UINT i = 0; i < entry.SubresourceCount; ++i)
+			{
+				Queue(resource, i, entry.SubresourceStates[i], after, false);
+			}
+			entry.SubresourceStates.clear();
+			entry.State = after;
+			return;
+		}
+
+		assert(subresource < entry.SubresourceCount);
+		if (entry.SubresourceStates.empty())
+		{
+			entry.SubresourceStates.assign(entry.SubresourceCount, entry.State);
+			SplitPending(resource, entry.SubresourceCount);
+		}
+		entry.SubresourceStates[subresource] = Queue(resource, subresource, entry.SubresourceStates[subresource], after, true);
+	}
+
+	//split transition: BeginTransition right after the last use of the resource in its current state, EndTransition
+	//right before the first use in the new one, with other work recorded in between that the GPU can overlap the
+	//transition with. The resource must not be used or transitioned in between. Resources tracked per subresource
+	//and transitions that would be elided aren't split, EndTransition then does a plain Transition.
+	void BeginTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES after)
+	{
+		auto it = m_Resources.find(resource);
+		assert(it != m_Resources.end());
+		Entry& entry = it->second;
+		assert(!entry.InSplit);
+		if (!entry.SubresourceStates.empty() || Satisfies(entry.State, after))
+		{
+			return;
+		}
+		m_Pending.push_back(MakeTransition(resource, entry.State, after, D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY));
+		entry.InSplit = true;
+		entry.SplitAfter = after;
+	}
+
+	void EndTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES after)
+	{
+		auto it = m_Resources.find(resource);
+		assert(it != m_Resources.end());
+		Entry& entry = it->second;
+		if (!entry.InSplit)
+		{
+			Transition(resource, after);
+			return;
+		}
+		assert(entry.SplitAfter == after);
+		m_Pending.push_back(MakeTransition(resource, entry.State, after, D3D12_RESOURCE_BARRIER_FLAG_END_ONLY));
+		entry.State = after;
+		entry.InSplit = false;
+		++m_Stats.Requested;
+		++m_Stats.Splits;
+	}
+
+	//queues an aliasing barrier for placed resources sharing memory, before may be null for any resource in it.
+	//Queue it ahead of the transitions of after, after's contents are undefined until it is cleared, discarded or copied to.
+	void Alias(ID3D12Resource* before, ID3D12Resource* after)
+	{
+		D3D12_RESOURCE_BARRIER barrier;
+		ZeroMemory(&barrier, sizeof(barrier));
+		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+		barrier.Aliasing.pResourceBefore = before;
+		barrier.Aliasing.pResourceAfter = after;
+		m_Pending.push_back(barrier);
+		m_FoldStart = m_Pending.size();
+	}
+
+	//queues a UAV barrier so unordered access writes finish before the next unordered access to the resource
+	void UavBarrier(ID3D12Resource* resource)
+	{
+		D3D12_RESOURCE_BARRIER barrier;
+		ZeroMemory(&barrier, sizeof(barrier));
+		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		barrier.UAV.pResource = resource;
+		m_Pending.push_back(barrier);
+		m_FoldStart = m_Pending.size();
+	}
+
+	//tracked state of a subresource, not counting any transition still pending (those are already applied here).
+	D3D12_RESOURCE_STATES GetState(ID3D12Resource* resource, UINT subresource = 0) const
+	{
+		auto it = m_Resources.find(resource);
+		assert(it != m_Resources.end());
+		return it->second.SubresourceStates.empty() ? it->second.State : it->second.SubresourceStates[subresource];
+	}
+
+	template<typename CommandList>
+	void Flush(CommandList* commandList)
+	{
+		if (m_Pending.empty())
+		{
+			return;
+		}
+		commandList->ResourceBarrier(static_cast<UINT>(m_Pending.size()), m_Pending.data());
+		m_Stats.Emitted += static_cast<UINT>(m_Pending.size());
+		++m_Stats.Flushes;
+		m_Pending.clear();
+		m_FoldStart = 0;
+	}
+
+	UINT GetPendingCount() const { return static_cast<UINT>(m_Pending.size()); }
+	const Statistics& GetStatistics() const { return m_Stats; }
+
+private:
+	struct Entry
+	{
+		D3D12_RESOURCE_STATES State;
+		UINT SubresourceCount;
+		std::vector<D3D12_RESOURCE_STATES> SubresourceStates; //empty while all subresources share State
+		bool InSplit; //between BeginTransition and EndTransition, State is still the before-state
+		D3D12_RESOURCE_STATES SplitAfter;
+	};
+
+	static D3D12_RESOURCE_BARRIER MakeTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, D3D12_RESOURCE_BARRIER_FLAGS flags)
+	{
+		D3D12_RESOURCE_BARRIER barrier;
+		ZeroMemory(&barrier, sizeof(barrier));
+		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		barrier.Flags = flags;
+		barrier.Transition.pResource = resource;
+		barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		barrier.Transition.StateBefore = before;
+		barrier.Transition.StateAfter = after;
+		return barrier;
+	}
+
+	static bool IsReadOnly(D3D12_RESOURCE_STATES state)
+	{
+		return state != D3D12_RESOURCE_STATE_COMMON && (state & D3D12_RESOURCE_STATE_GENERIC_READ) == state;
+	}
+
+	//a resource in a combined read state already satisfies any subset of it
+	static bool Satisfies(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES wanted)
+	{
+		if (current == wanted)
+		{
+			return true;
+		}
+		return IsReadOnly(current) && IsReadOnly(wanted) && (current & wanted) == wanted;
+	}
+
+	//queues before -> after unless it is redundant, returns the state the subresource is tracked in afterwards.
+	//allowSuperset keeps a combined read state that already covers the wanted one instead of narrowing it.
+	D3D12_RESOURCE_STATES Queue(ID3D12Resource* resource, UINT subresource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, bool allowSuperset)
+	{
+		++m_Stats.Requested;
+		if (before == after || (allowSuperset && Satisfies(before, after)))
+		{
+			++m_Stats.Elided;
+			return before;
+		}
+
+		//fold into a transition of the same subresource still waiting for the flush, queued after the last UAV or aliasing barrier
+		for (size_t i = m_FoldStart; i < m_Pending.size(); ++i)
+		{
+			if (m_Pending[i].Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION || m_Pending[i].Flags != D3D12_RESOURCE_BARRIER_FLAG_NONE)
+			{
+				continue;
+			}
+			D3D12_RESOURCE_TRANSITION_BARRIER& pending = m_Pending[i].Transition;
+			if (pending.pResource == resource && pending.Subresource == subresource)
+			{
+				assert(pending.StateAfter == before);
+				++m_Stats.Elided;
+				if (pending.StateBefore == after)
+				{
+					m_Pending.erase(m_Pending.begin() + i);
+					++m_Stats.Elided;
+				}
+				else
+				{
+					pending.StateAfter = after;
+				}
+				return after;
+			}
+		}
+
+		D3D12_RESOURCE_BARRIER barrier = MakeTransition(resource, before, after, D3D12_RESOURCE_BARRIER_FLAG_NONE);
+		barrier.Transition.Subresource = subresource;
+		m_Pending.push_back(barrier);
+		return after;
+	}
+
+	//a pending whole-resource transition becomes one per subresource when the resource starts being tracked
+	//per subresource, so later transitions of single subresources can fold into it. One queued before a UAV or
+	//aliasing barrier stays whole, the per subresource transitions queue behind the barrier.
+	void SplitPending(ID3D12Resource* resource, UINT subresourceCount)
+	{
+		for (size_t i = m_FoldStart; i < m_Pending.size(); ++i)
+		{
+			D3D12_RESOURCE_BARRIER whole = m_Pending[i];
+			if (whole.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION || whole.Flags != D3D12_RESOURCE_BARRIER_FLAG_NONE || whole.Transition.pResource != resource || whole.Transition.Subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+			{
+				continue;
+			}
+			m_Pending.erase(m_Pending.begin() + i);
+			for (UINT sub = 0; sub < subresourceCount; ++sub)
+			{
+				whole.Transition.Subresource = sub;
+				m_Pending.push_back(whole);
+			}
+			return;
+		}
+	}
+
+	std::unordered_map<ID3D12Resource*, Entry> m_Resources;
+	std::vector<D3D12_RESOURCE_BARRIER> m_Pending;
+	size_t m_FoldStart; //first pending barrier a transition may fold into, after the last UAV or aliasing barrier
+	Statistics m_Stats;
+};
@@ -0,0 +1,561 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SCENE_CULL_SSE 1
+#else
+#define SCENE_CULL_SSE 0
+#endif
+
+#include "workerpool.h"
+
+//bounds of a scene object: a box and a sphere around the same center. An object is culled when either of them
+//is outside a frustum plane, so round objects get the sphere and long thin ones the box.
+struct SceneBounds
+{
+	float Center[3];
+	float Extents[3]; //half size of the box
+	float Radius;
+
+	static SceneBounds FromBox(const float minimum[3], const float maximum[3])
+	{
+		SceneBounds bounds;
+		for (int i = 0; i < 3; ++i)
+		{
+			bounds.Center[i] = (minimum[i] + maximum[i]) * 0.5f;
+			bounds.Extents[i] = (maximum[i] - minimum[i]) * 0.5f;
+		}
+		bounds.Radius = sqrtf(bounds.Extents[0] * bounds.Extents[0] + bounds.Extents[1] * bounds.Extents[1] + bounds.Extents[2] * bounds.Extents[2]);
+		return bounds;
+	}
+
+	static SceneBounds FromSphere(const float center[3], float radius)
+	{
+		SceneBounds bounds;
+		for (int i = 0; i < 3; ++i)
+		{
+			bounds.Center[i] = center[i];
+			bounds.Extents[i] = radius;
+		}
+		bounds.Radius = radius;
+		return bounds;
+	}
+};
+
+//six planes with normals pointing inwards, a point p is inside when dot(N, p) + D >= 0 for all of them
+struct Frustum
+{
+	enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+	float NX[PlaneCount];
+	float NY[PlaneCount];
+	float NZ[PlaneCount];
+	float D[PlaneCount];
+
+	//viewProjection is row major for row vectors, as XMStoreFloat4x4 of view * proj stores it, with D3D's 0..w depth range
+	static Frustum FromViewProjection(const float viewProjection[16])
+	{
+		const float* m = viewProjection;
+		//column c of the matrix is m[c], m[4 + c], m[8 + c], m[12 + c]
+		float planes[PlaneCount][4];
+		for (int i = 0; i < 4; ++i)
+		{
+			float c0 = m[i * 4 + 0], c1 = m[i * 4 + 1], c2 = m[i * 4 + 2], c3 = m[i * 4 + 3];
+			planes[Left][i] = c3 + c0;
+			planes[Right][i] = c3 - c0;
+			planes[Bottom][i] = c3 + c1;
+			planes[Top][i] = c3 - c1;
+			planes[Near][i] = c2;
+			planes[Far][i] = c3 - c2;
+		}
+
+		Frustum frustum;
+		for (int p = 0; p < PlaneCount; ++p)
+		{
+			float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+			float scale = length > 0.0f ? 1.0f / length : 0.0f;
+			frustum.NX[p] = planes[p][0] * scale;
+			frustum.NY[p] = planes[p][1] * scale;
+			frustum.NZ[p] = planes[p][2] * scale;
+			frustum.D[p] = planes[p][3] * scale;
+		}
+		return frustum;
+	}
+
+	//where point lies between the near (0) and far (1) plane, linear in view distance. Sort keys take it for
+	//front to back ordering, see DrawSortKey::QuantizeDepth.
+	float GetNormalizedDepth(const float point[3]) const
+	{
+		float nearDistance = NX[Near] * point[0] + NY[Near] * point[1] + NZ[Near] * point[2] + D[Near];
+		float farDistance = NX[Far] * point[0] + NY[Far] * point[1] + NZ[Far] * point[2] + D[Far];
+		float range = nearDistance + farDistance;
+		return range > 0.0f ? nearDistance / range : 0.0f;
+	}
+};
+
+//objects' bounds in structure of arrays layout, ordered by a bounding volume hierarchy so every leaf is a
+//contiguous run of objects that is tested 4 at a time with SSE.
+//Cull walks the hierarchy: nodes outside a plane are skipped, nodes inside a plane stop testing against it,
+//and leaves entirely inside the frustum are output without per object tests.
+//Objects keep their id through Build; moving objects only need SetBounds and a Refit before the next Cull.
+class Scene
+{
+public:
+	typedef uint32_t ObjectId;
+
+	static const uint32_t LeafSize = 16;
+
+	struct Statistics
+	{
+		uint32_t NodesVisited;
+		uint32_t ObjectsTested; //tested one by one in leaves the frustum cuts through
+		uint32_t ObjectsAccepted; //output with their whole node, without a test
+		uint32_t Visible;
+	};
+
+	Scene() : m_Dirty(false) { ZeroStatistics(); }
+
+	void Clear()
+	{
+		m_Bounds.clear();
+		m_UserData.clear();
+		m_SlotOf.clear();
+		m_ObjectOf.clear();
+		m_Nodes.clear();
+		m_Dirty = false;
+	}
+
+	//userData is handed back by GetUserData, a draw or mesh index for instance. Call Build once all are added.
+	ObjectId Add(const SceneBounds& bounds, uint32_t userData)
+	{
+		ObjectId id = static_cast<ObjectId>(m_Bounds.size());
+		m_Bounds.push_back(bounds);
+		m_UserData.push_back(userData);
+		m_Nodes.clear();
+		return id;
+	}
+
+	void SetBounds(ObjectId id, const SceneBounds& bounds)
+	{
+		m_Bounds[id] = bounds;
+		if (!m_Nodes.empty())
+		{
+			StoreSlot(m_SlotOf[id], bounds);
+			m_Dirty = true;
+		}
+	}
+
+	const SceneBounds& GetBounds(ObjectId id) const { return m_Bounds[id]; }
+	uint32_t GetUserData(ObjectId id) const { return m_UserData[id]; }
+	uint32_t GetObjectCount() const { return static_cast<uint32_t>(m_Bounds.size()); }
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_Nodes.size()); }
+
+	//builds the hierarchy, median splits along the longest axis of the centers
+	void Build()
+	{
+		uint32_t count = GetObjectCount();
+		m_ObjectOf.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			m_ObjectOf[i] = i;
+		}
+		m_Nodes.clear();
+		m_Nodes.reserve(count ? 2 * (count / (LeafSize / 2) + 1) : 0);
+		if (count)
+		{
+			m_Nodes.push_back(Node());
+			BuildNode(0, 0, count);
+		}
+
+		//padded so the last group of 4 of any leaf can be loaded whole, the padding lanes are masked off
+		uint32_t padded = count + 3;
+		for (auto* array : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ, &m_Radius })
+		{
+			array->assign(padded, 0.0f);
+		}
+		m_SlotOf.resize(count);
+		for (uint32_t slot = 0; slot < count; ++slot)
+		{
+			m_SlotOf[m_ObjectOf[slot]] = slot;
+			StoreSlot(slot, m_Bounds[m_ObjectOf[slot]]);
+		}
+		m_Dirty = false;
+	}
+
+	//recomputes the node bounds after SetBounds, children are always after their parent so a reverse walk does it
+	void Refit()
+	{
+		if (!m_Dirty)
+		{
+			return;
+		}
+		for (size_t n = m_Nodes.size(); n-- > 0;)
+		{
+			Node& node = m_Nodes[n];
+			if (node.Count)
+			{
+				FitLeaf(node);
+			}
+			else
+			{
+				const Node& a = m_Nodes[node.First];
+				const Node& b = m_Nodes[node.First + 1];
+				for (int i = 0; i < 3; ++i)
+				{
+					node.Min[i] = std::min(a.Min[i], b.Min[i]);
+					node.Max[i] = std::max(a.Max[i], b.Max[i]);
+				}
+			}
+		}
+		m_Dirty = false;
+	}
+
+	//fills visible with the ids of the objects in the frustum, in hierarchy order. With a pool the top subtrees
+	//are split into jobs; the calling thread takes jobs as well, so it never waits on unrelated work in the pool.
+	void Cull(const Frustum& frustum, std::vector<ObjectId>& visible, WorkerPool* pool = nullptr)
+	{
+		assert(!m_Dirty && (m_Nodes.size() || m_Bounds.empty()));
+		visible.clear();
+		ZeroStatistics();
+		if (m_Nodes.empty())
+		{
+			return;
+		}
+
+		if (!pool || pool->GetThreadCount() == 0)
+		{
+			CullNode(frustum, 0, AllPlanes, visible, m_Stats);
+			m_Stats.Visible = static_cast<uint32_t>(visible.size());
+			return;
+		}
+
+		//subtrees of the same depth, a few per thread so uneven ones still balance
+		std::vector<uint32_t> roots(1, 0);
+		uint32_t wanted = (pool->GetThreadCount() + 1) * 4;
+		while (roots.size() < wanted)
+		{
+			std::vector<uint32_t> next;
+			for (uint32_t root : roots)
+			{
+				if (m_Nodes[root].Count)
+				{
+					next.push_back(root);
+				}
+				else
+				{
+					next.push_back(m_Nodes[root].First);
+					next.push_back(m_Nodes[root].First + 1);
+				}
+			}
+			if (next.size() == roots.size())
+			{
+				break;
+			}
+			roots.swap(next);
+		}
+
+		std::shared_ptr<CullJobs> jobs(new CullJobs(this, frustum, roots));
+		uint32_t helpers = std::min<uint32_t>(pool->GetThreadCount(), static_cast<uint32_t>(roots.size()) - 1);
+		for (uint32_t i = 0; i < helpers; ++i)
+		{
+			pool->Submit([jobs]() { jobs->Run(); });
+		}
+		jobs->Run();
+		while (jobs->Done.load(std::memory_order_acquire) != roots.size())
+		{
+			std::this_thread::yield();
+		}
+
+		for (size_t i = 0; i < roots.size(); ++i)
+		{
+			visible.insert(visible.end(), jobs->Visible[i].begin(), jobs->Visible[i].end());
+			m_Stats.NodesVisited += jobs->Stats[i].NodesVisited;
+			m_Stats.ObjectsTested += jobs->Stats[i].ObjectsTested;
+			m_Stats.ObjectsAccepted += jobs->Stats[i].ObjectsAccepted;
+		}
+		m_Stats.Visible = static_cast<uint32_t>(visible.size());
+	}
+
+	//every object tested against every plane, without the hierarchy. For reference and benchmarks.
+	void CullBruteForce(const Frustum& frustum, std::vector<ObjectId>& visible) const
+	{
+		visible.clear();
+		TestObjects(frustum, AllPlanes, 0, GetObjectCount(), visible);
+	}
+
+	const Statistics& GetStatistics() const { return m_Stats; }
+
+private:
+	static const uint32_t AllPlanes = (1u << Frustum::PlaneCount) - 1;
+
+	struct Node
+	{
+		float Min[3];
+		float Max[3];
+		uint32_t First; //first slot of a leaf, or the first of two consecutive children
+		uint32_t Count; //objects in a leaf, 0 for inner nodes
+	};
+
+	struct CullJobs
+	{
+		CullJobs(Scene* scene, const Frustum& frustum, const std::vector<uint32_t>& roots)
+			: Owner(scene), Planes(frustum), Roots(roots), Visible(roots.size()), Stats(roots.size()), Next(0), Done(0) {}
+
+		void Run()
+		{
+			for (;;)
+			{
+				uint32_t job = Next.fetch_add(1, std::memory_order_relaxed);
+				if (job >= Roots.size())
+				{
+					return;
+				}
+				Statistics& stats = Stats[job];
+				memset(&stats, 0, sizeof(stats));
+				Owner->CullNode(Planes, Roots[job], AllPlanes, Visible[job], stats);
+				Done.fetch_add(1, std::memory_order_release);
+			}
+		}
+
+		Scene* Owner;
+		Frustum Planes;
+		std::vector<uint32_t> Roots;
+		std::vector<std::vector<ObjectId>> Visible;
+		std::vector<Statistics> Stats;
+		std::atomic<uint32_t> Next;
+		std::atomic<uint32_t> Done;
+	};
+
+	void ZeroStatistics() { memset(&m_Stats, 0, sizeof(m_Stats)); }
+
+	void StoreSlot(uint32_t slot, const SceneBounds& bounds)
+	{
+		m_CenterX[slot] = bounds.Center[0];
+		m_CenterY[slot] = bounds.Center[1];
+		m_CenterZ[slot] = bounds.Center[2];
+		m_ExtentX[slot] = bounds.Extents[0];
+		m_ExtentY[slot] = bounds.Extents[1];
+		m_ExtentZ[slot] = bounds.Extents[2];
+		m_Radius[slot] = bounds.Radius;
+	}
+
+	void FitLeaf(Node& node) const
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			node.Min[i] = INFINITY;
+			node.Max[i] = -INFINITY;
+		}
+		const float* centers[3] = { m_CenterX.data(), m_CenterY.data(), m_CenterZ.data() };
+		const float* extents[3] = { m_ExtentX.data(), m_ExtentY.data(), m_ExtentZ.data() };
+		for (uint32_t slot = node.First; slot < node.First + node.Count; ++slot)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				node.Min[i] = std::min(node.Min[i], centers[i][slot] - extents[i][slot]);
+				node.Max[i] = std::max(node.Max[i], centers[i][slot] + extents[i][slot]);
+			}
+		}
+	}
+
+	//m_ObjectOf[first, first + count) are the node's objects, reordered in place
+	void BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count)
+	{
+		float boundsMin[3] = { INFINITY, INFINITY, INFINITY }, boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		float centerMin[3] = { INFINITY, INFINITY, INFINITY }, centerMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			const SceneBounds& bounds = m_Bounds[m_ObjectOf[i]];
+			for (int a = 0; a < 3; ++a)
+			{
+				boundsMin[a] = std::min(boundsMin[a], bounds.Center[a] - bounds.Extents[a]);
+				boundsMax[a] = std::max(boundsMax[a], bounds.Center[a] + bounds.Extents[a]);
+				centerMin[a] = std::min(centerMin[a], bounds.Center[a]);
+				centerMax[a] = std::max(centerMax[a], bounds.Center[a]);
+			}
+		}
+		Node& node = m_Nodes[nodeIndex];
+		for (int a = 0; a < 3; ++a)
+		{
+			node.Min[a] = boundsMin[a];
+			node.Max[a] = boundsMax[a];
+		}
+
+		if (count <= LeafSize)
+		{
+			node.First = first;
+			node.Count = count;
+			return;
+		}
+
+		int axis = 0;
+		for (int a = 1; a < 3; ++a)
+		{
+			if (centerMax[a] - centerMin[a] > centerMax[axis] - centerMin[axis])
+			{
+				axis = a;
+			}
+		}
+		uint32_t half = count / 2;
+		std::nth_element(m_ObjectOf.begin() + first, m_ObjectOf.begin() + first + half, m_ObjectOf.begin() + first + count,
+			[this, axis](uint32_t a, uint32_t b) { return m_Bounds[a].Center[axis] < m_Bounds[b].Center[axis]; });
+
+		uint32_t children = static_cast<uint32_t>(m_Nodes.size());
+		node.First = children;
+		node.Count = 0;
+		m_Nodes.push_back(Node()); //invalidates node
+		m_Nodes.push_back(Node());
+		BuildNode(children, first, half);
+		BuildNode(children + 1, first + half, count - half);
+	}
+
+	//planes is the mask of planes the node isn't known to be inside of yet
+	void CullNode(const Frustum& frustum, uint32_t nodeIndex, uint32_t planes, std::vector<ObjectId>& visible, Statistics& stats) const
+	{
+		const Node& node = m_Nodes[nodeIndex];
+		++stats.NodesVisited;
+
+		float center[3], extents[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			center[a] = (node.Min[a] + node.Max[a]) * 0.5f;
+			extents[a] = (node.Max[a] - node.Min[a]) * 0.5f;
+		}
+		for (uint32_t p = 0; p < Frustum::PlaneCount; ++p)
+		{
+			if (!(planes & (1u << p)))
+			{
+				continue;
+			}
+			float distance = frustum.NX[p] * center[0] + frustum.NY[p] * center[1] + frustum.NZ[p] * center[2] + frustum.D[p];
+			float reach = fabsf(frustum.NX[p]) * extents[0] + fabsf(frustum.NY[p]) * extents[1] + fabsf(frustum.NZ[p]) * extents[2];
+			if (distance < -reach)
+			{
+				return;
+			}
+			if (distance >= reach)
+			{
+				planes &= ~(1u << p);
+			}
+		}
+
+		if (node.Count)
+		{
+			if (!planes)
+			{
+				for (uint32_t slot = node.First; slot < node.First + node.Count; ++slot)
+				{
+					visible.push_back(m_ObjectOf[slot]);
+				}
+				stats.ObjectsAccepted += node.Count;
+			}
+			else
+			{
+				TestObjects(frustum, planes, node.First, node.Count, visible);
+				stats.ObjectsTested += node.Count;
+			}
+			return;
+		}
+		CullNode(frustum, node.First, planes, visible, stats);
+		CullNode(frustum, node.First + 1, planes, visible, stats);
+	}
+
+	//an object is outside a plane when its center is further out than the smaller of its radius and the
+	//box's extent along the plane normal
+	void TestObjects(const Frustum& frustum, uint32_t planes, uint32_t first, uint32_t count, std::vector<ObjectId>& visible) const
+	{
+#if SCENE_CULL_SSE
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		uint32_t end = first + count;
+		for (uint32_t slot = first; slot < end; slot += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&m_CenterX[slot]);
+			__m128 cy = _mm_loadu_ps(&m_CenterY[slot]);
+			__m128 cz = _mm_loadu_ps(&m_CenterZ[slot]);
+			__m128 ex = _mm_loadu_ps(&m_ExtentX[slot]);
+			__m128 ey = _mm_loadu_ps(&m_ExtentY[slot]);
+			__m128 ez = _mm_loadu_ps(&m_ExtentZ[slot]);
+			__m128 radius = _mm_loadu_ps(&m_Radius[slot]);
+			__m128 outside = _mm_setzero_ps();
+			for (uint32_t p = 0; p < Frustum::PlaneCount; ++p)
+			{
+				if (!(planes & (1u << p)))
+				{
+					continue;
+				}
+				__m128 nx = _mm_set1_ps(frustum.NX[p]);
+				__m128 ny = _mm_set1_ps(frustum.NY[p]);
+				__m128 nz = _mm_set1_ps(frustum.NZ[p]);
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(frustum.D[p])));
+				__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+					_mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+				reach = _mm_min_ps(reach, radius);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_xor_ps(reach, signMask)));
+			}
+			uint32_t inside = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xf;
+			if (end - slot < 4)
+			{
+				inside &= (1u << (end - slot)) - 1;
+			}
+			while (inside)
+			{
+				uint32_t lane = 0;
+				while (!(inside & (1u << lane)))
+				{
+					++lane;
+				}
+				inside &= inside - 1;
+				visible.push_back(m_ObjectOf[slot + lane]);
+			}
+		}
+#else
+		for (uint32_t slot = first; slot < first + count; ++slot)
+		{
+			bool outside = false;
+			for (uint32_t p = 0; p < Frustum::PlaneCount && !outside; ++p)
+			{
+				if (!(planes & (1u << p)))
+				{
+					continue;
+				}
+				float distance = frustum.NX[p] * m_CenterX[slot] + frustum.NY[p] * m_CenterY[slot] + frustum.NZ[p] * m_CenterZ[slot] + frustum.D[p];
+				float reach = fabsf(frustum.NX[p]) * m_ExtentX[slot] + fabsf(frustum.NY[p]) * m_ExtentY[slot] + fabsf(frustum.NZ[p]) * m_ExtentZ[slot];
+				outside = distance < -std::min(reach, m_Radius[slot]);
+			}
+			if (!outside)
+			{
+				visible.push_back(m_ObjectOf[slot]);
+			}
+		}
+#endif
+	}
+
+	//as added, by id
+	std::vector<SceneBounds> m_Bounds;
+	std::vector<uint32_t> m_UserData;
+
+	//by slot, the order of the hierarchy's leaves
+	std::vector<float> m_CenterX;
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_ExtentX;
+	std::vector<float> m_ExtentY;
+	std::vector<float> m_ExtentZ;
+	std::vector<float> m_Radius;
+	std::vector<ObjectId> m_ObjectOf;
+	std::vector<uint32_t> m_SlotOf; //by id
+
+	std::vector<Node> m_Nodes; //root first
+	bool m_Dirty; //bounds changed since the nodes were fitted
+	Statistics m_Stats;
+};
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+
+#include "workerpool.h"
+
+//one feature axis of a shader, compiled as "#define Name Values[i]".
+//A boolean feature is just an axis with the values "0" and "1".
+struct ShaderFeatureAxis
+{
+	std::string Name;
+	std::vector<std::string> Values;
+	uint32_t Shift;
+	uint32_t Bits;
+};
+
+//describes every feature axis of a shader and packs the selected value of each axis into a 64 bit key.
+//Each axis gets just enough bits to hold the index of its last value, so the keys stay dense.
+class ShaderPermutationKeySpace
+{
+public:
+	ShaderPermutationKeySpace() : m_TotalBits(0) {}
+
+	//returns the index of the new axis, value index 0 is the default of the axis.
+	uint32_t AddAxis(const std::string& name, const std::vector<std::string>& values)
+	{
+		assert(!values.empty());
+
+		ShaderFeatureAxis axis;
+		axis.Name = name;
+		axis.Values = values;
+		axis.Shift = m_TotalBits;
+		axis.Bits = 0;
+		while ((size_t(1) << axis.Bits) < values.size())
+		{
+			++axis.Bits;
+		}
+
+		m_TotalBits += axis.Bits;
+		assert(m_TotalBits <= 64);
+
+		m_Axes.push_back(axis);
+		return static_cast<uint32_t>(m_Axes.size() - 1);
+	}
+
+	uint32_t AddBoolAxis(const std::string& name)
+	{
+		return AddAxis(name, { "0", "1" });
+	}
+
+	//returns key with the value of the given axis replaced.
+	uint64_t Set(uint64_t key, uint32_t axisIndex, uint32_t valueIndex) const
+	{
+		const ShaderFeatureAxis& axis = m_Axes[axisIndex];
+		assert(valueIndex < axis.Values.size());
+		return (key & ~(AxisMask(axis) << axis.Shift)) | (uint64_t(valueIndex) << axis.Shift);
+	}
+
+	uint32_t Get(uint64_t key, uint32_t axisIndex) const
+	{
+		const ShaderFeatureAxis& axis = m_Axes[axisIndex];
+		return static_cast<uint32_t>((key >> axis.Shift) & AxisMask(axis));
+	}
+
+	//a key is valid when no bits beyond the last axis are set and every axis selects an existing value.
+	bool IsValid(uint64_t key) const
+	{
+		if (m_TotalBits < 64 && (key >> m_TotalBits) != 0)
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < m_Axes.size(); ++i)
+		{
+			if (Get(key, i) >= m_Axes[i].Values.size())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//number of distinct valid keys, i.e. the cost of compiling every permutation up front.
+	uint64_t GetVariantCount() const
+	{
+		uint64_t count = 1;
+		for (const auto& axis : m_Axes)
+		{
+			count *= axis.Values.size();
+		}
+		return count;
+	}
+
+	//name/value pairs of the macros to compile the variant with, one per axis.
+	std::vector<std::pair<std::string, std::string>> GetDefines(uint64_t key) const
+	{
+		assert(IsValid(key));
+		std::vector<std::pair<std::string, std::string>> defines;
+		defines.reserve(m_Axes.size());
+		for (uint32_t i = 0; i < m_Axes.size(); ++i)
+		{
+			defines.emplace_back(m_Axes[i].Name, m_Axes[i].Values[Get(key, i)]);
+		}
+		return defines;
+	}
+
+	//human readable key, e.g. "USE_TEXTURE=1 LIGHTS=4", for logging compile errors.
+	std::string GetKeyString(uint64_t key) const
+	{
+		std::string result;
+		for (const auto& define : GetDefines(key))
+		{
+			if (!result.empty())
+			{
+				result += ' ';
+			}
+			result += define.first + "=" + define.second;
+		}
+		return result;
+	}
+
+	uint32_t GetAxisCount() const { return static_cast<uint32_t>(m_Axes.size()); }
+	const ShaderFeatureAxis& GetAxis(uint32_t index) const { return m_Axes[index]; }
+	uint32_t GetTotalBits() const { return m_TotalBits; }
+
+private:
+	static uint64_t AxisMask(const ShaderFeatureAxis& axis)
+	{
+		return axis.Bits >= 64 ? ~uint64_t(0) : ((uint64_t(1) << axis.Bits) - 1);
+	}
+
+	std::vector<ShaderFeatureAxis> m_Axes;
+	uint32_t m_TotalBits;
+};
+
+//thread safe map of compiled variants keyed by permutation key.
+//Variants are only compiled when first requested. Request() never blocks: a miss queues the compile
+//on the worker pool and returns null so the caller can skip the draw or use a fallback for that frame.
+//A compile that returns null is remembered as failed and is not retried. Keys the key space given to Create
+//doesn't hold are rejected with null before anything is compiled or cached.
+template<typename Variant>
+class ShaderVariantCache
+{
+public:
+	typedef std::function<std::shared_ptr<Variant>(uint64_t key)> CompileFunc;
+
+	ShaderVariantCache() : m_Pool(nullptr), m_KeySpace(nullptr) {}
+
+	//pool may be null, misses are then compiled inline by the requesting thread.
+	//keySpace may be null when the keys aren't permutation keys, it has to outlive the cache otherwise.
+	void Create(CompileFunc compile, WorkerPool* pool, const ShaderPermutationKeySpace* keySpace = nullptr)
+	{
+		m_Compile = compile;
+		m_Pool = pool;
+		m_KeySpace = keySpace;
+	}
+
+	std::shared_ptr<Variant> Request(uint64_t key)
+	{
+		if (!IsValidKey(key))
+		{
+			return nullptr;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			auto it = m_Entries.find(key);
+			if (it != m_Entries.end())
+			{
+				return it->second.Value;
+			}
+			m_Entries[key].State = EntryState::Pending;
+		}
+
+		if (m_Pool)
+		{
+			m_Pool->Submit([this, key]() { Compile(key); });
+		}
+		else
+		{
+			Compile(key);
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Entries[key].Value;
+	}
+
+	//used at load time when the variant is required before the first frame.
+	std::shared_ptr<Variant> RequestBlocking(uint64_t key)
+	{
+		if (!IsValidKey(key))
+		{
+			return nullptr;
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			auto it = m_Entries.find(key);
+			if (it != m_Entries.end())
+			{
+				//already queued or compiled, wait for whoever owns the compile to finish it.
+				m_Compiled.wait(lock, [this, key]() { return m_Entries[key].State != EntryState::Pending; });
+				return m_Entries[key].Value;
+			}
+			m_Entries[key].State = EntryState::Pending;
+		}
+
+		Compile(key);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Entries[key].Value;
+	}
+
+	bool IsReady(uint64_t key) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_Entries.find(key);
+		return it != m_Entries.end() && it->second.State == EntryState::Ready;
+	}
+
+	bool HasFailed(uint64_t key) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_Entries.find(key);
+		return it != m_Entries.end() && it->second.State == EntryState::Failed;
+	}
+
+	size_t GetCount(bool pendingOnly = false) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!pendingOnly)
+		{
+			return m_Entries.size();
+		}
+		size_t count = 0;
+		for (const auto& entry : m_Entries)
+		{
+			count += (entry.second.State == EntryState::Pending) ? 1 : 0;
+		}
+		return count;
+	}
+
+private:
+	enum class EntryState { Pending, Ready, Failed };
+
+	struct Entry
+	{
+		Entry() : State(EntryState::Pending) {}
+		EntryState State;
+		std::shared_ptr<Variant> Value;
+	};
+
+	bool IsValidKey(uint64_t key) const
+	{
+		bool valid = !m_KeySpace || m_KeySpace->IsValid(key);
+		assert(valid);
+		return valid;
+	}
+
+	void Compile(uint64_t key)
+	{
+		std::shared_ptr<Variant> value = m_Compile(key);
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			Entry& entry = m_Entries[key];
+			entry.Value = value;
+			entry.State = value ? EntryState::Ready : EntryState::Failed;
+		}
+		m_Compiled.notify_all();
+	}
+
+	CompileFunc m_Compile;
+	WorkerPool* m_Pool;
+	const ShaderPermutationKeySpace* m_KeySpace;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Compiled;
+	std::unordered_map<uint64_t, Entry> m_Entries;
+};
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "d3d12types.h"
+#include "mappedfile.h"
+
+//cooked texture, laid out the way the copy queue reads it so loading is one copy of the whole data into staging:
+//
+//  TextureFileHeader | TextureFileFootprint[SubresourceCount] | data
+//
+//The data starts on a page and holds every subresource in D3D12 subresource order, each at a multiple of
+//D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT from the start of the data with rows D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+//apart, which are the placed footprints GetCopyableFootprints returns for the texture. Copied to an upload buffer
+//offset aligned to the placement alignment, or mapped from the file in place, the footprints only need that offset
+//added. A reader recomputes the footprints from the header and rejects a file that disagrees, so the layout rules
+//can't drift between the cooker and the loader. The structs are read in place, little endian.
+const uint32_t TextureFileMagic = 0x58455447; //"GTEX"
+const uint32_t TextureFileVersion = 1;
+const uint32_t TextureFileDataAlignment = 4096;
+
+struct TextureFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t FileSize;
+	uint32_t Dimension; //D3D12_RESOURCE_DIMENSION_TEXTURE2D or D3D12_RESOURCE_DIMENSION_TEXTURE3D
+	uint32_t Format; //DXGI_FORMAT
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t DepthOrArraySize;
+	uint32_t MipLevels;
+	uint32_t SubresourceCount;
+	uint32_t FootprintsOffset;
+	uint64_t DataOffset;
+	uint64_t DataSize;
+};
+static_assert(sizeof(TextureFileHeader) == 64, "TextureFileHeader is read in place");
+
+//a D3D12_PLACED_SUBRESOURCE_FOOTPRINT with the row count and size GetCopyableFootprints also returns
+struct TextureFileFootprint
+{
+	uint64_t Offset; //from the start of the data
+	uint32_t Format;
+	uint32_t Width; //in texels, a whole number of blocks for block compressed formats
+	uint32_t Height;
+	uint32_t Depth;
+	uint32_t RowPitch;
+	uint32_t RowCount; //rows of blocks per depth slice
+	uint32_t RowSize; //bytes of a row without the pitch padding
+	uint32_t Reserved;
+};
+static_assert(sizeof(TextureFileFootprint) == 40, "TextureFileFootprint is read in place");
+
+//texels per block side and bytes per block, 1 and the texel size for uncompressed formats
+struct TextureFormatInfo
+{
+	uint32_t BlockSize;
+	uint32_t BytesPerBlock;
+};
+
+//zero for the formats the cooker doesn't handle: planar, packed and depth formats
+inline TextureFormatInfo GetTextureFormatInfo(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return { 1, 16 };
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return { 1, 8 };
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_R8G8B8A8_SNORM:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R16G16_SNORM:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		return { 1, 4 };
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_SNORM:
+		return { 1, 2 };
+	case DXGI_FORMAT_R8_UNORM:
+		return { 1, 1 };
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return { 4, 8 };
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return { 4, 16 };
+	default:
+		return { 0, 0 };
+	}
+}
+
+//the size of a texture's data and the placed footprints of its subresources, what GetCopyableFootprints returns
+//for the resource at offset 0 except that every subresource takes whole rows to its end. 0 for a texture the
+//file can't describe; footprints holds MipLevels * (3D ? 1 : DepthOrArraySize) entries and may be null.
+inline uint64_t ComputeTextureFootprints(uint32_t dimension, DXGI_FORMAT format, uint32_t width, uint32_t height,
+	uint32_t depthOrArraySize, uint32_t mipLevels, TextureFileFootprint* footprints)
+{
+	TextureFormatInfo info = GetTextureFormatInfo(format);
+	bool volume = dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+	if (!info.BlockSize || (!volume && dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D) || !width || !height ||
+		!depthOrArraySize || depthOrArraySize > 0xffff || !mipLevels || mipLevels > 16 ||
+		(std::max(std::max(width, height), volume ? depthOrArraySize : 1u) >> (mipLevels - 1)) == 0)
+	{
+		return 0;
+	}
+	uint32_t arraySize = volume ? 1 : depthOrArraySize;
+	uint64_t offset = 0;
+	for (uint32_t slice = 0; slice < arraySize; ++slice)
+	{
+		for (uint32_t mip = 0; mip < mipLevels; ++mip)
+		{
+			uint32_t mipWidth = std::max(1u, width >> mip);
+			uint32_t mipHeight = std::max(1u, height >> mip);
+			uint32_t mipDepth = volume ? std::max(1u, depthOrArraySize >> mip) : 1;
+			uint32_t blocksWide = (mipWidth + info.BlockSize - 1) / info.BlockSize;
+			uint32_t blocksHigh = (mipHeight + info.BlockSize - 1) / info.BlockSize;
+
+			TextureFileFootprint footprint = {};
+			footprint.Offset = (offset + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) / D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT * D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+			footprint.Format = format;
+			footprint.Width = blocksWide * info.BlockSize;
+			footprint.Height = blocksHigh * info.BlockSize;
+			footprint.Depth = mipDepth;
+			footprint.RowSize = blocksWide * info.BytesPerBlock;
+			footprint.RowPitch = (footprint.RowSize + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) / D3D12_TEXTURE_DATA_PITCH_ALIGNMENT * D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+			footprint.RowCount = blocksHigh;
+			if (footprints)
+			{
+				footprints[slice * mipLevels + mip] = footprint;
+			}
+			offset = footprint.Offset + uint64_t(footprint.RowPitch) * footprint.RowCount * footprint.Depth;
+		}
+	}
+	return offset;
+}
+
+//what a cooker writes: the subresources tightly packed in subresource order, array slices of all their mips one
+//after the other and the depth slices of a mip together, as DDS files store them
+struct TextureFileContents
+{
+	uint32_t Dimension;
+	DXGI_FORMAT Format;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t DepthOrArraySize;
+	uint32_t MipLevels;
+	const void* Data;
+	size_t DataSize;
+};
+
+//the complete file for contents, appended to image
+inline HRESULT BuildTextureFile(const TextureFileContents& contents, std::vector<uint8_t>& image)
+{
+	uint64_t dataSize = ComputeTextureFootprints(contents.Dimension, contents.Format, contents.Width, contents.Height, contents.DepthOrArraySize, contents.MipLevels, nullptr);
+	if (!dataSize || !contents.Data)
+	{
+		return E_INVALIDARG;
+	}
+	uint32_t subresourceCount = contents.MipLevels * (contents.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : contents.DepthOrArraySize);
+	std::vector<TextureFileFootprint> footprints(subresourceCount);
+	ComputeTextureFootprints(contents.Dimension, contents.Format, contents.Width, contents.Height, contents.DepthOrArraySize, contents.MipLevels, footprints.data());
+	uint64_t packedSize = 0;
+	for (const TextureFileFootprint& footprint : footprints)
+	{
+		packedSize += uint64_t(footprint.RowSize) * footprint.RowCount * footprint.Depth;
+	}
+	if (packedSize != contents.DataSize)
+	{
+		return E_INVALIDARG;
+	}
+
+	TextureFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Magic = TextureFileMagic;
+	header.Version = TextureFileVersion;
+	header.Dimension = contents.Dimension;
+	header.Format = contents.Format;
+	header.Width = contents.Width;
+	header.Height = contents.Height;
+	header.DepthOrArraySize = contents.DepthOrArraySize;
+	header.MipLevels = contents.MipLevels;
+	header.SubresourceCount = subresourceCount;
+	header.FootprintsOffset = sizeof(TextureFileHeader);
+	header.DataOffset = (sizeof(TextureFileHeader) + footprints.size() * sizeof(TextureFileFootprint) + TextureFileDataAlignment - 1) / TextureFileDataAlignment * TextureFileDataAlignment;
+	header.DataSize = dataSize;
+	header.FileSize = header.DataOffset + dataSize;
+
+	//the pitch padding and the gaps between subresources stay zero
+	size_t base = image.size();
+	image.resize(base + static_cast<size_t>(header.FileSize), 0);
+	memcpy(&image[base], &header, sizeof(header));
+	memcpy(&image[base + header.FootprintsOffset], footprints.data(), footprints.size() * sizeof(TextureFileFootprint));
+	const uint8_t* source = static_cast<const uint8_t*>(contents.Data);
+	uint8_t* data = &image[base + static_cast<size_t>(header.DataOffset)];
+	for (const TextureFileFootprint& footprint : footprints)
+	{
+		uint8_t* target = data + footprint.Offset;
+		for (uint32_t row = 0; row < footprint.RowCount * footprint.Depth; ++row)
+		{
+			memcpy(target + size_t(row) * footprint.RowPitch, source, footprint.RowSize);
+			source += footprint.RowSize;
+		}
+	}
+	return S_OK;
+}
+
+inline HRESULT SaveTextureFile(const char* fileName, const TextureFileContents& contents)
+{
+	std::vector<uint8_t> image;
+	HRESULT hr = BuildTextureFile(contents, image);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+	FILE* file = fopen(fileName, "wb");
+	if (!file)
+	{
+		return E_FAIL;
+	}
+	bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+	written = fclose(file) == 0 && written;
+	return written ? S_OK : E_FAIL;
+}
+
+//a cooked texture, mapped by Open or already in memory through Attach. Loading checks the header and that the
+//footprints are the ones the header's texture has; the data is never touched, so everything returned points into
+//the image and is valid until Close.
+class TextureFile
+{
+public:
+	TextureFile() { Close(); }
+
+	HRESULT Open(const char* fileName)
+	{
+		Close();
+		HRESULT hr = m_File.Open(fileName);
+		if (SUCCEEDED(hr))
+		{
+			hr = Attach(m_File.GetData(), m_File.GetSize());
+		}
+		if (SUCCEEDED(hr))
+		{
+			//the data is about to be copied to staging whole, have the OS read it in ahead of the copy
+			m_File.Prefetch(static_cast<size_t>(m_Header->DataOffset), static_cast<size_t>(m_Header->DataSize));
+		}
+		else
+		{
+			Close();
+		}
+		return hr;
+	}
+
+	//image must stay valid until Close
+	HRESULT Attach(const void* image, size_t size)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(image);
+		if (!data || size < sizeof(TextureFileHeader))
+		{
+			return E_FAIL;
+		}
+		const TextureFileHeader* header = reinterpret_cast<const TextureFileHeader*>(data);
+		if (header->Magic != TextureFileMagic || header->Version != TextureFileVersion || header->FileSize != size ||
+			header->FootprintsOffset % 8 || header->FootprintsOffset > size ||
+			header->SubresourceCount > (size - header->FootprintsOffset) / sizeof(TextureFileFootprint) ||
+			header->DataOffset % TextureFileDataAlignment || header->DataOffset > size || header->DataSize != size - header->DataOffset)
+		{
+			return E_FAIL;
+		}
+
+		uint32_t subresourceCount = header->MipLevels * (header->Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : header->DepthOrArraySize);
+		if (subresourceCount != header->SubresourceCount)
+		{
+			return E_FAIL;
+		}
+		std::vector<TextureFileFootprint> expected(subresourceCount);
+		uint64_t dataSize = ComputeTextureFootprints(header->Dimension, static_cast<DXGI_FORMAT>(header->Format), header->Width, header->Height,
+			header->DepthOrArraySize, header->MipLevels, expected.data());
+		const TextureFileFootprint* footprints = reinterpret_cast<const TextureFileFootprint*>(data + header->FootprintsOffset);
+		if (!dataSize || dataSize != header->DataSize || memcmp(footprints, expected.data(), expected.size() * sizeof(TextureFileFootprint)))
+		{
+			return E_FAIL;
+		}
+
+		m_Header = header;
+		m_Footprints = footprints;
+		m_Data = data + header->DataOffset;
+		return S_OK;
+	}
+
+	void Close()
+	{
+		m_File.Close();
+		m_Header = nullptr;
+		m_Footprints = nullptr;
+		m_Data = nullptr;
+	}
+
+	const TextureFileHeader& GetHeader() const { return *m_Header; }
+	uint32_t GetSubresourceCount() const { return m_Header->SubresourceCount; }
+	const TextureFileFootprint& GetFootprint(uint32_t subresource) const { return m_Footprints[subresource]; }
+	//starts on a page, copy it whole to a multiple of D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+	const void* GetData() const { return m_Data; }
+	uint64_t GetDataSize() const { return m_Header->DataSize; }
+
+	//the footprint of the subresource for data copied to baseOffset in a buffer
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT GetPlacedFootprint(uint32_t subresource, uint64_t baseOffset) const
+	{
+		const TextureFileFootprint& footprint = m_Footprints[subresource];
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT placed;
+		placed.Offset = baseOffset + footprint.Offset;
+		placed.Footprint.Format = static_cast<DXGI_FORMAT>(footprint.Format);
+		placed.Footprint.Width = footprint.Width;
+		placed.Footprint.Height = footprint.Height;
+		placed.Footprint.Depth = footprint.Depth;
+		placed.Footprint.RowPitch = footprint.RowPitch;
+		return placed;
+	}
+
+	D3D12_RESOURCE_DESC GetResourceDesc() const
+	{
+		D3D12_RESOURCE_DESC desc;
+		memset(&desc, 0, sizeof(desc));
+		desc.Dimension = static_cast<D3D12_RESOURCE_DIMENSION>(m_Header->Dimension);
+		desc.Width = m_Header->Width;
+		desc.Height = m_Header->Height;
+		desc.DepthOrArraySize = static_cast<UINT16>(m_Header->DepthOrArraySize);
+		desc.MipLevels = static_cast<UINT16>(m_Header->MipLevels);
+		desc.Format = static_cast<DXGI_FORMAT>(m_Header->Format);
+		desc.SampleDesc.Count = 1;
+		desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+		return desc;
+	}
+
+private:
+	MappedFile m_File;
+	const TextureFileHeader* m_Header;
+	const TextureFileFootprint* m_Footprints;
+	const uint8_t* m_Data;
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+#include "d3d12types.h"
+#include "texturefile.h"
+
+//DDS reading for the texture cooker. Only what a DDS says about its layout is read: the format, from the DX10
+//header or the legacy pixel format, the dimensions and the mip and array counts. Cube maps cook to 2D arrays of
+//6 faces per cube. The texture data isn't copied, contents points into the file.
+const uint32_t DDSMagic = 0x20534444; //"DDS "
+
+struct DDSPixelFormat
+{
+	uint32_t Size;
+	uint32_t Flags;
+	uint32_t FourCC;
+	uint32_t RGBBitCount;
+	uint32_t RBitMask;
+	uint32_t GBitMask;
+	uint32_t BBitMask;
+	uint32_t ABitMask;
+};
+
+struct DDSHeader
+{
+	uint32_t Size;
+	uint32_t Flags;
+	uint32_t Height;
+	uint32_t Width;
+	uint32_t PitchOrLinearSize;
+	uint32_t Depth; //with DDSVolumeFlag in Flags
+	uint32_t MipMapCount;
+	uint32_t Reserved1[11];
+	DDSPixelFormat PixelFormat;
+	uint32_t Caps;
+	uint32_t Caps2;
+	uint32_t Caps3;
+	uint32_t Caps4;
+	uint32_t Reserved2;
+};
+static_assert(sizeof(DDSHeader) == 124, "DDSHeader is read in place");
+
+struct DDSHeaderDX10
+{
+	uint32_t Format; //DXGI_FORMAT
+	uint32_t ResourceDimension; //D3D12_RESOURCE_DIMENSION
+	uint32_t MiscFlag;
+	uint32_t ArraySize;
+	uint32_t MiscFlags2;
+};
+static_assert(sizeof(DDSHeaderDX10) == 20, "DDSHeaderDX10 is read in place");
+
+const uint32_t DDSFourCCFlag = 0x4;
+const uint32_t DDSRGBFlag = 0x40;
+const uint32_t DDSLuminanceFlag = 0x20000;
+const uint32_t DDSVolumeFlag = 0x800000;
+const uint32_t DDSCubeMapCaps2 = 0x200;
+const uint32_t DDSCubeMapMiscFlag = 0x4;
+
+inline uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+	return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+//the format of a DDS without the DX10 header, unknown for what the cooker doesn't handle
+inline DXGI_FORMAT GetDDSFormat(const DDSPixelFormat& pixelFormat)
+{
+	const DDSPixelFormat& p = pixelFormat;
+	auto masks = [&p](uint32_t r, uint32_t g, uint32_t b, uint32_t a) { return p.RBitMask == r && p.GBitMask == g && p.BBitMask == b && p.ABitMask == a; };
+	if (p.Flags & DDSFourCCFlag)
+	{
+		const uint32_t fourCC = p.FourCC;
+		if (fourCC == MakeFourCC('D', 'X', 'T', '1')) return DXGI_FORMAT_BC1_UNORM;
+		if (fourCC == MakeFourCC('D', 'X', 'T', '2') || fourCC == MakeFourCC('D', 'X', 'T', '3')) return DXGI_FORMAT_BC2_UNORM;
+		if (fourCC == MakeFourCC('D', 'X', 'T', '4') || fourCC == MakeFourCC('D', 'X', 'T', '5')) return DXGI_FORMAT_BC3_UNORM;
+		if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U')) return DXGI_FORMAT_BC4_UNORM;
+		if (fourCC == MakeFourCC('B', 'C', '4', 'S')) return DXGI_FORMAT_BC4_SNORM;
+		if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U')) return DXGI_FORMAT_BC5_UNORM;
+		if (fourCC == MakeFourCC('B', 'C', '5', 'S')) return DXGI_FORMAT_BC5_SNORM;
+		//D3DFORMAT values stored as the FourCC
+		switch (fourCC)
+		{
+		case 36: return DXGI_FORMAT_R16G16B16A16_UNORM;
+		case 113: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case 114: return DXGI_FORMAT_R32_FLOAT;
+		case 116: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		default: return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+	if ((p.Flags & DDSRGBFlag) && p.RGBBitCount == 32)
+	{
+		if (masks(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return DXGI_FORMAT_R8G8B8A8_UNORM;
+		if (masks(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000)) return DXGI_FORMAT_B8G8R8A8_UNORM;
+		if (masks(0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000)) return DXGI_FORMAT_B8G8R8X8_UNORM;
+		if (masks(0x000003ff, 0x000ffc00, 0x3ff00000, 0xc0000000)) return DXGI_FORMAT_R10G10B10A2_UNORM;
+		if (masks(0x0000ffff, 0xffff0000, 0x00000000, 0x00000000)) return DXGI_FORMAT_R16G16_UNORM;
+		if (masks(0xffffffff, 0x00000000, 0x00000000, 0x00000000)) return DXGI_FORMAT_R32_FLOAT;
+	}
+	if ((p.Flags & (DDSRGBFlag | DDSLuminanceFlag)) && p.RGBBitCount == 16 && (masks(0x00ff, 0xff00, 0, 0) || masks(0x00ff, 0, 0, 0xff00)))
+	{
+		return DXGI_FORMAT_R8G8_UNORM;
+	}
+	if ((p.Flags & (DDSRGBFlag | DDSLuminanceFlag)) && p.RGBBitCount == 8 && masks(0xff, 0, 0, 0))
+	{
+		return DXGI_FORMAT_R8_UNORM;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+//contents for BuildTextureFile, pointing into the DDS in data. Fails for formats and dimensions the cooked
+//format doesn't describe and for files shorter than their subresources; 1D textures cook as 2D ones of height 1.
+inline HRESULT ParseDDS(const void* data, size_t size, TextureFileContents& contents)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint32_t magic;
+	if (!bytes || size < sizeof(magic) + sizeof(DDSHeader) || (memcpy(&magic, bytes, sizeof(magic)), magic != DDSMagic))
+	{
+		return E_FAIL;
+	}
+	DDSHeader header;
+	memcpy(&header, bytes + sizeof(magic), sizeof(header));
+	if (header.Size != sizeof(DDSHeader) || header.PixelFormat.Size != sizeof(DDSPixelFormat))
+	{
+		return E_FAIL;
+	}
+
+	size_t offset = sizeof(magic) + sizeof(DDSHeader);
+	memset(&contents, 0, sizeof(contents));
+	contents.Width = header.Width;
+	contents.Height = header.Height;
+	contents.MipLevels = header.MipMapCount ? header.MipMapCount : 1;
+	if ((header.PixelFormat.Flags & DDSFourCCFlag) && header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		DDSHeaderDX10 extension;
+		if (size < offset + sizeof(extension))
+		{
+			return E_FAIL;
+		}
+		memcpy(&extension, bytes + offset, sizeof(extension));
+		offset += sizeof(extension);
+		contents.Format = static_cast<DXGI_FORMAT>(extension.Format);
+		contents.Dimension = extension.ResourceDimension == D3D12_RESOURCE_DIMENSION_TEXTURE1D ? static_cast<uint32_t>(D3D12_RESOURCE_DIMENSION_TEXTURE2D) : extension.ResourceDimension;
+		bool volume = contents.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+		contents.DepthOrArraySize = volume ? header.Depth : extension.ArraySize * (extension.MiscFlag & DDSCubeMapMiscFlag ? 6 : 1);
+		if (volume && extension.ArraySize > 1)
+		{
+			return E_FAIL;
+		}
+	}
+	else
+	{
+		contents.Format = GetDDSFormat(header.PixelFormat);
+		bool volume = (header.Flags & DDSVolumeFlag) != 0;
+		contents.Dimension = volume ? D3D12_RESOURCE_DIMENSION_TEXTURE3D : D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		//a legacy cube map has to have all 6 faces, there is no DX10 header to say how many
+		contents.DepthOrArraySize = volume ? header.Depth : (header.Caps2 & DDSCubeMapCaps2 ? 6 : 1);
+	}
+	if (contents.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && !contents.Height)
+	{
+		contents.Height = 1;
+	}
+
+	uint32_t subresourceCount = contents.MipLevels * (contents.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : contents.DepthOrArraySize);
+	std::vector<TextureFileFootprint> footprints(contents.MipLevels <= 16 && contents.DepthOrArraySize <= 0xffff ? subresourceCount : 0);
+	if (footprints.empty() || !ComputeTextureFootprints(contents.Dimension, contents.Format, contents.Width, contents.Height,
+		contents.DepthOrArraySize, contents.MipLevels, footprints.data()))
+	{
+		return E_FAIL;
+	}
+	uint64_t packedSize = 0;
+	for (const TextureFileFootprint& footprint : footprints)
+	{
+		packedSize += uint64_t(footprint.RowSize) * footprint.RowCount * footprint.Depth;
+	}
+	if (packedSize > size - offset)
+	{
+		return E_FAIL;
+	}
+	contents.Data = bytes + offset;
+	contents.DataSize = static_cast<size_t>(packedSize);
+	return S_OK;
+}
@@ -25,6 +25,9 @@
 #include <memory>
 
 #include "helpers.h"
+#include "tracing.h"
+#include "assetarchive.h"
+#include "texturefile.h"
 
 #pragma pack(push,1)
 const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
@@ -689,6 +692,86 @@ static HRESULT FillInitData(_In_ size_t width,
 	return (index > 0) ? S_OK : E_FAIL;
 }
 
+//when set, textures are looked up in this archive by file name before falling back to the loose files
+static const AssetArchive* g_TextureArchive = nullptr;
+
+//the archive must stay open while it is set, null goes back to loose files only
+inline void SetTextureArchive(const AssetArchive* archive)
+{
+	g_TextureArchive = archive;
+}
+
+//the file name as archive entries are named, false for names that aren't plain ASCII and so never archived
+static bool GetArchiveName(const wchar_t* fileName, std::string& name)
+{
+	name.clear();
+	for (; *fileName; ++fileName)
+	{
+		if (*fileName >= 0x80)
+		{
+			return false;
+		}
+		name += static_cast<char>(*fileName);
+	}
+	return true;
+}
+
+//validates the DDS file in ddsData and points header and bitData into it
+static HRESULT ParseTextureData(const uint8_t* ddsData,
+	size_t ddsSize,
+	DirectX::DDS_HEADER** header,
+	uint8_t** bitData,
+	size_t* bitSize
+	)
+{
+	using namespace DirectX;
+
+	// Need at least enough data to fill the header and magic number to be a valid DDS
+	if (ddsSize < (sizeof(DDS_HEADER) + sizeof(uint32_t)))
+	{
+		return E_FAIL;
+	}
+
+	// DDS files always start with the same magic number ("DDS ")
+	uint32_t dwMagicNumber = *(const uint32_t*)(ddsData);
+	if (dwMagicNumber != DDS_MAGIC)
+	{
+		return E_FAIL;
+	}
+
+	auto hdr = reinterpret_cast<DDS_HEADER*>(const_cast<uint8_t*>(ddsData) + sizeof(uint32_t));
+
+	// Verify header to validate DDS file
+	if (hdr->size != sizeof(DDS_HEADER) ||
+		hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
+	{
+		return E_FAIL;
+	}
+
+	// Check for DX10 extension
+	bool bDXT10Header = false;
+	if ((hdr->ddspf.flags & DDS_FOURCC) &&
+		(MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC))
+	{
+		// Must be long enough for both headers and magic value
+		if (ddsSize < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10)))
+		{
+			return E_FAIL;
+		}
+
+		bDXT10Header = true;
+	}
+
+	// setup the pointers in the process request
+	*header = hdr;
+	ptrdiff_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER)
+		+ (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
+	*bitData = const_cast<uint8_t*>(ddsData) + offset;
+	*bitSize = ddsSize - offset;
+
+	return S_OK;
+}
+
 HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
 	std::unique_ptr<uint8_t[]>& ddsData,
 	DirectX::DDS_HEADER** header,
@@ -696,6 +779,7 @@ HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
 	size_t* bitSize
 	)
 {
+	TRACE_SCOPE("LoadTextureDataFromFile");
 	using namespace DirectX;
 
 	if (!header || !bitData || !bitSize)
@@ -703,6 +787,29 @@ HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
 		return E_POINTER;
 	}
 
+	//one decompression out of the mapped archive instead of a file open and read
+	std::string archiveName;
+	uint32_t entry = g_TextureArchive && GetArchiveName(fileName, archiveName) ? g_TextureArchive->Find(archiveName.c_str()) : AssetArchive::NotFound;
+	if (entry != AssetArchive::NotFound)
+	{
+		uint64_t size = g_TextureArchive->GetSize(entry);
+		if (size > UINT32_MAX)
+		{
+			return E_FAIL;
+		}
+		ddsData.reset(new (std::nothrow) uint8_t[static_cast<size_t>(size)]);
+		if (!ddsData)
+		{
+			return E_OUTOFMEMORY;
+		}
+		HRESULT hr = g_TextureArchive->Read(entry, ddsData.get());
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+		return ParseTextureData(ddsData.get(), static_cast<size_t>(size), header, bitData, bitSize);
+	}
+
 	ScopedHandle hFile(safe_handle(CreateFile2(fileName,
 		GENERIC_READ,
 		FILE_SHARE_READ,
@@ -760,61 +867,45 @@ HRESULT LoadTextureDataFromFile(_In_z_ const wchar_t* fileName,
 		return E_FAIL;
 	}
 
-	// DDS files always start with the same magic number ("DDS ")
-	uint32_t dwMagicNumber = *(const uint32_t*)(ddsData.get());
-	if (dwMagicNumber != DDS_MAGIC)
-	{
-		return E_FAIL;
-	}
-
-	auto hdr = reinterpret_cast<DDS_HEADER*>(ddsData.get() + sizeof(uint32_t));
-
-	// Verify header to validate DDS file
-	if (hdr->size != sizeof(DDS_HEADER) ||
-		hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
-	{
-		return E_FAIL;
-	}
-
-	// Check for DX10 extension
-	bool bDXT10Header = false;
-	if ((hdr->ddspf.flags & DDS_FOURCC) &&
-		(MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC))
-	{
-		// Must be long enough for both headers and magic value
-		if (FileSize.LowPart < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10)))
-		{
-			return E_FAIL;
-		}
-
-		bDXT10Header = true;
-	}
-
-	// setup the pointers in the process request
-	*header = hdr;
-	ptrdiff_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER)
-		+ (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
-	*bitData = ddsData.get() + offset;
-	*bitSize = FileSize.LowPart - offset;
-
-	return S_OK;
+	return ParseTextureData(ddsData.get(), FileSize.LowPart, header, bitData, bitSize);
 }
 
 //-----------------------------------------------------------------------------------------------------------------
 //Here are the D3D12 functions that were thrown together.
 //-----------------------------------------------------------------------------------------------------------------
 
-// Align uLocation to the next multiple of uAlign.
-UINT64 Align(UINT64 uLocation, UINT64 uAlign)
+//the default heap texture resource in the copy dest state, committed or placed by the allocator when there is one
+static HRESULT CreateTextureResource(_In_ ID3D12Device* d3dDevice,
+	_In_ const D3D12_RESOURCE_DESC& desc,
+	_Outptr_opt_ ID3D12Resource** resourceOut,
+	_In_opt_ GpuMemoryAllocator* allocator,
+	_Out_opt_ GpuAllocation* allocationOut)
 {
-	bool valid = true;
-	if ((0 == uAlign) || (uAlign & (uAlign - 1)))
+	if (allocator)
 	{
-		valid = false;
+		assert(allocationOut);
+		return allocator->CreatePlacedResource(D3D12_HEAP_TYPE_DEFAULT,
+			desc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			resourceOut,
+			allocationOut
+			);
 	}
-	assert(valid);
 
-	return ((uLocation + (uAlign - 1)) & ~(uAlign - 1));
+	D3D12_HEAP_PROPERTIES heapProps;
+	heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	heapProps.CreationNodeMask = 1;
+	heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+	heapProps.VisibleNodeMask = 1;
+	return d3dDevice->CreateCommittedResource(&heapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(resourceOut)
+		);
 }
 
 HRESULT CreateD3DResources(_In_ ID3D12Device* d3dDevice,
@@ -831,7 +922,9 @@ HRESULT CreateD3DResources(_In_ ID3D12Device* d3dDevice,
 	_In_ D3D12_RESOURCE_STATES usage,
 	_In_ D3D12_RESOURCE_FLAGS miscFlags,
 	_In_reads_opt_(mipCount*arraySize) D3D12_SUBRESOURCE_DATA* initData,
-	_Outptr_opt_ ID3D12Resource** resourceOut)
+	_Outptr_opt_ ID3D12Resource** resourceOut,
+	_In_opt_ GpuMemoryAllocator* allocator,
+	_Out_opt_ GpuAllocation* allocationOut)
 {
 	HRESULT hr;
 	
@@ -865,21 +958,12 @@ HRESULT CreateD3DResources(_In_ ID3D12Device* d3dDevice,
 		return E_OUTOFMEMORY;
 	}
 
-	D3D12_HEAP_PROPERTIES heapProps;
-	heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	heapProps.CreationNodeMask = 1;
-	heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-	heapProps.VisibleNodeMask = 1;
-	
-	//create the default heap texture resource
-	hr = d3dDevice->CreateCommittedResource(&heapProps,
-		D3D12_HEAP_FLAG_NONE,
-		&desc,
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		nullptr,
-		IID_PPV_ARGS(resourceOut)
-		);
+	//create the default heap texture resource, placed in one of the allocator's heaps when there is one
+	hr = CreateTextureResource(d3dDevice, desc, resourceOut, allocator, allocationOut);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
 
 	//local pointers to the uploadbuffer memory locations
 	UINT8* pDataCur = uploadBuffer->pDataCur;
@@ -976,8 +1060,10 @@ HRESULT CreateD3DResources(_In_ ID3D12Device* d3dDevice,
 
 HRESULT CreateTextureFromDDS(_In_ ID3D12Device* d3dDevice, _In_ ID3D12GraphicsCommandList* cmdList, _In_ CUploadBufferWrapper* uploadBuffer,
 							_In_ const DirectX::DDS_HEADER* header, _In_reads_bytes_(bitSize) const uint8_t* bitData,
-							_In_ size_t bitSize, _Outptr_opt_ ID3D12Resource** resourceOut)
+							_In_ size_t bitSize, _Outptr_opt_ ID3D12Resource** resourceOut,
+							_In_opt_ GpuMemoryAllocator* allocator, _Out_opt_ GpuAllocation* allocationOut)
 {
+	TRACE_SCOPE("CreateTextureFromDDS");
 	using namespace DirectX;
 	HRESULT hr = S_OK;
 
@@ -1046,7 +1132,7 @@ HRESULT CreateTextureFromDDS(_In_ ID3D12Device* d3dDevice, _In_ ID3D12GraphicsCo
 		D3D12_RESOURCE_FLAGS miscFlags = D3D12_RESOURCE_FLAG_NONE;
 
 		hr = CreateD3DResources(d3dDevice, cmdList, uploadBuffer, resDim, twidth, theight, tdepth, mipCount - skipMip, bc, arraySize,
-			format, usage, miscFlags, initData.get(), resourceOut);
+			format, usage, miscFlags, initData.get(), resourceOut, allocator, allocationOut);
 	}
 
 	return hr;
@@ -1054,9 +1140,13 @@ HRESULT CreateTextureFromDDS(_In_ ID3D12Device* d3dDevice, _In_ ID3D12GraphicsCo
 
 //This function will create and initialise the resource at the given offset in the heap, and increment the offset value by
 //the size of the resource (indicating where the next resource should be placed in the heap).
+//Without an allocator the texture gets a committed resource, otherwise it is placed and allocationOut
+//receives the memory to hand back to GpuMemoryAllocator::Free when the texture is destroyed.
 HRESULT CreateTexture2D(_In_ ID3D12Device* d3dDevice, _In_ ID3D12GraphicsCommandList* cmdList, _In_ CUploadBufferWrapper* uploadBuffer,
-							_In_ const wchar_t* fileName, _Outptr_opt_ ID3D12Resource** resourceOut)
+							_In_ const wchar_t* fileName, _Outptr_opt_ ID3D12Resource** resourceOut,
+							_In_opt_ GpuMemoryAllocator* allocator = nullptr, _Out_opt_ GpuAllocation* allocationOut = nullptr)
 {
+	TRACE_SCOPE("CreateTexture2D");
 	using namespace DirectX;
 	HRESULT hr;
 
@@ -1077,7 +1167,115 @@ HRESULT CreateTexture2D(_In_ ID3D12Device* d3dDevice, _In_ ID3D12GraphicsCommand
 	}
 
 	hr = CreateTextureFromDDS(d3dDevice, cmdList, uploadBuffer,
-							header, bitData, bitSize, resourceOut);
+							header, bitData, bitSize, resourceOut, allocator, allocationOut);
 
 	return hr;
-}
\ No newline at end of file
+}
+
+//Cooked textures (see texturefile.h) are stored in the layout the copies read: instead of re-pitching every row of
+//every mip into the upload buffer as CreateD3DResources does, the data is one memcpy and each subresource one
+//CopyTextureRegion from its footprint.
+HRESULT CreateTextureFromTextureFile(_In_ ID3D12Device* d3dDevice, _In_ ID3D12GraphicsCommandList* cmdList, _In_ CUploadBufferWrapper* uploadBuffer,
+							_In_ const TextureFile& file, _Outptr_opt_ ID3D12Resource** resourceOut,
+							_In_opt_ GpuMemoryAllocator* allocator, _Out_opt_ GpuAllocation* allocationOut)
+{
+	TRACE_SCOPE("CreateTextureFromTextureFile");
+
+	D3D12_RESOURCE_DESC desc = file.GetResourceDesc();
+	//the same hack as CreateD3DResources, d3d9 style header BGRA loads as its srgb equivalent
+	if (desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM)
+	{
+		desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+	}
+
+	//the footprint offsets are multiples of the placement alignment from the start of the data, so the data goes to one too
+	UINT8* pDataCur = reinterpret_cast<UINT8*>(Align(reinterpret_cast<SIZE_T>(uploadBuffer->pDataCur), D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT));
+	if (pDataCur > uploadBuffer->pDataEnd || file.GetDataSize() > static_cast<UINT64>(uploadBuffer->pDataEnd - pDataCur))
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	HRESULT hr = CreateTextureResource(d3dDevice, desc, resourceOut, allocator, allocationOut);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	memcpy(pDataCur, file.GetData(), static_cast<size_t>(file.GetDataSize()));
+	UINT64 baseOffset = pDataCur - uploadBuffer->pDataBegin;
+	for (UINT i = 0; i < file.GetSubresourceCount(); ++i)
+	{
+		D3D12_TEXTURE_COPY_LOCATION dstTexture;
+		memset(&dstTexture, 0, sizeof(dstTexture));
+		dstTexture.pResource = *resourceOut;
+		dstTexture.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+		dstTexture.SubresourceIndex = i;
+
+		D3D12_TEXTURE_COPY_LOCATION srcTexture;
+		memset(&srcTexture, 0, sizeof(srcTexture));
+		srcTexture.pResource = uploadBuffer->pBuf.Get();
+		srcTexture.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+		srcTexture.PlacedFootprint = file.GetPlacedFootprint(i, baseOffset);
+		srcTexture.PlacedFootprint.Footprint.Format = desc.Format;
+
+#ifndef NDEBUG
+		//the cooker computes the footprints without a device, check this one agrees
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT deviceFootprint;
+		UINT rowCount = 0;
+		UINT64 rowSize = 0;
+		d3dDevice->GetCopyableFootprints(&desc, i, 1, srcTexture.PlacedFootprint.Offset, &deviceFootprint, &rowCount, &rowSize, nullptr);
+		assert(deviceFootprint.Offset == srcTexture.PlacedFootprint.Offset && deviceFootprint.Footprint.RowPitch == srcTexture.PlacedFootprint.Footprint.RowPitch);
+		assert(rowCount == file.GetFootprint(i).RowCount && rowSize == file.GetFootprint(i).RowSize);
+#endif
+
+		cmdList->CopyTextureRegion(
+			&dstTexture,
+			0, 0, 0,
+			&srcTexture,
+			NULL
+			);
+	}
+
+	uploadBuffer->pDataCur = pDataCur + file.GetDataSize();
+	return S_OK;
+}
+
+//Loads a texture cooked by tools/texturecook.cpp, out of the texture archive when it has the file and from the
+//mapped loose file otherwise. Fails when neither has it, callers fall back to CreateTexture2D on the DDS.
+HRESULT CreateTexture2DFromTextureFile(_In_ ID3D12Device* d3dDevice, _In_ ID3D12GraphicsCommandList* cmdList, _In_ CUploadBufferWrapper* uploadBuffer,
+							_In_z_ const char* fileName, _Outptr_opt_ ID3D12Resource** resourceOut,
+							_In_opt_ GpuMemoryAllocator* allocator = nullptr, _Out_opt_ GpuAllocation* allocationOut = nullptr)
+{
+	TRACE_SCOPE("CreateTexture2DFromTextureFile");
+	TextureFile file;
+	std::vector<uint8_t> decompressed;
+	HRESULT hr;
+	uint32_t entry = g_TextureArchive ? g_TextureArchive->Find(fileName) : AssetArchive::NotFound;
+	if (entry != AssetArchive::NotFound)
+	{
+		//stored whole, the texture is read in place from the mapped archive
+		const void* stored = g_TextureArchive->GetStoredData(entry);
+		if (stored)
+		{
+			hr = file.Attach(stored, static_cast<size_t>(g_TextureArchive->GetSize(entry)));
+		}
+		else
+		{
+			hr = g_TextureArchive->Read(entry, decompressed);
+			if (SUCCEEDED(hr))
+			{
+				hr = file.Attach(decompressed.data(), decompressed.size());
+			}
+		}
+	}
+	else
+	{
+		hr = file.Open(fileName);
+	}
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	return CreateTextureFromTextureFile(d3dDevice, cmdList, uploadBuffer, file, resourceOut, allocator, allocationOut);
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+//bookkeeping of GPU timestamp scopes, without the graphics API so it can be fed synthetic timestamps.
+//Every frame in flight owns a slot of 2 * maxScopes queries: a scope's begin and end timestamps go to
+//consecutive queries of the frame's slot, and the slot is resolved to the same place in a readback buffer.
+//Once the GPU has finished a frame, Collect reads its slot and turns the ticks into milliseconds, so the
+//timings of frame N are available around frame N + frameLatency without ever waiting on the GPU.
+class TimestampProfiler
+{
+public:
+	static const uint32_t InvalidScope = ~0u;
+
+	struct ScopeTiming
+	{
+		const char* Name;
+		uint32_t Depth; //0 for outermost scopes
+		double Milliseconds;
+		uint64_t BeginTicks; //raw GPU timestamps, to place the scope on a timeline
+		uint64_t EndTicks;
+	};
+
+	TimestampProfiler() : m_MaxScopes(0), m_Frequency(1), m_Current(nullptr), m_CurrentIndex(0), m_Depth(0), m_TimingsFrame(0), m_HasTimings(false), m_Dropped(0) {}
+
+	//frameLatency is the number of frames that can be in flight plus one, so a slot is never reused before it was read
+	void Create(uint32_t maxScopesPerFrame, uint32_t frameLatency, uint64_t frequency)
+	{
+		assert(maxScopesPerFrame > 0 && frameLatency > 0 && frequency > 0);
+		m_MaxScopes = maxScopesPerFrame;
+		m_Frequency = frequency;
+		m_Slots.assign(frameLatency, Slot());
+		for (auto& slot : m_Slots)
+		{
+			slot.Scopes.reserve(maxScopesPerFrame);
+		}
+		m_Current = nullptr;
+		m_CurrentIndex = 0;
+		m_Depth = 0;
+		m_Timings.clear();
+		m_TimingsFrame = 0;
+		m_HasTimings = false;
+		m_Dropped = 0;
+	}
+
+	uint32_t GetQueryCount() const { return 2 * m_MaxScopes * static_cast<uint32_t>(m_Slots.size()); }
+	uint32_t GetSlotIndex(uint64_t frame) const { return static_cast<uint32_t>(frame % m_Slots.size()); }
+	uint32_t GetSlotQueryCount() const { return 2 * m_MaxScopes; }
+	uint32_t GetSlotFirstQuery(uint32_t slot) const { return slot * GetSlotQueryCount(); }
+
+	void BeginFrame(uint64_t frame)
+	{
+		Slot& slot = m_Slots[GetSlotIndex(frame)];
+		if (slot.Pending)
+		{
+			++m_Dropped; //never collected, the caller got ahead of the GPU further than frameLatency allows
+		}
+		slot.Frame = frame;
+		slot.Pending = false;
+		slot.Scopes.clear();
+		m_Current = &slot;
+		m_CurrentIndex = GetSlotIndex(frame);
+		m_Depth = 0;
+	}
+
+	//returns the scope, InvalidScope when the frame is out of queries. See GetBeginQuery/GetEndQuery for where its timestamps go.
+	uint32_t BeginScope(const char* name)
+	{
+		assert(m_Current);
+		if (m_Current->Scopes.size() >= m_MaxScopes)
+		{
+			return InvalidScope;
+		}
+		Scope scope = { name, m_Depth++ };
+		m_Current->Scopes.push_back(scope);
+		return static_cast<uint32_t>(m_Current->Scopes.size() - 1);
+	}
+
+	//query index for a scope's begin and end timestamp
+	uint32_t GetBeginQuery(uint32_t scope) const { return GetSlotFirstQuery(m_CurrentIndex) + 2 * scope; }
+	uint32_t GetEndQuery(uint32_t scope) const { return GetSlotFirstQuery(m_CurrentIndex) + 2 * scope + 1; }
+
+	void EndScope(uint32_t scope)
+	{
+		if (scope != InvalidScope)
+		{
+			assert(m_Depth > 0);
+			--m_Depth;
+		}
+	}
+
+	//the queries to resolve at the end of the frame, first query and count
+	void GetFrameQueries(uint32_t& first, uint32_t& count) const
+	{
+		first = GetSlotFirstQuery(m_CurrentIndex);
+		count = 2 * static_cast<uint32_t>(m_Current->Scopes.size());
+	}
+
+	void EndFrame()
+	{
+		assert(m_Current && m_Depth == 0);
+		m_Current->Pending = true;
+		m_Current = nullptr;
+	}
+
+	//turns every frame up to completedFrame into timings, oldest first. read(slot) returns the slot's resolved
+	//timestamps, GetSlotFirstQuery(slot) onwards. The newest collected frame becomes GetTimings().
+	template<typename ReadSlot>
+	void Collect(uint64_t completedFrame, ReadSlot read)
+	{
+		Collect(completedFrame, read, [](const std::vector<ScopeTiming>&) {});
+	}
+
+	//as above, collected(timings) is called for every frame, not only the newest
+	template<typename ReadSlot, typename Collected>
+	void Collect(uint64_t completedFrame, ReadSlot read, Collected collected)
+	{
+		for (;;)
+		{
+			Slot* oldest = nullptr;
+			uint32_t oldestIndex = 0;
+			for (uint32_t i = 0; i < m_Slots.size(); ++i)
+			{
+				Slot& slot = m_Slots[i];
+				if (slot.Pending && slot.Frame <= completedFrame && (!oldest || slot.Frame < oldest->Frame))
+				{
+					oldest = &slot;
+					oldestIndex = i;
+				}
+			}
+			if (!oldest)
+			{
+				return;
+			}
+
+			const uint64_t* timestamps = read(oldestIndex);
+			m_Timings.resize(oldest->Scopes.size());
+			for (size_t s = 0; s < oldest->Scopes.size(); ++s)
+			{
+				uint64_t begin = timestamps[2 * s];
+				uint64_t end = timestamps[2 * s + 1];
+				m_Timings[s].Name = oldest->Scopes[s].Name;
+				m_Timings[s].Depth = oldest->Scopes[s].Depth;
+				m_Timings[s].BeginTicks = begin;
+				m_Timings[s].EndTicks = end;
+				//a scope that wasn't closed on the GPU or spans a timestamp reset has no meaningful time
+				m_Timings[s].Milliseconds = (end >= begin) ? double(end - begin) * 1000.0 / double(m_Frequency) : 0.0;
+			}
+			m_TimingsFrame = oldest->Frame;
+			m_HasTimings = true;
+			oldest->Pending = false;
+			collected(m_Timings);
+		}
+	}
+
+	bool HasTimings() const { return m_HasTimings; }
+	uint64_t GetTimingsFrame() const { return m_TimingsFrame; }
+	const std::vector<ScopeTiming>& GetTimings() const { return m_Timings; }
+	uint32_t GetDroppedFrames() const { return m_Dropped; }
+	uint64_t GetFrequency() const { return m_Frequency; }
+
+	//one line, nested scopes indented with dots
+	std::string Format() const
+	{
+		std::string line = "gpu ms";
+		char buffer[96];
+		for (const auto& timing : m_Timings)
+		{
+			snprintf(buffer, sizeof(buffer), " %s%s %.3f", std::string(timing.Depth, '.').c_str(), timing.Name, timing.Milliseconds);
+			line += buffer;
+		}
+		line += "\n";
+		return line;
+	}
+
+private:
+	struct Scope
+	{
+		const char* Name;
+		uint32_t Depth;
+	};
+
+	struct Slot
+	{
+		Slot() : Frame(0), Pending(false) {}
+
+		uint64_t Frame;
+		bool Pending; //recorded and waiting for the GPU
+		std::vector<Scope> Scopes;
+	};
+
+	uint32_t m_MaxScopes;
+	uint64_t m_Frequency;
+	std::vector<Slot> m_Slots;
+	Slot* m_Current;
+	uint32_t m_CurrentIndex;
+	uint32_t m_Depth;
+
+	std::vector<ScopeTiming> m_Timings;
+	uint64_t m_TimingsFrame;
+	bool m_HasTimings;
+	uint32_t m_Dropped;
+};
@@ -0,0 +1,390 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+//two level segregated fit allocator over an abstract range [0, capacity).
+//It never touches the memory it manages, all bookkeeping lives in a separate block array, so it can
+//sub-allocate GPU heaps and buffers. Allocation and free are O(1) apart from skipping free blocks that
+//are big enough but can't satisfy the requested alignment.
+class TlsfAllocator
+{
+public:
+	struct Allocation
+	{
+		uint64_t Offset;
+		uint64_t Size;
+		uint32_t Block; //internal handle, pass the allocation back to Free unchanged
+	};
+
+	struct Statistics
+	{
+		uint64_t Capacity;
+		uint64_t UsedBytes; //including alignment padding that could not be returned to the free lists
+		uint64_t FreeBytes;
+		uint64_t LargestFreeBlock;
+		uint32_t AllocationCount;
+		uint32_t FreeBlockCount;
+
+		//0 when all free space is one block, approaching 1 as it is scattered over many small holes.
+		double GetFragmentation() const
+		{
+			return FreeBytes ? 1.0 - double(LargestFreeBlock) / double(FreeBytes) : 0.0;
+		}
+	};
+
+	TlsfAllocator() : m_Capacity(0), m_FreeBytes(0), m_AllocationCount(0), m_FirstLevelMask(0) {}
+
+	void Create(uint64_t capacity)
+	{
+		assert(capacity > 0);
+		m_Capacity = capacity;
+		m_FreeBytes = capacity;
+		m_AllocationCount = 0;
+		m_Blocks.clear();
+		m_UnusedBlocks.clear();
+		m_FirstLevelMask = 0;
+		memset(m_SecondLevelMask, 0, sizeof(m_SecondLevelMask));
+		for (uint32_t i = 0; i < FirstLevelCount * SecondLevelCount; ++i)
+		{
+			m_FreeHeads[i] = Null;
+		}
+
+		uint32_t block = NewBlock(0, capacity);
+		InsertFree(block);
+	}
+
+	//alignment must be a power of two. Returns false when no free block can hold the request.
+	bool Allocate(uint64_t size, uint64_t alignment, Allocation& out)
+	{
+		assert(alignment && !(alignment & (alignment - 1)));
+		if (size == 0 || size > m_FreeBytes)
+		{
+			return false;
+		}
+
+		//start at the first list whose blocks are all >= size, then walk larger lists
+		uint32_t fl, sl;
+		MappingSearch(size, fl, sl);
+		for (uint32_t block = FindFreeFrom(fl, sl); block != Null; block = NextFreeList(block))
+		{
+			for (uint32_t candidate = block; candidate != Null; candidate = m_Blocks[candidate].NextFree)
+			{
+				const Block& b = m_Blocks[candidate];
+				uint64_t aligned = AlignUp(b.Offset, alignment);
+				if (aligned + size <= b.Offset + b.Size)
+				{
+					Use(candidate, aligned, size);
+					out.Offset = aligned;
+					out.Size = size;
+					out.Block = candidate;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void Free(const Allocation& allocation)
+	{
+		uint32_t block = allocation.Block;
+		assert(block < m_Blocks.size() && !m_Blocks[block].IsFree && m_Blocks[block].Offset == allocation.Offset);
+
+		m_FreeBytes += m_Blocks[block].Size;
+		--m_AllocationCount;
+
+		//coalesce with both physical neighbours so free space never sits in two adjacent blocks
+		uint32_t prev = m_Blocks[block].PrevPhysical;
+		if (prev != Null && m_Blocks[prev].IsFree)
+		{
+			RemoveFree(prev);
+			block = Merge(prev, block);
+		}
+		uint32_t next = m_Blocks[block].NextPhysical;
+		if (next != Null && m_Blocks[next].IsFree)
+		{
+			RemoveFree(next);
+			block = Merge(block, next);
+		}
+		InsertFree(block);
+	}
+
+	Statistics GetStatistics() const
+	{
+		Statistics stats;
+		stats.Capacity = m_Capacity;
+		stats.FreeBytes = m_FreeBytes;
+		stats.UsedBytes = m_Capacity - m_FreeBytes;
+		stats.AllocationCount = m_AllocationCount;
+		stats.FreeBlockCount = 0;
+		stats.LargestFreeBlock = 0;
+		for (uint32_t i = 0; i < FirstLevelCount * SecondLevelCount; ++i)
+		{
+			for (uint32_t block = m_FreeHeads[i]; block != Null; block = m_Blocks[block].NextFree)
+			{
+				++stats.FreeBlockCount;
+				if (m_Blocks[block].Size > stats.LargestFreeBlock)
+				{
+					stats.LargestFreeBlock = m_Blocks[block].Size;
+				}
+			}
+		}
+		return stats;
+	}
+
+	bool IsEmpty() const { return m_AllocationCount == 0; }
+	uint64_t GetCapacity() const { return m_Capacity; }
+
+private:
+	static const uint32_t Null = ~0u;
+	static const uint32_t SecondLevelBits = 4;
+	static const uint32_t SecondLevelCount = 1u << SecondLevelBits;
+	//sizes below SecondLevelCount all map to first level 0, larger ones to 1 + log2(size) - SecondLevelBits
+	static const uint32_t FirstLevelCount = 64 - SecondLevelBits + 1;
+
+	struct Block
+	{
+		uint64_t Offset;
+		uint64_t Size;
+		uint32_t PrevPhysical;
+		uint32_t NextPhysical;
+		uint32_t PrevFree;
+		uint32_t NextFree;
+		bool IsFree;
+	};
+
+	static uint32_t Log2(uint64_t value)
+	{
+		uint32_t result = 0;
+		while (value >>= 1)
+		{
+			++result;
+		}
+		return result;
+	}
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	//list a free block of this size is stored in
+	static void Mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+	{
+		if (size < SecondLevelCount)
+		{
+			fl = 0;
+			sl = static_cast<uint32_t>(size);
+			return;
+		}
+		uint32_t log2 = Log2(size);
+		fl = log2 - SecondLevelBits + 1;
+		sl = static_cast<uint32_t>((size >> (log2 - SecondLevelBits)) ^ SecondLevelCount);
+	}
+
+	//first list in which every block is at least size bytes
+	static void MappingSearch(uint64_t size, uint32_t& fl, uint32_t& sl)
+	{
+		if (size >= SecondLevelCount)
+		{
+			uint64_t round = (uint64_t(1) << (Log2(size) - SecondLevelBits)) - 1;
+			if (size + round > size)
+			{
+				size += round;
+			}
+		}
+		Mapping(size, fl, sl);
+	}
+
+	uint32_t FindFreeFrom(uint32_t fl, uint32_t sl) const
+	{
+		if (fl >= FirstLevelCount)
+		{
+			return Null;
+		}
+		uint32_t slMask = m_SecondLevelMask[fl] & (~0u << sl);
+		if (!slMask)
+		{
+			uint64_t flMask = (fl + 1 < 64) ? (m_FirstLevelMask & (~uint64_t(0) << (fl + 1))) : 0;
+			if (!flMask)
+			{
+				return Null;
+			}
+			fl = LowestBit(flMask);
+			slMask = m_SecondLevelMask[fl];
+		}
+		sl = LowestBit(slMask);
+		return m_FreeHeads[fl * SecondLevelCount + sl];
+	}
+
+	//head of the next non-empty free list after the one block is in
+	uint32_t NextFreeList(uint32_t block) const
+	{
+		uint32_t fl, sl;
+		Mapping(m_Blocks[block].Size, fl, sl);
+		if (sl + 1 < SecondLevelCount)
+		{
+			return FindFreeFrom(fl, sl + 1);
+		}
+		return FindFreeFrom(fl + 1, 0);
+	}
+
+	static uint32_t LowestBit(uint64_t mask)
+	{
+		uint32_t bit = 0;
+		while (!(mask & 1))
+		{
+			mask >>= 1;
+			++bit;
+		}
+		return bit;
+	}
+
+	uint32_t NewBlock(uint64_t offset, uint64_t size)
+	{
+		uint32_t index;
+		if (!m_UnusedBlocks.empty())
+		{
+			index = m_UnusedBlocks.back();
+			m_UnusedBlocks.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(m_Blocks.size());
+			m_Blocks.emplace_back();
+		}
+		Block& b = m_Blocks[index];
+		b.Offset = offset;
+		b.Size = size;
+		b.PrevPhysical = Null;
+		b.NextPhysical = Null;
+		b.PrevFree = Null;
+		b.NextFree = Null;
+		b.IsFree = false;
+		return index;
+	}
+
+	void InsertFree(uint32_t block)
+	{
+		uint32_t fl, sl;
+		Mapping(m_Blocks[block].Size, fl, sl);
+		uint32_t& head = m_FreeHeads[fl * SecondLevelCount + sl];
+
+		Block& b = m_Blocks[block];
+		b.IsFree = true;
+		b.PrevFree = Null;
+		b.NextFree = head;
+		if (head != Null)
+		{
+			m_Blocks[head].PrevFree = block;
+		}
+		head = block;
+
+		m_FirstLevelMask |= uint64_t(1) << fl;
+		m_SecondLevelMask[fl] |= 1u << sl;
+	}
+
+	void RemoveFree(uint32_t block)
+	{
+		uint32_t fl, sl;
+		Mapping(m_Blocks[block].Size, fl, sl);
+		uint32_t& head = m_FreeHeads[fl * SecondLevelCount + sl];
+
+		Block& b = m_Blocks[block];
+		if (b.PrevFree != Null)
+		{
+			m_Blocks[b.PrevFree].NextFree = b.NextFree;
+		}
+		else
+		{
+			head = b.NextFree;
+		}
+		if (b.NextFree != Null)
+		{
+			m_Blocks[b.NextFree].PrevFree = b.PrevFree;
+		}
+		b.IsFree = false;
+		b.PrevFree = Null;
+		b.NextFree = Null;
+
+		if (head == Null)
+		{
+			m_SecondLevelMask[fl] &= ~(1u << sl);
+			if (!m_SecondLevelMask[fl])
+			{
+				m_FirstLevelMask &= ~(uint64_t(1) << fl);
+			}
+		}
+	}
+
+	//splits block so that a new block starts at offset, returns the new block
+	uint32_t Split(uint32_t block, uint64_t offset)
+	{
+		uint64_t blockOffset = m_Blocks[block].Offset;
+		uint64_t blockSize = m_Blocks[block].Size;
+		assert(offset > blockOffset && offset < blockOffset + blockSize);
+
+		uint32_t tail = NewBlock(offset, blockOffset + blockSize - offset);
+		Block& b = m_Blocks[block];
+		b.Size = offset - blockOffset;
+
+		Block& t = m_Blocks[tail];
+		t.PrevPhysical = block;
+		t.NextPhysical = b.NextPhysical;
+		if (t.NextPhysical != Null)
+		{
+			m_Blocks[t.NextPhysical].PrevPhysical = tail;
+		}
+		b.NextPhysical = tail;
+		return tail;
+	}
+
+	//absorbs second into first, which must be its physical predecessor
+	uint32_t Merge(uint32_t first, uint32_t second)
+	{
+		Block& a = m_Blocks[first];
+		Block& b = m_Blocks[second];
+		assert(a.NextPhysical == second && a.Offset + a.Size == b.Offset);
+		a.Size += b.Size;
+		a.NextPhysical = b.NextPhysical;
+		if (a.NextPhysical != Null)
+		{
+			m_Blocks[a.NextPhysical].PrevPhysical = first;
+		}
+		m_UnusedBlocks.push_back(second);
+		return first;
+	}
+
+	//carves [offset, offset + size) out of a free block, giving the head and tail remainders back to the free lists
+	void Use(uint32_t& block, uint64_t offset, uint64_t size)
+	{
+		RemoveFree(block);
+
+		if (offset > m_Blocks[block].Offset)
+		{
+			uint32_t head = block;
+			block = Split(head, offset);
+			InsertFree(head);
+		}
+		if (m_Blocks[block].Size > size)
+		{
+			uint32_t tail = Split(block, offset + size);
+			InsertFree(tail);
+		}
+
+		m_Blocks[block].IsFree = false;
+		m_FreeBytes -= m_Blocks[block].Size;
+		++m_AllocationCount;
+	}
+
+	uint64_t m_Capacity;
+	uint64_t m_FreeBytes;
+	uint32_t m_AllocationCount;
+	std::vector<Block> m_Blocks;
+	std::vector<uint32_t> m_UnusedBlocks;
+	uint64_t m_FirstLevelMask;
+	uint32_t m_SecondLevelMask[FirstLevelCount];
+	uint32_t m_FreeHeads[FirstLevelCount * SecondLevelCount];
+};
@@ -0,0 +1,129 @@
+//packs files into the asset archive of assetarchive.h, LZ4 compressed in chunks of 64 KB (--chunk KB) or stored
+//with --store. Files keep the name they are given by; the files under a directory are named relative to it, so
+//"assetpack assets.pack data" packs data/seafloor2.dds as seafloor2.dds. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/assetpack.cpp -o assetpack
+//  ./assetpack output.pack [--chunk KB] [--store] files or directories...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "../assetarchive.h"
+#include "../frameclock.h"
+
+struct PackedFile
+{
+	std::string Path;
+	std::string Name;
+};
+
+//every regular file under directory, named by its path below root
+static void ListFiles(const std::string& directory, const std::string& prefix, std::vector<PackedFile>& files)
+{
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+	{
+		return;
+	}
+	while (dirent* item = readdir(dir))
+	{
+		if (!strcmp(item->d_name, ".") || !strcmp(item->d_name, ".."))
+		{
+			continue;
+		}
+		std::string path = directory + "/" + item->d_name;
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+		{
+			continue;
+		}
+		if (S_ISDIR(info.st_mode))
+		{
+			ListFiles(path, prefix + item->d_name + "/", files);
+		}
+		else if (S_ISREG(info.st_mode))
+		{
+			files.push_back({ path, prefix + item->d_name });
+		}
+	}
+	closedir(dir);
+}
+
+int main(int argc, char* argv[])
+{
+	const char* output = nullptr;
+	uint32_t chunkSize = AssetArchiveDefaultChunkSize;
+	bool compress = true;
+	std::vector<PackedFile> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		struct stat info;
+		if (!strcmp(argv[i], "--store")) compress = false;
+		else if (!strcmp(argv[i], "--chunk") && i + 1 < argc) chunkSize = std::max(1u, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10))) * 1024;
+		else if (argv[i][0] != '-' && !output) output = argv[i];
+		else if (argv[i][0] != '-' && stat(argv[i], &info) == 0 && S_ISDIR(info.st_mode)) ListFiles(argv[i], "", files);
+		else if (argv[i][0] != '-' && stat(argv[i], &info) == 0) files.push_back({ argv[i], argv[i] });
+		else
+		{
+			fprintf(stderr, "%s: not a file, directory or option\n", argv[i]);
+			return 2;
+		}
+	}
+	if (!output || files.empty())
+	{
+		fprintf(stderr, "usage: assetpack output.pack [--chunk KB] [--store] files or directories...\n");
+		return 2;
+	}
+
+	//in name order, so packing the same files again writes the same archive
+	std::sort(files.begin(), files.end(), [](const PackedFile& a, const PackedFile& b) { return a.Name < b.Name; });
+	SteadyFrameClock clock;
+	double start = clock.Now();
+	std::vector<MappedFile> mapped(files.size());
+	std::vector<AssetArchiveSource> sources;
+	uint64_t totalSize = 0;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (FAILED(mapped[i].Open(files[i].Path.c_str())))
+		{
+			fprintf(stderr, "%s: not readable\n", files[i].Path.c_str());
+			return 1;
+		}
+		sources.push_back({ files[i].Name, mapped[i].GetData(), mapped[i].GetSize() });
+		totalSize += mapped[i].GetSize();
+	}
+
+	std::vector<uint8_t> image;
+	HRESULT hr = BuildAssetArchive(sources, image, chunkSize, compress);
+	if (FAILED(hr))
+	{
+		fprintf(stderr, "%s: two files have the same name once normalized (%08x)\n", output, static_cast<uint32_t>(hr));
+		return 1;
+	}
+	FILE* file = fopen(output, "wb");
+	bool written = file && fwrite(image.data(), 1, image.size(), file) == image.size();
+	written = file && fclose(file) == 0 && written;
+	if (!written)
+	{
+		fprintf(stderr, "%s: write failed\n", output);
+		return 1;
+	}
+
+	AssetArchive archive;
+	archive.Attach(image.data(), image.size());
+	uint32_t stored = 0;
+	for (uint32_t e = 0; e < archive.GetEntryCount(); ++e)
+	{
+		stored += archive.GetStoredData(e) ? 1 : 0;
+	}
+	printf("%s: %zu files, %.1f KB -> %.1f KB (%.1f%%), %u stored whole, %.1f ms\n", output, files.size(),
+		totalSize / 1024.0, image.size() / 1024.0, totalSize ? 100.0 * image.size() / totalSize : 100.0, stored, (clock.Now() - start) * 1000.0);
+	return 0;
+}
@@ -0,0 +1,333 @@
+//asynchronous pipeline compiles against a mock compiler: checks that compiles run on the pool in submission order
+//and never on the recording thread, that a handle reads as pending, ready or failed as its compile finishes, that
+//Resolve hands out the fallback until then and null without one, that ResolveHandle names the pipeline Resolve
+//hands out, and that DrawList skips the draws of a null pipeline instead of binding it. Then resolves handles while a pool compiles thousands of them and reports how
+//long a Resolve takes, the recording thread pays it per draw. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/asyncpipelinecheck.cpp -o asyncpipelinecheck
+//  ./asyncpipelinecheck [--pipelines N] [--threads N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "../asyncpipelines.h"
+#include "../drawpackets.h"
+#include "../nulldevice.h"
+#include "../frameclock.h"
+#include "check.h"
+
+//what a pipeline description boils down to for the mock: which pipeline it makes and whether the driver refuses it
+struct MockPipelineDesc
+{
+	uint32_t Id;
+	bool Fails;
+};
+
+typedef AsyncPipelineCompiler<MockPipelineDesc, ID3D12PipelineState> MockPipelineCompiler;
+
+//hands out pipelines created up front on a null device, since the device isn't thread safe. Compiles of gated ids
+//block until they are released, so the test decides when each one finishes.
+class MockCompiler
+{
+public:
+	MockCompiler(NullDevice& device, ID3D12RootSignature* rootSignature, uint32_t count) : m_Gated(false)
+	{
+		m_Pipelines.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			device.CreateGraphicsPipelineState(rootSignature, false, &m_Pipelines[i]);
+		}
+	}
+
+	void SetGated(bool gated) { m_Gated = gated; }
+
+	void Release(uint32_t id)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Released.insert(id);
+		}
+		m_Changed.notify_all();
+	}
+
+	ID3D12PipelineState* Compile(const MockPipelineDesc& desc)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Order.push_back(desc.Id);
+		m_Threads.push_back(std::this_thread::get_id());
+		if (m_Gated)
+		{
+			m_Changed.wait(lock, [this, &desc]() { return m_Released.count(desc.Id) != 0; });
+		}
+		return desc.Fails ? nullptr : m_Pipelines[desc.Id];
+	}
+
+	ID3D12PipelineState* Get(uint32_t id) const { return m_Pipelines[id]; }
+
+	std::vector<uint32_t> GetOrder() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Order;
+	}
+
+	std::vector<std::thread::id> GetThreads() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Threads;
+	}
+
+	MockPipelineCompiler::CompileFunc GetFunc() { return [this](const MockPipelineDesc& desc) { return Compile(desc); }; }
+
+private:
+	std::vector<ID3D12PipelineState*> m_Pipelines;
+	bool m_Gated;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Changed;
+	std::set<uint32_t> m_Released;
+	std::vector<uint32_t> m_Order;
+	std::vector<std::thread::id> m_Threads;
+};
+
+//without a pool every compile is done by Submit
+static void CheckInline(NullDevice& device, ID3D12RootSignature* rootSignature)
+{
+	MockCompiler mock(device, rootSignature, 4);
+	MockPipelineCompiler compiler;
+	compiler.Create(mock.GetFunc(), nullptr);
+
+	MockPipelineCompiler::Handle ready = compiler.Submit({ 0, false });
+	Check(compiler.IsReady(ready) && compiler.GetPendingCount() == 0, "inline: compiled by Submit");
+	Check(compiler.Resolve(ready) == mock.Get(0), "inline: resolves to its own pipeline");
+
+	MockPipelineCompiler::Handle failed = compiler.Submit({ 1, true });
+	Check(compiler.HasFailed(failed) && !compiler.IsReady(failed), "inline: a refused compile has failed");
+	Check(!compiler.Resolve(failed) && !compiler.Wait(failed), "inline: a failed pipeline without a fallback resolves to null");
+	Check(compiler.ResolveHandle(failed) == MockPipelineCompiler::InvalidHandle, "inline: and to no handle");
+	compiler.SetFallback(ready);
+	Check(compiler.Resolve(failed) == mock.Get(0), "inline: a failed pipeline resolves to the fallback");
+	Check(compiler.ResolveHandle(failed) == ready && compiler.ResolveHandle(ready) == ready, "inline: the resolved handle names the pipeline bound");
+	Check(mock.GetThreads().size() == 2 && mock.GetThreads()[0] == std::this_thread::get_id(), "inline: compiled on the submitting thread");
+}
+
+//a handle is pending until its compile returns and reads as the fallback meanwhile
+static void CheckReadiness(NullDevice& device, ID3D12RootSignature* rootSignature)
+{
+	MockCompiler mock(device, rootSignature, 4);
+	mock.SetGated(true);
+	WorkerPool pool;
+	pool.Start(2);
+	MockPipelineCompiler compiler;
+	compiler.Create(mock.GetFunc(), &pool);
+
+	MockPipelineCompiler::Handle fallback = compiler.Submit({ 0, false });
+	Check(!compiler.IsReady(fallback) && !compiler.Resolve(fallback), "pool: pending without a fallback resolves to null");
+	mock.Release(0);
+	Check(compiler.Wait(fallback) == mock.Get(0), "pool: Wait returns the compiled pipeline");
+	compiler.SetFallback(fallback);
+
+	//the description is copied, changing the caller's afterwards doesn't change what is compiled
+	MockPipelineDesc desc = { 1, false };
+	MockPipelineCompiler::Handle first = compiler.Submit(desc);
+	desc.Id = 3;
+	desc.Fails = true;
+	MockPipelineCompiler::Handle second = compiler.Submit({ 2, false });
+	MockPipelineCompiler::Handle refused = compiler.Submit({ 3, true });
+	Check(compiler.GetPendingCount() == 3, "pool: three compiles pending");
+	Check(!compiler.IsReady(first) && !compiler.HasFailed(refused), "pool: pending is neither ready nor failed");
+	Check(compiler.Resolve(first) == mock.Get(0) && compiler.Resolve(refused) == mock.Get(0), "pool: pending handles resolve to the fallback");
+	Check(compiler.ResolveHandle(first) == fallback, "pool: a pending handle resolves to the fallback's handle");
+
+	mock.Release(2);
+	Check(compiler.Wait(second) == mock.Get(2), "pool: a later compile finishing first is ready first");
+	Check(compiler.Resolve(second) == mock.Get(2) && compiler.Resolve(first) == mock.Get(0), "pool: only the finished handle resolves to its pipeline");
+	Check(compiler.GetPendingCount() == 2, "pool: two compiles pending");
+
+	mock.Release(3);
+	Check(!compiler.Wait(refused) && compiler.HasFailed(refused), "pool: a refused compile has failed");
+	Check(compiler.Resolve(refused) == mock.Get(0), "pool: a failed handle keeps resolving to the fallback");
+
+	mock.Release(1);
+	Check(compiler.Wait(first) == mock.Get(1), "pool: the copied description is compiled");
+	Check(compiler.GetPendingCount() == 0, "pool: nothing pending");
+
+	bool offThread = true;
+	for (std::thread::id thread : mock.GetThreads())
+	{
+		offThread = offThread && thread != std::this_thread::get_id();
+	}
+	Check(offThread, "pool: nothing is compiled on the submitting thread");
+	pool.Stop();
+}
+
+//a single worker takes the compiles in the order they were submitted
+static void CheckOrder(NullDevice& device, ID3D12RootSignature* rootSignature)
+{
+	const uint32_t count = 32;
+	MockCompiler mock(device, rootSignature, count);
+	WorkerPool pool;
+	pool.Start(1);
+	MockPipelineCompiler compiler;
+	compiler.Create(mock.GetFunc(), &pool);
+	std::vector<uint32_t> submitted;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t id = (i * 7) % count;
+		compiler.Submit({ id, false });
+		submitted.push_back(id);
+	}
+	pool.WaitIdle();
+	Check(mock.GetOrder() == submitted, "one worker compiles in submission order");
+	pool.Stop();
+}
+
+//what a draw of an unresolved pipeline records: nothing, rather than SetPipelineState(nullptr)
+static void CheckSkippedDraws(NullDevice& device, ID3D12RootSignature* rootSignature)
+{
+	MockCompiler mock(device, rootSignature, 2);
+	mock.SetGated(true);
+	WorkerPool pool;
+	pool.Start(1);
+	MockPipelineCompiler compiler;
+	compiler.Create(mock.GetFunc(), &pool);
+	MockPipelineCompiler::Handle pending = compiler.Submit({ 0, false });
+	MockPipelineCompiler::Handle refused = compiler.Submit({ 1, true });
+	Check(!compiler.Resolve(pending), "a pending pipeline without a fallback resolves to null");
+
+	D3D12_HEAP_PROPERTIES heap = { D3D12_HEAP_TYPE_UPLOAD, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 1, 1 };
+	D3D12_RESOURCE_DESC bufferDesc = { D3D12_RESOURCE_DIMENSION_BUFFER, 0, 256, 1, 1, 1, DXGI_FORMAT_UNKNOWN, { 1, 0 }, D3D12_TEXTURE_LAYOUT_ROW_MAJOR, D3D12_RESOURCE_FLAG_NONE };
+	ID3D12Resource* constants = nullptr;
+	device.CreateCommittedResource(&heap, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, &constants);
+	ID3D12PipelineState* drawn = nullptr;
+	device.CreateGraphicsPipelineState(rootSignature, false, &drawn);
+
+	DrawPacket packet;
+	memset(&packet, 0, sizeof(packet));
+	packet.RootSignature = rootSignature;
+	packet.RootConstantBuffer = device.GetGPUVirtualAddress(constants);
+	packet.Topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	packet.VertexCount = 3;
+	packet.InstanceCount = 1;
+	DrawList drawList;
+	packet.Pipeline = compiler.Resolve(pending);
+	packet.SortKey = 0;
+	drawList.Add(packet);
+	packet.Pipeline = drawn;
+	packet.SortKey = 1;
+	drawList.Add(packet);
+	packet.Pipeline = compiler.Resolve(pending);
+	packet.SortKey = 2;
+	drawList.Add(packet);
+	drawList.Sort();
+
+	NullCommandAllocator* allocator = nullptr;
+	NullCommandList* commandList = nullptr;
+	device.CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, &allocator);
+	device.CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, nullptr, &commandList);
+	commandList->SetRecording(true);
+	D3D12_VIEWPORT viewport = { 0.0f, 0.0f, 64.0f, 64.0f, 0.0f, 1.0f };
+	D3D12_RECT scissor = { 0, 0, 64, 64 };
+	D3D12_CPU_DESCRIPTOR_HANDLE depth = { 0x100 };
+	commandList->RSSetViewports(1, &viewport);
+	commandList->RSSetScissorRects(1, &scissor);
+	commandList->OMSetRenderTargets(0, nullptr, FALSE, &depth);
+	UINT errors = device.GetErrorCount();
+	drawList.Submit(commandList);
+	commandList->Close();
+
+	bool nullBound = false;
+	for (const NullCommand& command : commandList->GetCommands())
+	{
+		nullBound = nullBound || (command.Call == NullCallCounts::SetPipelineState && !command.Args[0]);
+	}
+	Check(!nullBound, "no null pipeline is bound");
+	Check(drawList.GetStatistics().Draws == 1 && drawList.GetStatistics().Skipped == 2, "draws of a null pipeline are skipped");
+	Check(commandList->GetCounts().GetDraws() == 1 && device.GetErrorCount() == errors, "the remaining draw records cleanly");
+
+	mock.Release(0);
+	mock.Release(1);
+	Check(compiler.Wait(pending) == mock.Get(0) && !compiler.Wait(refused), "the gated compiles finish");
+	pool.Stop();
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t pipelines = 4000;
+	uint32_t threads = 4;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--pipelines") && i + 1 < argc)
+		{
+			pipelines = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+		{
+			threads = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+	pipelines = std::max(pipelines, 2u);
+
+	NullDevice device;
+	ID3D12RootSignature* rootSignature = nullptr;
+	device.CreateRootSignature(1, &rootSignature);
+
+	CheckInline(device, rootSignature);
+	CheckReadiness(device, rootSignature);
+	CheckOrder(device, rootSignature);
+	CheckSkippedDraws(device, rootSignature);
+
+	//the recording thread resolves every handle over and over while the pool compiles them; a handle only ever
+	//resolves to the fallback or to its own pipeline, every tenth is refused and stays on the fallback
+	MockCompiler mock(device, rootSignature, pipelines);
+	WorkerPool pool;
+	pool.Start(threads);
+	MockPipelineCompiler compiler;
+	compiler.Create(mock.GetFunc(), &pool);
+	MockPipelineCompiler::Handle fallback = compiler.Submit({ 0, false });
+	compiler.Wait(fallback);
+	compiler.SetFallback(fallback);
+	std::vector<MockPipelineCompiler::Handle> handles;
+	for (uint32_t id = 1; id < pipelines; ++id)
+	{
+		handles.push_back(compiler.Submit({ id, id % 10 == 0 }));
+	}
+
+	SteadyFrameClock clock;
+	bool consistent = true;
+	uint64_t resolves = 0, fallbacks = 0;
+	double start = clock.Now();
+	do
+	{
+		for (uint32_t i = 0; i < handles.size(); ++i)
+		{
+			ID3D12PipelineState* pipeline = compiler.Resolve(handles[i]);
+			consistent = consistent && (pipeline == mock.Get(0) || pipeline == mock.Get(i + 1));
+			fallbacks += pipeline == mock.Get(0) ? 1 : 0;
+		}
+		resolves += handles.size();
+	} while (compiler.GetPendingCount());
+	double seconds = clock.Now() - start;
+	pool.Stop();
+
+	bool settled = true;
+	for (uint32_t i = 0; i < handles.size(); ++i)
+	{
+		bool refused = (i + 1) % 10 == 0;
+		settled = settled && compiler.HasFailed(handles[i]) == refused && compiler.IsReady(handles[i]) == !refused &&
+			compiler.Resolve(handles[i]) == (refused ? mock.Get(0) : mock.Get(i + 1));
+	}
+	Check(consistent, "a handle resolves to the fallback or to its own pipeline");
+	Check(settled, "every handle ends ready or failed with the right pipeline");
+
+	printf("%u pipelines on %u threads | %llu resolves while compiling, %.1f%% to the fallback, %.1f ns per resolve | %s\n",
+		pipelines, threads, static_cast<unsigned long long>(resolves), resolves ? 100.0 * fallbacks / resolves : 0.0,
+		resolves ? seconds * 1e9 / resolves : 0.0, g_Failures ? "FAILED" : "scheduling, readiness and fallbacks hold");
+	return g_Failures ? 1 : 0;
+}
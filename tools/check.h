@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdio.h>
+
+//failure counting shared by the check and benchmark tools: Check reports a condition that doesn't hold and
+//counts it, main returns non-zero when g_Failures isn't 0.
+static int g_Failures = 0;
+
+static inline void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		fprintf(stderr, "FAILED: %s\n", what);
+		++g_Failures;
+	}
+}
@@ -0,0 +1,165 @@
+//frustum culling benchmark: a million objects scattered through a cube, a camera turning around in the middle
+//of it, culled by brute force over all objects, through the hierarchy, and through the hierarchy split over a
+//worker pool. The visible lists of all three are checked against each other. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/cullbench.cpp -o cullbench
+//  ./cullbench [--objects N] [--frames N] [--threads N] [--moving N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "../scene.h"
+#include "../frameclock.h"
+
+//view * proj for a camera at eye looking along yaw, row vectors and D3D depth as DirectXMath builds them
+static void MakeViewProjection(const float eye[3], float yaw, float fovY, float aspect, float zNear, float zFar, float out[16])
+{
+	float forward[3] = { sinf(yaw), 0.0f, cosf(yaw) };
+	float up[3] = { 0.0f, 1.0f, 0.0f };
+	float right[3] = { up[1] * forward[2] - up[2] * forward[1], up[2] * forward[0] - up[0] * forward[2], up[0] * forward[1] - up[1] * forward[0] };
+	float view[16] = {
+		right[0], up[0], forward[0], 0.0f,
+		right[1], up[1], forward[1], 0.0f,
+		right[2], up[2], forward[2], 0.0f,
+		-(right[0] * eye[0] + right[1] * eye[1] + right[2] * eye[2]),
+		-(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]),
+		-(forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2]), 1.0f };
+	float yScale = 1.0f / tanf(fovY * 0.5f);
+	float range = zFar / (zFar - zNear);
+	float proj[16] = {
+		yScale / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, yScale, 0.0f, 0.0f,
+		0.0f, 0.0f, range, 1.0f,
+		0.0f, 0.0f, -zNear * range, 0.0f };
+	for (int r = 0; r < 4; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			out[r * 4 + c] = view[r * 4 + 0] * proj[0 * 4 + c] + view[r * 4 + 1] * proj[1 * 4 + c] + view[r * 4 + 2] * proj[2 * 4 + c] + view[r * 4 + 3] * proj[3 * 4 + c];
+		}
+	}
+}
+
+static double Median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+static bool SameObjects(std::vector<Scene::ObjectId> a, std::vector<Scene::ObjectId> b)
+{
+	std::sort(a.begin(), a.end());
+	std::sort(b.begin(), b.end());
+	return a == b;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t objects = 1000000;
+	uint32_t frames = 30;
+	uint32_t threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	uint32_t moving = 10000;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		uint32_t value = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+		if (!strcmp(argv[i], "--objects")) objects = value;
+		else if (!strcmp(argv[i], "--frames")) frames = value;
+		else if (!strcmp(argv[i], "--threads")) threads = value;
+		else if (!strcmp(argv[i], "--moving")) moving = std::min(value, objects);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	SteadyFrameClock clock;
+	const float worldSize = 2000.0f;
+	Scene scene;
+	uint32_t seed = 1;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24); };
+	auto randomBounds = [&]()
+	{
+		float minimum[3], maximum[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			minimum[a] = (random() - 0.5f) * worldSize;
+			maximum[a] = minimum[a] + 0.5f + random() * 4.0f;
+		}
+		return SceneBounds::FromBox(minimum, maximum);
+	};
+	std::vector<SceneBounds> bounds(objects);
+	for (uint32_t i = 0; i < objects; ++i)
+	{
+		bounds[i] = randomBounds();
+		scene.Add(bounds[i], i);
+	}
+
+	double start = clock.Now();
+	scene.Build();
+	double buildMs = (clock.Now() - start) * 1000.0;
+
+	WorkerPool pool;
+	pool.Start(threads);
+
+	std::vector<Scene::ObjectId> bruteVisible, visible, parallelVisible;
+	std::vector<double> bruteTimes, hierarchyTimes, parallelTimes, refitTimes;
+	uint64_t visibleTotal = 0, testedTotal = 0, acceptedTotal = 0;
+	bool mismatch = false;
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		//move some objects a little, as animated ones would every frame
+		start = clock.Now();
+		for (uint32_t i = 0; i < moving; ++i)
+		{
+			SceneBounds& moved = bounds[(i * 7919u) % objects];
+			for (int a = 0; a < 3; ++a)
+			{
+				moved.Center[a] += random() - 0.5f;
+			}
+			scene.SetBounds((i * 7919u) % objects, moved);
+		}
+		scene.Refit();
+		refitTimes.push_back((clock.Now() - start) * 1000.0);
+
+		float eye[3] = { 0.0f, 0.0f, 0.0f };
+		float viewProjection[16];
+		MakeViewProjection(eye, float(frame) * 0.2f, 3.14159265f / 4.0f, 16.0f / 9.0f, 0.1f, 1000.0f, viewProjection);
+		Frustum frustum = Frustum::FromViewProjection(viewProjection);
+
+		start = clock.Now();
+		scene.CullBruteForce(frustum, bruteVisible);
+		bruteTimes.push_back((clock.Now() - start) * 1000.0);
+
+		start = clock.Now();
+		scene.Cull(frustum, visible);
+		hierarchyTimes.push_back((clock.Now() - start) * 1000.0);
+		visibleTotal += scene.GetStatistics().Visible;
+		testedTotal += scene.GetStatistics().ObjectsTested;
+		acceptedTotal += scene.GetStatistics().ObjectsAccepted;
+
+		start = clock.Now();
+		scene.Cull(frustum, parallelVisible, &pool);
+		parallelTimes.push_back((clock.Now() - start) * 1000.0);
+
+		if (!SameObjects(bruteVisible, visible) || !SameObjects(bruteVisible, parallelVisible))
+		{
+			fprintf(stderr, "frame %u: visible lists differ, brute force %zu hierarchy %zu parallel %zu\n",
+				frame, bruteVisible.size(), visible.size(), parallelVisible.size());
+			mismatch = true;
+		}
+	}
+	pool.Stop();
+
+	printf("%u objects, %u nodes, build %.1f ms, %u moving objects refit %.2f ms\n", objects, scene.GetNodeCount(), buildMs, moving, Median(refitTimes));
+	printf("visible %.0f per frame, %.0f tested, %.0f accepted with their node\n",
+		double(visibleTotal) / frames, double(testedTotal) / frames, double(acceptedTotal) / frames);
+	printf("cull ms p50: brute force %.3f | hierarchy %.3f | hierarchy on %u+1 threads %.3f\n",
+		Median(bruteTimes), Median(hierarchyTimes), threads, Median(parallelTimes));
+	return mismatch ? 1 : 0;
+}
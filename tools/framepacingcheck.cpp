@@ -0,0 +1,214 @@
+//frame pacing checks against a SimulatedFrameClock and a simulated display: which swapchain features each mode
+//asks for, that a frame rate cap holds the frame rate without sleeping between input and present in low latency
+//mode, that a late frame starts a new schedule instead of rushing the next ones, and that a low maximum frame
+//latency cuts input-to-photon time against the default three queued frames, with and without vsync. Reports the
+//frame rate and latencies of each run. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/framepacingcheck.cpp -o framepacingcheck
+//  ./framepacingcheck [--frames N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "../framepacing.h"
+#include "check.h"
+
+static const double Refresh = 1.0 / 60.0;
+
+static FramePacingSettings MakeSettings(PresentMode mode, uint32_t maxFrameLatency, bool vsync, double frameRateCap)
+{
+	FramePacingSettings settings;
+	settings.Mode = mode;
+	settings.MaxFrameLatency = maxFrameLatency;
+	settings.VSync = vsync;
+	settings.FrameRateCap = frameRateCap;
+	return settings;
+}
+
+struct Run
+{
+	std::vector<double> InputTimes; //per frame, when BeginFrame sampled input
+	double FrameRate;
+	double AverageInputToPhoton; //from sampling input to the frame reaching the display
+	FramePacer::Statistics Stats;
+};
+
+//a display scanning out at 60Hz. Presented frames queue up and are shown at the next vsync after the one before
+//them, without vsync they are shown right away. In low latency mode the latency wait blocks while
+//MaxFrameLatency frames are queued, in default mode Present blocks while three are.
+static Run Simulate(const FramePacingSettings& settings, uint32_t frames, const std::function<double(uint32_t)>& cpuTime)
+{
+	SimulatedFrameClock clock;
+	FramePacer pacer;
+	pacer.Create(settings, &clock, true);
+
+	Run run;
+	std::deque<double> queued; //display times of presented frames not shown yet
+	double lastDisplay = 0.0;
+	double photonTotal = 0.0;
+	auto retire = [&]()
+	{
+		while (!queued.empty() && queued.front() <= clock.Now())
+		{
+			queued.pop_front();
+		}
+	};
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		double latencyWait = 0.0;
+		retire();
+		if (pacer.UseWaitableObject() && queued.size() >= pacer.GetMaximumFrameLatency())
+		{
+			double start = clock.Now();
+			clock.SleepUntil(queued[queued.size() - pacer.GetMaximumFrameLatency()]);
+			latencyWait = clock.Now() - start;
+			retire();
+		}
+
+		double input = pacer.BeginFrame(latencyWait);
+		run.InputTimes.push_back(input);
+		clock.Advance(cpuTime(frame));
+
+		retire();
+		if (!pacer.UseWaitableObject() && queued.size() >= pacer.GetMaximumFrameLatency())
+		{
+			clock.SleepUntil(queued.front());
+			retire();
+		}
+		double display = clock.Now();
+		if (pacer.GetSyncInterval())
+		{
+			double vsync = std::max(display, lastDisplay + Refresh);
+			display = std::ceil(vsync / Refresh - 1e-9) * Refresh;
+		}
+		lastDisplay = display;
+		queued.push_back(display);
+		photonTotal += display - input;
+		pacer.EndFrame();
+	}
+
+	run.Stats = pacer.GetStatistics();
+	run.FrameRate = frames > 1 ? (frames - 1) / (run.InputTimes.back() - run.InputTimes.front()) : 0.0;
+	run.AverageInputToPhoton = frames ? photonTotal / frames : 0.0;
+	return run;
+}
+
+static void Report(const char* name, const Run& run)
+{
+	printf("%-34s %6.1f fps | input to present %5.2f ms, to photon %6.2f ms | waiting %5.2f ms per frame\n", name, run.FrameRate,
+		run.Stats.AverageInputToPresent * 1e3, run.AverageInputToPhoton * 1e3, run.Stats.AverageWait * 1e3);
+}
+
+static void CheckSettings()
+{
+	SimulatedFrameClock clock;
+	FramePacer pacer;
+
+	pacer.Create(MakeSettings(PresentMode::Default, 1, false, 0.0), &clock, true);
+	Check(!pacer.UseWaitableObject() && !pacer.UseTearing() && pacer.GetMaximumFrameLatency() == FramePacer::DefaultFrameLatency,
+		"default mode keeps DXGI's queue and doesn't tear");
+	Check(pacer.GetSyncInterval() == 0, "no vsync presents with sync interval 0");
+
+	pacer.Create(MakeSettings(PresentMode::LowLatency, 2, false, 0.0), &clock, true);
+	Check(pacer.UseWaitableObject() && pacer.UseTearing() && pacer.GetMaximumFrameLatency() == 2, "low latency mode waits and tears without vsync");
+	pacer.Create(MakeSettings(PresentMode::LowLatency, 2, false, 0.0), &clock, false);
+	Check(!pacer.UseTearing(), "no tearing where the system doesn't support it");
+	pacer.Create(MakeSettings(PresentMode::LowLatency, 2, true, 0.0), &clock, true);
+	Check(!pacer.UseTearing() && pacer.GetSyncInterval() == 1, "vsync never tears");
+	pacer.Create(MakeSettings(PresentMode::LowLatency, 0, true, 0.0), &clock, true);
+	Check(pacer.GetMaximumFrameLatency() == 1, "a maximum frame latency of 0 becomes 1");
+}
+
+static void CheckCap(uint32_t frames)
+{
+	//2ms of CPU work capped at 100fps without vsync, both modes hold the cap
+	auto cpu = [](uint32_t) { return 0.002; };
+	Run lowLatency = Simulate(MakeSettings(PresentMode::LowLatency, 1, false, 100.0), frames, cpu);
+	Run queued = Simulate(MakeSettings(PresentMode::Default, 1, false, 100.0), frames, cpu);
+	Report("capped at 100, low latency", lowLatency);
+	Report("capped at 100, default", queued);
+	Check(std::fabs(lowLatency.FrameRate - 100.0) < 0.5 && std::fabs(queued.FrameRate - 100.0) < 0.5, "the cap holds the frame rate");
+	Check(std::fabs(lowLatency.Stats.AverageWait - 0.008) < 1e-4 && std::fabs(queued.Stats.AverageWait - 0.008) < 1e-4,
+		"the cap sleeps what is left of the interval");
+
+	//low latency mode sleeps before sampling input, default mode after present, neither between them
+	Check(std::fabs(lowLatency.Stats.MaxInputToPresent - 0.002) < 1e-9 && std::fabs(queued.Stats.MaxInputToPresent - 0.002) < 1e-9,
+		"no sleep between input and present");
+	Check(lowLatency.Stats.Frames == frames && std::fabs(lowLatency.Stats.LastInputToPresent - 0.002) < 1e-9, "statistics count every frame");
+
+	//a 50ms hitch in the middle: the frames after it keep the interval instead of catching up
+	auto hitch = [frames](uint32_t frame) { return frame == frames / 2 ? 0.050 : 0.002; };
+	Run late = Simulate(MakeSettings(PresentMode::LowLatency, 1, false, 100.0), frames, hitch);
+	double shortest = 1.0;
+	for (size_t i = frames / 2 + 1; i < late.InputTimes.size(); ++i)
+	{
+		shortest = std::min(shortest, late.InputTimes[i] - late.InputTimes[i - 1]);
+	}
+	Check(shortest > 0.01 - 1e-9, "a late frame doesn't make the next ones rush");
+	Check(std::fabs(late.Stats.MaxInputToPresent - 0.050) < 1e-9, "the late frame is the slowest");
+	Run lateQueued = Simulate(MakeSettings(PresentMode::Default, 1, false, 100.0), frames, hitch);
+	shortest = 1.0;
+	for (size_t i = frames / 2 + 2; i < lateQueued.InputTimes.size(); ++i)
+	{
+		shortest = std::min(shortest, lateQueued.InputTimes[i] - lateQueued.InputTimes[i - 1]);
+	}
+	Check(shortest > 0.01 - 1e-9, "a late frame doesn't make the next ones rush in default mode");
+}
+
+static void CheckLatency(uint32_t frames)
+{
+	//4ms of CPU work under vsync at 60Hz: the CPU runs ahead until the queue is full, every frame then waits
+	//for as many refreshes as there are frames in front of it
+	auto cpu = [](uint32_t) { return 0.004; };
+	Run queued = Simulate(MakeSettings(PresentMode::Default, 1, true, 0.0), frames, cpu);
+	Run latency2 = Simulate(MakeSettings(PresentMode::LowLatency, 2, true, 0.0), frames, cpu);
+	Run latency1 = Simulate(MakeSettings(PresentMode::LowLatency, 1, true, 0.0), frames, cpu);
+	Report("vsync, default", queued);
+	Report("vsync, low latency 2", latency2);
+	Report("vsync, low latency 1", latency1);
+	Check(std::fabs(queued.FrameRate - 60.0) < 0.5 && std::fabs(latency1.FrameRate - 60.0) < 0.5, "vsync holds the refresh rate");
+	Check(queued.AverageInputToPhoton > 2.5 * Refresh, "three queued frames take about three refreshes to reach the display");
+	Check(latency2.AverageInputToPhoton < queued.AverageInputToPhoton - 0.9 * Refresh, "each frame less in the queue saves a refresh");
+	Check(latency1.AverageInputToPhoton <= Refresh + 1e-9, "a frame latency of 1 shows each frame at the next refresh");
+	Check(latency1.Stats.AverageWait > 0.0 && queued.Stats.AverageWait == 0.0, "low latency mode waits on the latency object before input");
+
+	//a frame rate cap just under the refresh rate keeps the queue from filling up, without vsync the display
+	//shows frames as they come and the queue never fills
+	Run capped = Simulate(MakeSettings(PresentMode::LowLatency, 2, true, 59.0), frames, cpu);
+	Report("vsync, low latency 2, capped at 59", capped);
+	Check(capped.AverageInputToPhoton < latency2.AverageInputToPhoton, "a cap under the refresh rate drains the queue");
+	Run tearing = Simulate(MakeSettings(PresentMode::LowLatency, 1, false, 0.0), frames, cpu);
+	Report("no vsync, low latency 1", tearing);
+	Check(std::fabs(tearing.FrameRate - 250.0) < 1.0 && std::fabs(tearing.AverageInputToPhoton - 0.004) < 1e-9,
+		"without vsync or cap frames go out as fast as the CPU makes them");
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t frames = 600;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+		{
+			frames = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+	if (frames < 10)
+	{
+		fprintf(stderr, "--frames has to be at least 10\n");
+		return 1;
+	}
+
+	CheckSettings();
+	CheckCap(frames);
+	CheckLatency(frames);
+	printf("%s\n", g_Failures ? "FAILED" : "caps hold and lower frame latency shortens input to photon");
+	return g_Failures ? 1 : 0;
+}
@@ -0,0 +1,174 @@
+//CPU frame profiler checks against a SimulatedFrameClock: phase times, a phase entered twice adding up, the
+//nearest rank percentiles of a known distribution, hitches against the median, the ring keeping only the last
+//frames, and the periodic log lines and CSV rows. Then reports what a profiled frame with every phase costs on
+//the steady clock. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/frameprofilercheck.cpp -o frameprofilercheck
+//  ./frameprofilercheck [--frames N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../frameprofiler.h"
+#include "check.h"
+
+static bool Near(double a, double b)
+{
+	return fabs(a - b) < 1e-9;
+}
+
+static void CheckPhases()
+{
+	SimulatedFrameClock clock;
+	FrameProfiler profiler;
+	profiler.Create(&clock, 16);
+
+	Check(profiler.GetReport().FrameCount == 0 && profiler.GetLastPhaseTime(FrameProfiler::Recording) == 0.0, "an empty profiler reports nothing");
+
+	profiler.BeginFrame();
+	profiler.BeginPhase(FrameProfiler::EventPump);
+	clock.Advance(0.001);
+	profiler.BeginPhase(FrameProfiler::Recording); //ends the event pump
+	clock.Advance(0.004);
+	profiler.EndPhase();
+	clock.Advance(0.002); //between phases, only counted in the frame
+	profiler.BeginPhase(FrameProfiler::Recording);
+	clock.Advance(0.003);
+	profiler.BeginPhase(FrameProfiler::Present);
+	clock.Advance(0.005);
+	profiler.EndFrame(); //ends the present
+
+	FrameProfiler::Report report = profiler.GetReport();
+	Check(report.FrameCount == 1 && profiler.GetFrameIndex() == 1, "one frame recorded");
+	Check(Near(profiler.GetLastPhaseTime(FrameProfiler::EventPump), 0.001), "starting a phase ends the running one");
+	Check(Near(profiler.GetLastPhaseTime(FrameProfiler::Recording), 0.007), "a phase entered twice adds up");
+	Check(Near(profiler.GetLastPhaseTime(FrameProfiler::Present), 0.005), "ending the frame ends the running phase");
+	Check(profiler.GetLastPhaseTime(FrameProfiler::FenceWait) == 0.0, "phases not entered are zero");
+	Check(Near(report.Frame.Max, 0.015), "the frame time includes the time between phases");
+
+	//the next frame starts from zero
+	profiler.BeginFrame();
+	profiler.BeginPhase(FrameProfiler::Present);
+	clock.Advance(0.002);
+	profiler.EndFrame();
+	Check(Near(profiler.GetLastPhaseTime(FrameProfiler::Present), 0.002) && profiler.GetLastPhaseTime(FrameProfiler::Recording) == 0.0,
+		"phases don't carry over to the next frame");
+}
+
+static void RunFrame(SimulatedFrameClock& clock, FrameProfiler& profiler, double seconds)
+{
+	profiler.BeginFrame();
+	profiler.BeginPhase(FrameProfiler::Recording);
+	clock.Advance(seconds);
+	profiler.EndFrame();
+}
+
+static void CheckPercentiles()
+{
+	SimulatedFrameClock clock;
+	FrameProfiler profiler;
+	profiler.Create(&clock, 100, 2.5);
+
+	//1 to 100ms in a shuffled order, so the nearest rank percentiles are the ms values themselves
+	for (uint32_t i = 0; i < 100; ++i)
+	{
+		RunFrame(clock, profiler, ((i * 37) % 100 + 1) * 0.001);
+	}
+	FrameProfiler::Report report = profiler.GetReport();
+	Check(report.FrameCount == 100, "the ring is full");
+	Check(Near(report.Frame.P50, 0.050) && Near(report.Frame.P95, 0.095) && Near(report.Frame.P99, 0.099) && Near(report.Frame.Max, 0.100),
+		"nearest rank percentiles");
+	Check(Near(report.Frame.Mean, 0.0505), "mean frame time");
+	Check(Near(report.Phases[FrameProfiler::Recording].P99, 0.099) && report.Phases[FrameProfiler::Submit].Max == 0.0, "phase percentiles");
+
+	//2.5 times the median is 125ms, nothing is above it
+	Check(Near(report.HitchThreshold, 0.125) && report.Hitches == 0, "no hitches under the threshold");
+
+	//100 more frames replace the old ones: 95 at 10ms and 5 hitches at 50ms
+	for (uint32_t i = 0; i < 100; ++i)
+	{
+		RunFrame(clock, profiler, (i % 20 == 19) ? 0.050 : 0.010);
+	}
+	report = profiler.GetReport();
+	Check(report.FrameCount == 100 && Near(report.Frame.Max, 0.050), "the ring only keeps the last frames");
+	Check(Near(report.Frame.P50, 0.010) && Near(report.Frame.P95, 0.010) && Near(report.Frame.P99, 0.050), "percentiles of the new frames");
+	Check(report.Hitches == 5 && Near(report.HitchThreshold, 0.025), "frames over 2.5 times the median are hitches");
+}
+
+static void CheckReports()
+{
+	SimulatedFrameClock clock;
+	FrameProfiler profiler;
+	profiler.Create(&clock, 64);
+
+	std::vector<std::string> lines;
+	profiler.SetLog([&lines](const char* line) { lines.push_back(line); }, 10);
+	const char* csvName = "frameprofilercheck.csv";
+	Check(profiler.OpenCsv(csvName), "the CSV file opens");
+	for (uint32_t i = 0; i < 35; ++i)
+	{
+		RunFrame(clock, profiler, 0.016);
+	}
+
+	Check(lines.size() == 3, "a report every 10 frames");
+	Check(!lines.empty() && lines.back().find("p50 16.00") != std::string::npos && lines.back().find("in 30 frames") != std::string::npos &&
+		lines.back().find("Recording 16.00/16.00") != std::string::npos, "the report line holds the frame and phase times");
+
+	std::ifstream csv(csvName);
+	std::string header, row;
+	std::vector<std::string> rows;
+	std::getline(csv, header);
+	while (std::getline(csv, row))
+	{
+		rows.push_back(row);
+	}
+	Check(header.compare(0, 17, "frame,frames,p50_") == 0 && header.find("FenceWait_p99_ms") != std::string::npos, "the CSV header names every column");
+	Check(rows.size() == 3 && rows[2].compare(0, 9, "30,30,16,") == 0, "a CSV row per report");
+	csv.close();
+	remove(csvName);
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t frames = 100000;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+		{
+			frames = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+
+	CheckPhases();
+	CheckPercentiles();
+	CheckReports();
+
+	//the cost of profiling a frame through every phase, reports excluded
+	SteadyFrameClock clock;
+	FrameProfiler profiler;
+	profiler.Create(&clock);
+	double start = clock.Now();
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		profiler.BeginFrame();
+		for (uint32_t p = 0; p < FrameProfiler::PhaseCount; ++p)
+		{
+			profiler.BeginPhase(static_cast<FrameProfiler::Phase>(p));
+		}
+		profiler.EndFrame();
+	}
+	double nsPerFrame = frames ? (clock.Now() - start) * 1e9 / frames : 0.0;
+	double reportStart = clock.Now();
+	FrameProfiler::Report report = profiler.GetReport();
+	double reportUs = (clock.Now() - reportStart) * 1e6;
+
+	printf("%.0f ns to profile a frame of %u phases | %.1f us for a report of %u frames | %s\n", nsPerFrame, uint32_t(FrameProfiler::PhaseCount),
+		reportUs, report.FrameCount, g_Failures ? "FAILED" : "phases, percentiles, hitches and reports add up");
+	return g_Failures ? 1 : 0;
+}
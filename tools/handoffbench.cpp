@@ -0,0 +1,120 @@
+//latency of the input snapshot handoff between the event thread and the render thread: an event thread
+//publishes timestamped snapshots through a TripleBuffer, a render thread consumes the newest one at the start
+//of every frame, and the time from publishing to consuming is reported as percentiles. With --frame-ms 0 the
+//consumer spins, which measures the handoff itself; otherwise it is paced like a frame loop and the latency
+//includes waiting for the next frame. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/handoffbench.cpp -o handoffbench
+//  ./handoffbench [--events N] [--interval-us N] [--frame-ms N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "../triplebuffer.h"
+#include "../frameclock.h"
+
+struct Snapshot
+{
+	uint64_t Sequence;
+	double Time;
+	bool Quit;
+};
+
+int main(int argc, char* argv[])
+{
+	uint32_t events = 100000;
+	double intervalUs = 50.0;
+	double frameMs = 0.0;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (!strcmp(argv[i], "--events")) events = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+		else if (!strcmp(argv[i], "--interval-us")) intervalUs = atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "--frame-ms")) frameMs = atof(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+	if (!events)
+	{
+		//the last event carries Quit, without one the consumer would never stop
+		fprintf(stderr, "--events has to be at least 1\n");
+		return 2;
+	}
+
+	SteadyFrameClock clock;
+	TripleBuffer<Snapshot> handoff;
+	std::vector<double> latencies;
+	latencies.reserve(events);
+	uint64_t lastSequence = 0;
+	uint64_t skipped = 0;
+
+	std::thread consumer([&]()
+	{
+		double nextFrame = clock.Now();
+		for (;;)
+		{
+			if (frameMs > 0.0)
+			{
+				nextFrame += frameMs / 1000.0;
+				clock.SleepUntil(nextFrame);
+			}
+			if (!handoff.Consume())
+			{
+				continue;
+			}
+			const Snapshot& snapshot = handoff.GetReadBuffer();
+			double now = clock.Now();
+			if (snapshot.Sequence <= lastSequence)
+			{
+				fprintf(stderr, "snapshot %llu consumed after %llu\n", (unsigned long long)snapshot.Sequence, (unsigned long long)lastSequence);
+				exit(1);
+			}
+			skipped += snapshot.Sequence - lastSequence - 1;
+			lastSequence = snapshot.Sequence;
+			latencies.push_back(now - snapshot.Time);
+			if (snapshot.Quit)
+			{
+				return;
+			}
+		}
+	});
+
+	double next = clock.Now();
+	for (uint32_t e = 1; e <= events; ++e)
+	{
+		next += intervalUs / 1e6;
+		while (clock.Now() < next)
+		{
+			//spin, sleeping is far coarser than the intervals measured here
+		}
+		Snapshot& snapshot = handoff.GetWriteBuffer();
+		snapshot.Sequence = e;
+		snapshot.Quit = (e == events);
+		snapshot.Time = clock.Now();
+		handoff.Publish();
+	}
+	consumer.join();
+
+	std::sort(latencies.begin(), latencies.end());
+	auto rank = [&](double p)
+	{
+		if (latencies.empty())
+		{
+			return 0.0;
+		}
+		size_t index = static_cast<size_t>(p * double(latencies.size()) + 0.999999);
+		return latencies[index ? std::min(index, latencies.size()) - 1 : 0] * 1e6;
+	};
+	printf("%u events every %.1f us, consumer %s: %zu consumed, %llu skipped | publish to consume us p50 %.2f p95 %.2f p99 %.2f max %.2f\n",
+		events, intervalUs, frameMs > 0.0 ? "paced" : "spinning", latencies.size(), (unsigned long long)skipped,
+		rank(0.50), rank(0.95), rank(0.99), rank(1.0));
+	return 0;
+}
@@ -0,0 +1,187 @@
+//CPU side of GPU driven drawing: checks the command record layout and the command signature rules against what
+//D3D12 expects, then culls a scene with the reference of the culling compute shader and compares the draws its
+//argument buffer holds with a brute force cull of the same scene. Reports the argument bytes a frame produces
+//and how long the reference takes, the GPU does the same work in a single dispatch. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/indirectbench.cpp -o indirectbench
+//  ./indirectbench [--objects N] [--frames N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "../indirectdraw.h"
+#include "../frameclock.h"
+#include "check.h"
+
+//the layouts CreateCommandSignature accepts and rejects
+static void CheckLayoutRules()
+{
+	IndirectCommandLayout layout;
+	Check(FAILED(layout.Validate()), "empty layout is rejected");
+
+	//the layout main.cpp draws with: worldmatrix CBV, vertex and index buffer, indexed draw
+	uint32_t cbv = layout.AddConstantBufferView(0);
+	uint32_t vb = layout.AddVertexBufferView(0);
+	uint32_t ib = layout.AddIndexBufferView();
+	uint32_t draw = layout.AddDrawIndexed();
+	Check(SUCCEEDED(layout.Validate()), "CBV, VB, IB, indexed draw is valid");
+	Check(layout.GetOffset(cbv) == 0 && layout.GetOffset(vb) == 8 && layout.GetOffset(ib) == 24 && layout.GetOffset(draw) == 40, "arguments are packed in order");
+	Check(layout.GetByteStride() == 60, "stride is the sum of the argument sizes");
+	Check(layout.NeedsRootSignature(), "a root CBV needs the root signature");
+	D3D12_COMMAND_SIGNATURE_DESC desc = layout.GetDesc();
+	Check(desc.ByteStride == 60 && desc.NumArgumentDescs == 4 && desc.pArgumentDescs[3].Type == D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED, "signature desc mirrors the layout");
+
+	layout.Reset();
+	uint32_t constants = layout.AddConstants(1, 2, 3);
+	layout.AddDraw();
+	Check(SUCCEEDED(layout.Validate()) && layout.GetSize(constants) == 12 && layout.GetByteStride() == 28, "constants take 4 bytes each");
+
+	layout.Reset();
+	layout.AddDraw();
+	Check(SUCCEEDED(layout.Validate()) && !layout.NeedsRootSignature(), "a lone draw needs no root signature");
+
+	layout.Reset();
+	layout.AddDraw();
+	layout.AddVertexBufferView(0);
+	Check(FAILED(layout.Validate()), "draw must come last");
+
+	layout.Reset();
+	layout.AddDraw();
+	layout.AddDraw();
+	Check(FAILED(layout.Validate()), "one draw per record");
+
+	layout.Reset();
+	layout.AddVertexBufferView(1);
+	layout.AddVertexBufferView(1);
+	layout.AddDraw();
+	Check(FAILED(layout.Validate()), "vertex buffer slot set twice");
+
+	layout.Reset();
+	layout.AddIndexBufferView();
+	layout.AddDispatch();
+	Check(FAILED(layout.Validate()), "dispatch with input assembler state");
+
+	layout.Reset();
+	layout.AddConstants(0, 0, 0);
+	layout.AddDispatch();
+	Check(FAILED(layout.Validate()), "empty constant range");
+}
+
+static double Median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t objects = 100000;
+	uint32_t frames = 20;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		uint32_t value = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+		if (!strcmp(argv[i], "--objects")) objects = value;
+		else if (!strcmp(argv[i], "--frames")) frames = value;
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	CheckLayoutRules();
+
+	IndirectCommandLayout layout;
+	uint32_t cbvArgument = layout.AddConstantBufferView(0);
+	uint32_t vbArgument = layout.AddVertexBufferView(0);
+	uint32_t ibArgument = layout.AddIndexBufferView();
+	uint32_t drawArgument = layout.AddDrawIndexed();
+	const D3D12_GPU_VIRTUAL_ADDRESS constantsBase = 0x100000000ull;
+	const UINT constantsStride = 256;
+
+	//every object's record points at its own constants, which is how the visible ones are told apart below
+	Scene scene;
+	std::vector<GpuCullObject> cullObjects(objects);
+	std::vector<uint8_t> templates(size_t(objects) * layout.GetByteStride());
+	uint32_t seed = 1;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24); };
+	for (uint32_t i = 0; i < objects; ++i)
+	{
+		float minimum[3], maximum[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			minimum[a] = (random() - 0.5f) * 1000.0f;
+			maximum[a] = minimum[a] + 0.5f + random() * 4.0f;
+		}
+		SceneBounds bounds = SceneBounds::FromBox(minimum, maximum);
+		scene.Add(bounds, i);
+		cullObjects[i] = GpuCullObject::Make(bounds, i);
+
+		void* record = &templates[size_t(i) * layout.GetByteStride()];
+		D3D12_VERTEX_BUFFER_VIEW vertexBuffer = { 0x200000000ull, 3 * 20, 20 };
+		D3D12_INDEX_BUFFER_VIEW indexBuffer = { 0x300000000ull, 3 * 2, DXGI_FORMAT_R16_UINT };
+		D3D12_DRAW_INDEXED_ARGUMENTS drawIndexed = { 3, 1, 0, 0, 0 };
+		layout.Write(record, cbvArgument, constantsBase + D3D12_GPU_VIRTUAL_ADDRESS(i) * constantsStride);
+		layout.Write(record, vbArgument, vertexBuffer);
+		layout.Write(record, ibArgument, indexBuffer);
+		layout.Write(record, drawArgument, drawIndexed);
+	}
+	scene.Build();
+
+	SteadyFrameClock clock;
+	std::vector<uint8_t> commands(templates.size());
+	std::vector<Scene::ObjectId> bruteVisible, indirectVisible;
+	std::vector<double> cullTimes;
+	uint64_t drawsTotal = 0;
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		//camera at the origin turning around, as in cullbench
+		float yaw = float(frame) * 0.3f;
+		float forward[3] = { sinf(yaw), 0.0f, cosf(yaw) };
+		float right[3] = { forward[2], 0.0f, -forward[0] };
+		float yScale = 1.0f / tanf(3.14159265f / 8.0f), xScale = yScale * 9.0f / 16.0f;
+		float zNear = 0.1f, zFar = 500.0f, range = zFar / (zFar - zNear);
+		float viewProjection[16] = {
+			right[0] * xScale, 0.0f, forward[0] * range, forward[0],
+			0.0f, yScale, 0.0f, 0.0f,
+			right[2] * xScale, 0.0f, forward[2] * range, forward[2],
+			0.0f, 0.0f, -zNear * range, 0.0f };
+		Frustum frustum = Frustum::FromViewProjection(viewProjection);
+
+		GpuCullConstants constants = GpuCullConstants::Make(frustum, objects, layout, objects);
+		double start = clock.Now();
+		uint32_t count = CullIndirectCommandsReference(constants, cullObjects.data(), templates.data(), commands.data());
+		cullTimes.push_back((clock.Now() - start) * 1000.0);
+		drawsTotal += count;
+
+		indirectVisible.clear();
+		for (uint32_t c = 0; c < count; ++c)
+		{
+			D3D12_GPU_VIRTUAL_ADDRESS address;
+			memcpy(&address, &commands[size_t(c) * layout.GetByteStride() + layout.GetOffset(cbvArgument)], sizeof(address));
+			indirectVisible.push_back(static_cast<Scene::ObjectId>((address - constantsBase) / constantsStride));
+		}
+		scene.CullBruteForce(frustum, bruteVisible);
+		std::sort(bruteVisible.begin(), bruteVisible.end());
+		if (indirectVisible != bruteVisible)
+		{
+			fprintf(stderr, "frame %u: argument buffer draws %zu objects, brute force finds %zu\n", frame, indirectVisible.size(), bruteVisible.size());
+			++g_Failures;
+		}
+
+		//a full argument buffer drops the draws past its end instead of overrunning it
+		constants.MaxCommands = count / 2;
+		Check(CullIndirectCommandsReference(constants, cullObjects.data(), templates.data(), commands.data()) == count / 2, "draw count clamps to MaxCommands");
+	}
+
+	double draws = double(drawsTotal) / (frames ? frames : 1);
+	printf("%u objects, record %u bytes: %.0f draws per frame, %.1f KB of arguments | reference cull p50 %.3f ms | %s\n",
+		objects, layout.GetByteStride(), draws, draws * layout.GetByteStride() / 1024.0, Median(cullTimes),
+		g_Failures ? "FAILED" : "layout and draws match");
+	return g_Failures ? 1 : 0;
+}
@@ -0,0 +1,332 @@
+//import time mesh optimization: runs meshoptimizer.h over a large grid given as an unindexed triangle soup in random
+//order and over a clump of spheres, reports the vertex cache and fetch statistics before and after, how fast every
+//step runs, and the overdraw of the spheres rasterized from six sides with and without OptimizeOverdraw. Checks
+//that the optimized meshes still hold exactly the triangles they started with. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/meshbench.cpp -o meshbench
+//  ./meshbench [--grid N] [--spheres N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "../meshoptimizer.h"
+#include "../frameclock.h"
+#include "check.h"
+
+//same layout as VertexTypes::P3F_T2F
+struct Vertex
+{
+	float pos[3];
+	float tex[2];
+};
+
+static uint32_t g_Seed = 1;
+static uint32_t Random()
+{
+	g_Seed = g_Seed * 1664525u + 1013904223u;
+	return g_Seed >> 8;
+}
+
+//triangles as the positions of their corners, rotated so the smallest corner comes first to keep the winding
+struct TriangleKey
+{
+	float Corners[9];
+	bool operator<(const TriangleKey& other) const { return std::lexicographical_compare(Corners, Corners + 9, other.Corners, other.Corners + 9); }
+	bool operator==(const TriangleKey& other) const { return std::equal(Corners, Corners + 9, other.Corners); }
+};
+
+static std::vector<TriangleKey> GetTriangles(const std::vector<uint8_t>& vertices, const uint32_t* indices, size_t indexCount)
+{
+	const Vertex* v = reinterpret_cast<const Vertex*>(vertices.data());
+	std::vector<TriangleKey> triangles(indexCount / 3);
+	for (size_t t = 0; t < triangles.size(); ++t)
+	{
+		const float* corners[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			corners[c] = v[indices ? indices[t * 3 + c] : t * 3 + c].pos;
+		}
+		int first = 0;
+		for (int c = 1; c < 3; ++c)
+		{
+			if (std::lexicographical_compare(corners[c], corners[c] + 3, corners[first], corners[first] + 3))
+			{
+				first = c;
+			}
+		}
+		for (int c = 0; c < 3; ++c)
+		{
+			memcpy(&triangles[t].Corners[c * 3], corners[(first + c) % 3], 3 * sizeof(float));
+		}
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+//grid of n by n vertices as a soup of separate triangles in random order, every vertex repeated by its triangles
+static std::vector<uint8_t> MakeGridSoup(uint32_t n)
+{
+	std::vector<Vertex> soup;
+	auto corner = [n](uint32_t x, uint32_t y)
+	{
+		Vertex vertex = { { float(x), float(y), float((x * 7 + y * 13) % 5) }, { float(x) / float(n), float(y) / float(n) } };
+		return vertex;
+	};
+	for (uint32_t y = 0; y + 1 < n; ++y)
+	{
+		for (uint32_t x = 0; x + 1 < n; ++x)
+		{
+			Vertex quad[6] = { corner(x, y), corner(x, y + 1), corner(x + 1, y), corner(x + 1, y), corner(x, y + 1), corner(x + 1, y + 1) };
+			soup.insert(soup.end(), quad, quad + 6);
+		}
+	}
+	for (size_t t = soup.size() / 3; t > 1; --t)
+	{
+		size_t other = Random() % t;
+		std::swap_ranges(&soup[(t - 1) * 3], &soup[(t - 1) * 3 + 3], &soup[other * 3]);
+	}
+	std::vector<uint8_t> bytes(soup.size() * sizeof(Vertex));
+	memcpy(bytes.data(), soup.data(), bytes.size());
+	return bytes;
+}
+
+//count^3 overlapping spheres in a cube, indexed, wound outwards, triangles in random order
+static void MakeSpheres(uint32_t count, std::vector<uint8_t>& vertexBytes, std::vector<uint32_t>& indices)
+{
+	const uint32_t Rings = 12, Segments = 24;
+	std::vector<Vertex> vertices;
+	for (uint32_t s = 0; s < count * count * count; ++s)
+	{
+		float center[3] = { float(s % count), float(s / count % count), float(s / count / count) };
+		uint32_t base = static_cast<uint32_t>(vertices.size());
+		for (uint32_t r = 0; r <= Rings; ++r)
+		{
+			for (uint32_t g = 0; g <= Segments; ++g)
+			{
+				float theta = 3.14159265f * float(r) / float(Rings), phi = 6.2831853f * float(g) / float(Segments);
+				Vertex vertex = { { center[0] + 0.7f * sinf(theta) * cosf(phi), center[1] + 0.7f * cosf(theta), center[2] + 0.7f * sinf(theta) * sinf(phi) },
+					{ float(g) / float(Segments), float(r) / float(Rings) } };
+				vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t r = 0; r < Rings; ++r)
+		{
+			for (uint32_t g = 0; g < Segments; ++g)
+			{
+				uint32_t a = base + r * (Segments + 1) + g, b = a + Segments + 1;
+				uint32_t quad[6] = { a, a + 1, b, b, a + 1, b + 1 };
+				for (int t = 0; t < 6; t += 3)
+				{
+					//skip the slivers at the poles, flip what faces inwards
+					const float* p0 = vertices[quad[t]].pos;
+					const float* p1 = vertices[quad[t + 1]].pos;
+					const float* p2 = vertices[quad[t + 2]].pos;
+					float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+					float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+					float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+					float outwards = n[0] * (p0[0] - center[0]) + n[1] * (p0[1] - center[1]) + n[2] * (p0[2] - center[2]);
+					if (fabsf(outwards) < 1e-9f)
+					{
+						continue;
+					}
+					uint32_t triangle[3] = { quad[t], outwards > 0.0f ? quad[t + 1] : quad[t + 2], outwards > 0.0f ? quad[t + 2] : quad[t + 1] };
+					indices.insert(indices.end(), triangle, triangle + 3);
+				}
+			}
+		}
+	}
+	for (size_t t = indices.size() / 3; t > 1; --t)
+	{
+		size_t other = Random() % t;
+		std::swap_ranges(&indices[(t - 1) * 3], &indices[(t - 1) * 3 + 3], &indices[other * 3]);
+	}
+	vertexBytes.resize(vertices.size() * sizeof(Vertex));
+	memcpy(vertexBytes.data(), vertices.data(), vertexBytes.size());
+}
+
+//fragments shaded per pixel covered, early Z and back face culling, orthographic from both ends of every axis
+static float MeasureOverdraw(const std::vector<uint8_t>& vertexBytes, const std::vector<uint32_t>& indices)
+{
+	const int Size = 256;
+	const Vertex* vertices = reinterpret_cast<const Vertex*>(vertexBytes.data());
+	size_t vertexCount = vertexBytes.size() / sizeof(Vertex);
+	float minimum[3] = { 1e30f, 1e30f, 1e30f }, maximum[3] = { -1e30f, -1e30f, -1e30f };
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			minimum[a] = std::min(minimum[a], vertices[v].pos[a]);
+			maximum[a] = std::max(maximum[a], vertices[v].pos[a]);
+		}
+	}
+
+	uint64_t shaded = 0, covered = 0;
+	std::vector<float> depth(Size * Size);
+	for (int view = 0; view < 6; ++view)
+	{
+		int axis = view / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+		float direction = view % 2 ? -1.0f : 1.0f;
+		std::fill(depth.begin(), depth.end(), 1e30f);
+		for (size_t t = 0; t < indices.size() / 3; ++t)
+		{
+			const float* p[3] = { vertices[indices[t * 3]].pos, vertices[indices[t * 3 + 1]].pos, vertices[indices[t * 3 + 2]].pos };
+			//front facing when the normal points against the view direction
+			float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+			float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+			float normal = e1[(axis + 1) % 3] * e2[(axis + 2) % 3] - e1[(axis + 2) % 3] * e2[(axis + 1) % 3];
+			if (normal * direction >= 0.0f)
+			{
+				continue;
+			}
+			float x[3], y[3], z[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				x[c] = (p[c][u] - minimum[u]) / (maximum[u] - minimum[u]) * Size;
+				y[c] = (p[c][v] - minimum[v]) / (maximum[v] - minimum[v]) * Size;
+				z[c] = p[c][axis] * direction;
+			}
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (area == 0.0f)
+			{
+				continue;
+			}
+			int x0 = std::max(0, int(floorf(std::min({ x[0], x[1], x[2] })))), x1 = std::min(Size - 1, int(ceilf(std::max({ x[0], x[1], x[2] }))));
+			int y0 = std::max(0, int(floorf(std::min({ y[0], y[1], y[2] })))), y1 = std::min(Size - 1, int(ceilf(std::max({ y[0], y[1], y[2] }))));
+			for (int py = y0; py <= y1; ++py)
+			{
+				for (int px = x0; px <= x1; ++px)
+				{
+					float cx = px + 0.5f, cy = py + 0.5f;
+					float w0 = ((x[1] - cx) * (y[2] - cy) - (x[2] - cx) * (y[1] - cy)) / area;
+					float w1 = ((x[2] - cx) * (y[0] - cy) - (x[0] - cx) * (y[2] - cy)) / area;
+					float w2 = 1.0f - w0 - w1;
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					{
+						continue;
+					}
+					float fragment = w0 * z[0] + w1 * z[1] + w2 * z[2];
+					float& stored = depth[py * Size + px];
+					if (fragment < stored)
+					{
+						stored = fragment;
+						++shaded;
+					}
+				}
+			}
+		}
+		for (float d : depth)
+		{
+			covered += d < 1e30f;
+		}
+	}
+	return covered ? float(double(shaded) / double(covered)) : 0.0f;
+}
+
+static void PrintReport(const char* name, const MeshOptimizer::MeshOptimizeReport& report)
+{
+	printf("%s: vertices %zu -> %zu | ACMR %.3f -> %.3f | ATVR %.3f -> %.3f | overfetch %.2f -> %.2f\n", name,
+		report.VerticesBefore, report.VerticesAfter, report.CacheBefore.Acmr, report.CacheAfter.Acmr,
+		report.CacheBefore.Atvr, report.CacheAfter.Atvr, report.FetchBefore.Overfetch, report.FetchAfter.Overfetch);
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t grid = 700;
+	uint32_t spheres = 5;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		uint32_t value = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+		if (!strcmp(argv[i], "--grid")) grid = std::max(value, 2u);
+		else if (!strcmp(argv[i], "--spheres")) spheres = std::max(value, 1u);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	//the grid step by step, to time each of them
+	{
+		std::vector<uint8_t> soup = MakeGridSoup(grid);
+		const size_t soupCount = soup.size() / sizeof(Vertex);
+		const double triangles = double(soupCount / 3);
+		std::vector<TriangleKey> expected = GetTriangles(soup, nullptr, soupCount);
+		SteadyFrameClock clock;
+
+		double start = clock.Now();
+		std::vector<uint32_t> remap(soupCount);
+		size_t uniqueCount = MeshOptimizer::GenerateVertexRemap(remap.data(), nullptr, soupCount, soup.data(), soupCount, sizeof(Vertex));
+		std::vector<uint32_t> indices(soupCount);
+		std::vector<uint8_t> unique(uniqueCount * sizeof(Vertex));
+		MeshOptimizer::RemapIndexBuffer(indices.data(), nullptr, soupCount, remap.data());
+		MeshOptimizer::RemapVertexBuffer(unique.data(), soup.data(), soupCount, sizeof(Vertex), remap.data());
+		double dedupSeconds = clock.Now() - start;
+		Check(uniqueCount == size_t(grid) * grid, "duplicates merge into one vertex per grid point");
+
+		MeshOptimizer::VertexCacheStatistics cacheBefore = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), uniqueCount);
+		start = clock.Now();
+		MeshOptimizer::OptimizeVertexCache(indices.data(), indices.data(), indices.size(), uniqueCount);
+		double cacheSeconds = clock.Now() - start;
+		MeshOptimizer::VertexCacheStatistics cacheAfter = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), uniqueCount);
+
+		MeshOptimizer::VertexFetchStatistics fetchBefore = MeshOptimizer::AnalyzeVertexFetch(indices.data(), indices.size(), uniqueCount, sizeof(Vertex));
+		std::vector<uint8_t> vertices(unique.size());
+		start = clock.Now();
+		size_t fetchCount = MeshOptimizer::OptimizeVertexFetch(vertices.data(), indices.data(), indices.size(), unique.data(), uniqueCount, sizeof(Vertex));
+		double fetchSeconds = clock.Now() - start;
+		MeshOptimizer::VertexFetchStatistics fetchAfter = MeshOptimizer::AnalyzeVertexFetch(indices.data(), indices.size(), uniqueCount, sizeof(Vertex));
+		MeshOptimizer::VertexCacheStatistics cacheFinal = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), uniqueCount);
+
+		printf("grid %ux%u, %.0f triangles from a %zu vertex soup\n", grid, grid, triangles, soupCount);
+		printf("  dedup  %7.1f Mtris/s | vertices %zu -> %zu\n", triangles / dedupSeconds / 1e6, soupCount, uniqueCount);
+		printf("  cache  %7.1f Mtris/s | ACMR %.3f -> %.3f | ATVR %.3f -> %.3f\n", triangles / cacheSeconds / 1e6, cacheBefore.Acmr, cacheAfter.Acmr, cacheBefore.Atvr, cacheAfter.Atvr);
+		printf("  fetch  %7.1f Mtris/s | overfetch %.2f -> %.2f\n", triangles / fetchSeconds / 1e6, fetchBefore.Overfetch, fetchAfter.Overfetch);
+
+		Check(GetTriangles(vertices, indices.data(), indices.size()) == expected, "the grid keeps its triangles and their winding");
+		Check(fetchCount == uniqueCount, "every grid vertex is used");
+		//a grid can't do better than 0.5, a strip order gets 1
+		Check(cacheAfter.Acmr < 0.75f, "grid cache order is close to optimal");
+		Check(cacheFinal.Misses == cacheAfter.Misses, "fetch order leaves the cache order alone");
+		Check(fetchAfter.Overfetch < fetchBefore.Overfetch * 0.6f, "fetch order streams the vertices");
+	}
+
+	//the spheres with and without the overdraw step
+	{
+		std::vector<uint8_t> source;
+		std::vector<uint32_t> sourceIndices;
+		MakeSpheres(spheres, source, sourceIndices);
+		std::vector<TriangleKey> expected = GetTriangles(source, sourceIndices.data(), sourceIndices.size());
+		float overdrawBefore = MeasureOverdraw(source, sourceIndices);
+		printf("%u spheres, %zu triangles\n", spheres * spheres * spheres, sourceIndices.size() / 3);
+
+		std::vector<uint8_t> cacheVertices = source;
+		std::vector<uint32_t> cacheIndices = sourceIndices;
+		MeshOptimizer::MeshOptimizeReport cacheReport = MeshOptimizer::OptimizeMesh(cacheVertices, cacheIndices, sizeof(Vertex), 0, 0.0f);
+		PrintReport("  cache only", cacheReport);
+
+		std::vector<uint8_t> overdrawVertices = source;
+		std::vector<uint32_t> overdrawIndices = sourceIndices;
+		SteadyFrameClock clock;
+		double start = clock.Now();
+		MeshOptimizer::MeshOptimizeReport overdrawReport = MeshOptimizer::OptimizeMesh(overdrawVertices, overdrawIndices, sizeof(Vertex), offsetof(Vertex, pos), 1.05f);
+		double seconds = clock.Now() - start;
+		PrintReport("  with overdraw", overdrawReport);
+
+		float overdrawCache = MeasureOverdraw(cacheVertices, cacheIndices);
+		float overdrawAfter = MeasureOverdraw(overdrawVertices, overdrawIndices);
+		printf("  overdraw %.3f random, %.3f cache only, %.3f with overdraw | full pass %.1f Mtris/s\n",
+			overdrawBefore, overdrawCache, overdrawAfter, double(sourceIndices.size() / 3) / seconds / 1e6);
+
+		Check(GetTriangles(overdrawVertices, overdrawIndices.data(), overdrawIndices.size()) == expected, "the spheres keep their triangles and their winding");
+		Check(overdrawReport.CacheAfter.Acmr <= cacheReport.CacheAfter.Acmr * 1.15f, "overdraw order costs little vertex cache");
+		Check(overdrawAfter < overdrawCache, "overdraw order draws less overdraw");
+	}
+
+	printf("%s\n", g_Failures ? "FAILED" : "meshes match");
+	return g_Failures ? 1 : 0;
+}
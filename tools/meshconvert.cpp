@@ -0,0 +1,75 @@
+//converts a Wavefront OBJ into the binary mesh file of meshfile.h: packed vertices (P3S16_N2S16_T2H16) with the
+//position quantization, or full floats with --float, ordered for the vertex cache, overdraw and fetch unless
+//--no-optimize. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/meshconvert.cpp -o meshconvert
+//  ./meshconvert input.obj output.mesh [--float] [--no-optimize]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../meshimport.h"
+#include "../frameclock.h"
+
+int main(int argc, char* argv[])
+{
+	const char* input = nullptr;
+	const char* output = nullptr;
+	MeshConvertOptions options = { MeshFileVertexFormat::Packed, true };
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--float")) options.Format = MeshFileVertexFormat::Float;
+		else if (!strcmp(argv[i], "--no-optimize")) options.Optimize = false;
+		else if (argv[i][0] != '-' && !input) input = argv[i];
+		else if (argv[i][0] != '-' && !output) output = argv[i];
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+	if (!input || !output)
+	{
+		fprintf(stderr, "usage: meshconvert input.obj output.mesh [--float] [--no-optimize]\n");
+		return 2;
+	}
+
+	SteadyFrameClock clock;
+	double start = clock.Now();
+	ObjMesh mesh;
+	HRESULT hr = LoadObj(input, mesh);
+	if (FAILED(hr))
+	{
+		fprintf(stderr, "%s: not a readable OBJ (%08x)\n", input, static_cast<uint32_t>(hr));
+		return 1;
+	}
+	double parsed = clock.Now();
+
+	std::vector<uint8_t> image;
+	MeshOptimizer::MeshOptimizeReport report;
+	hr = ConvertToMeshFile(mesh, options, image, &report);
+	if (FAILED(hr))
+	{
+		fprintf(stderr, "%s: conversion failed (%08x)\n", input, static_cast<uint32_t>(hr));
+		return 1;
+	}
+	FILE* file = fopen(output, "wb");
+	bool written = file && fwrite(image.data(), 1, image.size(), file) == image.size();
+	written = file && fclose(file) == 0 && written;
+	if (!written)
+	{
+		fprintf(stderr, "%s: write failed\n", output);
+		return 1;
+	}
+
+	const MeshFileHeader& header = *reinterpret_cast<const MeshFileHeader*>(image.data());
+	printf("%s: %zu triangles, %zu -> %u vertices of %u bytes, %s indices, %.1f KB\n", output,
+		mesh.Indices.size() / 3, report.VerticesBefore, header.VertexCount, header.VertexStride,
+		header.IndexFormat == DXGI_FORMAT_R16_UINT ? "16 bit" : "32 bit", image.size() / 1024.0);
+	printf("ACMR %.3f -> %.3f | ATVR %.3f -> %.3f | parse %.1f ms, convert %.1f ms\n",
+		report.CacheBefore.Acmr, report.CacheAfter.Acmr, report.CacheBefore.Atvr, report.CacheAfter.Atvr,
+		(parsed - start) * 1000.0, (clock.Now() - parsed) * 1000.0);
+	return 0;
+}
@@ -0,0 +1,184 @@
+//mesh loading: writes a large textured, lit grid as OBJ text and as a mesh file, then times getting it GPU ready
+//both ways. The text path parses the OBJ and packs the vertices as a runtime importer would, the binary path maps
+//the mesh file and copies its payloads into a staging buffer as GpuMesh does. Also checks the copied payloads and
+//that damaged files are rejected. --cold drops both files from the page cache before every run. From the
+//repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/meshloadbench.cpp -o meshloadbench
+//  ./meshloadbench [--grid N] [--runs N] [--dir PATH] [--cold]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../meshimport.h"
+#include "../frameclock.h"
+#include "check.h"
+
+static double Median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+static bool WriteFile(const std::string& fileName, const void* data, size_t size)
+{
+	FILE* file = fopen(fileName.c_str(), "wb");
+	bool written = file && fwrite(data, 1, size, file) == size;
+	return file && fclose(file) == 0 && written;
+}
+
+//written back and evicted, so the next read comes from the disk
+static void DropFromPageCache(const std::string& fileName)
+{
+	int file = open(fileName.c_str(), O_RDONLY);
+	if (file >= 0)
+	{
+		fdatasync(file);
+		posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+		close(file);
+	}
+}
+
+static std::string MakeGridObj(uint32_t n)
+{
+	std::string text;
+	char line[128];
+	for (uint32_t y = 0; y < n; ++y)
+	{
+		for (uint32_t x = 0; x < n; ++x)
+		{
+			float fx = float(x) / float(n - 1), fy = float(y) / float(n - 1);
+			float height = 0.05f * sinf(fx * 25.0f) * cosf(fy * 17.0f);
+			snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+				fx * 10.0f - 5.0f, height, fy * 10.0f - 5.0f, fx, fy, -1.25f * cosf(fx * 25.0f) * cosf(fy * 17.0f), 1.0f, 0.85f * sinf(fx * 25.0f) * sinf(fy * 17.0f));
+			text += line;
+		}
+	}
+	for (uint32_t y = 0; y + 1 < n; ++y)
+	{
+		for (uint32_t x = 0; x + 1 < n; ++x)
+		{
+			uint32_t a = y * n + x + 1, b = a + 1, c = a + n, d = c + 1;
+			snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, d, d, d, b, b, b);
+			text += line;
+		}
+	}
+	return text;
+}
+
+static void CheckRejected(const std::vector<uint8_t>& image)
+{
+	MeshFile mesh;
+	Check(SUCCEEDED(mesh.Attach(image.data(), image.size())), "the written file loads");
+	Check(FAILED(mesh.Attach(image.data(), image.size() - 1)), "a truncated file is rejected");
+	Check(FAILED(mesh.Attach(image.data(), sizeof(MeshFileHeader) - 1)), "a file shorter than the header is rejected");
+
+	std::vector<uint8_t> damaged = image;
+	reinterpret_cast<MeshFileHeader*>(damaged.data())->Magic ^= 1;
+	Check(FAILED(mesh.Attach(damaged.data(), damaged.size())), "a wrong magic is rejected");
+	damaged = image;
+	reinterpret_cast<MeshFileHeader*>(damaged.data())->Version = MeshFileVersion + 1;
+	Check(FAILED(mesh.Attach(damaged.data(), damaged.size())), "another version is rejected");
+	damaged = image;
+	reinterpret_cast<MeshFileSection*>(damaged.data() + sizeof(MeshFileHeader))->Offset = (damaged.size() / MeshFileSectionAlignment + 1) * MeshFileSectionAlignment;
+	Check(FAILED(mesh.Attach(damaged.data(), damaged.size())), "a section past the end is rejected");
+	damaged = image;
+	reinterpret_cast<MeshFileHeader*>(damaged.data())->VertexCount += 1;
+	Check(FAILED(mesh.Attach(damaged.data(), damaged.size())), "a vertex count the payload doesn't hold is rejected");
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t grid = 512;
+	uint32_t runs = 5;
+	std::string directory = "/tmp";
+	bool cold = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--cold")) cold = true;
+		else if (!strcmp(argv[i], "--grid") && i + 1 < argc) grid = std::max(2u, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+		else if (!strcmp(argv[i], "--runs") && i + 1 < argc) runs = std::max(1u, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+		else if (!strcmp(argv[i], "--dir") && i + 1 < argc) directory = argv[++i];
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	const std::string objName = directory + "/meshloadbench.obj";
+	const std::string meshName = directory + "/meshloadbench.mesh";
+	std::string text = MakeGridObj(grid);
+	ObjMesh source;
+	std::vector<uint8_t> image;
+	MeshConvertOptions options = { MeshFileVertexFormat::Packed, true };
+	if (FAILED(ParseObj(text.data(), text.size(), source)) || FAILED(ConvertToMeshFile(source, options, image)) ||
+		!WriteFile(objName, text.data(), text.size()) || !WriteFile(meshName, image.data(), image.size()))
+	{
+		fprintf(stderr, "could not write the test files to %s\n", directory.c_str());
+		return 1;
+	}
+	Check(source.GetVertexCount() == size_t(grid) * grid, "OBJ corners sharing all indices are one vertex");
+	CheckRejected(image);
+
+	MeshFile reference;
+	reference.Attach(image.data(), image.size());
+	const size_t vertexBytes = static_cast<size_t>(reference.GetVertexBytes());
+	const size_t indexBytes = static_cast<size_t>(reference.GetIndexBytes());
+	//pre-touched, as the persistently mapped upload buffer is
+	std::vector<uint8_t> staging(vertexBytes + indexBytes, 0);
+
+	SteadyFrameClock clock;
+	std::vector<double> textTimes, binaryTimes;
+	for (uint32_t run = 0; run < runs; ++run)
+	{
+		if (cold)
+		{
+			DropFromPageCache(objName);
+			DropFromPageCache(meshName);
+		}
+
+		//text: parse, then pack into what the GPU reads
+		double start = clock.Now();
+		ObjMesh mesh;
+		HRESULT hr = LoadObj(objName.c_str(), mesh);
+		std::vector<uint8_t> packed(mesh.GetVertexCount() * sizeof(VertexTypes::P3S16_N2S16_T2H16));
+		PositionQuantization quantization = PositionQuantization::FromPositions(mesh.Positions.data(), mesh.GetVertexCount());
+		VertexTypes::P3S16_N2S16_T2H16::Layout::Encode(mesh.GetStreams(), quantization, packed.data());
+		textTimes.push_back(clock.Now() - start);
+		Check(SUCCEEDED(hr) && mesh.Indices == source.Indices, "the OBJ reads back the same");
+
+		//binary: map, then one copy per payload into staging
+		start = clock.Now();
+		MeshFile file;
+		hr = file.Open(meshName.c_str());
+		if (SUCCEEDED(hr))
+		{
+			memcpy(staging.data(), file.GetVertices(), static_cast<size_t>(file.GetVertexBytes()));
+			memcpy(staging.data() + vertexBytes, file.GetIndices(), static_cast<size_t>(file.GetIndexBytes()));
+		}
+		binaryTimes.push_back(clock.Now() - start);
+		Check(SUCCEEDED(hr) && file.GetVertexBytes() == vertexBytes && file.GetIndexBytes() == indexBytes, "the mesh file opens");
+		Check(!memcmp(staging.data(), reference.GetVertices(), vertexBytes) && !memcmp(staging.data() + vertexBytes, reference.GetIndices(), indexBytes), "staging holds the payloads");
+	}
+
+	const MeshFileHeader& header = reference.GetHeader();
+	double textSeconds = Median(textTimes), binarySeconds = Median(binaryTimes);
+	printf("grid %ux%u: %u vertices of %u bytes, %u %s indices, %s page cache\n", grid, grid, header.VertexCount, header.VertexStride,
+		header.IndexCount, header.IndexFormat == DXGI_FORMAT_R16_UINT ? "16 bit" : "32 bit", cold ? "cold" : "warm");
+	printf("  OBJ  %7.1f MB %8.2f ms %8.1f MB/s\n", text.size() / 1e6, textSeconds * 1000.0, text.size() / 1e6 / textSeconds);
+	printf("  mesh %7.1f MB %8.2f ms %8.1f MB/s | %.1fx faster\n", image.size() / 1e6, binarySeconds * 1000.0, image.size() / 1e6 / binarySeconds, textSeconds / binarySeconds);
+
+	remove(objName.c_str());
+	remove(meshName.c_str());
+	printf("%s\n", g_Failures ? "FAILED" : "payloads match");
+	return g_Failures ? 1 : 0;
+}
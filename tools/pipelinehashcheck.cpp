@@ -0,0 +1,300 @@
+//pipeline description hashing: checks that descriptions the driver compiles to the same pipeline hash the same,
+//whether they only differ in where their shaders and input layout live or in state that is disabled, and that
+//every field that changes the pipeline changes the hash. Then hashes a grid of distinct descriptions to look for
+//collisions and reports how long a hash takes, the PSO cache pays it on every lookup. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/pipelinehashcheck.cpp -o pipelinehashcheck
+//  ./pipelinehashcheck [--runs N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "../pipelinehash.h"
+#include "../frameclock.h"
+#include "check.h"
+
+static const uint64_t RootSignatureHash = 0x1234567890abcdefull;
+
+//stand-ins for compiled shader bytecode, every copy in its own buffer
+static std::vector<uint8_t> MakeBytecode(uint8_t seed, size_t size)
+{
+	std::vector<uint8_t> bytecode(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		bytecode[i] = static_cast<uint8_t>(seed + i * 31);
+	}
+	return bytecode;
+}
+
+//the owner of the memory a description points at, so two of them share nothing but their contents
+struct PipelineSource
+{
+	std::vector<uint8_t> VS;
+	std::vector<uint8_t> PS;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> Elements;
+	std::vector<char> Semantics;
+
+	PipelineSource() : VS(MakeBytecode(1, 1200)), PS(MakeBytecode(2, 900)), Semantics(16)
+	{
+		memcpy(Semantics.data(), "POSITION\0COLOR\0", 15);
+		Elements.push_back({ Semantics.data(), 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+		Elements.push_back({ Semantics.data() + 9, 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+
+	//the state PipelineStateObjectDescription::Simple sets up
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Describe() const
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+		ZeroMemory(&desc, sizeof(desc));
+		desc.VS = { VS.data(), VS.size() };
+		desc.PS = { PS.data(), PS.size() };
+		desc.InputLayout = { Elements.data(), static_cast<UINT>(Elements.size()) };
+		desc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+		desc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+		desc.RasterizerState.DepthClipEnable = TRUE;
+		for (UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+		{
+			desc.BlendState.RenderTarget[i] = { FALSE, FALSE, D3D12_BLEND_ONE, D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD,
+				D3D12_BLEND_ONE, D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD, D3D12_LOGIC_OP_NOOP, D3D12_COLOR_WRITE_ENABLE_ALL };
+		}
+		desc.SampleMask = 0xffffffff;
+		desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		desc.NumRenderTargets = 1;
+		desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+		desc.SampleDesc.Count = 1;
+		return desc;
+	}
+};
+
+static uint64_t Hash(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	return HashPipelineStateDescription(desc, RootSignatureHash);
+}
+
+//descriptions the driver can't tell apart dedup to one hash
+static void CheckEquivalent()
+{
+	PipelineSource source, copy;
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC base = source.Describe();
+	const uint64_t hash = Hash(base);
+	Check(hash == Hash(source.Describe()), "the hash is deterministic");
+	Check(hash == Hash(copy.Describe()), "shaders and input layout hash by content, not by pointer");
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = base;
+	desc.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_SRC_ALPHA;
+	desc.BlendState.RenderTarget[0].BlendOpAlpha = D3D12_BLEND_OP_MAX;
+	Check(hash == Hash(desc), "blend factors of a target with blending off are dead");
+
+	desc = base;
+	desc.BlendState.RenderTarget[0].LogicOp = D3D12_LOGIC_OP_CLEAR;
+	Check(hash == Hash(desc), "the logic op with logic ops off is dead");
+
+	desc = base;
+	desc.BlendState.RenderTarget[1].BlendEnable = TRUE;
+	desc.BlendState.RenderTarget[3].RenderTargetWriteMask = 0;
+	Check(hash == Hash(desc), "targets past the first are dead without independent blend");
+
+	desc = base;
+	desc.RTVFormats[1] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	desc.RTVFormats[7] = DXGI_FORMAT_R32_FLOAT;
+	Check(hash == Hash(desc), "formats past NumRenderTargets are dead");
+
+	desc = base;
+	desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+	desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_GREATER;
+	Check(hash == Hash(desc), "depth write and function with depth off are dead");
+
+	desc = base;
+	desc.DepthStencilState.StencilReadMask = 0x0f;
+	desc.DepthStencilState.FrontFace.StencilPassOp = D3D12_STENCIL_OP_REPLACE;
+	desc.DepthStencilState.BackFace.StencilFunc = D3D12_COMPARISON_FUNC_ALWAYS;
+	Check(hash == Hash(desc), "stencil masks and ops with stencil off are dead");
+
+	desc = base;
+	uint8_t blob[64] = {};
+	desc.CachedPSO = { blob, sizeof(blob) };
+	Check(hash == Hash(desc), "the cached blob is not part of the pipeline");
+
+	desc = base;
+	desc.StreamOutput.RasterizedStream = 3;
+	Check(hash == Hash(desc), "the rasterized stream without stream output is dead");
+
+	desc = base;
+	desc.pRootSignature = reinterpret_cast<ID3D12RootSignature*>(uintptr_t(0x1000));
+	Check(hash == Hash(desc), "the root signature hashes by its serialized hash when there is one");
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC other = desc;
+	Check(HashPipelineStateDescription(desc, 0) == HashPipelineStateDescription(other, 0), "without one the same root signature object dedups");
+	other.pRootSignature = reinterpret_cast<ID3D12RootSignature*>(uintptr_t(0x2000));
+	Check(HashPipelineStateDescription(desc, 0) != HashPipelineStateDescription(other, 0), "without one other root signature objects don't");
+
+	//the blend state of the targets in use, all dead fields of a disabled one changed at once
+	desc = base;
+	desc.NumRenderTargets = 2;
+	desc.RTVFormats[1] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	desc.BlendState.IndependentBlendEnable = TRUE;
+	other = desc;
+	other.BlendState.RenderTarget[1].DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+	other.BlendState.RenderTarget[2].BlendEnable = TRUE;
+	Check(Hash(desc) == Hash(other), "independent blend only hashes the targets in use");
+}
+
+//every change the driver compiles differently gives another hash
+static void CheckDistinct()
+{
+	PipelineSource source;
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC base = source.Describe();
+	std::vector<std::pair<const char*, D3D12_GRAPHICS_PIPELINE_STATE_DESC>> variants;
+	variants.reserve(64);
+	auto variant = [&](const char* name) -> D3D12_GRAPHICS_PIPELINE_STATE_DESC& {
+		variants.emplace_back(name, base);
+		return variants.back().second;
+	};
+
+	std::vector<uint8_t> vs = source.VS;
+	vs[vs.size() / 2] ^= 1;
+	variant("one byte of the vertex shader").VS = { vs.data(), vs.size() };
+	variant("a shorter vertex shader").VS.BytecodeLength -= 4;
+	variant("no pixel shader").PS = { nullptr, 0 };
+	variant("the pixel shader in the geometry shader slot").GS = base.PS;
+
+	std::vector<D3D12_INPUT_ELEMENT_DESC> elements = source.Elements;
+	elements[1].Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	variant("an input element format").InputLayout.pInputElementDescs = elements.data();
+	std::vector<D3D12_INPUT_ELEMENT_DESC> offsets = source.Elements;
+	offsets[1].AlignedByteOffset = 16;
+	variant("an input element offset").InputLayout.pInputElementDescs = offsets.data();
+	std::vector<D3D12_INPUT_ELEMENT_DESC> semantics = source.Elements;
+	semantics[1].SemanticName = "TEXCOORD";
+	variant("an input element semantic").InputLayout.pInputElementDescs = semantics.data();
+	variant("fewer input elements").InputLayout.NumElements = 1;
+
+	variant("cull mode").RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	variant("fill mode").RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+	variant("winding").RasterizerState.FrontCounterClockwise = TRUE;
+	variant("depth bias").RasterizerState.DepthBias = 4;
+	variant("slope scaled depth bias").RasterizerState.SlopeScaledDepthBias = 1.5f;
+	variant("depth clip").RasterizerState.DepthClipEnable = FALSE;
+	variant("conservative raster").RasterizerState.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_ON;
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& blend = variant("blending on");
+	blend.BlendState.RenderTarget[0].BlendEnable = TRUE;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& alpha = variant("blending on with alpha blend factors");
+	alpha.BlendState.RenderTarget[0].BlendEnable = TRUE;
+	alpha.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_SRC_ALPHA;
+	alpha.BlendState.RenderTarget[0].DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+	variant("write mask").BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_RED;
+	variant("alpha to coverage").BlendState.AlphaToCoverageEnable = TRUE;
+	variant("sample mask").SampleMask = 1;
+
+	variant("depth on").DepthStencilState.DepthEnable = TRUE;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& depthWrite = variant("depth on and written");
+	depthWrite.DepthStencilState.DepthEnable = TRUE;
+	depthWrite.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& depthLess = variant("depth on and written with LESS");
+	depthLess.DepthStencilState.DepthEnable = TRUE;
+	depthLess.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+	depthLess.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& stencil = variant("stencil on");
+	stencil.DepthStencilState.StencilEnable = TRUE;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& stencilOp = variant("stencil on with a pass op");
+	stencilOp.DepthStencilState.StencilEnable = TRUE;
+	stencilOp.DepthStencilState.FrontFace.StencilPassOp = D3D12_STENCIL_OP_REPLACE;
+
+	variant("render target format").RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& targets = variant("a second render target");
+	targets.NumRenderTargets = 2;
+	targets.RTVFormats[1] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	variant("depth format").DSVFormat = DXGI_FORMAT_D32_FLOAT;
+	variant("sample count").SampleDesc.Count = 4;
+	variant("topology type").PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE;
+	variant("strip cut").IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_0xFFFF;
+	variant("node mask").NodeMask = 2;
+	variant("flags").Flags = D3D12_PIPELINE_STATE_FLAG_TOOL_DEBUG;
+
+	D3D12_SO_DECLARATION_ENTRY entry = { 0, "POSITION", 0, 0, 3, 0 };
+	UINT stride = 12;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC& streamOutput = variant("stream output");
+	streamOutput.StreamOutput = { &entry, 1, &stride, 1, 0 };
+
+	std::set<uint64_t> hashes;
+	hashes.insert(Hash(base));
+	char what[256];
+	for (const auto& v : variants)
+	{
+		snprintf(what, sizeof(what), "%s changes the hash", v.first);
+		Check(hashes.insert(Hash(v.second)).second, what);
+	}
+	Check(Hash(base) != HashPipelineStateDescription(base, RootSignatureHash + 1), "another root signature changes the hash");
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t runs = 200;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--runs") && i + 1 < argc)
+		{
+			runs = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+
+	CheckEquivalent();
+	CheckDistinct();
+
+	//a grid of descriptions that all compile differently, as a renderer's worth of pipelines
+	PipelineSource source;
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC base = source.Describe();
+	const D3D12_CULL_MODE cullModes[] = { D3D12_CULL_MODE_NONE, D3D12_CULL_MODE_FRONT, D3D12_CULL_MODE_BACK };
+	const DXGI_FORMAT formats[] = { DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, DXGI_FORMAT_R16G16B16A16_FLOAT,
+		DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_R32_FLOAT };
+	std::vector<D3D12_GRAPHICS_PIPELINE_STATE_DESC> grid;
+	for (uint32_t cull = 0; cull < 3; ++cull)
+	{
+		for (uint32_t format = 0; format < 6; ++format)
+		{
+			for (uint32_t depthFunc = D3D12_COMPARISON_FUNC_NEVER; depthFunc <= D3D12_COMPARISON_FUNC_ALWAYS; ++depthFunc)
+			{
+				for (uint32_t bias = 0; bias < 8; ++bias)
+				{
+					D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = base;
+					desc.RasterizerState.CullMode = cullModes[cull];
+					desc.RTVFormats[0] = formats[format];
+					desc.DepthStencilState.DepthEnable = TRUE;
+					desc.DepthStencilState.DepthFunc = static_cast<D3D12_COMPARISON_FUNC>(depthFunc);
+					desc.RasterizerState.DepthBias = INT(bias);
+					grid.push_back(desc);
+				}
+			}
+		}
+	}
+	std::set<uint64_t> hashes;
+	for (const auto& desc : grid)
+	{
+		hashes.insert(Hash(desc));
+	}
+	Check(hashes.size() == grid.size(), "no collisions over the grid");
+
+	SteadyFrameClock clock;
+	std::vector<double> times;
+	volatile uint64_t sink = 0;
+	for (uint32_t run = 0; run < runs; ++run)
+	{
+		double start = clock.Now();
+		for (const auto& desc : grid)
+		{
+			sink = sink ^ Hash(desc);
+		}
+		times.push_back((clock.Now() - start) * 1e6 / grid.size());
+	}
+	std::sort(times.begin(), times.end());
+	double median = times.empty() ? 0.0 : times[times.size() / 2];
+	printf("%zu descriptions, %zu distinct hashes | %.2f us per hash with %zu bytes of shaders | %s\n",
+		grid.size(), hashes.size(), median, source.VS.size() + source.PS.size(),
+		g_Failures ? "FAILED" : "equivalent descriptions dedup, distinct ones don't");
+	return g_Failures ? 1 : 0;
+}
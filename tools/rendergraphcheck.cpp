@@ -0,0 +1,654 @@
+//render graph checks: builds a shadow, gbuffer, ssao, lighting and tonemap frame and checks which passes are
+//culled, the order the rest run in, where the transients are placed and which barriers go in front of which pass,
+//including split transitions and UAV barriers. The same frame is then recorded twice on a NullCommandList the way
+//GpuRenderGraph::Execute records it, through the ResourceStateTracker, and the barriers that reach the command
+//list are checked batch by batch, with the null device validating every before-state and split pair. Then
+//compiles random graphs and replays their barriers pass by
+//pass, checking that every access finds its resource in the state it declared, that no resource is touched in
+//the middle of a split transition and that transients alive at the same time never share memory. Last, times
+//declaring and compiling graphs of hundreds of passes, which happens every frame. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/rendergraphcheck.cpp -o rendergraphcheck
+//  ./rendergraphcheck [--graphs N] [--runs N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../rendergraph.h"
+#include "../resourcestates.h"
+#include "../nulldevice.h"
+#include "../frameclock.h"
+#include "check.h"
+
+typedef RenderGraph::ResourceHandle ResourceHandle;
+typedef RenderGraph::PassHandle PassHandle;
+
+static const uint32_t RenderTargetHeap = 0;
+static const uint32_t TextureHeap = 1;
+static const uint64_t MB = 1024 * 1024;
+
+//a render graph that remembers its declarations, so compiled results can be checked against them
+struct CheckedGraph
+{
+	struct Access
+	{
+		PassHandle Pass;
+		ResourceHandle Resource;
+		RenderGraph::State State;
+		bool IsWrite;
+	};
+
+	RenderGraph Graph;
+	std::vector<Access> Accesses;
+	std::vector<RenderGraph::State> InitialStates; //per resource, UnknownState for transients
+	std::vector<RenderGraph::State> FinalStates;
+
+	void Reset()
+	{
+		Graph.Reset();
+		Accesses.clear();
+		InitialStates.clear();
+		FinalStates.clear();
+	}
+
+	ResourceHandle Import(RenderGraph::State current, RenderGraph::State final)
+	{
+		InitialStates.push_back(current);
+		FinalStates.push_back(final);
+		return Graph.Import(current, final);
+	}
+
+	ResourceHandle Transient(uint64_t size, uint64_t alignment, uint32_t heapClass)
+	{
+		RenderGraph::TransientDesc desc = { size, alignment, heapClass };
+		RenderGraph::State unknown = RenderGraph::UnknownState; //push_back takes a reference, the constant has no definition
+		InitialStates.push_back(unknown);
+		FinalStates.push_back(unknown);
+		return Graph.CreateTransient(desc);
+	}
+
+	void Read(PassHandle pass, ResourceHandle resource, RenderGraph::State state)
+	{
+		Graph.Read(pass, resource, state);
+		Accesses.push_back({ pass, resource, state, false });
+	}
+
+	void Write(PassHandle pass, ResourceHandle resource, RenderGraph::State state)
+	{
+		Graph.Write(pass, resource, state);
+		Accesses.push_back({ pass, resource, state, true });
+	}
+};
+
+//replays the compiled barriers pass by pass. Returns false at the first barrier whose before-state isn't the
+//current one, a resource used in the middle of a split transition, or an access that doesn't find its resource
+//in the state it declared: exactly that state for writers, at least the declared bits for readers. A pass
+//declaring a resource more than once needs all of it at once, as the graph combines them.
+static bool ReplayBarriers(const CheckedGraph& checked)
+{
+	const RenderGraph& graph = checked.Graph;
+	std::vector<RenderGraph::State> current = checked.InitialStates;
+	std::vector<bool> inSplit(current.size(), false);
+
+	auto apply = [&](const RenderGraph::Barrier& barrier) -> bool
+	{
+		RenderGraph::State& state = current[barrier.Resource];
+		//a transient's first transition starts from whatever the memory held, which the graph can't know
+		if (barrier.Before != RenderGraph::UnknownState && state != barrier.Before)
+		{
+			return false;
+		}
+		if (barrier.Split == RenderGraph::SplitBegin)
+		{
+			bool nested = inSplit[barrier.Resource];
+			inSplit[barrier.Resource] = true;
+			return !nested;
+		}
+		if (inSplit[barrier.Resource] != (barrier.Split == RenderGraph::SplitEnd))
+		{
+			return false;
+		}
+		inSplit[barrier.Resource] = false;
+		state = barrier.After;
+		return true;
+	};
+
+	std::vector<RenderGraph::State> required(current.size());
+	std::vector<bool> written(current.size());
+	for (const auto& compiled : graph.GetSchedule())
+	{
+		const RenderGraph::Barrier* barriers = graph.GetBarriers(compiled);
+		for (uint32_t i = 0; i < compiled.BarrierCount; ++i)
+		{
+			if (!apply(barriers[i]))
+			{
+				return false;
+			}
+		}
+
+		std::fill(required.begin(), required.end(), 0);
+		std::fill(written.begin(), written.end(), false);
+		for (const auto& access : checked.Accesses)
+		{
+			if (access.Pass == compiled.Pass)
+			{
+				required[access.Resource] |= access.State;
+				written[access.Resource] = written[access.Resource] || access.IsWrite;
+			}
+		}
+		for (ResourceHandle r = 0; r < current.size(); ++r)
+		{
+			if (!required[r])
+			{
+				continue;
+			}
+			if (inSplit[r] || (written[r] ? current[r] != required[r] : (current[r] & required[r]) != required[r]))
+			{
+				return false;
+			}
+		}
+	}
+	for (const auto& barrier : graph.GetFinalBarriers())
+	{
+		if (!apply(barrier))
+		{
+			return false;
+		}
+	}
+	for (ResourceHandle r = 0; r < current.size(); ++r)
+	{
+		if (inSplit[r] || (graph.IsImported(r) && current[r] != checked.FinalStates[r]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//transients used at the same time never overlap, and every one is aligned and inside its heap
+static bool CheckPlacement(const CheckedGraph& checked)
+{
+	const RenderGraph& graph = checked.Graph;
+	std::vector<uint32_t> first(graph.GetResourceCount(), ~0u), last(graph.GetResourceCount(), 0);
+	for (uint32_t s = 0; s < graph.GetSchedule().size(); ++s)
+	{
+		for (const auto& access : checked.Accesses)
+		{
+			if (access.Pass == graph.GetSchedule()[s].Pass)
+			{
+				first[access.Resource] = std::min(first[access.Resource], s);
+				last[access.Resource] = std::max(last[access.Resource], s);
+			}
+		}
+	}
+	for (ResourceHandle a = 0; a < graph.GetResourceCount(); ++a)
+	{
+		if (!graph.IsAllocated(a))
+		{
+			continue;
+		}
+		const RenderGraph::TransientDesc& da = graph.GetTransientDesc(a);
+		uint64_t offset = graph.GetHeapOffset(a);
+		if (offset % da.Alignment || offset + da.Size > graph.GetHeapSize(da.HeapClass))
+		{
+			return false;
+		}
+		for (ResourceHandle b = a + 1; b < graph.GetResourceCount(); ++b)
+		{
+			if (!graph.IsAllocated(b) || graph.GetTransientDesc(b).HeapClass != da.HeapClass)
+			{
+				continue;
+			}
+			bool alive = first[a] <= last[b] && first[b] <= last[a];
+			bool overlap = offset < graph.GetHeapOffset(b) + graph.GetTransientDesc(b).Size && graph.GetHeapOffset(b) < offset + da.Size;
+			if (alive && overlap)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static const RenderGraph::Barrier* FindBarrier(const RenderGraph& graph, uint32_t scheduleIndex, ResourceHandle resource, RenderGraph::SplitType split)
+{
+	const RenderGraph::CompiledPass& compiled = graph.GetSchedule()[scheduleIndex];
+	const RenderGraph::Barrier* barriers = graph.GetBarriers(compiled);
+	for (uint32_t i = 0; i < compiled.BarrierCount; ++i)
+	{
+		if (barriers[i].Resource == resource && barriers[i].Split == split)
+		{
+			return &barriers[i];
+		}
+	}
+	return nullptr;
+}
+
+static const RenderGraph::State Present = D3D12_RESOURCE_STATE_PRESENT;
+static const RenderGraph::State RenderTarget = D3D12_RESOURCE_STATE_RENDER_TARGET;
+static const RenderGraph::State DepthWrite = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+static const RenderGraph::State PixelRead = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+static const RenderGraph::State ComputeRead = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+static const RenderGraph::State UnorderedAccess = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+
+//a deferred frame: shadow map, gbuffer, ssao with a blur, lighting, tonemap and ui into the back buffer
+struct Frame
+{
+	ResourceHandle BackBuffer, ShadowMap, Albedo, Normals, Depth, DebugView, Ssao, Hdr, Ldr;
+	PassHandle ShadowPass, GbufferPass, DebugPass, SsaoPass, BlurPass, LightingPass, TonemapPass, UiPass, QueryPass;
+};
+
+static Frame DeclareFrame(CheckedGraph& checked)
+{
+	Frame f;
+	checked.Reset();
+	f.BackBuffer = checked.Import(Present, Present);
+	f.ShadowMap = checked.Transient(8 * MB, 64 * 1024, RenderTargetHeap);
+	f.Albedo = checked.Transient(16 * MB, 64 * 1024, RenderTargetHeap);
+	f.Normals = checked.Transient(16 * MB, 64 * 1024, RenderTargetHeap);
+	f.Depth = checked.Transient(8 * MB, 64 * 1024, RenderTargetHeap);
+	f.DebugView = checked.Transient(16 * MB, 64 * 1024, RenderTargetHeap);
+	f.Ssao = checked.Transient(4 * MB, 64 * 1024, TextureHeap);
+	f.Hdr = checked.Transient(32 * MB, 64 * 1024, RenderTargetHeap);
+	f.Ldr = checked.Transient(16 * MB, 64 * 1024, RenderTargetHeap);
+
+	f.ShadowPass = checked.Graph.AddPass("shadow");
+	checked.Write(f.ShadowPass, f.ShadowMap, DepthWrite);
+	f.GbufferPass = checked.Graph.AddPass("gbuffer");
+	checked.Write(f.GbufferPass, f.Albedo, RenderTarget);
+	checked.Write(f.GbufferPass, f.Normals, RenderTarget);
+	checked.Write(f.GbufferPass, f.Depth, DepthWrite);
+	f.DebugPass = checked.Graph.AddPass("debug normals"); //its output is never read
+	checked.Read(f.DebugPass, f.Normals, PixelRead);
+	checked.Write(f.DebugPass, f.DebugView, RenderTarget);
+	f.SsaoPass = checked.Graph.AddPass("ssao");
+	checked.Read(f.SsaoPass, f.Depth, ComputeRead);
+	checked.Read(f.SsaoPass, f.Normals, ComputeRead);
+	checked.Write(f.SsaoPass, f.Ssao, UnorderedAccess);
+	f.BlurPass = checked.Graph.AddPass("ssao blur");
+	checked.Read(f.BlurPass, f.Ssao, UnorderedAccess);
+	checked.Write(f.BlurPass, f.Ssao, UnorderedAccess);
+	f.LightingPass = checked.Graph.AddPass("lighting");
+	checked.Read(f.LightingPass, f.ShadowMap, PixelRead);
+	checked.Read(f.LightingPass, f.Albedo, PixelRead);
+	checked.Read(f.LightingPass, f.Normals, PixelRead);
+	checked.Read(f.LightingPass, f.Depth, PixelRead);
+	checked.Read(f.LightingPass, f.Ssao, PixelRead);
+	checked.Write(f.LightingPass, f.Hdr, RenderTarget);
+	f.TonemapPass = checked.Graph.AddPass("tonemap");
+	checked.Read(f.TonemapPass, f.Hdr, PixelRead);
+	checked.Write(f.TonemapPass, f.Ldr, RenderTarget);
+	f.UiPass = checked.Graph.AddPass("ui");
+	checked.Read(f.UiPass, f.Ldr, PixelRead);
+	checked.Write(f.UiPass, f.BackBuffer, RenderTarget);
+	f.QueryPass = checked.Graph.AddPass("timestamps"); //no resources, kept for its side effects
+	checked.Graph.SetNeverCull(f.QueryPass);
+	return f;
+}
+
+static void CheckFrame()
+{
+	CheckedGraph checked;
+	Frame f = DeclareFrame(checked);
+	Check(checked.Graph.Compile(), "the frame compiles");
+	const RenderGraph& graph = checked.Graph;
+
+	//culling and order
+	Check(graph.IsCulled(f.DebugPass) && !graph.IsAllocated(f.DebugView), "a pass whose output nobody reads is culled with its transient");
+	Check(!graph.IsCulled(f.QueryPass), "a never cull pass is kept");
+	const PassHandle order[] = { f.ShadowPass, f.GbufferPass, f.SsaoPass, f.BlurPass, f.LightingPass, f.TonemapPass, f.UiPass, f.QueryPass };
+	bool inOrder = graph.GetSchedule().size() == sizeof(order) / sizeof(order[0]);
+	for (size_t i = 0; inOrder && i < graph.GetSchedule().size(); ++i)
+	{
+		inOrder = graph.GetSchedule()[i].Pass == order[i];
+	}
+	Check(inOrder, "kept passes run in the order they were added");
+
+	//placement: ldr is only alive after the gbuffer is done, so it reuses gbuffer memory; hdr overlaps all of them
+	Check(CheckPlacement(checked), "transients alive together don't overlap and are aligned");
+	RenderGraph::Statistics stats = graph.GetStatistics();
+	Check(stats.TransientCount == 7 && stats.HeapBytes < stats.TransientBytes, "aliasing saves memory");
+	Check(graph.GetHeapSize(TextureHeap) == 4 * MB, "heap classes are placed apart");
+	Check(graph.GetHeapSize(RenderTargetHeap) == 8 * MB + 16 * MB + 16 * MB + 8 * MB + 32 * MB, "ldr fits into the gbuffer's memory");
+	const RenderGraph::CompiledPass& tonemap = graph.GetSchedule()[5];
+	const RenderGraph::AliasingBarrier* aliasing = graph.GetAliasingBarriers(tonemap);
+	bool ldrAliased = false;
+	for (uint32_t i = 0; i < tonemap.AliasingBarrierCount; ++i)
+	{
+		ldrAliased |= aliasing[i].After == f.Ldr && aliasing[i].Before != RenderGraph::InvalidResource && aliasing[i].Before != f.Hdr;
+	}
+	Check(ldrAliased, "the first pass writing ldr has an aliasing barrier from the transient that used its memory");
+
+	//barrier placement
+	const RenderGraph::Barrier* barrier = FindBarrier(graph, 2, f.Depth, RenderGraph::NotSplit);
+	Check(barrier && barrier->Before == DepthWrite && barrier->After == (ComputeRead | PixelRead),
+		"consecutive readers of depth share one combined read state");
+	Check(!FindBarrier(graph, 4, f.Depth, RenderGraph::NotSplit) && !FindBarrier(graph, 4, f.Depth, RenderGraph::SplitEnd),
+		"the second reader needs no transition");
+	barrier = FindBarrier(graph, 3, f.Ssao, RenderGraph::NotSplit);
+	Check(barrier && barrier->Before == UnorderedAccess && barrier->After == UnorderedAccess, "two unordered access writers get a UAV barrier");
+	barrier = FindBarrier(graph, 1, f.ShadowMap, RenderGraph::SplitBegin);
+	const RenderGraph::Barrier* end = FindBarrier(graph, 4, f.ShadowMap, RenderGraph::SplitEnd);
+	Check(barrier && end && barrier->Before == DepthWrite && end->After == PixelRead,
+		"the shadow map transition begins after the shadow pass and ends before lighting");
+	barrier = FindBarrier(graph, 0, f.BackBuffer, RenderGraph::SplitBegin);
+	Check(barrier && FindBarrier(graph, 6, f.BackBuffer, RenderGraph::SplitEnd) && barrier->Before == Present && barrier->After == RenderTarget,
+		"the back buffer transition begins with the frame and ends before the ui");
+	barrier = FindBarrier(graph, 7, f.BackBuffer, RenderGraph::SplitBegin);
+	Check(barrier && graph.GetFinalBarriers().size() == 1 && graph.GetFinalBarriers()[0].Split == RenderGraph::SplitEnd &&
+		graph.GetFinalBarriers()[0].After == Present, "the back buffer goes back to present, split over the last pass");
+	Check(ReplayBarriers(checked), "every access finds its resource in the declared state");
+
+	//a pass reading a transient nothing wrote
+	checked.Reset();
+	ResourceHandle target = checked.Import(Present, Present);
+	ResourceHandle unwritten = checked.Transient(MB, 64 * 1024, RenderTargetHeap);
+	PassHandle pass = checked.Graph.AddPass("reads garbage");
+	checked.Read(pass, unwritten, PixelRead);
+	checked.Write(pass, target, RenderTarget);
+	Check(!checked.Graph.Compile(), "reading an unwritten transient fails to compile");
+}
+
+//records the graph the way GpuRenderGraph::Execute does: before every pass its aliasing barriers and transitions
+//go through the tracker and are flushed as one batch, the final barriers follow the last pass. batchStarts gets
+//the command index each pass's batch starts at, and one more for the final barriers.
+static void ExecuteRecorded(const RenderGraph& graph, const std::vector<ID3D12Resource*>& resources, ResourceStateTracker& states,
+	NullCommandList* commandList, std::vector<size_t>& batchStarts)
+{
+	auto record = [&](const RenderGraph::Barrier& barrier)
+	{
+		ID3D12Resource* resource = resources[barrier.Resource];
+		D3D12_RESOURCE_STATES after = static_cast<D3D12_RESOURCE_STATES>(barrier.After);
+		if (barrier.Before == barrier.After)
+		{
+			states.UavBarrier(resource);
+		}
+		else if (barrier.Split == RenderGraph::SplitBegin)
+		{
+			states.BeginTransition(resource, after);
+		}
+		else if (barrier.Split == RenderGraph::SplitEnd)
+		{
+			states.EndTransition(resource, after);
+		}
+		else
+		{
+			states.Transition(resource, after);
+		}
+	};
+
+	batchStarts.clear();
+	for (const auto& pass : graph.GetSchedule())
+	{
+		batchStarts.push_back(commandList->GetCommands().size());
+		const RenderGraph::AliasingBarrier* aliasing = graph.GetAliasingBarriers(pass);
+		for (uint32_t i = 0; i < pass.AliasingBarrierCount; ++i)
+		{
+			states.Alias(aliasing[i].Before == RenderGraph::InvalidResource ? nullptr : resources[aliasing[i].Before], resources[aliasing[i].After]);
+		}
+		const RenderGraph::Barrier* barriers = graph.GetBarriers(pass);
+		for (uint32_t i = 0; i < pass.BarrierCount; ++i)
+		{
+			record(barriers[i]);
+		}
+		states.Flush(commandList);
+	}
+	batchStarts.push_back(commandList->GetCommands().size());
+	for (const auto& barrier : graph.GetFinalBarriers())
+	{
+		record(barrier);
+	}
+	states.Flush(commandList);
+}
+
+//a barrier that reached the command list, with the batch of the pass it was flushed in front of
+struct RecordedBarrier
+{
+	uint32_t Batch;
+	D3D12_RESOURCE_BARRIER Barrier;
+};
+
+//false when a batch took more than one ResourceBarrier call
+static bool CollectBarriers(const NullCommandList* commandList, const std::vector<size_t>& batchStarts, std::vector<RecordedBarrier>& recorded)
+{
+	recorded.clear();
+	std::vector<uint32_t> calls(batchStarts.size(), 0);
+	const std::vector<NullCommand>& commands = commandList->GetCommands();
+	for (size_t c = 0; c < commands.size(); ++c)
+	{
+		if (commands[c].Call != NullCallCounts::ResourceBarrier)
+		{
+			continue;
+		}
+		uint32_t batch = static_cast<uint32_t>(std::upper_bound(batchStarts.begin(), batchStarts.end(), c) - batchStarts.begin()) - 1;
+		++calls[batch];
+		for (UINT64 i = 0; i < commands[c].Args[0]; ++i)
+		{
+			recorded.push_back({ batch, commandList->GetBarriers()[commands[c].Args[1] + i] });
+		}
+	}
+	return std::all_of(calls.begin(), calls.end(), [](uint32_t count) { return count <= 1; });
+}
+
+//batch of the first recorded barrier of that type and flags on resource, -1 if there is none. Transitions also
+//have to go to after.
+static int FindBatch(const std::vector<RecordedBarrier>& recorded, D3D12_RESOURCE_BARRIER_TYPE type, ID3D12Resource* resource,
+	D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE, RenderGraph::State after = 0)
+{
+	for (const auto& r : recorded)
+	{
+		const D3D12_RESOURCE_BARRIER& b = r.Barrier;
+		if (b.Type != type || b.Flags != flags)
+		{
+			continue;
+		}
+		bool same = (type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION) ? b.Transition.pResource == resource && b.Transition.StateAfter == after :
+			(type == D3D12_RESOURCE_BARRIER_TYPE_UAV) ? b.UAV.pResource == resource : b.Aliasing.pResourceAfter == resource;
+		if (same)
+		{
+			return static_cast<int>(r.Batch);
+		}
+	}
+	return -1;
+}
+
+static void CheckRecordedFrames()
+{
+	NullDevice device;
+	NullCommandAllocator* allocator = nullptr;
+	NullCommandList* commandList = nullptr;
+	device.CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, &allocator);
+	device.CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, nullptr, &commandList);
+	commandList->Close();
+	commandList->SetRecording(true);
+
+	CheckedGraph checked;
+	Frame f = DeclareFrame(checked);
+	const RenderGraph& graph = checked.Graph;
+	Check(checked.Graph.Compile(), "the recorded frame compiles");
+
+	//a committed resource per graph resource stands in for the placed ones, created and registered in the
+	//state of their first use like GpuRenderGraph does
+	D3D12_HEAP_PROPERTIES heap;
+	memset(&heap, 0, sizeof(heap));
+	heap.Type = D3D12_HEAP_TYPE_DEFAULT;
+	D3D12_RESOURCE_DESC desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.Width = 256;
+	desc.Height = 256;
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = 1;
+	desc.SampleDesc.Count = 1;
+	ResourceStateTracker states;
+	std::vector<ID3D12Resource*> resources(graph.GetResourceCount(), nullptr);
+	for (ResourceHandle r = 0; r < graph.GetResourceCount(); ++r)
+	{
+		if (!graph.IsImported(r) && !graph.IsAllocated(r))
+		{
+			continue;
+		}
+		D3D12_RESOURCE_STATES state = static_cast<D3D12_RESOURCE_STATES>(graph.IsImported(r) ? checked.InitialStates[r] : graph.GetFirstState(r));
+		device.CreateCommittedResource(&heap, D3D12_HEAP_FLAG_NONE, &desc, state, nullptr, &resources[r]);
+		states.Register(resources[r], state);
+	}
+
+	std::vector<size_t> batchStarts;
+	std::vector<RecordedBarrier> recorded;
+	const D3D12_RESOURCE_BARRIER_TYPE transition = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	const D3D12_RESOURCE_BARRIER_FLAGS beginOnly = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+	const D3D12_RESOURCE_BARRIER_FLAGS endOnly = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+	for (int frame = 0; frame < 2; ++frame)
+	{
+		commandList->Reset(allocator, nullptr);
+		ExecuteRecorded(graph, resources, states, commandList, batchStarts);
+		commandList->Close();
+		Check(CollectBarriers(commandList, batchStarts, recorded), "each pass flushes its barriers in one call");
+		Check(device.GetErrorCount() == 0, "the null device accepts every barrier of the frame");
+		for (const auto& message : device.GetMessages())
+		{
+			fprintf(stderr, "  %s\n", message.c_str());
+		}
+		device.ClearErrors();
+
+		//batches are schedule indices, 8 is the final barriers after the last pass
+		Check(FindBatch(recorded, transition, resources[f.BackBuffer], beginOnly, RenderTarget) == 0 &&
+			FindBatch(recorded, transition, resources[f.BackBuffer], endOnly, RenderTarget) == 6,
+			"recorded: the back buffer transition begins before the first pass and ends before the ui");
+		Check(FindBatch(recorded, transition, resources[f.BackBuffer], beginOnly, Present) == 7 &&
+			FindBatch(recorded, transition, resources[f.BackBuffer], endOnly, Present) == 8,
+			"recorded: the back buffer goes back to present over the last pass");
+		Check(FindBatch(recorded, transition, resources[f.ShadowMap], beginOnly, PixelRead) == 1 &&
+			FindBatch(recorded, transition, resources[f.ShadowMap], endOnly, PixelRead) == 4,
+			"recorded: the shadow map transition begins after the shadow pass and ends before lighting");
+		Check(FindBatch(recorded, D3D12_RESOURCE_BARRIER_TYPE_UAV, resources[f.Ssao]) == 3, "recorded: the blur waits on the ssao writes");
+		Check(FindBatch(recorded, D3D12_RESOURCE_BARRIER_TYPE_ALIASING, resources[f.Ldr]) == 5 &&
+			FindBatch(recorded, transition, resources[f.Ldr], D3D12_RESOURCE_BARRIER_FLAG_NONE, RenderTarget) == (frame ? 5 : -1),
+			"recorded: ldr is aliased in before the tonemap, and transitioned from what the last frame left once there is one");
+		Check(FindBatch(recorded, transition, resources[f.ShadowMap], D3D12_RESOURCE_BARRIER_FLAG_NONE, DepthWrite) == (frame ? 0 : -1),
+			"recorded: a transient's first transition isn't split");
+		Check(device.GetResourceState(resources[f.BackBuffer]) == D3D12_RESOURCE_STATE_PRESENT, "recorded: the frame ends with the back buffer in present");
+	}
+}
+
+//passes reading a few earlier outputs and writing one or two transients, every 16th and the last ones also
+//composite into the back buffer. Transients nobody reads later get their passes culled.
+static void BuildRandomGraph(CheckedGraph& checked, uint32_t passCount, std::mt19937& random)
+{
+	static const RenderGraph::State readStates[] = { D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+		D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_DEPTH_READ };
+	static const RenderGraph::State writeStates[] = { D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_COPY_DEST };
+
+	checked.Reset();
+	ResourceHandle backBuffer = checked.Import(D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
+	std::vector<ResourceHandle> written;
+	for (uint32_t p = 0; p < passCount; ++p)
+	{
+		PassHandle pass = checked.Graph.AddPass("pass");
+		uint32_t reads = written.empty() ? 0 : 1 + random() % 4;
+		for (uint32_t i = 0; i < reads; ++i)
+		{
+			//mostly recent outputs, sometimes one from far back to stretch a lifetime
+			size_t back = (random() % 8 == 0) ? random() % written.size() : random() % std::min<size_t>(written.size(), 6);
+			checked.Read(pass, written[written.size() - 1 - back], readStates[random() % 4]);
+		}
+		if (p + 3 >= passCount)
+		{
+			checked.Write(pass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+			continue;
+		}
+		if (p % 16 == 15)
+		{
+			checked.Write(pass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		}
+		uint32_t writes = 1 + random() % 2;
+		for (uint32_t i = 0; i < writes; ++i)
+		{
+			//now and then a pass writes an existing transient again, in a state of its own or as unordered access
+			if (!written.empty() && random() % 6 == 0)
+			{
+				checked.Write(pass, written[written.size() - 1 - random() % std::min<size_t>(written.size(), 4)], writeStates[random() % 4]);
+				continue;
+			}
+			uint64_t size = (1 + random() % 32) * 64 * 1024;
+			ResourceHandle transient = checked.Transient(size, (random() % 4 == 0) ? 4 * MB : 64 * 1024, random() % 3);
+			checked.Write(pass, transient, writeStates[random() % 4]);
+			written.push_back(transient);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t graphs = 500;
+	uint32_t runs = 20;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--graphs") && i + 1 < argc)
+		{
+			graphs = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--runs") && i + 1 < argc)
+		{
+			runs = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+
+	CheckFrame();
+	CheckRecordedFrames();
+
+	std::mt19937 random(5);
+	CheckedGraph checked;
+	bool compiled = true, replayed = true, placed = true;
+	uint32_t culled = 0, splits = 0;
+	for (uint32_t g = 0; g < graphs; ++g)
+	{
+		BuildRandomGraph(checked, 4 + random() % 60, random);
+		if (!checked.Graph.Compile())
+		{
+			compiled = false;
+			continue;
+		}
+		replayed &= ReplayBarriers(checked);
+		placed &= CheckPlacement(checked);
+		RenderGraph::Statistics stats = checked.Graph.GetStatistics();
+		culled += stats.CulledPassCount;
+		splits += stats.SplitBarrierCount;
+	}
+	Check(compiled, "random graphs compile");
+	Check(replayed, "random graphs replay with every access in its declared state");
+	Check(placed, "random graphs place their transients apart while alive");
+	printf("%u random graphs, %u passes culled, %u transitions split\n", graphs, culled, splits);
+
+	//declaring and compiling happen every frame, the graph is rebuilt from scratch
+	SteadyFrameClock clock;
+	static const uint32_t passCounts[] = { 100, 250, 500, 1000 };
+	for (uint32_t passCount : passCounts)
+	{
+		std::vector<double> times;
+		RenderGraph::Statistics stats = {};
+		for (uint32_t run = 0; run < runs; ++run)
+		{
+			std::mt19937 graphRandom(passCount);
+			double start = clock.Now();
+			BuildRandomGraph(checked, passCount, graphRandom);
+			bool ok = checked.Graph.Compile();
+			times.push_back((clock.Now() - start) * 1e3);
+			Check(ok, "benchmark graph compiles");
+			stats = checked.Graph.GetStatistics();
+		}
+		std::sort(times.begin(), times.end());
+		double median = times.empty() ? 0.0 : times[times.size() / 2];
+		printf("%5u passes (%u culled), %4u transients in %6.1f of %6.1f MB, %5u barriers | %8.3f ms to build and compile\n",
+			passCount, stats.CulledPassCount, stats.TransientCount, stats.HeapBytes / double(MB), stats.TransientBytes / double(MB),
+			stats.BarrierCount + stats.AliasingBarrierCount, median);
+	}
+	printf("%s\n", g_Failures ? "FAILED" : "culling, order, placement and barriers hold");
+	return g_Failures ? 1 : 0;
+}
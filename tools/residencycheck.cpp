@@ -0,0 +1,259 @@
+//residency policy under a simulated budget: checks that what a frame uses is always resident, that nothing the
+//GPU may still read is evicted, that least recently used resources go first and lose top mips before being
+//evicted whole, and that dropped mips come back once there is room. Then walks a camera through a streaming
+//scene of textures whose working set is larger than the budget while the budget shrinks and grows, checking
+//every frame, and reports the resident bytes against the budget and how often resources were paged back in.
+//From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/residencycheck.cpp -o residencycheck
+//  ./residencycheck [--frames N] [--textures N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../residency.h"
+#include "check.h"
+
+static const uint64_t MB = 1024 * 1024;
+
+//mip sizes of a square texture with 4 bytes per texel, most detailed first
+static std::vector<uint64_t> MakeMips(uint32_t size)
+{
+	std::vector<uint64_t> mips;
+	for (; size; size >>= 1)
+	{
+		mips.push_back(uint64_t(size) * size * 4);
+	}
+	return mips;
+}
+
+static bool Contains(const std::vector<ResidencyPolicy::Handle>& handles, ResidencyPolicy::Handle handle)
+{
+	return std::find(handles.begin(), handles.end(), handle) != handles.end();
+}
+
+static void CheckEvictionOrder()
+{
+	ResidencyPolicy policy;
+	policy.Create(2, 0.0f);
+	ResidencyPolicy::Operations ops;
+
+	//four 10MB buffers used in frames 1 to 4
+	ResidencyPolicy::Handle buffers[4];
+	for (uint64_t i = 0; i < 4; ++i)
+	{
+		buffers[i] = policy.Register(10 * MB, i + 1);
+	}
+	policy.Update(4, 100 * MB, ops);
+	Check(ops.IsEmpty() && policy.GetResidentBytes() == 40 * MB, "nothing changes under the budget");
+
+	//least recently used go first, and only as many as it takes
+	policy.Update(5, 25 * MB, ops);
+	Check(ops.Evict.size() == 2 && ops.Evict[0] == buffers[0] && ops.Evict[1] == buffers[1], "least recently used are evicted first");
+	Check(policy.IsResident(buffers[2]) && policy.IsResident(buffers[3]), "eviction stops under the budget");
+
+	//at frame 5 with two frames in flight the GPU may still read what frame 4 used, so it stays over the budget
+	policy.Update(5, 5 * MB, ops);
+	Check(ops.Evict.size() == 1 && ops.Evict[0] == buffers[2], "what isn't in flight is evicted");
+	Check(policy.IsResident(buffers[3]) && policy.GetResidentBytes() == 10 * MB, "nothing in flight is evicted to meet the budget");
+
+	//a frame using an evicted buffer brings it back before it executes
+	policy.MarkUsed(buffers[0], 6);
+	policy.Update(6, 100 * MB, ops);
+	Check(Contains(ops.MakeResident, buffers[0]) && policy.IsResident(buffers[0]), "used resources are made resident");
+
+	ResidencyPolicy::Statistics stats = policy.GetStatistics();
+	Check(stats.Evictions == 3 && stats.Restores == 1 && stats.EvictedCount == 2 && stats.ResidentCount == 2,
+		"statistics count evictions and restores");
+}
+
+static void CheckMipDrops()
+{
+	ResidencyPolicy policy;
+	policy.Create(1, 0.0f);
+	ResidencyPolicy::Operations ops;
+
+	//1024^2: 4MB top mip, 1MB, 256KB and so on, up to 3 top mips can be dropped
+	std::vector<uint64_t> mips = MakeMips(1024);
+	uint64_t full = 0;
+	for (uint64_t size : mips)
+	{
+		full += size;
+	}
+	ResidencyPolicy::Handle texture = policy.Register(mips.data(), static_cast<uint32_t>(mips.size()), 3, 1);
+	ResidencyPolicy::Handle buffer = policy.Register(2 * MB, 2);
+
+	//dropping the top mip of the older texture is enough, so it isn't evicted
+	policy.Update(3, full + 2 * MB - 4 * MB, ops);
+	Check(ops.Evict.empty() && policy.IsResident(texture) && policy.GetMipBias(texture) == 1, "top mip is dropped before evicting");
+	Check(ops.SetMipBias.size() == 1 && ops.SetMipBias[0].Resource == texture && ops.SetMipBias[0].MipBias == 1, "the mip bias change is reported");
+
+	//dropping every droppable mip isn't enough, so the texture goes as a whole
+	policy.Update(3, 2 * MB, ops);
+	Check(Contains(ops.Evict, texture) && !policy.IsResident(texture) && policy.IsResident(buffer), "texture is evicted when mips aren't enough");
+
+	//coming back it starts at the lowest allowed detail, and gets mips back while there is room
+	policy.MarkUsed(texture, 4);
+	policy.Update(4, 2 * MB + full - 1 * MB, ops);
+	Check(Contains(ops.MakeResident, texture), "reused texture is made resident");
+	Check(policy.GetMipBias(texture) == 1, "restored mips stop at the budget");
+	Check(!ops.SetMipBias.empty() && ops.SetMipBias.back().Resource == texture && ops.SetMipBias.back().MipBias == 1, "the last mip bias entry wins");
+
+	policy.MarkUsed(texture, 5);
+	policy.Update(5, 100 * MB, ops);
+	Check(policy.GetMipBias(texture) == 0 && policy.GetResidentBytes() == full + 2 * MB, "all mips come back with room");
+}
+
+static void CheckUnregister()
+{
+	ResidencyPolicy policy;
+	policy.Create(1);
+	ResidencyPolicy::Operations ops;
+
+	ResidencyPolicy::Handle a = policy.Register(8 * MB, 1);
+	ResidencyPolicy::Handle b = policy.Register(8 * MB, 1);
+	policy.Unregister(a);
+	Check(policy.GetResidentBytes() == 8 * MB, "unregistering removes the resident bytes");
+	ResidencyPolicy::Handle c = policy.Register(4 * MB, 2);
+	Check(c == a, "handles are reused");
+	policy.Update(10, 1 * MB, ops);
+	Check(ops.Evict.size() == 2 && Contains(ops.Evict, b) && Contains(ops.Evict, c), "reused handles are tracked");
+}
+
+//a camera moving along a row of textures, each frame it sees a window of them. The window is larger than the
+//budget at full detail, so textures at the edge of the window lose mips and the ones behind are evicted.
+static void CheckStreaming(uint32_t frames, uint32_t textureCount)
+{
+	const uint32_t framesInFlight = 2;
+	const float headroom = 0.05f;
+	ResidencyPolicy policy;
+	policy.Create(framesInFlight, headroom);
+	ResidencyPolicy::Operations ops;
+
+	std::mt19937 random(3);
+	std::vector<ResidencyPolicy::Handle> textures(textureCount);
+	std::vector<uint64_t> lastUsed(textureCount, 0);
+	for (auto& texture : textures)
+	{
+		std::vector<uint64_t> mips = MakeMips(256u << (random() % 4));
+		texture = policy.Register(mips.data(), static_cast<uint32_t>(mips.size()), 2, 0);
+	}
+	//registered in order on a new policy, so handles index lastUsed directly
+
+	const uint32_t window = textureCount / 8 + 1;
+	bool usedResident = true;
+	bool inFlightKept = true;
+	bool underBudget = true;
+	bool lruOrder = true;
+	uint64_t budgetFrames = 0;
+	double residentRatio = 0.0;
+	uint32_t thrash = 0; //evicted and made resident again within a few frames
+	std::vector<uint64_t> evictedAt(textureCount, 0);
+	for (uint64_t frame = 1; frame <= frames; ++frame)
+	{
+		//the budget sags to a third in the middle of the run, as when another application takes video memory
+		uint64_t budget = (frame > frames / 3 && frame < 2 * frames / 3) ? 96 * MB : 288 * MB;
+
+		uint32_t first = static_cast<uint32_t>((frame / 4) % textureCount);
+		std::vector<ResidencyPolicy::Handle> used;
+		for (uint32_t i = 0; i < window; ++i)
+		{
+			uint32_t index = (first + i) % textureCount;
+			policy.MarkUsed(textures[index], frame);
+			lastUsed[index] = frame;
+			used.push_back(textures[index]);
+		}
+		policy.Update(frame, budget, ops);
+
+		for (ResidencyPolicy::Handle h : used)
+		{
+			usedResident &= policy.IsResident(h);
+		}
+		uint64_t newestEvicted = 0;
+		for (ResidencyPolicy::Handle h : ops.Evict)
+		{
+			inFlightKept &= lastUsed[h] + framesInFlight <= frame;
+			newestEvicted = std::max(newestEvicted, lastUsed[h]);
+			evictedAt[h] = frame;
+		}
+		for (ResidencyPolicy::Handle h : ops.MakeResident)
+		{
+			thrash += evictedAt[h] && evictedAt[h] + 8 > frame;
+		}
+		//every resident texture that could have gone instead was used more recently than the ones evicted
+		if (!ops.Evict.empty())
+		{
+			for (uint32_t i = 0; i < textureCount; ++i)
+			{
+				if (policy.IsResident(textures[i]) && lastUsed[i] + framesInFlight <= frame && policy.GetMipBias(textures[i]) == 0)
+				{
+					lruOrder &= lastUsed[i] >= newestEvicted;
+				}
+			}
+		}
+
+		//only what is in flight or in use can keep usage over the budget
+		uint32_t pinned = 0;
+		for (uint32_t i = 0; i < textureCount; ++i)
+		{
+			if (policy.IsResident(textures[i]) && lastUsed[i] + framesInFlight > frame)
+			{
+				++pinned;
+			}
+		}
+		ResidencyPolicy::Statistics stats = policy.GetStatistics();
+		if (stats.ResidentBytes > budget)
+		{
+			//every resident texture has to be one the policy wasn't allowed to touch
+			underBudget &= pinned == stats.ResidentCount;
+		}
+		else
+		{
+			residentRatio += double(stats.ResidentBytes) / double(budget);
+			++budgetFrames;
+		}
+	}
+	Check(usedResident, "textures a frame uses are resident");
+	Check(inFlightKept, "textures in flight are never evicted");
+	Check(underBudget, "usage only exceeds the budget when everything resident is in flight");
+	Check(lruOrder, "evictions take the least recently used textures");
+
+	ResidencyPolicy::Statistics stats = policy.GetStatistics();
+	printf("%u frames, %u textures | %.0f%% of the budget used on average, %llu frames over it | %u evictions, %u mip drops, %u restores, %u within 8 frames | ",
+		frames, textureCount, budgetFrames ? residentRatio * 100.0 / budgetFrames : 0.0,
+		static_cast<unsigned long long>(frames - budgetFrames), stats.Evictions, stats.MipDrops, stats.Restores, thrash);
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t frames = 3000;
+	uint32_t textures = 400;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+		{
+			frames = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--textures") && i + 1 < argc)
+		{
+			textures = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+	if (!textures)
+	{
+		fprintf(stderr, "--textures has to be at least 1\n");
+		return 1;
+	}
+
+	CheckEvictionOrder();
+	CheckMipDrops();
+	CheckUnregister();
+	CheckStreaming(frames, textures);
+	printf("%s\n", g_Failures ? "FAILED" : "budget respected, in flight and used textures kept");
+	return g_Failures ? 1 : 0;
+}
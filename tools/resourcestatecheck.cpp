@@ -0,0 +1,269 @@
+//resource state tracking against a null device: checks that redundant transitions are elided or folded before
+//the flush, that combined read states cover their parts, that textures are tracked per mip of every array slice,
+//and that transitions never fold across a UAV or aliasing barrier, which would move them ahead of it. Every
+//flush is recorded on a NullCommandList, whose validation catches a wrong before-state, and the recorded
+//barriers are compared with the expected ones in order. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/resourcestatecheck.cpp -o resourcestatecheck
+//  ./resourcestatecheck
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../resourcestates.h"
+#include "../nulldevice.h"
+#include "check.h"
+
+static ID3D12Resource* CreateResource(NullDevice& device, D3D12_RESOURCE_DIMENSION dimension, UINT16 mips, UINT16 depthOrArraySize, D3D12_RESOURCE_STATES state)
+{
+	D3D12_HEAP_PROPERTIES heap;
+	memset(&heap, 0, sizeof(heap));
+	heap.Type = D3D12_HEAP_TYPE_DEFAULT;
+	D3D12_RESOURCE_DESC desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.Dimension = dimension;
+	desc.Width = 256;
+	desc.Height = dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? 1 : 256;
+	desc.DepthOrArraySize = depthOrArraySize;
+	desc.MipLevels = mips;
+	desc.SampleDesc.Count = 1;
+	ID3D12Resource* resource = nullptr;
+	device.CreateCommittedResource(&heap, D3D12_HEAP_FLAG_NONE, &desc, state, nullptr, &resource);
+	return resource;
+}
+
+//a barrier as the tests spell them out, subresource is ignored for UAV and aliasing barriers
+struct ExpectedBarrier
+{
+	D3D12_RESOURCE_BARRIER_TYPE Type;
+	ID3D12Resource* Resource; //after-resource of an aliasing barrier
+	UINT Subresource;
+	D3D12_RESOURCE_STATES Before;
+	D3D12_RESOURCE_STATES After;
+};
+
+static ExpectedBarrier Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+{
+	ExpectedBarrier barrier = { D3D12_RESOURCE_BARRIER_TYPE_TRANSITION, resource, subresource, before, after };
+	return barrier;
+}
+
+static ExpectedBarrier Uav(ID3D12Resource* resource)
+{
+	ExpectedBarrier barrier = { D3D12_RESOURCE_BARRIER_TYPE_UAV, resource, 0, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COMMON };
+	return barrier;
+}
+
+static ExpectedBarrier Aliasing(ID3D12Resource* after)
+{
+	ExpectedBarrier barrier = { D3D12_RESOURCE_BARRIER_TYPE_ALIASING, after, 0, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COMMON };
+	return barrier;
+}
+
+static bool Matches(const D3D12_RESOURCE_BARRIER& barrier, const ExpectedBarrier& expected)
+{
+	if (barrier.Type != expected.Type)
+	{
+		return false;
+	}
+	switch (barrier.Type)
+	{
+	case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+		return barrier.Transition.pResource == expected.Resource && barrier.Transition.Subresource == expected.Subresource &&
+			barrier.Transition.StateBefore == expected.Before && barrier.Transition.StateAfter == expected.After;
+	case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+		return barrier.UAV.pResource == expected.Resource;
+	default:
+		return barrier.Aliasing.pResourceAfter == expected.Resource;
+	}
+}
+
+//records one flush and compares what reached the command list, in order
+class FlushChecker
+{
+public:
+	FlushChecker(NullDevice& device) : m_Device(device)
+	{
+		device.CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, &m_Allocator);
+		device.CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_Allocator, nullptr, &m_CommandList);
+		m_CommandList->Close();
+		m_CommandList->SetRecording(true);
+	}
+
+	void Flush(ResourceStateTracker& states, const std::vector<ExpectedBarrier>& expected, const char* what)
+	{
+		UINT errors = m_Device.GetErrorCount();
+		m_CommandList->Reset(m_Allocator, nullptr);
+		states.Flush(m_CommandList);
+		m_CommandList->Close();
+
+		const std::vector<D3D12_RESOURCE_BARRIER>& barriers = m_CommandList->GetBarriers();
+		bool same = barriers.size() == expected.size() && m_CommandList->GetCounts().Calls[NullCallCounts::ResourceBarrier] == (expected.empty() ? 0u : 1u);
+		for (size_t i = 0; same && i < barriers.size(); ++i)
+		{
+			same = Matches(barriers[i], expected[i]);
+		}
+		Check(same, what);
+		Check(m_Device.GetErrorCount() == errors, "the null device accepts the barriers");
+		for (size_t i = errors; i < m_Device.GetMessages().size(); ++i)
+		{
+			fprintf(stderr, "  %s\n", m_Device.GetMessages()[i].c_str());
+		}
+		m_Device.ClearErrors();
+	}
+
+private:
+	NullDevice& m_Device;
+	NullCommandAllocator* m_Allocator;
+	NullCommandList* m_CommandList;
+};
+
+static void CheckElision(NullDevice& device, FlushChecker& checker)
+{
+	ID3D12Resource* texture = CreateResource(device, D3D12_RESOURCE_DIMENSION_TEXTURE2D, 1, 1, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	ResourceStateTracker states;
+	states.Register(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+	states.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	Check(states.GetPendingCount() == 0, "a transition to the current state is elided");
+
+	states.Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	states.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	Check(states.GetPendingCount() == 0, "a transition and its reverse cancel before the flush");
+
+	states.Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	states.Transition(texture, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	checker.Flush(states, { Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE) },
+		"two transitions fold into one from the first to the last state");
+
+	states.Transition(texture, D3D12_RESOURCE_STATE_GENERIC_READ);
+	states.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	checker.Flush(states, { Transition(texture, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_GENERIC_READ) },
+		"a combined read state covers its parts");
+	Check(states.GetState(texture) == D3D12_RESOURCE_STATE_GENERIC_READ, "the combined read state is kept");
+
+	ResourceStateTracker::Statistics stats = states.GetStatistics();
+	Check(stats.Emitted == 2 && stats.Flushes == 2 && stats.Requested == 7 && stats.Elided == 5, "statistics count requested, elided and emitted transitions");
+}
+
+static void CheckSubresources(NullDevice& device, FlushChecker& checker)
+{
+	//4 mips of 3 slices, subresource = mip + slice * mips
+	ID3D12Resource* array = CreateResource(device, D3D12_RESOURCE_DIMENSION_TEXTURE2D, 4, 3, D3D12_RESOURCE_STATE_COPY_DEST);
+	ID3D12Resource* volume = CreateResource(device, D3D12_RESOURCE_DIMENSION_TEXTURE3D, 4, 8, D3D12_RESOURCE_STATE_COPY_DEST);
+	ID3D12Resource* buffer = CreateResource(device, D3D12_RESOURCE_DIMENSION_BUFFER, 1, 1, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	D3D12_RESOURCE_DESC desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.MipLevels = 4;
+	desc.DepthOrArraySize = 3;
+	Check(GetSubresourceCount(desc) == 12, "an array texture has a subresource per mip of every slice");
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+	desc.DepthOrArraySize = 8;
+	Check(GetSubresourceCount(desc) == 4, "a volume texture has a subresource per mip");
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	desc.MipLevels = 1;
+	desc.DepthOrArraySize = 1;
+	Check(GetSubresourceCount(desc) == 1, "a buffer is one subresource");
+
+	ResourceStateTracker states;
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.MipLevels = 4;
+	desc.DepthOrArraySize = 3;
+	states.Register(array, D3D12_RESOURCE_STATE_COPY_DEST, GetSubresourceCount(desc));
+	states.Register(volume, D3D12_RESOURCE_STATE_COPY_DEST, 4);
+	states.Register(buffer, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	//mip 1 of the last slice, past MipLevels
+	const UINT lastSliceMip1 = 1 + 2 * 4;
+	states.Transition(array, D3D12_RESOURCE_STATE_RENDER_TARGET, lastSliceMip1);
+	states.Transition(volume, D3D12_RESOURCE_STATE_RENDER_TARGET, 3);
+	checker.Flush(states, {
+		Transition(array, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_RENDER_TARGET, lastSliceMip1),
+		Transition(volume, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_RENDER_TARGET, 3) },
+		"a subresource of any slice is transitioned on its own");
+	Check(device.GetResourceState(array, lastSliceMip1) == D3D12_RESOURCE_STATE_RENDER_TARGET &&
+		device.GetResourceState(array, lastSliceMip1 - 4) == D3D12_RESOURCE_STATE_COPY_DEST, "only that subresource changes state");
+
+	//diverged subresources come back one by one, the rest as they are
+	states.Transition(array, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	std::vector<ExpectedBarrier> expected;
+	for (UINT i = 0; i < 12; ++i)
+	{
+		expected.push_back(Transition(array, i == lastSliceMip1 ? D3D12_RESOURCE_STATE_RENDER_TARGET : D3D12_RESOURCE_STATE_COPY_DEST,
+			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, i));
+	}
+	checker.Flush(states, expected, "every subresource of every slice is brought back");
+	Check(device.GetResourceState(array, 11) == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, "the last slice's last mip is tracked");
+}
+
+static void CheckUavAndAliasing(NullDevice& device, FlushChecker& checker)
+{
+	ID3D12Resource* texture = CreateResource(device, D3D12_RESOURCE_DIMENSION_TEXTURE2D, 2, 1, D3D12_RESOURCE_STATE_COMMON);
+	ID3D12Resource* buffer = CreateResource(device, D3D12_RESOURCE_DIMENSION_BUFFER, 1, 1, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	ID3D12Resource* aliased = CreateResource(device, D3D12_RESOURCE_DIMENSION_TEXTURE2D, 1, 1, D3D12_RESOURCE_STATE_COMMON);
+	ResourceStateTracker states;
+	states.Register(texture, D3D12_RESOURCE_STATE_COMMON, 2);
+	states.Register(buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	states.Register(aliased, D3D12_RESOURCE_STATE_COMMON);
+
+	//a transition after a UAV barrier doesn't fold into one before it
+	states.Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	states.UavBarrier(buffer);
+	states.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	checker.Flush(states, {
+		Transition(texture, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_RENDER_TARGET),
+		Uav(buffer),
+		Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE) },
+		"transitions don't fold across a UAV barrier");
+
+	//nor cancel out across an aliasing barrier
+	states.Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST);
+	states.Alias(nullptr, aliased);
+	states.Transition(aliased, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	states.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	checker.Flush(states, {
+		Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+		Aliasing(aliased),
+		Transition(aliased, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_RENDER_TARGET),
+		Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE) },
+		"transitions don't cancel across an aliasing barrier");
+
+	//a whole resource transition before the barrier stays whole when the resource goes per subresource after it
+	states.Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	states.UavBarrier(buffer);
+	states.Transition(texture, D3D12_RESOURCE_STATE_COPY_SOURCE, 1);
+	states.Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, 1);
+	checker.Flush(states, {
+		Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET),
+		Uav(buffer),
+		Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_DEST, 1) },
+		"per subresource transitions queue behind the barrier and fold there");
+
+	//unregistering a resource whose transition was queued before the barrier leaves the ones after it foldable
+	states.Transition(aliased, D3D12_RESOURCE_STATE_COPY_DEST);
+	states.UavBarrier(buffer);
+	states.Transition(texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	states.Unregister(aliased);
+	states.Transition(texture, D3D12_RESOURCE_STATE_COPY_SOURCE, 0);
+	checker.Flush(states, {
+		Uav(buffer),
+		Transition(texture, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_SOURCE, 0),
+		Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, 1) },
+		"transitions after the barrier still fold once an earlier one is dropped");
+}
+
+int main()
+{
+	NullDevice device;
+	FlushChecker checker(device);
+	CheckElision(device, checker);
+	CheckSubresources(device, checker);
+	CheckUavAndAliasing(device, checker);
+	printf("%s\n", g_Failures ? "FAILED" : "barriers are elided, folded and ordered as expected");
+	return g_Failures ? 1 : 0;
+}
@@ -0,0 +1,364 @@
+//headless benchmark of the per frame draw submission path: synthetic scenes of 1k to 1M objects go through
+//constant updates, draw packet building, sorting and recording into the null device, timed per phase with
+//FrameProfiler. Runs anywhere the null device builds, e.g. from the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/scenebench.cpp -o scenebench
+//  ./scenebench [--objects N] [--materials N] [--textures N] [--pipelines N] [--frames N] [--csv file]
+//
+//Without --objects every standard size is run. The process exits with 1 when the null device reported a
+//validation error, so the benchmark also guards the recording code.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "../nulldevice.h"
+#include "../drawpackets.h"
+#include "../resourcestates.h"
+#include "../frameclock.h"
+#include "../frameprofiler.h"
+
+struct SceneConfig
+{
+	uint32_t Objects;
+	uint32_t Materials;
+	uint32_t Textures;
+	uint32_t Pipelines;
+	uint32_t Frames;
+};
+
+//per object constants, a world matrix padded to the 256 byte constant buffer alignment
+struct ObjectConstants
+{
+	float World[16];
+	float Padding[48];
+};
+
+//the GPU objects of a scene and the state of its objects, structured like the sample: root CBV at parameter 0,
+//a texture table at parameter 1, one constant buffer slot per object in a persistently mapped upload buffer
+class SyntheticScene
+{
+public:
+	static const uint32_t ConstantsSize = sizeof(ObjectConstants);
+	static const uint32_t MeshCount = 16;
+
+	bool Create(NullDevice& device, const SceneConfig& config)
+	{
+		m_Config = config;
+
+		HRESULT hr = device.CreateRootSignature(2, &m_RootSignature);
+		for (uint32_t i = 0; i < config.Pipelines && SUCCEEDED(hr); ++i)
+		{
+			ID3D12PipelineState* pipeline = nullptr;
+			hr = device.CreateGraphicsPipelineState(m_RootSignature, true, &pipeline);
+			m_Pipelines.push_back(pipeline);
+		}
+
+		D3D12_DESCRIPTOR_HEAP_DESC heapDesc = { D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, config.Textures, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE, 0 };
+		if (SUCCEEDED(hr))
+		{
+			hr = device.CreateDescriptorHeap(&heapDesc, &m_DescriptorHeap);
+		}
+
+		D3D12_HEAP_PROPERTIES uploadHeap = {};
+		uploadHeap.Type = D3D12_HEAP_TYPE_UPLOAD;
+		D3D12_RESOURCE_DESC bufferDesc = {};
+		bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		bufferDesc.Width = UINT64(config.Objects) * ConstantsSize;
+		bufferDesc.Height = 1;
+		bufferDesc.DepthOrArraySize = 1;
+		bufferDesc.MipLevels = 1;
+		bufferDesc.SampleDesc.Count = 1;
+		bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		if (SUCCEEDED(hr))
+		{
+			hr = device.CreateCommittedResource(&uploadHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, &m_ConstantBuffer);
+		}
+		D3D12_HEAP_PROPERTIES defaultHeap = {};
+		defaultHeap.Type = D3D12_HEAP_TYPE_DEFAULT;
+		bufferDesc.Width = 1 << 20;
+		if (SUCCEEDED(hr))
+		{
+			hr = device.CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, &m_MeshBuffer);
+		}
+		D3D12_RESOURCE_DESC targetDesc = bufferDesc;
+		targetDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		targetDesc.Width = 1920;
+		targetDesc.Height = 1080;
+		targetDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		targetDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		targetDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+		if (SUCCEEDED(hr))
+		{
+			hr = device.CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &targetDesc, D3D12_RESOURCE_STATE_PRESENT, nullptr, &m_BackBuffer);
+		}
+		if (FAILED(hr))
+		{
+			return false;
+		}
+
+		m_Constants.resize(config.Objects);
+		m_ConstantsAddress = device.GetGPUVirtualAddress(m_ConstantBuffer);
+		m_MeshAddress = device.GetGPUVirtualAddress(m_MeshBuffer);
+		m_TextureTables = device.GetGPUDescriptorHandleForHeapStart(m_DescriptorHeap);
+
+		//objects on a grid, each with a fixed mesh, material and spin; a material picks a pipeline and a texture
+		m_Objects.resize(config.Objects);
+		uint32_t seed = 12345;
+		uint32_t side = static_cast<uint32_t>(ceil(sqrt(double(config.Objects))));
+		for (uint32_t i = 0; i < config.Objects; ++i)
+		{
+			Object& object = m_Objects[i];
+			object.X = float(i % side) * 2.0f;
+			object.Z = float(i / side) * 2.0f;
+			object.Mesh = Random(seed) % MeshCount;
+			object.Material = Random(seed) % config.Materials;
+			object.Spin = float(Random(seed) % 1000) * 0.001f;
+		}
+		m_MaterialPipeline.resize(config.Materials);
+		m_MaterialTexture.resize(config.Materials);
+		for (uint32_t m = 0; m < config.Materials; ++m)
+		{
+			m_MaterialPipeline[m] = m % config.Pipelines;
+			m_MaterialTexture[m] = m % config.Textures;
+		}
+		m_ResourceStates.Register(m_BackBuffer, D3D12_RESOURCE_STATE_PRESENT);
+		return true;
+	}
+
+	//world matrices of every object, written to the upload buffer the way the sample writes its world matrix
+	void UpdateConstants(float time)
+	{
+		for (uint32_t i = 0; i < m_Config.Objects; ++i)
+		{
+			const Object& object = m_Objects[i];
+			float angle = time * object.Spin;
+			float c = cosf(angle), s = sinf(angle);
+			float* world = m_Constants[i].World;
+			world[0] = c;    world[1] = 0.0f; world[2] = -s;   world[3] = object.X;
+			world[4] = 0.0f; world[5] = 1.0f; world[6] = 0.0f; world[7] = 0.0f;
+			world[8] = s;    world[9] = 0.0f; world[10] = c;   world[11] = object.Z;
+			world[12] = 0.0f; world[13] = 0.0f; world[14] = 0.0f; world[15] = 1.0f;
+		}
+	}
+
+	void BuildDrawList(DrawList& drawList)
+	{
+		drawList.Reset();
+		float depthScale = 1.0f / (float(m_Objects.size()) * 2.0f + 1.0f);
+		for (uint32_t i = 0; i < m_Config.Objects; ++i)
+		{
+			const Object& object = m_Objects[i];
+			uint32_t pipeline = m_MaterialPipeline[object.Material];
+
+			DrawPacket packet;
+			memset(&packet, 0, sizeof(packet));
+			packet.SortKey = DrawSortKey::Make(0, pipeline, object.Material, (object.X + object.Z) * depthScale);
+			packet.Pipeline = m_Pipelines[pipeline];
+			packet.RootSignature = m_RootSignature;
+			packet.DescriptorHeapCount = 1;
+			packet.DescriptorHeaps[0] = m_DescriptorHeap;
+			packet.RootConstantBuffer = m_ConstantsAddress + UINT64(i) * ConstantsSize;
+			packet.RootTableCount = 1;
+			packet.RootTables[0].ptr = m_TextureTables.ptr + UINT64(m_MaterialTexture[object.Material]) * NullDevice::DescriptorSize;
+			packet.Topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			packet.VertexBuffer.BufferLocation = m_MeshAddress + UINT64(object.Mesh) * 0x8000;
+			packet.VertexBuffer.SizeInBytes = 0x6000;
+			packet.VertexBuffer.StrideInBytes = 32;
+			packet.IndexBuffer.BufferLocation = m_MeshAddress + UINT64(object.Mesh) * 0x8000 + 0x6000;
+			packet.IndexBuffer.SizeInBytes = 0x2000;
+			packet.IndexBuffer.Format = DXGI_FORMAT_R16_UINT;
+			packet.IndexCount = 36;
+			packet.InstanceCount = 1;
+			drawList.Add(packet);
+		}
+		drawList.Sort();
+	}
+
+	//the frame's commands, as in Frame(): target transition, pass setup, the draws, transition back
+	void Record(NullCommandList* commandList, DrawList& drawList)
+	{
+		m_ResourceStates.Transition(m_BackBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_ResourceStates.Flush(commandList);
+
+		D3D12_VIEWPORT viewport = { 0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f };
+		D3D12_RECT scissor = { 0, 0, 1920, 1080 };
+		D3D12_CPU_DESCRIPTOR_HANDLE renderTarget = { 1 };
+		const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
+		commandList->RSSetViewports(1, &viewport);
+		commandList->RSSetScissorRects(1, &scissor);
+		commandList->OMSetRenderTargets(1, &renderTarget, FALSE, nullptr);
+		commandList->ClearRenderTargetView(renderTarget, clearColor, 0, nullptr);
+		drawList.Submit(commandList);
+
+		m_ResourceStates.Transition(m_BackBuffer, D3D12_RESOURCE_STATE_PRESENT);
+		m_ResourceStates.Flush(commandList);
+	}
+
+private:
+	struct Object
+	{
+		float X;
+		float Z;
+		uint32_t Mesh;
+		uint32_t Material;
+		float Spin;
+	};
+
+	static uint32_t Random(uint32_t& seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	}
+
+	SceneConfig m_Config;
+	ID3D12RootSignature* m_RootSignature;
+	std::vector<ID3D12PipelineState*> m_Pipelines;
+	ID3D12DescriptorHeap* m_DescriptorHeap;
+	ID3D12Resource* m_ConstantBuffer;
+	ID3D12Resource* m_MeshBuffer;
+	ID3D12Resource* m_BackBuffer;
+	D3D12_GPU_VIRTUAL_ADDRESS m_ConstantsAddress;
+	D3D12_GPU_VIRTUAL_ADDRESS m_MeshAddress;
+	D3D12_GPU_DESCRIPTOR_HANDLE m_TextureTables;
+	std::vector<ObjectConstants> m_Constants; //stands in for the mapped upload buffer
+	std::vector<Object> m_Objects;
+	std::vector<uint32_t> m_MaterialPipeline;
+	std::vector<uint32_t> m_MaterialTexture;
+	ResourceStateTracker m_ResourceStates;
+};
+
+//runs one configuration and prints a line, returns the number of validation errors
+static uint32_t RunScene(const SceneConfig& config, FILE* csv)
+{
+	NullDevice device;
+	NullCommandAllocator* allocator = nullptr;
+	NullCommandList* commandList = nullptr;
+	NullCommandQueue* queue = nullptr;
+	NullFence* fence = nullptr;
+	device.CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, &allocator);
+	device.CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, nullptr, &commandList);
+	device.CreateCommandQueue(&queue);
+	device.CreateFence(0, &fence);
+	commandList->Close();
+
+	SyntheticScene scene;
+	if (!scene.Create(device, config))
+	{
+		fprintf(stderr, "failed to create a scene of %u objects\n", config.Objects);
+		return 1;
+	}
+
+	SteadyFrameClock clock;
+	FrameProfiler profiler;
+	profiler.Create(&clock, config.Frames);
+	DrawList drawList;
+
+	//one warm up frame so allocations of the draw list are not measured
+	for (uint32_t frame = 0; frame <= config.Frames; ++frame)
+	{
+		if (frame == 1)
+		{
+			profiler.Create(&clock, config.Frames);
+		}
+		profiler.BeginFrame();
+
+		profiler.BeginPhase(FrameProfiler::ConstantUpdate);
+		scene.UpdateConstants(float(frame) / 60.0f);
+
+		profiler.BeginPhase(FrameProfiler::Recording);
+		allocator->Reset();
+		commandList->Reset(allocator, nullptr);
+		scene.BuildDrawList(drawList);
+		scene.Record(commandList, drawList);
+		commandList->Close();
+
+		profiler.BeginPhase(FrameProfiler::Submit);
+		queue->ExecuteCommandLists(1, &commandList);
+		queue->Signal(fence, frame + 1);
+
+		profiler.EndFrame();
+	}
+
+	FrameProfiler::Report report = profiler.GetReport();
+	const DrawSubmitStatistics& stats = drawList.GetStatistics();
+	double drawsPerSecond = report.Frame.P50 > 0.0 ? double(stats.Draws) / report.Frame.P50 : 0.0;
+	printf("%8u objects %5u materials %5u textures %4u pipelines | frame ms p50 %8.3f p99 %8.3f | constants %7.3f recording %8.3f submit %6.3f | %6.2f Mdraws/s | %u calls/frame, %u elided\n",
+		config.Objects, config.Materials, config.Textures, config.Pipelines,
+		report.Frame.P50 * 1000.0, report.Frame.P99 * 1000.0,
+		report.Phases[FrameProfiler::ConstantUpdate].P50 * 1000.0, report.Phases[FrameProfiler::Recording].P50 * 1000.0,
+		report.Phases[FrameProfiler::Submit].P50 * 1000.0, drawsPerSecond / 1e6,
+		unsigned(commandList->GetCounts().GetStateChanges() + commandList->GetCounts().GetDraws()), stats.GetTotalElided());
+	if (csv)
+	{
+		fprintf(csv, "%u,%u,%u,%u,%u,%f,%f,%f,%f,%f,%f\n", config.Objects, config.Materials, config.Textures, config.Pipelines, report.FrameCount,
+			report.Frame.P50 * 1000.0, report.Frame.P99 * 1000.0, report.Phases[FrameProfiler::ConstantUpdate].P50 * 1000.0,
+			report.Phases[FrameProfiler::Recording].P50 * 1000.0, report.Phases[FrameProfiler::Submit].P50 * 1000.0, drawsPerSecond);
+	}
+
+	for (const auto& message : device.GetMessages())
+	{
+		fprintf(stderr, "validation: %s\n", message.c_str());
+	}
+	return device.GetErrorCount();
+}
+
+int main(int argc, char* argv[])
+{
+	SceneConfig config = { 0, 256, 128, 16, 0 };
+	const char* csvFile = nullptr;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		uint32_t value = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+		if (!strcmp(argv[i], "--objects")) config.Objects = value;
+		else if (!strcmp(argv[i], "--materials")) config.Materials = value;
+		else if (!strcmp(argv[i], "--textures")) config.Textures = value;
+		else if (!strcmp(argv[i], "--pipelines")) config.Pipelines = value;
+		else if (!strcmp(argv[i], "--frames")) config.Frames = value;
+		else if (!strcmp(argv[i], "--csv")) csvFile = argv[i + 1];
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+	if (!config.Materials || !config.Textures || !config.Pipelines || config.Pipelines > (1u << DrawSortKey::PipelineBits) ||
+		config.Materials > (1u << DrawSortKey::MaterialBits))
+	{
+		fprintf(stderr, "materials, textures and pipelines must be at least 1 and fit the sort key\n");
+		return 2;
+	}
+
+	FILE* csv = csvFile ? fopen(csvFile, "w") : nullptr;
+	if (csv)
+	{
+		fprintf(csv, "objects,materials,textures,pipelines,frames,frame_p50_ms,frame_p99_ms,constants_p50_ms,recording_p50_ms,submit_p50_ms,draws_per_second\n");
+	}
+
+	static const uint32_t standardSizes[] = { 1000, 10000, 100000, 1000000 };
+	uint32_t errors = 0;
+	for (uint32_t size : standardSizes)
+	{
+		SceneConfig run = config;
+		run.Objects = config.Objects ? config.Objects : size;
+		if (!run.Frames)
+		{
+			//roughly the same number of draws per size, at least 10 frames for the percentiles to mean something
+			run.Frames = run.Objects >= 1000000 ? 10 : (run.Objects >= 100000 ? 30 : 200);
+		}
+		errors += RunScene(run, csv);
+		if (config.Objects)
+		{
+			break;
+		}
+	}
+
+	if (csv)
+	{
+		fclose(csv);
+	}
+	return errors ? 1 : 0;
+}
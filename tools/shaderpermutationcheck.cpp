@@ -0,0 +1,270 @@
+//shader permutation checks against a stub compiler: packing and unpacking keys across several axes and the
+//defines they compile with, that keys with bits past the last axis or value indices past an axis's values are
+//invalid and never compiled or cached, that Request misses with null while the pool compiles and then returns the
+//variant, that a failed compile is remembered and not retried, and that RequestBlocking on a key still queued on
+//the pool waits for that compile instead of compiling it again. Then reports how long a Request hit takes.
+//The invalid keys are the point of some checks, so it is built with NDEBUG to keep the asserts from stopping it.
+//From the repository root:
+//
+//  g++ -O2 -DNDEBUG -std=c++14 -pthread -I. tools/shaderpermutationcheck.cpp -o shaderpermutationcheck
+//  ./shaderpermutationcheck [--requests N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "../shaderpermutations.h"
+#include "../frameclock.h"
+#include "check.h"
+
+#ifndef NDEBUG
+#error "build with -DNDEBUG, the invalid key checks trip the asserts otherwise"
+#endif
+
+struct StubVariant
+{
+	uint64_t Key;
+};
+
+typedef ShaderVariantCache<StubVariant> StubCache;
+
+//counts the compiles of every key and the thread that ran them, and refuses the keys it is told to fail
+class StubCompiler
+{
+public:
+	StubCompiler() : m_Failing(~uint64_t(0)) {}
+
+	void SetFailing(uint64_t key) { m_Failing = key; }
+
+	std::shared_ptr<StubVariant> Compile(uint64_t key)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		++m_Compiles[key];
+		m_Threads[key] = std::this_thread::get_id();
+		if (key == m_Failing)
+		{
+			return nullptr;
+		}
+		std::shared_ptr<StubVariant> variant = std::make_shared<StubVariant>();
+		variant->Key = key;
+		return variant;
+	}
+
+	uint32_t GetCompiles(uint64_t key) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_Compiles.find(key);
+		return it != m_Compiles.end() ? it->second : 0;
+	}
+
+	uint32_t GetTotalCompiles() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		uint32_t total = 0;
+		for (const auto& compiles : m_Compiles)
+		{
+			total += compiles.second;
+		}
+		return total;
+	}
+
+	std::thread::id GetThread(uint64_t key) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_Threads.find(key);
+		return it != m_Threads.end() ? it->second : std::thread::id();
+	}
+
+	StubCache::CompileFunc GetFunc() { return [this](uint64_t key) { return Compile(key); }; }
+
+private:
+	uint64_t m_Failing;
+	mutable std::mutex m_Mutex;
+	std::map<uint64_t, uint32_t> m_Compiles;
+	std::map<uint64_t, std::thread::id> m_Threads;
+};
+
+//a bool axis (1 bit), five light counts (3 bits) and three quality levels (2 bits)
+static void MakeKeySpace(ShaderPermutationKeySpace& keySpace, uint32_t& texture, uint32_t& lights, uint32_t& quality)
+{
+	texture = keySpace.AddBoolAxis("USE_TEXTURE");
+	lights = keySpace.AddAxis("LIGHTS", { "0", "1", "2", "4", "8" });
+	quality = keySpace.AddAxis("QUALITY", { "LOW", "MEDIUM", "HIGH" });
+}
+
+static void CheckKeys()
+{
+	ShaderPermutationKeySpace keySpace;
+	uint32_t texture, lights, quality;
+	MakeKeySpace(keySpace, texture, lights, quality);
+
+	Check(keySpace.GetAxisCount() == 3 && keySpace.GetTotalBits() == 6, "each axis gets just enough bits");
+	Check(keySpace.GetAxis(lights).Shift == 1 && keySpace.GetAxis(lights).Bits == 3 && keySpace.GetAxis(quality).Shift == 4,
+		"axes are packed one after the other");
+	Check(keySpace.GetVariantCount() == 30, "the variant count is the product of the value counts");
+
+	uint64_t key = keySpace.Set(0, texture, 1);
+	key = keySpace.Set(key, lights, 3);
+	key = keySpace.Set(key, quality, 2);
+	Check(key == (1 | (3 << 1) | (2 << 4)), "values are packed at their axis's shift");
+	Check(keySpace.Get(key, texture) == 1 && keySpace.Get(key, lights) == 3 && keySpace.Get(key, quality) == 2, "values unpack");
+
+	uint64_t changed = keySpace.Set(key, lights, 4);
+	Check(keySpace.Get(changed, lights) == 4 && keySpace.Get(changed, texture) == 1 && keySpace.Get(changed, quality) == 2,
+		"setting an axis leaves its neighbours alone");
+	Check(keySpace.Set(changed, lights, 0) == keySpace.Set(key, lights, 0), "setting an axis replaces its old value");
+
+	std::vector<std::pair<std::string, std::string>> defines = keySpace.GetDefines(key);
+	Check(defines.size() == 3 && defines[0] == std::make_pair(std::string("USE_TEXTURE"), std::string("1")) &&
+		defines[1] == std::make_pair(std::string("LIGHTS"), std::string("4")) && defines[2] == std::make_pair(std::string("QUALITY"), std::string("HIGH")),
+		"a define per axis with the selected value");
+	Check(keySpace.GetDefines(0)[1].second == "0" && keySpace.GetDefines(0)[2].second == "LOW", "value index 0 is the default");
+	Check(keySpace.GetKeyString(key) == "USE_TEXTURE=1 LIGHTS=4 QUALITY=HIGH", "the key string lists the defines");
+
+	//every 6 bit key with valid value indices, nothing past them
+	uint32_t valid = 0;
+	for (uint64_t k = 0; k < 64; ++k)
+	{
+		valid += keySpace.IsValid(k) ? 1 : 0;
+	}
+	Check(valid == keySpace.GetVariantCount(), "as many valid keys as variants");
+	Check(!keySpace.IsValid(uint64_t(1) << 6) && !keySpace.IsValid(uint64_t(1) << 63), "bits past the last axis are invalid");
+	Check(!keySpace.IsValid(uint64_t(5) << 1) && !keySpace.IsValid(uint64_t(7) << 1), "light indices past the last light count are invalid");
+	Check(!keySpace.IsValid(uint64_t(3) << 4), "a quality index past the last quality is invalid");
+
+	ShaderPermutationKeySpace empty;
+	Check(empty.GetVariantCount() == 1 && empty.IsValid(0) && !empty.IsValid(1), "a shader without axes has only key 0");
+}
+
+static void CheckInvalidKeys()
+{
+	ShaderPermutationKeySpace keySpace;
+	uint32_t texture, lights, quality;
+	MakeKeySpace(keySpace, texture, lights, quality);
+	StubCompiler stub;
+	StubCache cache;
+	cache.Create(stub.GetFunc(), nullptr, &keySpace);
+
+	const uint64_t invalid[] = { uint64_t(1) << 6, uint64_t(5) << 1, uint64_t(3) << 4, ~uint64_t(0) };
+	bool rejected = true;
+	for (uint64_t key : invalid)
+	{
+		rejected &= !cache.Request(key) && !cache.RequestBlocking(key) && !cache.IsReady(key) && !cache.HasFailed(key);
+	}
+	Check(rejected, "invalid keys are rejected with null");
+	Check(stub.GetTotalCompiles() == 0 && cache.GetCount() == 0, "invalid keys are neither compiled nor cached");
+
+	std::shared_ptr<StubVariant> variant = cache.Request(keySpace.Set(0, lights, 4));
+	Check(variant && variant->Key == (4 << 1) && cache.GetCount() == 1, "without a pool Request compiles a valid key inline");
+}
+
+static void CheckPool()
+{
+	StubCompiler stub;
+	stub.SetFailing(7);
+	WorkerPool pool;
+	pool.Start(1);
+	StubCache cache;
+	cache.Create(stub.GetFunc(), &pool);
+
+	//a miss queues the compile and returns null, the variant is there once the pool ran it
+	std::mutex gateMutex;
+	std::condition_variable gateChanged;
+	bool open = false;
+	pool.Submit([&]()
+	{
+		std::unique_lock<std::mutex> lock(gateMutex);
+		gateChanged.wait(lock, [&]() { return open; });
+	});
+	Check(!cache.Request(1) && !cache.IsReady(1) && cache.GetCount(true) == 1, "a miss returns null and is pending");
+	Check(!cache.Request(1) && stub.GetCompiles(1) == 0, "a pending key misses again");
+
+	//the pool's only worker is held up, so key 2 stays queued while RequestBlocking waits for it
+	Check(!cache.Request(2), "a second miss is queued behind the first");
+	std::shared_ptr<StubVariant> blocking;
+	std::thread::id waiter;
+	std::thread waiting([&]()
+	{
+		waiter = std::this_thread::get_id();
+		blocking = cache.RequestBlocking(2);
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	Check(stub.GetCompiles(2) == 0, "RequestBlocking doesn't compile a key queued on the pool");
+	{
+		std::lock_guard<std::mutex> lock(gateMutex);
+		open = true;
+	}
+	gateChanged.notify_all();
+	waiting.join();
+	Check(blocking && blocking->Key == 2, "RequestBlocking returns the variant the pool compiled");
+	Check(stub.GetCompiles(2) == 1 && stub.GetThread(2) != waiter, "the queued key is compiled once, by the pool");
+
+	pool.WaitIdle();
+	std::shared_ptr<StubVariant> variant = cache.Request(1);
+	Check(variant && variant->Key == 1 && cache.IsReady(1) && cache.GetCount(true) == 0, "the variant is returned once the pool has run it");
+	Check(cache.Request(1) == variant && stub.GetCompiles(1) == 1, "a hit returns the same variant without compiling");
+
+	//a compile returning null is cached as failed and never compiled again
+	Check(!cache.Request(7), "a failing key misses");
+	pool.WaitIdle();
+	Check(cache.HasFailed(7) && !cache.IsReady(7), "a null compile is cached as failed");
+	Check(!cache.Request(7) && !cache.RequestBlocking(7) && stub.GetCompiles(7) == 1, "a failed key isn't compiled again");
+
+	//a pool without threads compiles inline, so the first Request already hits
+	WorkerPool inlinePool;
+	StubCache inlineCache;
+	inlineCache.Create(stub.GetFunc(), &inlinePool);
+	Check(inlineCache.Request(3) && inlineCache.IsReady(3), "a pool without threads compiles in Request");
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t requests = 1000000;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--requests") && i + 1 < argc)
+		{
+			requests = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+
+	CheckKeys();
+	CheckInvalidKeys();
+	CheckPool();
+
+	//the frame loop asks for its variants every draw, a hit is what it pays
+	ShaderPermutationKeySpace keySpace;
+	uint32_t texture, lights, quality;
+	MakeKeySpace(keySpace, texture, lights, quality);
+	StubCompiler stub;
+	StubCache cache;
+	cache.Create(stub.GetFunc(), nullptr, &keySpace);
+	std::vector<uint64_t> keys;
+	for (uint64_t key = 0; key < 64; ++key)
+	{
+		if (keySpace.IsValid(key))
+		{
+			cache.RequestBlocking(key);
+			keys.push_back(key);
+		}
+	}
+	SteadyFrameClock clock;
+	double start = clock.Now();
+	uint64_t hits = 0;
+	for (uint32_t r = 0; r < requests; ++r)
+	{
+		hits += cache.Request(keys[r % keys.size()]) ? 1 : 0;
+	}
+	double nsPerRequest = requests ? (clock.Now() - start) * 1e9 / requests : 0.0;
+	Check(hits == requests, "every request of a compiled key hits");
+
+	printf("%zu variants of %u key bits | %.0f ns per Request hit | %s\n", keys.size(), keySpace.GetTotalBits(), nsPerRequest,
+		g_Failures ? "FAILED" : "keys pack, invalid keys are rejected, compiles happen once");
+	return g_Failures ? 1 : 0;
+}
@@ -0,0 +1,426 @@
+//texture cooking: checks that cooked textures are laid out as the GPU copies read them. Without arguments it cooks
+//generated DDS files over the supported formats, odd sizes, mip chains down to 1x1, arrays, cube maps and volumes,
+//and checks every footprint against the re-pitching CreateD3DResources does at load time, every row against the
+//source, the padding and that damaged files are rejected, then times a load's re-pitching against the one copy of
+//a cooked texture. With arguments it checks the given .tex files, or cooks the given .dds files in memory and
+//checks them against their source. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/texturecheck.cpp -o texturecheck
+//  ./texturecheck [--runs N] [--dir PATH] [files.tex or files.dds...]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../textureimport.h"
+#include "../frameclock.h"
+#include "check.h"
+
+static double Median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+//the layout rules on their own, and the pitch padding and the gaps between subresources zero as the cooker writes them
+static void CheckLayout(const TextureFile& file, const char* name)
+{
+	const uint8_t* data = static_cast<const uint8_t*>(file.GetData());
+	bool aligned = true;
+	bool padded = true;
+	uint64_t end = 0;
+	for (uint32_t i = 0; i < file.GetSubresourceCount(); ++i)
+	{
+		const TextureFileFootprint& footprint = file.GetFootprint(i);
+		aligned = aligned && footprint.Offset % D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT == 0 && footprint.RowPitch % D3D12_TEXTURE_DATA_PITCH_ALIGNMENT == 0 &&
+			footprint.RowPitch >= footprint.RowSize && footprint.Offset >= end;
+		for (uint64_t gap = end; gap < footprint.Offset; ++gap)
+		{
+			padded = padded && !data[gap];
+		}
+		for (uint32_t row = 0; row < footprint.RowCount * footprint.Depth; ++row)
+		{
+			const uint8_t* line = data + footprint.Offset + uint64_t(row) * footprint.RowPitch;
+			for (uint32_t b = footprint.RowSize; b < footprint.RowPitch; ++b)
+			{
+				padded = padded && !line[b];
+			}
+		}
+		end = footprint.Offset + uint64_t(footprint.RowPitch) * footprint.RowCount * footprint.Depth;
+	}
+	char what[256];
+	snprintf(what, sizeof(what), "%s: subresources on 512 bytes and rows on 256", name);
+	Check(aligned, what);
+	snprintf(what, sizeof(what), "%s: padding is zero", name);
+	Check(padded, what);
+	snprintf(what, sizeof(what), "%s: the data ends with the last subresource", name);
+	Check(end == file.GetDataSize(), what);
+}
+
+//what CreateD3DResources and FillInitData work out per mip of a 2D texture while re-pitching, kept apart from
+//ComputeTextureFootprints so the two can be compared
+static void CheckAgainstRepitching(const TextureFile& file, const char* name)
+{
+	const TextureFileHeader& header = file.GetHeader();
+	TextureFormatInfo info = GetTextureFormatInfo(static_cast<DXGI_FORMAT>(header.Format));
+	uint64_t current = 0;
+	bool same = true;
+	for (uint32_t slice = 0; slice < (header.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : header.DepthOrArraySize); ++slice)
+	{
+		uint32_t width = header.Width, height = header.Height, depth = header.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? header.DepthOrArraySize : 1;
+		for (uint32_t mip = 0; mip < header.MipLevels; ++mip)
+		{
+			uint64_t rowBytes = info.BlockSize > 1 ? std::max<uint64_t>(1, (width + 3) / 4) * info.BytesPerBlock : uint64_t(width) * info.BytesPerBlock;
+			uint64_t rowCount = info.BlockSize > 1 ? std::max<uint64_t>(1, (height + 3) / 4) : height;
+			uint64_t rowPitch = AlignUp(rowBytes, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+			current = AlignUp(current, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+			const TextureFileFootprint& footprint = file.GetFootprint(slice * header.MipLevels + mip);
+			same = same && footprint.Offset == current && footprint.RowPitch == rowPitch && footprint.RowSize == rowBytes &&
+				footprint.RowCount == rowCount && footprint.Depth == depth;
+			current += rowCount * rowPitch * depth;
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+			depth = std::max(1u, depth / 2);
+		}
+	}
+	char what[256];
+	snprintf(what, sizeof(what), "%s: footprints are where load time re-pitching puts the subresources", name);
+	Check(same, what);
+}
+
+//every row of the cooked file is the row of the tightly packed source
+static void CheckRows(const TextureFile& file, const TextureFileContents& contents, const char* name)
+{
+	const uint8_t* source = static_cast<const uint8_t*>(contents.Data);
+	const uint8_t* data = static_cast<const uint8_t*>(file.GetData());
+	bool same = true;
+	for (uint32_t i = 0; i < file.GetSubresourceCount(); ++i)
+	{
+		const TextureFileFootprint& footprint = file.GetFootprint(i);
+		for (uint32_t row = 0; row < footprint.RowCount * footprint.Depth; ++row)
+		{
+			same = same && !memcmp(data + footprint.Offset + uint64_t(row) * footprint.RowPitch, source, footprint.RowSize);
+			source += footprint.RowSize;
+		}
+	}
+	char what[256];
+	snprintf(what, sizeof(what), "%s: rows match the source", name);
+	Check(same && source == static_cast<const uint8_t*>(contents.Data) + contents.DataSize, what);
+}
+
+static void CheckRejected(const std::vector<uint8_t>& image, const char* name)
+{
+	TextureFile file;
+	char what[256];
+	snprintf(what, sizeof(what), "%s: damaged copies are rejected", name);
+	bool rejected = FAILED(file.Attach(image.data(), image.size() - 1)) && FAILED(file.Attach(image.data(), sizeof(TextureFileHeader) - 1));
+	std::vector<uint8_t> damaged = image;
+	reinterpret_cast<TextureFileHeader*>(damaged.data())->Magic ^= 1;
+	rejected = rejected && FAILED(file.Attach(damaged.data(), damaged.size()));
+	damaged = image;
+	reinterpret_cast<TextureFileHeader*>(damaged.data())->Version = TextureFileVersion + 1;
+	rejected = rejected && FAILED(file.Attach(damaged.data(), damaged.size()));
+	damaged = image;
+	reinterpret_cast<TextureFileHeader*>(damaged.data())->Width += 4;
+	rejected = rejected && FAILED(file.Attach(damaged.data(), damaged.size()));
+	damaged = image;
+	reinterpret_cast<TextureFileHeader*>(damaged.data())->MipLevels = 17;
+	rejected = rejected && FAILED(file.Attach(damaged.data(), damaged.size()));
+	//a footprint of another layout rule, rows further apart than they need to be
+	damaged = image;
+	reinterpret_cast<TextureFileFootprint*>(damaged.data() + sizeof(TextureFileHeader))->RowPitch += D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
+	rejected = rejected && FAILED(file.Attach(damaged.data(), damaged.size()));
+	Check(rejected, what);
+}
+
+//a DDS with the DX10 header and a deterministic pattern in every byte of its data
+static std::vector<uint8_t> MakeDDS(DXGI_FORMAT format, uint32_t dimension, uint32_t width, uint32_t height, uint32_t depthOrArraySize, uint32_t mipLevels, bool cube)
+{
+	TextureFileFootprint footprints[16 * 64] = {};
+	uint32_t arraySize = dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : depthOrArraySize * (cube ? 6 : 1);
+	bool valid = ComputeTextureFootprints(dimension, format, width, height, dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? depthOrArraySize : arraySize, mipLevels, footprints) != 0;
+	uint64_t packedSize = 0;
+	for (uint32_t i = 0; valid && i < arraySize * mipLevels; ++i)
+	{
+		packedSize += uint64_t(footprints[i].RowSize) * footprints[i].RowCount * footprints[i].Depth;
+	}
+
+	DDSHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Size = sizeof(DDSHeader);
+	header.Flags = 0x1007 | (dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? DDSVolumeFlag : 0);
+	header.Width = width;
+	header.Height = height;
+	header.Depth = dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? depthOrArraySize : 0;
+	header.MipMapCount = mipLevels;
+	header.PixelFormat.Size = sizeof(DDSPixelFormat);
+	header.PixelFormat.Flags = DDSFourCCFlag;
+	header.PixelFormat.FourCC = MakeFourCC('D', 'X', '1', '0');
+	DDSHeaderDX10 extension = { static_cast<uint32_t>(format), dimension, cube ? DDSCubeMapMiscFlag : 0, dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : depthOrArraySize, 0 };
+
+	std::vector<uint8_t> dds(sizeof(DDSMagic) + sizeof(header) + sizeof(extension) + static_cast<size_t>(packedSize));
+	memcpy(dds.data(), &DDSMagic, sizeof(DDSMagic));
+	memcpy(dds.data() + sizeof(DDSMagic), &header, sizeof(header));
+	memcpy(dds.data() + sizeof(DDSMagic) + sizeof(header), &extension, sizeof(extension));
+	uint32_t state = width * 7919 + height * 31 + format;
+	for (size_t i = sizeof(DDSMagic) + sizeof(header) + sizeof(extension); i < dds.size(); ++i)
+	{
+		state = state * 1664525u + 1013904223u;
+		dds[i] = static_cast<uint8_t>(state >> 24);
+	}
+	return dds;
+}
+
+//cooks dds in memory and checks the result, false when it doesn't cook
+static bool CheckCooked(const std::vector<uint8_t>& dds, const char* name, std::vector<uint8_t>* imageOut = nullptr)
+{
+	TextureFileContents contents;
+	std::vector<uint8_t> image;
+	TextureFile file;
+	if (FAILED(ParseDDS(dds.data(), dds.size(), contents)) || FAILED(BuildTextureFile(contents, image)) || FAILED(file.Attach(image.data(), image.size())))
+	{
+		return false;
+	}
+	CheckLayout(file, name);
+	CheckAgainstRepitching(file, name);
+	CheckRows(file, contents, name);
+	CheckRejected(image, name);
+	if (imageOut)
+	{
+		imageOut->swap(image);
+	}
+	return true;
+}
+
+static void CheckGenerated()
+{
+	const DXGI_FORMAT formats[] = { DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_B8G8R8A8_UNORM_SRGB, DXGI_FORMAT_R8_UNORM, DXGI_FORMAT_R8G8_UNORM,
+		DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM_SRGB, DXGI_FORMAT_BC4_UNORM,
+		DXGI_FORMAT_BC5_SNORM, DXGI_FORMAT_BC7_UNORM };
+	const uint32_t sizes[][2] = { { 1, 1 }, { 3, 5 }, { 64, 64 }, { 100, 37 }, { 256, 256 }, { 257, 129 }, { 1024, 16 }, { 13, 600 } };
+	uint32_t cooked = 0;
+	for (DXGI_FORMAT format : formats)
+	{
+		for (const uint32_t* size : sizes)
+		{
+			uint32_t fullChain = 1;
+			while ((std::max(size[0], size[1]) >> fullChain) > 0)
+			{
+				++fullChain;
+			}
+			char name[128];
+			snprintf(name, sizeof(name), "format %u %ux%u", format, size[0], size[1]);
+			Check(CheckCooked(MakeDDS(format, D3D12_RESOURCE_DIMENSION_TEXTURE2D, size[0], size[1], 1, fullChain, false), name), "generated textures cook");
+			Check(CheckCooked(MakeDDS(format, D3D12_RESOURCE_DIMENSION_TEXTURE2D, size[0], size[1], 3, 1, false), name), "generated arrays cook");
+			cooked += 2;
+		}
+		char name[128];
+		snprintf(name, sizeof(name), "format %u cube", format);
+		Check(CheckCooked(MakeDDS(format, D3D12_RESOURCE_DIMENSION_TEXTURE2D, 32, 32, 2, 6, true), name), "generated cube maps cook");
+		snprintf(name, sizeof(name), "format %u volume", format);
+		Check(CheckCooked(MakeDDS(format, D3D12_RESOURCE_DIMENSION_TEXTURE3D, 40, 24, 9, 4, false), name), "generated volumes cook");
+		cooked += 2;
+	}
+
+	//what the cooked format can't hold is refused rather than cooked wrong
+	Check(!CheckCooked(MakeDDS(DXGI_FORMAT_D32_FLOAT, D3D12_RESOURCE_DIMENSION_TEXTURE2D, 64, 64, 1, 1, false), "depth"), "depth formats are refused");
+	Check(!CheckCooked(MakeDDS(DXGI_FORMAT_R8G8B8A8_UNORM, D3D12_RESOURCE_DIMENSION_TEXTURE2D, 64, 64, 1, 8, false), "too many mips"), "more mips than the size has are refused");
+	std::vector<uint8_t> truncated = MakeDDS(DXGI_FORMAT_BC1_UNORM, D3D12_RESOURCE_DIMENSION_TEXTURE2D, 64, 64, 1, 7, false);
+	truncated.pop_back();
+	Check(!CheckCooked(truncated, "truncated"), "a DDS shorter than its subresources is refused");
+
+	//the legacy header of the d3d9 era files, DXT1 by FourCC and BGRA by masks
+	std::vector<uint8_t> legacy = MakeDDS(DXGI_FORMAT_BC1_UNORM, D3D12_RESOURCE_DIMENSION_TEXTURE2D, 128, 64, 1, 8, false);
+	legacy.erase(legacy.begin() + sizeof(DDSMagic) + sizeof(DDSHeader), legacy.begin() + sizeof(DDSMagic) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10));
+	DDSHeader* header = reinterpret_cast<DDSHeader*>(legacy.data() + sizeof(DDSMagic));
+	header->PixelFormat.FourCC = MakeFourCC('D', 'X', 'T', '1');
+	TextureFileContents contents;
+	Check(SUCCEEDED(ParseDDS(legacy.data(), legacy.size(), contents)) && contents.Format == DXGI_FORMAT_BC1_UNORM && contents.MipLevels == 8, "legacy DXT1 parses");
+	header->Width = 32;
+	header->Height = 16;
+	header->MipMapCount = 1;
+	header->PixelFormat.Flags = DDSRGBFlag;
+	header->PixelFormat.RGBBitCount = 32;
+	header->PixelFormat.RBitMask = 0x00ff0000;
+	header->PixelFormat.GBitMask = 0x0000ff00;
+	header->PixelFormat.BBitMask = 0x000000ff;
+	header->PixelFormat.ABitMask = 0xff000000;
+	Check(SUCCEEDED(ParseDDS(legacy.data(), legacy.size(), contents)) && contents.Format == DXGI_FORMAT_B8G8R8A8_UNORM && contents.DataSize == 32 * 16 * 4, "legacy BGRA parses");
+	printf("%u generated textures cooked and checked\n", cooked);
+}
+
+static bool WriteFile(const std::string& fileName, const void* data, size_t size)
+{
+	FILE* file = fopen(fileName.c_str(), "wb");
+	bool written = file && fwrite(data, 1, size, file) == size;
+	return file && fclose(file) == 0 && written;
+}
+
+//a load up to the filled upload buffer: the DDS read into memory as LoadTextureDataFromFile does and re-pitched
+//row by row as CreateD3DResources does, against the cooked file mapped and copied to staging at once
+static void Benchmark(DXGI_FORMAT format, uint32_t size, uint32_t runs, const std::string& directory)
+{
+	uint32_t mips = 1;
+	while ((size >> mips) > 0)
+	{
+		++mips;
+	}
+	std::vector<uint8_t> dds = MakeDDS(format, D3D12_RESOURCE_DIMENSION_TEXTURE2D, size, size, 1, mips, false);
+	std::vector<uint8_t> image;
+	TextureFileContents contents;
+	TextureFile reference;
+	ParseDDS(dds.data(), dds.size(), contents);
+	BuildTextureFile(contents, image);
+	reference.Attach(image.data(), image.size());
+	const std::string ddsName = directory + "/texturecheck.dds";
+	const std::string cookedName = directory + "/texturecheck.tex";
+	if (!WriteFile(ddsName, dds.data(), dds.size()) || !WriteFile(cookedName, image.data(), image.size()))
+	{
+		Check(false, "the benchmark files are written");
+		return;
+	}
+	//pre-touched, as the persistently mapped upload buffer is
+	const size_t dataSize = static_cast<size_t>(reference.GetDataSize());
+	std::vector<uint8_t> staging(dataSize + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, 1);
+	uint8_t* base = staging.data() + (D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - reinterpret_cast<uintptr_t>(staging.data()) % D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT) % D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+
+	SteadyFrameClock clock;
+	std::vector<double> repitchTimes, copyTimes;
+	for (uint32_t run = 0; run < runs; ++run)
+	{
+		//DDS: read the file, then per mip align the position and copy each row to its pitch. Re-pitching leaves the
+		//padding as it was, cleared beforehand so the staging compares equal to the cooked data.
+		memset(base, 0, dataSize);
+		double start = clock.Now();
+		FILE* input = fopen(ddsName.c_str(), "rb");
+		std::unique_ptr<uint8_t[]> ddsData(new uint8_t[dds.size()]);
+		bool read = input && fread(ddsData.get(), 1, dds.size(), input) == dds.size();
+		if (input)
+		{
+			fclose(input);
+		}
+		TextureFileContents loaded;
+		read = read && SUCCEEDED(ParseDDS(ddsData.get(), dds.size(), loaded));
+		const uint8_t* source = static_cast<const uint8_t*>(loaded.Data);
+		uint64_t current = 0;
+		for (uint32_t i = 0; read && i < reference.GetSubresourceCount(); ++i)
+		{
+			const TextureFileFootprint& footprint = reference.GetFootprint(i);
+			uint32_t rowPitch = static_cast<uint32_t>(AlignUp(footprint.RowSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT));
+			current = AlignUp(current, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+			for (uint32_t row = 0; row < footprint.RowCount; ++row)
+			{
+				memcpy(base + current + uint64_t(row) * rowPitch, source, footprint.RowSize);
+				source += footprint.RowSize;
+			}
+			current += uint64_t(rowPitch) * footprint.RowCount;
+		}
+		repitchTimes.push_back(clock.Now() - start);
+		Check(read && current == dataSize && !memcmp(base, reference.GetData(), dataSize), "re-pitching fills staging as the cooked data");
+
+		//cooked: map, one copy
+		start = clock.Now();
+		TextureFile file;
+		HRESULT hr = file.Open(cookedName.c_str());
+		if (SUCCEEDED(hr))
+		{
+			memcpy(base, file.GetData(), static_cast<size_t>(file.GetDataSize()));
+		}
+		copyTimes.push_back(clock.Now() - start);
+		Check(SUCCEEDED(hr) && !memcmp(base, reference.GetData(), dataSize), "the cooked file fills staging");
+	}
+	remove(ddsName.c_str());
+	remove(cookedName.c_str());
+
+	double repitch = Median(repitchTimes), copy = Median(copyTimes);
+	printf("  format %2u %5ux%-5u %2u mips %8.1f KB | DDS read and re-pitch %7.3f ms, cooked map and copy %7.3f ms, %.1fx\n", format, size, size, mips,
+		dataSize / 1024.0, repitch * 1000.0, copy * 1000.0, repitch / copy);
+}
+
+static void CheckFile(const char* fileName)
+{
+	size_t length = strlen(fileName);
+	bool dds = length > 4 && !strcmp(fileName + length - 4, ".dds");
+	MappedFile mapped;
+	if (FAILED(mapped.Open(fileName)))
+	{
+		Check(false, fileName);
+		return;
+	}
+	std::vector<uint8_t> data(static_cast<const uint8_t*>(mapped.GetData()), static_cast<const uint8_t*>(mapped.GetData()) + mapped.GetSize());
+	std::vector<uint8_t> image;
+	if (dds)
+	{
+		char what[512];
+		snprintf(what, sizeof(what), "%s cooks", fileName);
+		Check(CheckCooked(data, fileName, &image), what);
+	}
+	else
+	{
+		image = data;
+	}
+
+	TextureFile file;
+	if (FAILED(file.Attach(image.data(), image.size())))
+	{
+		char what[512];
+		snprintf(what, sizeof(what), "%s is a texture file of this version with the footprints of its texture", fileName);
+		Check(false, what);
+		return;
+	}
+	CheckLayout(file, fileName);
+	CheckAgainstRepitching(file, fileName);
+	const TextureFileHeader& header = file.GetHeader();
+	printf("%s: %ux%ux%u, format %u, %u mips, %u subresources, %.1f KB of data\n", fileName, header.Width, header.Height, header.DepthOrArraySize,
+		header.Format, header.MipLevels, header.SubresourceCount, header.DataSize / 1024.0);
+	for (uint32_t i = 0; i < file.GetSubresourceCount(); ++i)
+	{
+		const TextureFileFootprint& footprint = file.GetFootprint(i);
+		printf("  %3u: offset %8llu, %5ux%-5ux%u, pitch %6u, %5u rows of %6u bytes\n", i, static_cast<unsigned long long>(footprint.Offset),
+			footprint.Width, footprint.Height, footprint.Depth, footprint.RowPitch, footprint.RowCount, footprint.RowSize);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t runs = 9;
+	std::string directory = "/tmp";
+	std::vector<const char*> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--runs") && i + 1 < argc) runs = std::max(1u, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+		else if (!strcmp(argv[i], "--dir") && i + 1 < argc) directory = argv[++i];
+		else if (argv[i][0] != '-') files.push_back(argv[i]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	if (files.empty())
+	{
+		CheckGenerated();
+		printf("loading a texture with its full mip chain into staging, warm page cache:\n");
+		Benchmark(DXGI_FORMAT_R8G8B8A8_UNORM, 2048, runs, directory);
+		Benchmark(DXGI_FORMAT_BC1_UNORM, 4096, runs, directory);
+		Benchmark(DXGI_FORMAT_BC7_UNORM, 256, runs, directory);
+	}
+	for (const char* file : files)
+	{
+		CheckFile(file);
+	}
+
+	printf("%s\n", g_Failures ? "FAILED" : "layouts match");
+	return g_Failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+//cooks a DDS into the texture file of texturefile.h: every subresource already at its placed footprint, rows 256
+//bytes apart and subresources 512 bytes apart, so the renderer uploads it with one copy. Several inputs cook to
+//the same names with .tex. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/texturecook.cpp -o texturecook
+//  ./texturecook input.dds [output.tex]
+//  ./texturecook input.dds...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../textureimport.h"
+#include "../frameclock.h"
+
+static std::string GetCookedName(const std::string& input)
+{
+	size_t dot = input.find_last_of('.');
+	size_t slash = input.find_last_of("/\\");
+	return (dot != std::string::npos && (slash == std::string::npos || dot > slash) ? input.substr(0, dot) : input) + ".tex";
+}
+
+static bool Cook(const char* input, const std::string& output)
+{
+	SteadyFrameClock clock;
+	double start = clock.Now();
+	MappedFile dds;
+	TextureFileContents contents;
+	if (FAILED(dds.Open(input)) || FAILED(ParseDDS(dds.GetData(), dds.GetSize(), contents)))
+	{
+		fprintf(stderr, "%s: not a DDS of a format and dimension the texture file holds\n", input);
+		return false;
+	}
+	std::vector<uint8_t> image;
+	if (FAILED(BuildTextureFile(contents, image)))
+	{
+		fprintf(stderr, "%s: cooking failed\n", input);
+		return false;
+	}
+	FILE* file = fopen(output.c_str(), "wb");
+	bool written = file && fwrite(image.data(), 1, image.size(), file) == image.size();
+	written = file && fclose(file) == 0 && written;
+	if (!written)
+	{
+		fprintf(stderr, "%s: write failed\n", output.c_str());
+		return false;
+	}
+
+	const TextureFileHeader& header = *reinterpret_cast<const TextureFileHeader*>(image.data());
+	printf("%s: %ux%ux%u %s, format %u, %u mips, %u subresources, %.1f KB -> %.1f KB, %.2f ms\n", output.c_str(),
+		header.Width, header.Height, header.DepthOrArraySize, header.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? "volume" : "array",
+		header.Format, header.MipLevels, header.SubresourceCount, contents.DataSize / 1024.0, image.size() / 1024.0, (clock.Now() - start) * 1000.0);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: texturecook input.dds [output.tex] | texturecook input.dds...\n");
+		return 2;
+	}
+	//a second argument ending in .tex is the output of the first
+	size_t length = argc == 3 ? strlen(argv[2]) : 0;
+	if (length > 4 && !strcmp(argv[2] + length - 4, ".tex"))
+	{
+		return Cook(argv[1], argv[2]) ? 0 : 1;
+	}
+	bool cooked = true;
+	for (int i = 1; i < argc; ++i)
+	{
+		cooked = Cook(argv[i], GetCookedName(argv[i])) && cooked;
+	}
+	return cooked ? 0 : 1;
+}
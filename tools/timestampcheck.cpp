@@ -0,0 +1,295 @@
+//GPU timestamp bookkeeping checks with synthetic timestamps: a simulated GPU runs a few frames behind the CPU,
+//writes the timestamps of each frame's scopes and resolves them into the frame's slot of a readback buffer. The
+//checks cover the query layout, that every frame's timings come back with its own durations and nesting once the
+//GPU is done with it and not before, that slots are reused only after they were read, that frames the CPU never
+//collected before reusing their slot are counted as dropped, scopes past the per-frame limit and scopes the GPU
+//never closed. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/timestampcheck.cpp -o timestampcheck
+//  ./timestampcheck [--frames N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "../timestamps.h"
+#include "check.h"
+
+static const uint64_t Frequency = 1000000; //ticks per second, a tick is a microsecond
+
+//ticks a scope of a frame takes on the simulated GPU, different for every frame and scope
+static uint64_t ScopeTicks(uint64_t frame, uint32_t scope)
+{
+	return (frame % 7 + 1) * 1000 + scope * 100;
+}
+
+//records frames on the profiler and completes them on a simulated GPU lagging behind. Completing a frame writes
+//its timestamps and resolves them into the readback buffer, as ResolveQueryData at the end of its command list.
+class SimulatedGpu
+{
+public:
+	void Create(TimestampProfiler* profiler)
+	{
+		m_Profiler = profiler;
+		m_Readback.assign(profiler->GetQueryCount(), 0);
+		m_Ticks = 0;
+	}
+
+	//frame scope with three passes inside, the second with a nested scope
+	void RecordFrame(uint64_t frame, uint32_t extraScopes = 0)
+	{
+		Submitted submitted;
+		submitted.Frame = frame;
+		m_Profiler->BeginFrame(frame);
+		uint32_t frameScope = m_Profiler->BeginScope("frame");
+		Write(submitted, m_Profiler->GetBeginQuery(frameScope), frameScope, true);
+		static const char* passes[] = { "shadow", "gbuffer", "lighting" };
+		for (uint32_t p = 0; p < 3; ++p)
+		{
+			uint32_t scope = m_Profiler->BeginScope(passes[p]);
+			Write(submitted, m_Profiler->GetBeginQuery(scope), scope, true);
+			if (p == 1)
+			{
+				uint32_t nested = m_Profiler->BeginScope("decals");
+				Write(submitted, m_Profiler->GetBeginQuery(nested), nested, true);
+				Write(submitted, m_Profiler->GetEndQuery(nested), nested, false);
+				m_Profiler->EndScope(nested);
+			}
+			Write(submitted, m_Profiler->GetEndQuery(scope), scope, false);
+			m_Profiler->EndScope(scope);
+		}
+		for (uint32_t i = 0; i < extraScopes; ++i)
+		{
+			uint32_t scope = m_Profiler->BeginScope("extra");
+			if (scope != TimestampProfiler::InvalidScope)
+			{
+				Write(submitted, m_Profiler->GetBeginQuery(scope), scope, true);
+				Write(submitted, m_Profiler->GetEndQuery(scope), scope, false);
+			}
+			m_Profiler->EndScope(scope);
+		}
+		Write(submitted, m_Profiler->GetEndQuery(frameScope), frameScope, false);
+		m_Profiler->EndScope(frameScope);
+		m_Profiler->GetFrameQueries(submitted.FirstQuery, submitted.QueryCount);
+		m_Profiler->EndFrame();
+		m_Submitted.push_back(submitted);
+	}
+
+	//the GPU finishes every frame up to frame
+	void Complete(uint64_t frame)
+	{
+		while (!m_Submitted.empty() && m_Submitted.front().Frame <= frame)
+		{
+			const Submitted& submitted = m_Submitted.front();
+			std::vector<uint64_t> queries(m_Readback.size(), 0);
+			for (const auto& write : submitted.Writes)
+			{
+				queries[write.Query] = write.Ticks;
+			}
+			for (uint32_t q = submitted.FirstQuery; q < submitted.FirstQuery + submitted.QueryCount; ++q)
+			{
+				m_Readback[q] = queries[q];
+			}
+			m_Submitted.pop_front();
+		}
+	}
+
+	const uint64_t* Read(uint32_t slot) const { return m_Readback.data() + m_Profiler->GetSlotFirstQuery(slot); }
+
+	//a query the simulated GPU never wrote, as when the end of a scope wasn't executed
+	void Corrupt(uint32_t query, uint64_t ticks) { m_Readback[query] = ticks; }
+
+private:
+	struct QueryWrite
+	{
+		uint32_t Query;
+		uint64_t Ticks;
+	};
+
+	struct Submitted
+	{
+		uint64_t Frame;
+		uint32_t FirstQuery;
+		uint32_t QueryCount;
+		std::vector<QueryWrite> Writes;
+	};
+
+	//begins at the running tick count, ends ScopeTicks later
+	void Write(Submitted& submitted, uint32_t query, uint32_t scope, bool begin)
+	{
+		if (begin)
+		{
+			m_Begins.resize(std::max<size_t>(m_Begins.size(), scope + 1));
+			m_Begins[scope] = m_Ticks;
+			m_Ticks += 10;
+		}
+		QueryWrite write = { query, begin ? m_Begins[scope] : m_Begins[scope] + ScopeTicks(submitted.Frame, scope) };
+		submitted.Writes.push_back(write);
+	}
+
+	TimestampProfiler* m_Profiler;
+	std::vector<uint64_t> m_Readback;
+	std::deque<Submitted> m_Submitted;
+	std::vector<uint64_t> m_Begins;
+	uint64_t m_Ticks;
+};
+
+static bool TimingsMatch(const std::vector<TimestampProfiler::ScopeTiming>& timings, uint64_t frame)
+{
+	static const char* names[] = { "frame", "shadow", "gbuffer", "decals", "lighting" };
+	static const uint32_t depths[] = { 0, 1, 1, 2, 1 };
+	if (timings.size() != 5)
+	{
+		return false;
+	}
+	for (uint32_t s = 0; s < 5; ++s)
+	{
+		double expected = double(ScopeTicks(frame, s)) * 1000.0 / double(Frequency);
+		if (strcmp(timings[s].Name, names[s]) || timings[s].Depth != depths[s] || fabs(timings[s].Milliseconds - expected) > 1e-9 ||
+			timings[s].EndTicks - timings[s].BeginTicks != ScopeTicks(frame, s))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void CheckLayout()
+{
+	TimestampProfiler profiler;
+	profiler.Create(8, 3, Frequency);
+	Check(profiler.GetQueryCount() == 48 && profiler.GetSlotQueryCount() == 16, "a slot of two queries per scope for each frame in flight");
+	Check(profiler.GetSlotIndex(0) == 0 && profiler.GetSlotIndex(4) == 1 && profiler.GetSlotFirstQuery(2) == 32, "frames cycle through the slots");
+
+	profiler.BeginFrame(5);
+	uint32_t a = profiler.BeginScope("a");
+	uint32_t b = profiler.BeginScope("b");
+	Check(profiler.GetBeginQuery(a) == 32 && profiler.GetEndQuery(a) == 33 && profiler.GetBeginQuery(b) == 34, "a scope's queries are consecutive in its frame's slot");
+	profiler.EndScope(b);
+	profiler.EndScope(a);
+	uint32_t first = 0, count = 0;
+	profiler.GetFrameQueries(first, count);
+	Check(first == 32 && count == 4, "only the used queries are resolved");
+	profiler.EndFrame();
+}
+
+static void CheckLatency(uint32_t frames)
+{
+	//two frames in flight: recording frame N, the GPU has finished N - 2
+	const uint32_t frameLatency = 3;
+	TimestampProfiler profiler;
+	profiler.Create(16, frameLatency, Frequency);
+	SimulatedGpu gpu;
+	gpu.Create(&profiler);
+
+	bool early = false, match = true, inOrder = true;
+	uint64_t collectedFrames = 0, lastCollected = 0;
+	for (uint64_t frame = 1; frame <= frames; ++frame)
+	{
+		uint64_t completed = frame > frameLatency - 1 ? frame - (frameLatency - 1) : 0;
+		gpu.Complete(completed);
+		profiler.Collect(completed, [&](uint32_t slot) { return gpu.Read(slot); }, [&](const std::vector<TimestampProfiler::ScopeTiming>& timings)
+		{
+			++collectedFrames;
+			match &= TimingsMatch(timings, profiler.GetTimingsFrame());
+			inOrder &= profiler.GetTimingsFrame() == lastCollected + 1;
+			lastCollected = profiler.GetTimingsFrame();
+		});
+		early |= profiler.HasTimings() && profiler.GetTimingsFrame() > completed;
+		if (frame == 2)
+		{
+			Check(!profiler.HasTimings(), "no timings before the GPU finished a frame");
+		}
+		gpu.RecordFrame(frame);
+	}
+	Check(!early, "timings are never read before the GPU finished the frame");
+	Check(match, "every frame reads back its own durations and nesting");
+	Check(inOrder && collectedFrames == frames - (frameLatency - 1), "frames are collected oldest first, each once");
+	Check(profiler.GetDroppedFrames() == 0, "no frame dropped while the CPU stays within the frame latency");
+	Check(profiler.GetTimingsFrame() == frames - (frameLatency - 1), "timings are frameLatency - 1 frames old");
+	std::string line = profiler.Format();
+	Check(line.find(" .gbuffer ") != std::string::npos && line.find(" ..decals ") != std::string::npos, "the report indents nested scopes");
+
+	//the GPU catches up after a stall, every finished frame is collected in one call
+	gpu.Complete(frames);
+	uint32_t caught = 0;
+	profiler.Collect(frames, [&](uint32_t slot) { return gpu.Read(slot); }, [&](const std::vector<TimestampProfiler::ScopeTiming>&) { ++caught; });
+	Check(caught == frameLatency - 1 && profiler.GetTimingsFrame() == frames, "catching up collects every frame in flight");
+}
+
+static void CheckDropped()
+{
+	const uint32_t frameLatency = 2;
+	TimestampProfiler profiler;
+	profiler.Create(16, frameLatency, Frequency);
+	SimulatedGpu gpu;
+	gpu.Create(&profiler);
+
+	//the CPU records 6 frames without collecting, every slot reuse drops the frame that was in it
+	for (uint64_t frame = 1; frame <= 6; ++frame)
+	{
+		gpu.RecordFrame(frame);
+	}
+	Check(profiler.GetDroppedFrames() == 4, "reusing a slot that was never collected drops its frame");
+
+	gpu.Complete(6);
+	std::vector<uint64_t> collected;
+	profiler.Collect(6, [&](uint32_t slot) { return gpu.Read(slot); }, [&](const std::vector<TimestampProfiler::ScopeTiming>& timings)
+	{
+		collected.push_back(profiler.GetTimingsFrame());
+		Check(TimingsMatch(timings, profiler.GetTimingsFrame()), "frames surviving a drop read back their own durations");
+	});
+	Check(collected.size() == 2 && collected[0] == 5 && collected[1] == 6, "only the frames still in a slot are collected");
+}
+
+static void CheckLimits()
+{
+	TimestampProfiler profiler;
+	profiler.Create(6, 2, Frequency);
+	SimulatedGpu gpu;
+	gpu.Create(&profiler);
+
+	//5 scopes per frame plus 3 more, only 1 fits
+	gpu.RecordFrame(1, 3);
+	gpu.Complete(1);
+	profiler.Collect(1, [&](uint32_t slot) { return gpu.Read(slot); });
+	Check(profiler.GetTimings().size() == 6 && !strcmp(profiler.GetTimings()[5].Name, "extra"), "scopes past the limit are dropped");
+
+	//the end of the lighting scope was never written and reads as older than its begin
+	gpu.RecordFrame(2);
+	gpu.Complete(2);
+	gpu.Corrupt(profiler.GetSlotFirstQuery(profiler.GetSlotIndex(2)) + 2 * 4 + 1, 0);
+	profiler.Collect(2, [&](uint32_t slot) { return gpu.Read(slot); });
+	Check(profiler.GetTimingsFrame() == 2 && profiler.GetTimings()[4].Milliseconds == 0.0 && profiler.GetTimings()[0].Milliseconds > 0.0,
+		"an end before its begin times as zero");
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t frames = 1000;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+		{
+			frames = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+	if (frames < 3)
+	{
+		fprintf(stderr, "--frames has to be at least 3\n");
+		return 1;
+	}
+
+	CheckLayout();
+	CheckLatency(frames);
+	CheckDropped();
+	CheckLimits();
+	printf("%u frames read back | %s\n", frames, g_Failures ? "FAILED" : "every frame gets its own timings, late and never early");
+	return g_Failures ? 1 : 0;
+}
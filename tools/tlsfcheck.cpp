@@ -0,0 +1,295 @@
+//TLSF allocator checks: allocate and free, alignment, coalescing with the previous, the next and both physical
+//neighbours, the out of space failures and the fragmentation statistics. Then runs random allocations and frees
+//against a reference list of live ranges, checking that no two overlap and that the statistics add up, and
+//reports how long an allocate and free pair takes. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/tlsfcheck.cpp -o tlsfcheck
+//  ./tlsfcheck [--ops N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../tlsfallocator.h"
+#include "../frameclock.h"
+#include "check.h"
+
+static void CheckAllocateFree()
+{
+	TlsfAllocator allocator;
+	allocator.Create(1024);
+	Check(allocator.IsEmpty() && allocator.GetCapacity() == 1024, "a new allocator is empty");
+
+	TlsfAllocator::Allocation a, b;
+	Check(allocator.Allocate(100, 1, a) && a.Offset == 0 && a.Size == 100, "first allocation starts at 0");
+	Check(allocator.Allocate(200, 1, b) && b.Offset == 100, "second allocation follows the first");
+	Check(!allocator.IsEmpty(), "not empty with live allocations");
+
+	TlsfAllocator::Statistics stats = allocator.GetStatistics();
+	Check(stats.UsedBytes == 300 && stats.FreeBytes == 724 && stats.AllocationCount == 2, "statistics count the live allocations");
+
+	allocator.Free(a);
+	allocator.Free(b);
+	stats = allocator.GetStatistics();
+	Check(allocator.IsEmpty() && stats.FreeBytes == 1024 && stats.FreeBlockCount == 1, "freeing everything leaves one block");
+
+	TlsfAllocator::Allocation all;
+	Check(allocator.Allocate(1024, 1, all) && all.Offset == 0, "the whole capacity is allocatable after frees");
+	allocator.Free(all);
+}
+
+static void CheckAlignment()
+{
+	TlsfAllocator allocator;
+	allocator.Create(1 << 20);
+
+	TlsfAllocator::Allocation odd;
+	Check(allocator.Allocate(3, 1, odd) && odd.Offset == 0, "unaligned allocation");
+
+	static const uint64_t alignments[] = { 4, 256, 4096, 65536 };
+	std::vector<TlsfAllocator::Allocation> allocations;
+	for (uint64_t alignment : alignments)
+	{
+		TlsfAllocator::Allocation allocation;
+		bool ok = allocator.Allocate(alignment + 1, alignment, allocation);
+		Check(ok && allocation.Offset % alignment == 0, "offset is a multiple of the alignment");
+		allocations.push_back(allocation);
+	}
+
+	//the padding in front of an aligned allocation goes back to the free lists
+	TlsfAllocator::Allocation small;
+	Check(allocator.Allocate(1, 1, small) && small.Offset < allocations.back().Offset, "alignment padding is reusable");
+
+	allocator.Free(small);
+	allocator.Free(odd);
+	for (const auto& allocation : allocations)
+	{
+		allocator.Free(allocation);
+	}
+	TlsfAllocator::Statistics stats = allocator.GetStatistics();
+	Check(allocator.IsEmpty() && stats.FreeBlockCount == 1 && stats.FreeBytes == stats.Capacity, "aligned allocations coalesce back");
+}
+
+static void CheckCoalescing()
+{
+	TlsfAllocator allocator;
+	allocator.Create(400);
+
+	//four blocks filling the allocator, [a][b][c][d]
+	TlsfAllocator::Allocation a, b, c, d;
+	allocator.Allocate(100, 1, a);
+	allocator.Allocate(100, 1, b);
+	allocator.Allocate(100, 1, c);
+	allocator.Allocate(100, 1, d);
+	Check(allocator.GetStatistics().FreeBlockCount == 0, "a full allocator has no free block");
+
+	TlsfAllocator::Allocation big;
+	allocator.Free(a);
+	allocator.Free(b); //merges with the previous neighbour
+	TlsfAllocator::Statistics stats = allocator.GetStatistics();
+	Check(stats.FreeBlockCount == 1 && stats.LargestFreeBlock == 200, "free merges with the previous neighbour");
+
+	Check(allocator.Allocate(200, 1, big) && big.Offset == 0, "merged block is allocatable");
+	allocator.Free(big);
+
+	allocator.Free(d);
+	allocator.Free(c); //merges with both the previous and the next neighbour
+	stats = allocator.GetStatistics();
+	Check(stats.FreeBlockCount == 1 && stats.LargestFreeBlock == 400, "free merges with both neighbours");
+
+	allocator.Allocate(100, 1, a);
+	allocator.Allocate(100, 1, b);
+	allocator.Allocate(100, 1, c);
+	allocator.Allocate(100, 1, d);
+	allocator.Free(d);
+	allocator.Free(c); //merges with the next neighbour only, b is still live
+	stats = allocator.GetStatistics();
+	Check(stats.FreeBlockCount == 1 && stats.LargestFreeBlock == 200, "free merges with the next neighbour");
+	Check(allocator.Allocate(200, 1, big) && big.Offset == 200, "merged tail is allocatable");
+}
+
+static void CheckOutOfSpace()
+{
+	TlsfAllocator allocator;
+	allocator.Create(1000);
+
+	TlsfAllocator::Allocation allocation;
+	Check(!allocator.Allocate(0, 1, allocation), "zero sized allocations fail");
+	Check(!allocator.Allocate(1001, 1, allocation), "allocations larger than the capacity fail");
+
+	//free bytes are enough but split across holes
+	std::vector<TlsfAllocator::Allocation> blocks(10);
+	for (auto& block : blocks)
+	{
+		allocator.Allocate(100, 1, block);
+	}
+	Check(!allocator.Allocate(1, 1, allocation), "a full allocator fails");
+	for (size_t i = 1; i < blocks.size(); i += 2)
+	{
+		allocator.Free(blocks[i]);
+	}
+	TlsfAllocator::Statistics before = allocator.GetStatistics();
+	Check(before.FreeBytes == 500 && before.FreeBlockCount == 5, "every other block freed");
+	Check(!allocator.Allocate(200, 1, allocation), "fragmented free space can't hold a larger block");
+
+	//alignment alone can make a hole unusable, the holes start at 100, 300, .. 900 and only [500, 600) has a
+	//multiple of 256 in it, too late for 100 bytes
+	Check(!allocator.Allocate(100, 256, allocation), "no hole holds an allocation at that alignment");
+
+	TlsfAllocator::Statistics after = allocator.GetStatistics();
+	Check(after.FreeBytes == before.FreeBytes && after.FreeBlockCount == before.FreeBlockCount && after.AllocationCount == before.AllocationCount,
+		"a failed allocation leaves the allocator unchanged");
+}
+
+static void CheckFragmentation()
+{
+	TlsfAllocator allocator;
+	allocator.Create(1000);
+	Check(allocator.GetStatistics().GetFragmentation() == 0.0, "a new allocator isn't fragmented");
+
+	std::vector<TlsfAllocator::Allocation> blocks(10);
+	for (auto& block : blocks)
+	{
+		allocator.Allocate(100, 1, block);
+	}
+	Check(allocator.GetStatistics().GetFragmentation() == 0.0, "a full allocator isn't fragmented");
+
+	for (size_t i = 0; i < blocks.size(); i += 2)
+	{
+		allocator.Free(blocks[i]);
+	}
+	TlsfAllocator::Statistics stats = allocator.GetStatistics();
+	Check(stats.LargestFreeBlock == 100 && stats.GetFragmentation() > 0.79 && stats.GetFragmentation() < 0.81,
+		"five holes of 100 bytes are 80% fragmented");
+
+	for (size_t i = 1; i < blocks.size(); i += 2)
+	{
+		allocator.Free(blocks[i]);
+	}
+	Check(allocator.GetStatistics().GetFragmentation() == 0.0, "freeing everything removes the fragmentation");
+}
+
+//random allocations and frees against the list of live ranges, returns the allocate and free pairs it did
+static uint32_t CheckRandom(uint32_t ops)
+{
+	const uint64_t capacity = 64ull << 20;
+	TlsfAllocator allocator;
+	allocator.Create(capacity);
+
+	std::mt19937 random(7);
+	std::vector<TlsfAllocator::Allocation> live;
+	bool overlap = false;
+	bool accounted = true;
+	uint32_t pairs = 0;
+	for (uint32_t op = 0; op < ops; ++op)
+	{
+		if (live.empty() || random() % 3 != 0)
+		{
+			uint64_t size = 1 + random() % (1 << (4 + random() % 14));
+			uint64_t alignment = uint64_t(1) << (random() % 13);
+			TlsfAllocator::Allocation allocation;
+			if (!allocator.Allocate(size, alignment, allocation))
+			{
+				continue;
+			}
+			overlap |= allocation.Offset % alignment != 0 || allocation.Offset + allocation.Size > capacity;
+			for (const auto& other : live)
+			{
+				overlap |= allocation.Offset < other.Offset + other.Size && other.Offset < allocation.Offset + allocation.Size;
+			}
+			live.push_back(allocation);
+		}
+		else
+		{
+			size_t index = random() % live.size();
+			allocator.Free(live[index]);
+			live[index] = live.back();
+			live.pop_back();
+			++pairs;
+		}
+
+		if (op % 64 == 0)
+		{
+			TlsfAllocator::Statistics stats = allocator.GetStatistics();
+			uint64_t used = 0;
+			for (const auto& allocation : live)
+			{
+				used += allocation.Size;
+			}
+			//UsedBytes also holds the padding too small to return, never less than the live sizes
+			accounted &= stats.AllocationCount == live.size() && stats.UsedBytes >= used &&
+				stats.UsedBytes + stats.FreeBytes == capacity && stats.LargestFreeBlock <= stats.FreeBytes;
+		}
+	}
+	Check(!overlap, "random allocations are aligned and don't overlap");
+	Check(accounted, "statistics match the live allocations");
+
+	for (const auto& allocation : live)
+	{
+		allocator.Free(allocation);
+	}
+	TlsfAllocator::Statistics stats = allocator.GetStatistics();
+	Check(allocator.IsEmpty() && stats.FreeBlockCount == 1 && stats.FreeBytes == capacity, "random run coalesces back to one block");
+	return pairs;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t ops = 200000;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--ops") && i + 1 < argc)
+		{
+			ops = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+
+	CheckAllocateFree();
+	CheckAlignment();
+	CheckCoalescing();
+	CheckOutOfSpace();
+	CheckFragmentation();
+	uint32_t pairs = CheckRandom(ops / 10);
+
+	//timing with a steady population of a few thousand live allocations, as in a heap of a streaming scene
+	const uint32_t population = 4096;
+	TlsfAllocator allocator;
+	allocator.Create(256ull << 20);
+	std::mt19937 random(11);
+	std::vector<TlsfAllocator::Allocation> live(population);
+	for (auto& allocation : live)
+	{
+		allocator.Allocate(256 + random() % 65536, 256, allocation);
+	}
+	std::vector<uint64_t> sizes(1024);
+	for (auto& size : sizes)
+	{
+		size = 256 + random() % 65536;
+	}
+
+	SteadyFrameClock clock;
+	double start = clock.Now();
+	uint32_t failed = 0;
+	for (uint32_t op = 0; op < ops; ++op)
+	{
+		TlsfAllocator::Allocation& slot = live[op % population];
+		allocator.Free(slot);
+		if (!allocator.Allocate(sizes[op % sizes.size()], 256, slot))
+		{
+			++failed; //slot is gone, freeing it again would be a double free
+			break;
+		}
+	}
+	double nsPerPair = ops ? (clock.Now() - start) * 1e9 / ops : 0.0;
+	Check(!failed, "steady population never runs out of space");
+
+	TlsfAllocator::Statistics stats = allocator.GetStatistics();
+	printf("%u random frees checked | %u allocations live, %.1f%% fragmented | %.1f ns per free and allocate | %s\n",
+		pairs, stats.AllocationCount, stats.GetFragmentation() * 100.0, nsPerPair,
+		g_Failures ? "FAILED" : "allocations are aligned, disjoint and coalesce");
+	return g_Failures ? 1 : 0;
+}
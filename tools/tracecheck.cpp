@@ -0,0 +1,520 @@
+//tracer checks: two threads record at once and their events land on their own tracks in order, a thread buffer
+//that fills up drops and counts the events past its capacity, the capture ring keeps only the newest events oldest
+//first, and naming threads while another thread flushes is safe. Every capture is written with Flush and parsed back
+//as JSON to check the Chrome trace format: the thread_name metadata, the "X" events and their ts and dur in
+//microseconds. Then reports what a scope costs, enabled and disabled. Add -fsanitize=thread to check the threads
+//for races as well. From the repository root:
+//
+//  g++ -O2 -DENABLE_TRACING=1 -std=c++14 -pthread -I. tools/tracecheck.cpp -o tracecheck
+//  ./tracecheck [--scopes N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../tracing.h"
+#include "../frameclock.h"
+#include "check.h"
+
+#if !ENABLE_TRACING
+#error "build with -DENABLE_TRACING=1, there is nothing to check otherwise"
+#endif
+
+static const char* TraceFileName = "tracecheck.json";
+
+//just enough JSON to read a trace back: numbers keep their text so ts and dur can be compared digit for digit
+struct JsonValue
+{
+	enum Type { Null, Bool, Number, String, Array, Object };
+
+	JsonValue() : ValueType(Null) {}
+
+	const JsonValue* Find(const char* key) const
+	{
+		for (const auto& member : Members)
+		{
+			if (member.first == key)
+			{
+				return &member.second;
+			}
+		}
+		return nullptr;
+	}
+
+	Type ValueType;
+	std::string Text; //strings unescaped, numbers, true and false as written
+	std::vector<JsonValue> Items;
+	std::vector<std::pair<std::string, JsonValue>> Members;
+};
+
+class JsonParser
+{
+public:
+	explicit JsonParser(const std::string& text) : m_Text(text.c_str()), m_End(text.c_str() + text.size()) {}
+
+	//false unless the whole text is one well formed value
+	bool Parse(JsonValue& value)
+	{
+		if (!ParseValue(value))
+		{
+			return false;
+		}
+		SkipSpace();
+		return m_Text == m_End;
+	}
+
+private:
+	void SkipSpace()
+	{
+		while (m_Text < m_End && (*m_Text == ' ' || *m_Text == '\n' || *m_Text == '\r' || *m_Text == '\t'))
+		{
+			++m_Text;
+		}
+	}
+
+	bool Expect(char c)
+	{
+		SkipSpace();
+		if (m_Text < m_End && *m_Text == c)
+		{
+			++m_Text;
+			return true;
+		}
+		return false;
+	}
+
+	bool ParseString(std::string& text)
+	{
+		if (!Expect('"'))
+		{
+			return false;
+		}
+		for (; m_Text < m_End && *m_Text != '"'; ++m_Text)
+		{
+			if (static_cast<unsigned char>(*m_Text) < 0x20)
+			{
+				return false;
+			}
+			if (*m_Text == '\\')
+			{
+				//the tracer only ever escapes quotes and backslashes
+				if (++m_Text == m_End || (*m_Text != '"' && *m_Text != '\\'))
+				{
+					return false;
+				}
+			}
+			text += *m_Text;
+		}
+		return Expect('"');
+	}
+
+	bool ParseValue(JsonValue& value)
+	{
+		SkipSpace();
+		if (m_Text == m_End)
+		{
+			return false;
+		}
+		if (*m_Text == '{')
+		{
+			value.ValueType = JsonValue::Object;
+			++m_Text;
+			if (Expect('}'))
+			{
+				return true;
+			}
+			do
+			{
+				value.Members.emplace_back();
+				if (!ParseString(value.Members.back().first) || !Expect(':') || !ParseValue(value.Members.back().second))
+				{
+					return false;
+				}
+			} while (Expect(','));
+			return Expect('}');
+		}
+		if (*m_Text == '[')
+		{
+			value.ValueType = JsonValue::Array;
+			++m_Text;
+			if (Expect(']'))
+			{
+				return true;
+			}
+			do
+			{
+				value.Items.emplace_back();
+				if (!ParseValue(value.Items.back()))
+				{
+					return false;
+				}
+			} while (Expect(','));
+			return Expect(']');
+		}
+		if (*m_Text == '"')
+		{
+			value.ValueType = JsonValue::String;
+			return ParseString(value.Text);
+		}
+		for (const char* word : { "true", "false", "null" })
+		{
+			size_t length = strlen(word);
+			if (size_t(m_End - m_Text) >= length && !strncmp(m_Text, word, length))
+			{
+				value.ValueType = word[0] == 'n' ? JsonValue::Null : JsonValue::Bool;
+				value.Text = word;
+				m_Text += length;
+				return true;
+			}
+		}
+		const char* start = m_Text;
+		char* end = nullptr;
+		strtod(start, &end);
+		if (end == start || end > m_End)
+		{
+			return false;
+		}
+		value.ValueType = JsonValue::Number;
+		value.Text.assign(start, static_cast<size_t>(end - start));
+		m_Text = end;
+		return true;
+	}
+
+	const char* m_Text;
+	const char* m_End;
+};
+
+//what a flushed trace holds, read back from the JSON
+struct Trace
+{
+	struct Thread
+	{
+		uint32_t Id;
+		std::string Name;
+		uint64_t Dropped;
+	};
+
+	struct Event
+	{
+		std::string Name;
+		uint32_t ThreadId;
+		std::string Start; //microseconds as written
+		std::string Duration;
+	};
+
+	bool Valid; //parsed and every event has the fields of its phase
+	std::vector<Thread> Threads;
+	std::vector<Event> Events;
+	uint64_t Overwritten;
+
+	const Thread* FindThread(const char* name) const
+	{
+		for (const Thread& thread : Threads)
+		{
+			if (thread.Name == name)
+			{
+				return &thread;
+			}
+		}
+		return nullptr;
+	}
+
+	std::vector<const Event*> GetEvents(uint32_t threadId) const
+	{
+		std::vector<const Event*> events;
+		for (const Event& event : Events)
+		{
+			if (event.ThreadId == threadId)
+			{
+				events.push_back(&event);
+			}
+		}
+		return events;
+	}
+};
+
+static bool IsNumber(const JsonValue* value)
+{
+	return value && value->ValueType == JsonValue::Number;
+}
+
+static bool IsString(const JsonValue* value, const char* text = nullptr)
+{
+	return value && value->ValueType == JsonValue::String && (!text || value->Text == text);
+}
+
+static Trace FlushAndRead()
+{
+	Trace trace;
+	trace.Valid = false;
+	trace.Overwritten = 0;
+	if (!Tracer::Get().Flush(TraceFileName))
+	{
+		return trace;
+	}
+	std::ifstream file(TraceFileName);
+	std::stringstream text;
+	text << file.rdbuf();
+	file.close();
+	remove(TraceFileName);
+
+	JsonValue root;
+	if (!JsonParser(text.str()).Parse(root) || root.ValueType != JsonValue::Object)
+	{
+		return trace;
+	}
+	const JsonValue* events = root.Find("traceEvents");
+	const JsonValue* otherData = root.Find("otherData");
+	const JsonValue* overwritten = otherData ? otherData->Find("overwritten") : nullptr;
+	if (!events || events->ValueType != JsonValue::Array || !IsString(root.Find("displayTimeUnit"), "ns") || !IsNumber(overwritten))
+	{
+		return trace;
+	}
+	trace.Overwritten = strtoull(overwritten->Text.c_str(), nullptr, 10);
+
+	trace.Valid = true;
+	for (const JsonValue& event : events->Items)
+	{
+		const JsonValue* phase = event.Find("ph");
+		const JsonValue* name = event.Find("name");
+		const JsonValue* tid = event.Find("tid");
+		bool valid = IsString(phase) && IsString(name) && IsNumber(event.Find("pid")) && IsNumber(tid);
+		if (valid && phase->Text == "M")
+		{
+			const JsonValue* args = event.Find("args");
+			const JsonValue* threadName = args ? args->Find("name") : nullptr;
+			const JsonValue* dropped = args ? args->Find("dropped") : nullptr;
+			valid = name->Text == "thread_name" && IsString(threadName) && IsNumber(dropped);
+			if (valid)
+			{
+				Trace::Thread thread = { uint32_t(atoi(tid->Text.c_str())), threadName->Text, strtoull(dropped->Text.c_str(), nullptr, 10) };
+				trace.Threads.push_back(thread);
+			}
+		}
+		else if (valid && phase->Text == "X")
+		{
+			const JsonValue* ts = event.Find("ts");
+			const JsonValue* dur = event.Find("dur");
+			valid = IsNumber(ts) && IsNumber(dur);
+			if (valid)
+			{
+				Trace::Event captured = { name->Text, uint32_t(atoi(tid->Text.c_str())), ts->Text, dur->Text };
+				trace.Events.push_back(captured);
+			}
+		}
+		trace.Valid &= valid;
+	}
+	return trace;
+}
+
+//how Flush writes a time in nanoseconds: microseconds with three decimals
+static std::string Microseconds(uint64_t ns)
+{
+	char text[32];
+	snprintf(text, sizeof(text), "%llu.%03u", (unsigned long long)(ns / 1000), unsigned(ns % 1000));
+	return text;
+}
+
+//events are recorded with made up times, so the trace can be checked digit for digit
+static void RecordNumbered(const char* name, uint32_t first, uint32_t count)
+{
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		Tracer::Get().Record(name, uint64_t(i) * 1000 + 7, 1500 + i);
+	}
+}
+
+static bool IsNumbered(const std::vector<const Trace::Event*>& events, const char* name, uint32_t first, uint32_t count)
+{
+	if (events.size() != count)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const Trace::Event& event = *events[i];
+		if (event.Name != name || event.Start != Microseconds(uint64_t(first + i) * 1000 + 7) || event.Duration != Microseconds(1500 + first + i))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void CheckThreads()
+{
+	Tracer::Get().SetCaptureCapacity(Tracer::DefaultCaptureCapacity);
+
+	//both threads record at the same time once they are both running
+	std::atomic<uint32_t> ready(0);
+	auto record = [&ready](const char* threadName, const char* name)
+	{
+		TRACE_THREAD_NAME(threadName);
+		++ready;
+		while (ready.load() < 2)
+		{
+		}
+		RecordNumbered(name, 0, 5000);
+	};
+	std::thread first(record, "Recorder \"A\"", "a");
+	std::thread second(record, "Recorder\\B", "b");
+	first.join();
+	second.join();
+
+	Trace trace = FlushAndRead();
+	Check(trace.Valid, "the trace parses as Chrome trace JSON");
+	const Trace::Thread* a = trace.FindThread("Recorder \"A\"");
+	const Trace::Thread* b = trace.FindThread("Recorder\\B");
+	const Trace::Thread* gpu = trace.FindThread("GPU");
+	Check(a && b && a->Id != b->Id, "each thread has a thread_name track, quotes and backslashes escaped");
+	Check(gpu && gpu->Id == Tracer::GpuThreadId, "the GPU has a track of its own");
+	if (a && b)
+	{
+		Check(a->Dropped == 0 && b->Dropped == 0, "nothing dropped below the buffer capacity");
+		Check(IsNumbered(trace.GetEvents(a->Id), "a", 0, 5000) && IsNumbered(trace.GetEvents(b->Id), "b", 0, 5000),
+			"every event is on its thread's track in order, with ts and dur in microseconds");
+	}
+	Check(trace.Events.size() == 10000 && trace.Overwritten == 0, "nothing else captured or overwritten");
+}
+
+static void CheckDropped()
+{
+	Tracer::Get().SetCaptureCapacity(Tracer::DefaultCaptureCapacity);
+
+	//without a Collect the buffer keeps its first Capacity events and counts the rest
+	std::thread overflowing([]()
+	{
+		TRACE_THREAD_NAME("Overflowing");
+		RecordNumbered("o", 0, TraceBuffer::Capacity + 100);
+	});
+	overflowing.join();
+
+	Trace trace = FlushAndRead();
+	const Trace::Thread* thread = trace.FindThread("Overflowing");
+	Check(trace.Valid && thread && thread->Dropped == 100, "events past a full buffer are dropped and counted");
+	Check(thread && IsNumbered(trace.GetEvents(thread->Id), "o", 0, TraceBuffer::Capacity), "a full buffer keeps the events it already had");
+
+	//collecting in between makes room
+	std::thread collected([]()
+	{
+		TRACE_THREAD_NAME("Collected");
+		RecordNumbered("c", 0, TraceBuffer::Capacity);
+		Tracer::Get().Collect();
+		RecordNumbered("c", TraceBuffer::Capacity, 100);
+	});
+	collected.join();
+	trace = FlushAndRead();
+	thread = trace.FindThread("Collected");
+	Check(thread && thread->Dropped == 0 && IsNumbered(trace.GetEvents(thread->Id), "c", 0, TraceBuffer::Capacity + 100),
+		"Collect makes room in the thread buffers");
+}
+
+static void CheckCaptureRing()
+{
+	//20 events through a ring of 8, over two collects so the ring wraps between them
+	Tracer::Get().SetCaptureCapacity(8);
+	std::thread wrapping([]()
+	{
+		TRACE_THREAD_NAME("Wrapping");
+		RecordNumbered("w", 0, 5);
+		Tracer::Get().Collect();
+		RecordNumbered("w", 5, 15);
+	});
+	wrapping.join();
+
+	Trace trace = FlushAndRead();
+	const Trace::Thread* thread = trace.FindThread("Wrapping");
+	Check(trace.Valid && trace.Events.size() == 8, "the capture holds its capacity");
+	Check(thread && IsNumbered(trace.GetEvents(thread->Id), "w", 12, 8), "only the newest events remain, oldest first");
+	Check(trace.Overwritten == 12, "overwritten events are counted");
+
+	Tracer::Get().SetCaptureCapacity(8);
+	trace = FlushAndRead();
+	Check(trace.Valid && trace.Events.empty() && trace.Overwritten == 0, "setting the capacity clears the capture");
+}
+
+static void CheckRenaming()
+{
+	Tracer::Get().SetCaptureCapacity(Tracer::DefaultCaptureCapacity);
+	std::atomic<bool> stop(false);
+	std::thread renaming([&stop]()
+	{
+		const char* names[] = { "Renamed", "Renamed with a longer name than fits in a short string" };
+		for (uint32_t i = 0; !stop; ++i)
+		{
+			TRACE_THREAD_NAME(names[i % 2]);
+		}
+		TRACE_THREAD_NAME("Renamed last");
+	});
+	bool valid = true;
+	for (uint32_t flush = 0; flush < 20; ++flush)
+	{
+		valid &= FlushAndRead().Valid;
+	}
+	stop = true;
+	renaming.join();
+	Check(valid, "flushing while a thread renames itself writes valid traces");
+	Check(FlushAndRead().FindThread("Renamed last") != nullptr, "the last name wins");
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t scopes = 1000000;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--scopes") && i + 1 < argc)
+		{
+			scopes = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+
+	TRACE_THREAD_NAME("Main");
+	TRACE_ENABLE(true);
+	CheckThreads();
+	CheckDropped();
+	CheckCaptureRing();
+	CheckRenaming();
+
+	//a disabled scope records nothing
+	Tracer::Get().SetCaptureCapacity(Tracer::DefaultCaptureCapacity);
+	TRACE_ENABLE(false);
+	{
+		TRACE_SCOPE("disabled");
+	}
+	Check(FlushAndRead().Events.empty(), "disabled scopes record nothing");
+
+	//the cost of a scope, collecting before the thread buffer fills up and outside the timing
+	SteadyFrameClock clock;
+	const uint32_t bufferCapacity = TraceBuffer::Capacity;
+	double disabledSeconds = 0.0, enabledSeconds = 0.0;
+	for (int enabled = 0; enabled < 2; ++enabled)
+	{
+		TRACE_ENABLE(enabled != 0);
+		for (uint32_t done = 0; done < scopes; done += bufferCapacity)
+		{
+			uint32_t batch = std::min(scopes - done, bufferCapacity);
+			double start = clock.Now();
+			for (uint32_t s = 0; s < batch; ++s)
+			{
+				TRACE_SCOPE("timed");
+			}
+			(enabled ? enabledSeconds : disabledSeconds) += clock.Now() - start;
+			TRACE_COLLECT();
+		}
+	}
+	TRACE_ENABLE(false);
+	Tracer::Get().SetCaptureCapacity(Tracer::DefaultCaptureCapacity);
+
+	printf("%u scopes: %.1f ns enabled, %.1f ns disabled | %s\n", scopes, scopes ? enabledSeconds * 1e9 / scopes : 0.0,
+		scopes ? disabledSeconds * 1e9 / scopes : 0.0, g_Failures ? "FAILED" : "tracks, drops, the capture ring and the JSON hold up");
+	return g_Failures ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+//triple buffer checks: single threaded, that nothing new reads as false and keeps the last value, that the newest
+//of several publishes wins and that the producer never writes into the buffer the consumer reads. Then a producer
+//and a consumer thread hand over snapshots of a few cache lines, each filled with its sequence number, and the
+//consumer checks that every snapshot is whole (no tearing), that sequences only go up and that the quit flag on
+//the last snapshot always arrives, also when the consumer is slower than the producer. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/triplebuffercheck.cpp -o triplebuffercheck
+//  ./triplebuffercheck [--events N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include "../triplebuffer.h"
+#include "check.h"
+
+struct Snapshot
+{
+	uint64_t Sequence;
+	uint64_t Payload[31]; //every entry holds Sequence, a torn read mixes two
+	bool Quit;
+};
+
+static void Fill(Snapshot& snapshot, uint64_t sequence, bool quit)
+{
+	snapshot.Sequence = sequence;
+	for (uint64_t& value : snapshot.Payload)
+	{
+		value = sequence;
+	}
+	snapshot.Quit = quit;
+}
+
+static bool IsWhole(const Snapshot& snapshot)
+{
+	for (uint64_t value : snapshot.Payload)
+	{
+		if (value != snapshot.Sequence)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void CheckSingleThreaded()
+{
+	TripleBuffer<int> buffer;
+	Check(!buffer.Consume() && buffer.GetReadBuffer() == 0, "nothing published reads as nothing new");
+
+	buffer.GetWriteBuffer() = 1;
+	buffer.Publish();
+	Check(buffer.Consume() && buffer.GetReadBuffer() == 1, "a published value is consumed");
+	Check(!buffer.Consume() && buffer.GetReadBuffer() == 1, "consuming again keeps the last value");
+
+	for (int value = 2; value <= 4; ++value)
+	{
+		buffer.GetWriteBuffer() = value;
+		buffer.Publish();
+		Check(&buffer.GetWriteBuffer() != &buffer.GetReadBuffer(), "the producer never writes the consumer's buffer");
+	}
+	Check(buffer.Consume() && buffer.GetReadBuffer() == 4, "the newest value wins");
+	Check(!buffer.Consume(), "skipped values aren't queued");
+	Check(buffer.GetPublishedCount() == 4 && buffer.GetConsumedCount() == 2, "publishes and consumes are counted");
+
+	//a value written but not published isn't visible
+	buffer.GetWriteBuffer() = 5;
+	Check(!buffer.Consume() && buffer.GetReadBuffer() == 4, "unpublished writes stay private");
+	buffer.Publish();
+	Check(buffer.Consume() && buffer.GetReadBuffer() == 5, "publishing after a consume");
+}
+
+//returns the snapshots the consumer saw. consumerDelayUs slows the consumer down like a frame loop.
+static uint64_t RunThreads(uint32_t events, uint32_t consumerDelayUs, bool& whole, bool& ordered, bool& quit)
+{
+	TripleBuffer<Snapshot> buffer;
+	uint64_t consumed = 0;
+	uint64_t last = 0;
+	whole = ordered = true;
+	quit = false;
+	std::thread consumer([&]()
+	{
+		while (!quit)
+		{
+			if (consumerDelayUs)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(consumerDelayUs));
+			}
+			if (!buffer.Consume())
+			{
+				continue;
+			}
+			const Snapshot& snapshot = buffer.GetReadBuffer();
+			whole &= IsWhole(snapshot);
+			ordered &= snapshot.Sequence > last;
+			last = snapshot.Sequence;
+			quit = snapshot.Quit;
+			++consumed;
+		}
+		ordered &= last == events;
+	});
+
+	//a publish every microsecond or so, a producer publishing back to back would leave the consumer few chances
+	//to read while a write is under way
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+	for (uint32_t e = 1; e <= events; ++e)
+	{
+		next += std::chrono::microseconds(1);
+		while (std::chrono::steady_clock::now() < next)
+		{
+		}
+		Fill(buffer.GetWriteBuffer(), e, e == events);
+		buffer.Publish();
+	}
+	consumer.join();
+	return consumed;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t events = 200000;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--events") && i + 1 < argc)
+		{
+			events = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+	}
+	if (!events)
+	{
+		fprintf(stderr, "--events has to be at least 1\n");
+		return 1;
+	}
+
+	CheckSingleThreaded();
+
+	bool whole, ordered, quit;
+	uint64_t spinning = RunThreads(events, 0, whole, ordered, quit);
+	Check(whole, "snapshots are never torn");
+	Check(ordered, "sequences only go up and end at the last one");
+	Check(quit, "the consumer sees quit");
+
+	uint64_t paced = RunThreads(events / 10 + 1, 500, whole, ordered, quit);
+	Check(whole && ordered && quit, "a slow consumer skips to the newest snapshot and still sees quit");
+
+	printf("%u snapshots of %zu bytes: %llu consumed by a spinning consumer, %llu of %u by a slow one | %s\n", events, sizeof(Snapshot),
+		(unsigned long long)spinning, (unsigned long long)paced, events / 10 + 1, g_Failures ? "FAILED" : "latest wins, no tearing, quit arrives");
+	return g_Failures ? 1 : 0;
+}
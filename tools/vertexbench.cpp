@@ -0,0 +1,216 @@
+//packed vertex formats: encodes a large synthetic mesh into every format of vertexformats.h, reports the bytes
+//per vertex against the full float formats, the encoding throughput, and the largest error of every attribute
+//after decoding it the way the GPU would. Also checks the SSE conversions against the scalar ones and the half
+//conversion against every half value. From the repository root:
+//
+//  g++ -O2 -std=c++14 -pthread -I. tools/vertexbench.cpp -o vertexbench
+//  ./vertexbench [--vertices N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "../vertexformats.h"
+#include "../frameclock.h"
+#include "check.h"
+
+struct Mesh
+{
+	std::vector<float> Positions, Normals, TexCoords, Colors;
+	VertexStreams Streams;
+	float Extent; //largest half extent of the bounds, position errors are relative to it
+};
+
+static Mesh MakeMesh(size_t count)
+{
+	Mesh mesh;
+	uint32_t seed = 7;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24); };
+	//a mesh away from the origin, as most are in their own space after export
+	const float center[3] = { 120.0f, 15.0f, -40.0f };
+	const float size[3] = { 20.0f, 8.0f, 3.0f };
+	for (size_t v = 0; v < count; ++v)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			mesh.Positions.push_back(center[a] + (random() - 0.5f) * size[a]);
+		}
+		float n[3] = { random() * 2.0f - 1.0f, random() * 2.0f - 1.0f, random() * 2.0f - 1.0f };
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length < 1e-3f)
+		{
+			n[0] = 0.0f; n[1] = 0.0f; n[2] = length = 1.0f;
+		}
+		for (int a = 0; a < 3; ++a)
+		{
+			mesh.Normals.push_back(n[a] / length);
+		}
+		mesh.TexCoords.push_back(random());
+		mesh.TexCoords.push_back(random());
+		for (int c = 0; c < 4; ++c)
+		{
+			mesh.Colors.push_back(random());
+		}
+	}
+	mesh.Extent = 10.0f;
+	mesh.Streams.Count = count;
+	mesh.Streams.Positions = mesh.Positions.data();
+	mesh.Streams.Normals = mesh.Normals.data();
+	mesh.Streams.TexCoords = mesh.TexCoords.data();
+	mesh.Streams.Colors = mesh.Colors.data();
+	return mesh;
+}
+
+//largest decoded error of attribute Index: relative to the extent for positions, degrees for normals, absolute otherwise
+template<typename Layout, UINT Index>
+static float MeasureError(const Mesh& mesh, const PositionQuantization& quantization, const std::vector<uint8_t>& vertices)
+{
+	typedef typename Layout::template Attribute<Index> Attribute;
+	typedef typename Attribute::SemanticType Semantic;
+	float worst = 0.0f;
+	for (size_t v = 0; v < mesh.Streams.Count; ++v)
+	{
+		float value[4];
+		Attribute::Decode(&vertices[v * Layout::Stride + Layout::template Offset<Index>::Value], value);
+		float error = 0.0f;
+		if (std::is_same<Semantic, VertexSemantic::Position>::value)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				float decoded = value[a] * quantization.Scale[a] + quantization.Bias[a];
+				error = std::max(error, fabsf(decoded - mesh.Positions[v * 3 + a]) / mesh.Extent);
+			}
+		}
+		else if (std::is_same<Semantic, VertexSemantic::Normal>::value)
+		{
+			float normal[3];
+			VertexPacking::OctahedralDecode(value, normal);
+			const float* original = &mesh.Normals[v * 3];
+			//acos of a float dot product loses everything under a few hundredths of a degree, atan2 of the cross
+			//and dot products in double keeps small angles and doesn't need unit length
+			double cross[3] =
+			{
+				double(normal[1]) * original[2] - double(normal[2]) * original[1],
+				double(normal[2]) * original[0] - double(normal[0]) * original[2],
+				double(normal[0]) * original[1] - double(normal[1]) * original[0],
+			};
+			double dot = double(normal[0]) * original[0] + double(normal[1]) * original[1] + double(normal[2]) * original[2];
+			error = static_cast<float>(atan2(sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), dot) * 180.0 / 3.14159265358979323846);
+		}
+		else
+		{
+			const float* original = std::is_same<Semantic, VertexSemantic::TexCoord>::value ? &mesh.TexCoords[v * 2] : &mesh.Colors[v * 4];
+			for (UINT c = 0; c < Attribute::Components; ++c)
+			{
+				error = std::max(error, fabsf(value[c] - original[c]));
+			}
+		}
+		worst = std::max(worst, error);
+	}
+	return worst;
+}
+
+template<typename Vertex>
+static void Measure(const char* name, const Mesh& mesh, const PositionQuantization& quantization, float positionTolerance, size_t floatBytes)
+{
+	typedef typename Vertex::Layout Layout;
+	std::vector<uint8_t> vertices(mesh.Streams.Count * Layout::Stride);
+	SteadyFrameClock clock;
+	double start = clock.Now();
+	Layout::Encode(mesh.Streams, quantization, vertices.data());
+	double seconds = clock.Now() - start;
+
+	float positionError = MeasureError<Layout, 0>(mesh, quantization, vertices);
+	float secondError = MeasureError<Layout, 1>(mesh, quantization, vertices);
+	printf("%-18s %2u bytes (%2zu in floats, %3.0f%%) | encode %6.1f Mverts/s | position error %.2e of extent, attribute 1 error %.2e",
+		name, Layout::Stride, floatBytes, 100.0 * Layout::Stride / floatBytes, double(mesh.Streams.Count) / seconds / 1e6, positionError, secondError);
+	if (Layout::AttributeCount > 2)
+	{
+		printf(", attribute 2 error %.2e", MeasureError<Layout, (Layout::AttributeCount > 2 ? 2 : 0)>(mesh, quantization, vertices));
+	}
+	printf("\n");
+	if (positionError > positionTolerance)
+	{
+		fprintf(stderr, "FAILED: %s position error %g above %g\n", name, positionError, positionTolerance);
+		++g_Failures;
+	}
+}
+
+static void CheckConversions()
+{
+	//every half converts to float and back unchanged, NaNs aside
+	for (uint32_t h = 0; h < 0x10000; ++h)
+	{
+		bool nan = ((h >> 10) & 0x1f) == 0x1f && (h & 0x3ff);
+		if (!nan && VertexPacking::FloatToHalf(VertexPacking::HalfToFloat(static_cast<uint16_t>(h))) != h)
+		{
+			fprintf(stderr, "FAILED: half %04x does not round trip\n", h);
+			++g_Failures;
+			return;
+		}
+	}
+	if (VertexPacking::FloatToHalf(65520.0f) != 0x7c00 || VertexPacking::FloatToHalf(65519.0f) != 0x7bff || VertexPacking::FloatToHalf(1.0f + 1.0f / 2048.0f) != 0x3c00)
+	{
+		fprintf(stderr, "FAILED: half rounding\n");
+		++g_Failures;
+	}
+
+	//the SSE packing matches the scalar conversions, out of range values included
+	uint32_t seed = 3;
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24) * 3.0f - 1.5f; };
+	for (int i = 0; i < 100000; ++i)
+	{
+		float value[4] = { random(), random(), random(), random() };
+		int16_t s16[4]; uint16_t u16[4]; int8_t s8[4]; uint8_t u8[4];
+		VertexPacking::PackComponents(VertexPacking::Snorm16, 4, value, s16);
+		VertexPacking::PackComponents(VertexPacking::Unorm16, 4, value, u16);
+		VertexPacking::PackComponents(VertexPacking::Snorm8, 4, value, s8);
+		VertexPacking::PackComponents(VertexPacking::Unorm8, 4, value, u8);
+		for (int c = 0; c < 4; ++c)
+		{
+			if (s16[c] != VertexPacking::FloatToSnorm16(value[c]) || u16[c] != VertexPacking::FloatToUnorm16(value[c]) ||
+				s8[c] != VertexPacking::FloatToSnorm8(value[c]) || u8[c] != VertexPacking::FloatToUnorm8(value[c]))
+			{
+				fprintf(stderr, "FAILED: packing %g differs from the scalar conversion\n", value[c]);
+				++g_Failures;
+				return;
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 1000000;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (!strcmp(argv[i], "--vertices")) count = static_cast<size_t>(strtoull(argv[i + 1], nullptr, 10));
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	CheckConversions();
+
+	Mesh mesh = MakeMesh(count);
+	PositionQuantization quantization = PositionQuantization::FromPositions(mesh.Positions.data(), count);
+	printf("%zu vertices, SSE packing %s\n", count, VERTEX_PACKING_SSE ? "on" : "off");
+	//SNORM16 over the bounds is good to half a step of 2/65534 of the half extent
+	Measure<VertexTypes::P3S16_T2U16>("P3S16_T2U16", mesh, quantization, 2e-5f, 20);
+	Measure<VertexTypes::P3S16_C4U8>("P3S16_C4U8", mesh, quantization, 2e-5f, 28);
+	Measure<VertexTypes::P3S16_N2S16_T2H16>("P3S16_N2S16_T2H16", mesh, quantization, 2e-5f, 32);
+	//halves keep 11 bits, relative to the position's own magnitude rather than the bounds
+	Measure<VertexTypes::P3H16_T2H16>("P3H16_T2H16", mesh, PositionQuantization::Identity(), 0.01f, 20);
+
+	if (g_Failures)
+	{
+		printf("FAILED\n");
+	}
+	return g_Failures ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+//scoped CPU (and GPU) timeline instrumentation written out as Chrome trace JSON, which chrome://tracing and
+//the Perfetto UI both open.
+//Build with ENABLE_TRACING defined to 1 to compile it in; otherwise the TRACE_ macros expand to nothing.
+//When compiled in, scopes cost a relaxed atomic load until Tracer::Get().SetEnabled(true).
+//
+//Every thread records into its own ring buffer, single producer and single consumer, so recording never takes a
+//lock. Flush drains all buffers into the capture and writes it out. Events recorded while a buffer is full are
+//dropped and counted, so long captures should call Collect every few thousand scopes per thread. The capture is
+//a ring as well: it keeps the most recent events up to its capacity and overwrites the oldest, so a session
+//traced for hours holds its last minutes instead of growing without bound.
+
+#ifndef ENABLE_TRACING
+#define ENABLE_TRACING 0
+#endif
+
+#if ENABLE_TRACING
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TraceEvent
+{
+	const char* Name; //must outlive the capture, string literals in practice
+	uint64_t Start; //nanoseconds since the tracer was created
+	uint64_t Duration;
+};
+
+class TraceBuffer
+{
+public:
+	static const uint32_t Capacity = 1 << 14;
+
+	TraceBuffer(uint32_t threadId) : m_Head(0), m_Tail(0), m_Dropped(0), m_ThreadId(threadId) {}
+
+	//owning thread only
+	void Push(const TraceEvent& event)
+	{
+		uint64_t head = m_Head.load(std::memory_order_relaxed);
+		if (head - m_Tail.load(std::memory_order_acquire) >= Capacity)
+		{
+			m_Dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		m_Events[head % Capacity] = event;
+		m_Head.store(head + 1, std::memory_order_release);
+	}
+
+	//flushing thread only
+	template<typename Func>
+	void Drain(Func func)
+	{
+		uint64_t tail = m_Tail.load(std::memory_order_relaxed);
+		uint64_t head = m_Head.load(std::memory_order_acquire);
+		for (; tail != head; ++tail)
+		{
+			func(m_Events[tail % Capacity]);
+		}
+		m_Tail.store(tail, std::memory_order_release);
+	}
+
+	uint32_t GetThreadId() const { return m_ThreadId; }
+	uint64_t GetDropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+	std::string Name; //set by the owning thread and read when flushing, both under the tracer's lock
+
+private:
+	TraceEvent m_Events[Capacity];
+	std::atomic<uint64_t> m_Head;
+	std::atomic<uint64_t> m_Tail;
+	std::atomic<uint64_t> m_Dropped;
+	uint32_t m_ThreadId;
+};
+
+class Tracer
+{
+public:
+	static const uint32_t GpuThreadId = 0; //GPU scopes go on a track of their own
+	static const size_t DefaultCaptureCapacity = 1 << 20; //events, 24MB
+
+	static Tracer& Get()
+	{
+		static Tracer tracer;
+		return tracer;
+	}
+
+	void SetEnabled(bool enabled) { m_Enabled.store(enabled, std::memory_order_relaxed); }
+	bool IsEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+	uint64_t Now() const
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count());
+	}
+
+	void Record(const char* name, uint64_t start, uint64_t duration)
+	{
+		TraceEvent event = { name, start, duration };
+		GetThreadBuffer()->Push(event);
+	}
+
+	//GPU scopes, already converted to the tracer's clock. Only the thread collecting GPU timings may call this.
+	void RecordGpu(const char* name, uint64_t start, uint64_t duration)
+	{
+		TraceEvent event = { name, start, duration };
+		m_GpuBuffer->Push(event);
+	}
+
+	//Flush reads the names under the lock, so they are written under it too
+	void SetThreadName(const char* name)
+	{
+		TraceBuffer* buffer = GetThreadBuffer();
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		buffer->Name = name;
+	}
+
+	//events the capture keeps before overwriting the oldest, clears what was captured so far
+	void SetCaptureCapacity(size_t capacity)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_CaptureCapacity = capacity ? capacity : 1;
+		m_Capture.clear();
+		m_Capture.shrink_to_fit();
+		m_CaptureNext = 0;
+		m_Overwritten = 0;
+	}
+
+	//moves everything recorded so far into the capture, making room in the thread buffers
+	void Collect()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		CollectLocked();
+	}
+
+	//collects, then writes the whole capture to fileName
+	bool Flush(const char* fileName)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		CollectLocked();
+
+		FILE* file = fopen(fileName, "w");
+		if (!file)
+		{
+			return false;
+		}
+		fprintf(file, "{\"traceEvents\":[\n");
+		bool first = true;
+		for (const auto& buffer : m_Buffers)
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\",\"dropped\":%llu}}",
+				first ? "" : ",\n", buffer->GetThreadId(), Escape(buffer->Name.c_str()).c_str(), (unsigned long long)buffer->GetDropped());
+			first = false;
+		}
+		//oldest first, m_CaptureNext is the oldest once the ring has wrapped and 0 until then
+		for (size_t i = 0; i < m_Capture.size(); ++i)
+		{
+			const CapturedEvent& captured = m_Capture[(m_CaptureNext + i) % m_Capture.size()];
+			//microseconds with nanosecond precision
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u,\"dur\":%llu.%03u}",
+				Escape(captured.Event.Name).c_str(), captured.ThreadId,
+				(unsigned long long)(captured.Event.Start / 1000), unsigned(captured.Event.Start % 1000),
+				(unsigned long long)(captured.Event.Duration / 1000), unsigned(captured.Event.Duration % 1000));
+		}
+		fprintf(file, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"overwritten\":%llu}}\n", (unsigned long long)m_Overwritten);
+		return fclose(file) == 0;
+	}
+
+private:
+	struct CapturedEvent
+	{
+		TraceEvent Event;
+		uint32_t ThreadId;
+	};
+
+	Tracer() : m_Enabled(false), m_Start(std::chrono::steady_clock::now()), m_CaptureCapacity(DefaultCaptureCapacity), m_CaptureNext(0), m_Overwritten(0)
+	{
+		m_Buffers.emplace_back(new TraceBuffer(GpuThreadId));
+		m_Buffers.back()->Name = "GPU";
+		m_GpuBuffer = m_Buffers.back().get();
+	}
+
+	void CollectLocked()
+	{
+		for (auto& buffer : m_Buffers)
+		{
+			uint32_t threadId = buffer->GetThreadId();
+			buffer->Drain([&](const TraceEvent& event)
+			{
+				CapturedEvent captured = { event, threadId };
+				if (m_Capture.size() < m_CaptureCapacity)
+				{
+					m_Capture.push_back(captured);
+					return;
+				}
+				m_Capture[m_CaptureNext] = captured;
+				m_CaptureNext = (m_CaptureNext + 1) % m_Capture.size();
+				++m_Overwritten;
+			});
+		}
+	}
+
+	//registers the calling thread's buffer the first time it records, the only time recording takes the lock
+	TraceBuffer* GetThreadBuffer()
+	{
+		static thread_local TraceBuffer* t_Buffer = nullptr;
+		if (!t_Buffer)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Buffers.emplace_back(new TraceBuffer(static_cast<uint32_t>(m_Buffers.size())));
+			t_Buffer = m_Buffers.back().get();
+		}
+		return t_Buffer;
+	}
+
+	static std::string Escape(const char* text)
+	{
+		std::string escaped;
+		for (; text && *text; ++text)
+		{
+			if (*text == '"' || *text == '\\')
+			{
+				escaped += '\\';
+			}
+			if (static_cast<unsigned char>(*text) >= 0x20)
+			{
+				escaped += *text;
+			}
+		}
+		return escaped;
+	}
+
+	std::atomic<bool> m_Enabled;
+	std::chrono::steady_clock::time_point m_Start;
+	std::mutex m_Mutex;
+	std::vector<std::unique_ptr<TraceBuffer>> m_Buffers;
+	TraceBuffer* m_GpuBuffer;
+	std::vector<CapturedEvent> m_Capture; //ring of up to m_CaptureCapacity events
+	size_t m_CaptureCapacity;
+	size_t m_CaptureNext; //slot the next event overwrites once the ring is full
+	uint64_t m_Overwritten;
+};
+
+class TraceScope
+{
+public:
+	explicit TraceScope(const char* name)
+	{
+		Tracer& tracer = Tracer::Get();
+		m_Name = tracer.IsEnabled() ? name : nullptr;
+		m_Start = m_Name ? tracer.Now() : 0;
+	}
+
+	~TraceScope()
+	{
+		if (m_Name)
+		{
+			Tracer& tracer = Tracer::Get();
+			tracer.Record(m_Name, m_Start, tracer.Now() - m_Start);
+		}
+	}
+
+private:
+	TraceScope(const TraceScope&);
+	TraceScope& operator=(const TraceScope&);
+
+	const char* m_Name;
+	uint64_t m_Start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Tracer::Get().SetThreadName(name)
+#define TRACE_ENABLE(enabled) Tracer::Get().SetEnabled(enabled)
+#define TRACE_COLLECT() Tracer::Get().Collect()
+#define TRACE_FLUSH(fileName) Tracer::Get().Flush(fileName)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+#define TRACE_ENABLE(enabled)
+#define TRACE_COLLECT()
+#define TRACE_FLUSH(fileName)
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+//hands the latest value from one producer thread to one consumer thread without locks or waiting.
+//Three copies: the producer fills its back buffer and Publish swaps it with the middle one, the consumer
+//swaps the middle one with its front buffer in Consume when something new was published. Neither side ever
+//touches the other's buffer, and values published faster than they are consumed are skipped, not queued,
+//so the consumer always sees the newest one.
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : m_Back(0), m_Published(0), m_Middle(1), m_Front(2), m_Consumed(0)
+	{
+		m_Buffers[0] = m_Buffers[1] = m_Buffers[2] = T();
+	}
+
+	//producer only. Write the next value here, then Publish.
+	T& GetWriteBuffer() { return m_Buffers[m_Back]; }
+
+	//producer only
+	void Publish()
+	{
+		//acq_rel: releases the write to the back buffer, and acquires the buffer the consumer released
+		uint32_t previous = m_Middle.exchange(m_Back | NewFlag, std::memory_order_acq_rel);
+		m_Back = previous & IndexMask;
+		++m_Published;
+	}
+
+	//consumer only. Moves the newest published value to the front buffer, returns false when there was
+	//nothing new and the front buffer still holds the previous value.
+	bool Consume()
+	{
+		if (!(m_Middle.load(std::memory_order_relaxed) & NewFlag))
+		{
+			return false;
+		}
+		uint32_t previous = m_Middle.exchange(m_Front, std::memory_order_acq_rel);
+		m_Front = previous & IndexMask;
+		++m_Consumed;
+		return true;
+	}
+
+	//consumer only, the value moved by the last successful Consume
+	const T& GetReadBuffer() const { return m_Buffers[m_Front]; }
+
+	uint64_t GetPublishedCount() const { return m_Published; } //producer only
+	uint64_t GetConsumedCount() const { return m_Consumed; } //consumer only
+
+private:
+	static const uint32_t IndexMask = 0x3;
+	static const uint32_t NewFlag = 0x4; //set on the middle index by Publish, cleared by Consume
+
+	T m_Buffers[3];
+	alignas(64) uint32_t m_Back; //producer's
+	uint64_t m_Published;
+	alignas(64) std::atomic<uint32_t> m_Middle; //shared, the index of the middle buffer plus NewFlag
+	alignas(64) uint32_t m_Front; //consumer's
+	uint64_t m_Consumed;
+};
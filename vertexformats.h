@@ -0,0 +1,524 @@
+#pragma once
+
+#include "d3d12types.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define VERTEX_PACKING_SSE 1
+#else
+#define VERTEX_PACKING_SSE 0
+#endif
+
+//compact vertex formats. A format is declared once as a VertexLayout of VertexAttributes, each a semantic and a
+//DXGI format; the input layout, the stride, the attribute offsets and the encoder quantizing full float meshes
+//into it are all generated from that declaration at compile time.
+
+//full float mesh data an encoder reads from, attributes a format doesn't have may be null
+struct VertexStreams
+{
+	size_t Count;
+	const float* Positions; //3 per vertex
+	const float* Normals; //3 per vertex, unit length
+	const float* TexCoords; //2 per vertex
+	const float* Colors; //4 per vertex, RGBA in [0, 1]
+};
+
+//maps a mesh's bounding box onto [-1, 1] so positions fit SNORM16: quantized = (position - Bias) / Scale.
+//The vertex shader gets position = quantized * Scale + Bias back without any change to it when GetMatrix is
+//multiplied in front of the world matrix.
+struct PositionQuantization
+{
+	float Scale[3];
+	float Bias[3];
+
+	static PositionQuantization Identity()
+	{
+		PositionQuantization quantization = { { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+		return quantization;
+	}
+
+	static PositionQuantization FromPositions(const float* positions, size_t count)
+	{
+		if (!count)
+		{
+			return Identity();
+		}
+		float minimum[3] = { positions[0], positions[1], positions[2] };
+		float maximum[3] = { positions[0], positions[1], positions[2] };
+		for (size_t v = 1; v < count; ++v)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				minimum[a] = std::min(minimum[a], positions[v * 3 + a]);
+				maximum[a] = std::max(maximum[a], positions[v * 3 + a]);
+			}
+		}
+		PositionQuantization quantization;
+		for (int a = 0; a < 3; ++a)
+		{
+			quantization.Bias[a] = (minimum[a] + maximum[a]) * 0.5f;
+			//flat axes keep a scale of 1, their quantized value is 0 anyway
+			float halfExtent = (maximum[a] - minimum[a]) * 0.5f;
+			quantization.Scale[a] = halfExtent > 0.0f ? halfExtent : 1.0f;
+		}
+		return quantization;
+	}
+
+	//row major for row vectors, as XMLoadFloat4x4 expects: v * GetMatrix() * world
+	void GetMatrix(float m[16]) const
+	{
+		memset(m, 0, 16 * sizeof(float));
+		m[0] = Scale[0];
+		m[5] = Scale[1];
+		m[10] = Scale[2];
+		m[12] = Bias[0];
+		m[13] = Bias[1];
+		m[14] = Bias[2];
+		m[15] = 1.0f;
+	}
+};
+
+namespace VertexPacking
+{
+	enum ComponentType
+	{
+		Float32,
+		Float16,
+		Snorm16,
+		Unorm16,
+		Snorm8,
+		Unorm8
+	};
+
+	inline constexpr UINT GetComponentBytes(ComponentType type)
+	{
+		return type == Float32 ? 4 : (type == Float16 || type == Snorm16 || type == Unorm16) ? 2 : 1;
+	}
+
+	//round to nearest even, as the SSE conversions do
+	inline int16_t FloatToSnorm16(float value) { return static_cast<int16_t>(lrintf(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f)); }
+	inline uint16_t FloatToUnorm16(float value) { return static_cast<uint16_t>(lrintf(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f)); }
+	inline int8_t FloatToSnorm8(float value) { return static_cast<int8_t>(lrintf(std::min(std::max(value, -1.0f), 1.0f) * 127.0f)); }
+	inline uint8_t FloatToUnorm8(float value) { return static_cast<uint8_t>(lrintf(std::min(std::max(value, 0.0f), 1.0f) * 255.0f)); }
+
+	//-32768 decodes to -1 like -32767, as the GPU does
+	inline float Snorm16ToFloat(int16_t value) { return std::max(float(value) / 32767.0f, -1.0f); }
+	inline float Unorm16ToFloat(uint16_t value) { return float(value) / 65535.0f; }
+	inline float Snorm8ToFloat(int8_t value) { return std::max(float(value) / 127.0f, -1.0f); }
+	inline float Unorm8ToFloat(uint8_t value) { return float(value) / 255.0f; }
+
+	//IEEE half, rounded to nearest even. Out of range values become infinity, NaNs stay NaN.
+	inline uint16_t FloatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+		bits &= 0x7fffffff;
+		if (bits >= 0x7f800000)
+		{
+			return sign | 0x7c00 | (bits > 0x7f800000 ? 0x200 : 0);
+		}
+		if (bits >= 0x477ff000) //65520 and up round past the largest half
+		{
+			return sign | 0x7c00;
+		}
+		if (bits < 0x38800000) //below the smallest normal half, 2^-14: denormal steps of 2^-24
+		{
+			float magnitude;
+			memcpy(&magnitude, &bits, sizeof(magnitude));
+			return sign | static_cast<uint16_t>(lrintf(magnitude * 16777216.0f));
+		}
+		uint32_t half = (bits - 0x38000000) >> 13; //rebias the exponent from 127 to 15
+		uint32_t rest = bits & 0x1fff;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		{
+			++half;
+		}
+		return sign | static_cast<uint16_t>(half);
+	}
+
+	inline float HalfToFloat(uint16_t half)
+	{
+		uint32_t sign = uint32_t(half & 0x8000) << 16;
+		uint32_t exponent = (half >> 10) & 0x1f;
+		uint32_t mantissa = half & 0x3ff;
+		uint32_t bits;
+		if (exponent == 0)
+		{
+			float magnitude = float(mantissa) / 16777216.0f;
+			memcpy(&bits, &magnitude, sizeof(bits));
+			bits |= sign;
+		}
+		else if (exponent == 31)
+		{
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		}
+		else
+		{
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	//unit vector folded onto the octahedron and unfolded onto a square, two components in [-1, 1]
+	inline void OctahedralEncode(const float normal[3], float encoded[2])
+	{
+		float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+		float u = length > 0.0f ? normal[0] / length : 0.0f;
+		float v = length > 0.0f ? normal[1] / length : 0.0f;
+		if (normal[2] < 0.0f)
+		{
+			float foldedU = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+			float foldedV = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+			u = foldedU;
+			v = foldedV;
+		}
+		encoded[0] = u;
+		encoded[1] = v;
+	}
+
+	//as OctDecode in Shaders.hlsl
+	inline void OctahedralDecode(const float encoded[2], float normal[3])
+	{
+		float x = encoded[0], y = encoded[1];
+		float z = 1.0f - fabsf(x) - fabsf(y);
+		if (z < 0.0f)
+		{
+			float unfoldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float unfoldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = unfoldedX;
+			y = unfoldedY;
+		}
+		float length = sqrtf(x * x + y * y + z * z);
+		normal[0] = x / length;
+		normal[1] = y / length;
+		normal[2] = z / length;
+	}
+
+	//writes the first components of value in type to out
+	inline void PackComponents(ComponentType type, UINT components, const float value[4], void* out)
+	{
+		assert(components >= 1 && components <= 4);
+#if VERTEX_PACKING_SSE
+		if (type != Float32 && type != Float16)
+		{
+			__m128 v = _mm_loadu_ps(value);
+			__m128i packed;
+			switch (type)
+			{
+			case Snorm16:
+				packed = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f)), _mm_set1_ps(32767.0f)));
+				packed = _mm_packs_epi32(packed, packed);
+				break;
+			case Unorm16:
+				//SSE2 only packs signed, shift into the int16 range and back
+				packed = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f)), _mm_set1_ps(65535.0f)));
+				packed = _mm_sub_epi32(packed, _mm_set1_epi32(32768));
+				packed = _mm_xor_si128(_mm_packs_epi32(packed, packed), _mm_set1_epi16(-32768));
+				break;
+			case Snorm8:
+				packed = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f)), _mm_set1_ps(127.0f)));
+				packed = _mm_packs_epi32(packed, packed);
+				packed = _mm_packs_epi16(packed, packed);
+				break;
+			default: //Unorm8
+				packed = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f)), _mm_set1_ps(255.0f)));
+				packed = _mm_packs_epi32(packed, packed);
+				packed = _mm_packus_epi16(packed, packed);
+				break;
+			}
+			uint8_t bytes[16];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), packed);
+			memcpy(out, bytes, components * GetComponentBytes(type));
+			return;
+		}
+#endif
+		for (UINT c = 0; c < components; ++c)
+		{
+			switch (type)
+			{
+			case Float32: memcpy(static_cast<float*>(out) + c, &value[c], sizeof(float)); break;
+			case Float16: { uint16_t h = FloatToHalf(value[c]); memcpy(static_cast<uint16_t*>(out) + c, &h, sizeof(h)); break; }
+			case Snorm16: { int16_t s = FloatToSnorm16(value[c]); memcpy(static_cast<int16_t*>(out) + c, &s, sizeof(s)); break; }
+			case Unorm16: { uint16_t u = FloatToUnorm16(value[c]); memcpy(static_cast<uint16_t*>(out) + c, &u, sizeof(u)); break; }
+			case Snorm8: static_cast<int8_t*>(out)[c] = FloatToSnorm8(value[c]); break;
+			case Unorm8: static_cast<uint8_t*>(out)[c] = FloatToUnorm8(value[c]); break;
+			}
+		}
+	}
+
+	//what the input assembler hands the shader, missing components are 0
+	inline void UnpackComponents(ComponentType type, UINT components, const void* in, float value[4])
+	{
+		value[0] = value[1] = value[2] = value[3] = 0.0f;
+		for (UINT c = 0; c < components; ++c)
+		{
+			switch (type)
+			{
+			case Float32: memcpy(&value[c], static_cast<const float*>(in) + c, sizeof(float)); break;
+			case Float16: { uint16_t h; memcpy(&h, static_cast<const uint16_t*>(in) + c, sizeof(h)); value[c] = HalfToFloat(h); break; }
+			case Snorm16: { int16_t s; memcpy(&s, static_cast<const int16_t*>(in) + c, sizeof(s)); value[c] = Snorm16ToFloat(s); break; }
+			case Unorm16: { uint16_t u; memcpy(&u, static_cast<const uint16_t*>(in) + c, sizeof(u)); value[c] = Unorm16ToFloat(u); break; }
+			case Snorm8: value[c] = Snorm8ToFloat(static_cast<const int8_t*>(in)[c]); break;
+			case Unorm8: value[c] = Unorm8ToFloat(static_cast<const uint8_t*>(in)[c]); break;
+			}
+		}
+	}
+}
+
+//component count and type of the DXGI formats vertex attributes can use. Formats without a specialization
+//don't compile as an attribute.
+template<DXGI_FORMAT Format> struct VertexFormatTraits;
+
+#define VERTEX_FORMAT_TRAITS(format, components, type) \
+	template<> struct VertexFormatTraits<format> \
+	{ \
+		static const UINT Components = components; \
+		static const VertexPacking::ComponentType Type = VertexPacking::type; \
+	};
+
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R32G32B32A32_FLOAT, 4, Float32)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R32G32B32_FLOAT, 3, Float32)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R32G32_FLOAT, 2, Float32)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R16G16B16A16_FLOAT, 4, Float16)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R16G16B16A16_SNORM, 4, Snorm16)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R16G16B16A16_UNORM, 4, Unorm16)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R16G16_FLOAT, 2, Float16)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R16G16_SNORM, 2, Snorm16)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R16G16_UNORM, 2, Unorm16)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R8G8B8A8_SNORM, 4, Snorm8)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R8G8B8A8_UNORM, 4, Unorm8)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R8G8_SNORM, 2, Snorm8)
+VERTEX_FORMAT_TRAITS(DXGI_FORMAT_R8G8_UNORM, 2, Unorm8)
+
+#undef VERTEX_FORMAT_TRAITS
+
+//the semantics an attribute can have: the HLSL name and how the encoder gets the attribute's value out of the
+//full float streams
+namespace VertexSemantic
+{
+	//quantized with the mesh's PositionQuantization
+	struct Position
+	{
+		static const char* GetName() { return "POSITION"; }
+		static void Load(const VertexStreams& streams, size_t vertex, const PositionQuantization& quantization, UINT, float value[4])
+		{
+			assert(streams.Positions);
+			for (int a = 0; a < 3; ++a)
+			{
+				value[a] = (streams.Positions[vertex * 3 + a] - quantization.Bias[a]) / quantization.Scale[a];
+			}
+		}
+	};
+
+	//octahedral encoded into two component formats, decode with OctDecode in Shaders.hlsl
+	struct Normal
+	{
+		static const char* GetName() { return "NORMAL"; }
+		static void Load(const VertexStreams& streams, size_t vertex, const PositionQuantization&, UINT components, float value[4])
+		{
+			assert(streams.Normals);
+			const float* normal = streams.Normals + vertex * 3;
+			if (components == 2)
+			{
+				VertexPacking::OctahedralEncode(normal, value);
+				return;
+			}
+			value[0] = normal[0];
+			value[1] = normal[1];
+			value[2] = normal[2];
+		}
+	};
+
+	struct TexCoord
+	{
+		static const char* GetName() { return "TEXCOORD"; }
+		static void Load(const VertexStreams& streams, size_t vertex, const PositionQuantization&, UINT, float value[4])
+		{
+			assert(streams.TexCoords);
+			value[0] = streams.TexCoords[vertex * 2 + 0];
+			value[1] = streams.TexCoords[vertex * 2 + 1];
+		}
+	};
+
+	struct Color
+	{
+		static const char* GetName() { return "COLOR"; }
+		static void Load(const VertexStreams& streams, size_t vertex, const PositionQuantization&, UINT, float value[4])
+		{
+			assert(streams.Colors);
+			memcpy(value, streams.Colors + vertex * 4, 4 * sizeof(float));
+		}
+	};
+}
+
+template<typename Semantic, DXGI_FORMAT AttributeFormat, UINT SemanticIndex = 0>
+struct VertexAttribute
+{
+	typedef Semantic SemanticType;
+	static const DXGI_FORMAT Format = AttributeFormat;
+	static const UINT Components = VertexFormatTraits<AttributeFormat>::Components;
+	static const VertexPacking::ComponentType Type = VertexFormatTraits<AttributeFormat>::Type;
+	static const UINT Size = Components * VertexPacking::GetComponentBytes(Type);
+
+	static D3D12_INPUT_ELEMENT_DESC GetElement(UINT offset)
+	{
+		D3D12_INPUT_ELEMENT_DESC element = { Semantic::GetName(), SemanticIndex, AttributeFormat, 0, offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+		return element;
+	}
+
+	static void Encode(const VertexStreams& streams, const PositionQuantization& quantization, uint8_t* vertices, UINT stride)
+	{
+		for (size_t v = 0; v < streams.Count; ++v)
+		{
+			float value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			Semantic::Load(streams, v, quantization, Components, value);
+			VertexPacking::PackComponents(Type, Components, value, vertices + v * stride);
+		}
+	}
+
+	//the components as the shader sees them, before dequantization or octahedral decoding
+	static void Decode(const uint8_t* attribute, float value[4])
+	{
+		VertexPacking::UnpackComponents(Type, Components, attribute, value);
+	}
+};
+
+//byte offset of attribute Index, the sum of the sizes before it
+template<UINT Index, typename... Attributes>
+struct VertexAttributeOffset
+{
+	static const UINT Value = 0;
+};
+
+template<UINT Index, typename First, typename... Rest>
+struct VertexAttributeOffset<Index, First, Rest...>
+{
+	static const UINT Value = First::Size + VertexAttributeOffset<Index - 1, Rest...>::Value;
+};
+
+template<typename First, typename... Rest>
+struct VertexAttributeOffset<0, First, Rest...>
+{
+	static const UINT Value = 0;
+};
+
+//attributes packed in order into one vertex buffer slot, without padding
+template<typename... Attributes>
+struct VertexLayout
+{
+	static const UINT AttributeCount = sizeof...(Attributes);
+	static const UINT Stride = VertexAttributeOffset<AttributeCount, Attributes...>::Value;
+
+	template<UINT Index>
+	struct Offset
+	{
+		static const UINT Value = VertexAttributeOffset<Index, Attributes...>::Value;
+	};
+
+	template<UINT Index>
+	using Attribute = typename std::tuple_element<Index, std::tuple<Attributes...>>::type;
+
+	static const D3D12_INPUT_LAYOUT_DESC& GetInputLayoutDesc()
+	{
+		static const D3D12_INPUT_LAYOUT_DESC desc = { GetElements(std::index_sequence_for<Attributes...>()), AttributeCount };
+		return desc;
+	}
+
+	//quantizes streams.Count vertices into vertices, Stride bytes each
+	static void Encode(const VertexStreams& streams, const PositionQuantization& quantization, void* vertices)
+	{
+		EncodeAttributes(streams, quantization, static_cast<uint8_t*>(vertices), std::index_sequence_for<Attributes...>());
+	}
+
+private:
+	template<size_t... I>
+	static const D3D12_INPUT_ELEMENT_DESC* GetElements(std::index_sequence<I...>)
+	{
+		static const D3D12_INPUT_ELEMENT_DESC elements[] = { Attributes::GetElement(VertexAttributeOffset<I, Attributes...>::Value)... };
+		return elements;
+	}
+
+	template<size_t... I>
+	static void EncodeAttributes(const VertexStreams& streams, const PositionQuantization& quantization, uint8_t* vertices, std::index_sequence<I...>)
+	{
+		int expand[] = { 0, (Attributes::Encode(streams, quantization, vertices + VertexAttributeOffset<I, Attributes...>::Value, Stride), 0)... };
+		(void)expand;
+	}
+};
+
+//the packed formats, next to the full float ones in helpers.h. Names give the components, S/U for SNORM/UNORM,
+//H for half, F for float, and the bits per component. Positions only come in 4 component formats, DXGI has no
+//3 component 16 bit ones; w is unused.
+namespace VertexTypes
+{
+	//12 bytes, P3F_T2F is 20. Positions need the mesh's PositionQuantization.
+	struct P3S16_T2U16
+	{
+		int16_t pos[4];
+		uint16_t tex[2]; //[0, 1] only, use P3H16_T2H16 style half UVs for tiling coordinates
+
+		typedef VertexLayout<
+			VertexAttribute<VertexSemantic::Position, DXGI_FORMAT_R16G16B16A16_SNORM>,
+			VertexAttribute<VertexSemantic::TexCoord, DXGI_FORMAT_R16G16_UNORM>
+		> Layout;
+		static const D3D12_INPUT_LAYOUT_DESC& GetInputLayoutDesc() { return Layout::GetInputLayoutDesc(); }
+	};
+
+	//12 bytes, P3F_C4F is 28
+	struct P3S16_C4U8
+	{
+		int16_t pos[4];
+		uint8_t color[4];
+
+		typedef VertexLayout<
+			VertexAttribute<VertexSemantic::Position, DXGI_FORMAT_R16G16B16A16_SNORM>,
+			VertexAttribute<VertexSemantic::Color, DXGI_FORMAT_R8G8B8A8_UNORM>
+		> Layout;
+		static const D3D12_INPUT_LAYOUT_DESC& GetInputLayoutDesc() { return Layout::GetInputLayoutDesc(); }
+	};
+
+	//16 bytes for a lit, textured vertex that takes 32 in floats
+	struct P3S16_N2S16_T2H16
+	{
+		int16_t pos[4];
+		int16_t normal[2]; //octahedral
+		uint16_t tex[2];
+
+		typedef VertexLayout<
+			VertexAttribute<VertexSemantic::Position, DXGI_FORMAT_R16G16B16A16_SNORM>,
+			VertexAttribute<VertexSemantic::Normal, DXGI_FORMAT_R16G16_SNORM>,
+			VertexAttribute<VertexSemantic::TexCoord, DXGI_FORMAT_R16G16_FLOAT>
+		> Layout;
+		static const D3D12_INPUT_LAYOUT_DESC& GetInputLayoutDesc() { return Layout::GetInputLayoutDesc(); }
+	};
+
+	//12 bytes, half positions work without quantization for small meshes near their origin
+	struct P3H16_T2H16
+	{
+		uint16_t pos[4];
+		uint16_t tex[2];
+
+		typedef VertexLayout<
+			VertexAttribute<VertexSemantic::Position, DXGI_FORMAT_R16G16B16A16_FLOAT>,
+			VertexAttribute<VertexSemantic::TexCoord, DXGI_FORMAT_R16G16_FLOAT>
+		> Layout;
+		static const D3D12_INPUT_LAYOUT_DESC& GetInputLayoutDesc() { return Layout::GetInputLayoutDesc(); }
+	};
+
+	static_assert(sizeof(P3S16_T2U16) == P3S16_T2U16::Layout::Stride && offsetof(P3S16_T2U16, tex) == P3S16_T2U16::Layout::Offset<1>::Value, "P3S16_T2U16 must match its layout");
+	static_assert(sizeof(P3S16_C4U8) == P3S16_C4U8::Layout::Stride && offsetof(P3S16_C4U8, color) == P3S16_C4U8::Layout::Offset<1>::Value, "P3S16_C4U8 must match its layout");
+	static_assert(sizeof(P3S16_N2S16_T2H16) == P3S16_N2S16_T2H16::Layout::Stride && offsetof(P3S16_N2S16_T2H16, normal) == P3S16_N2S16_T2H16::Layout::Offset<1>::Value &&
+		offsetof(P3S16_N2S16_T2H16, tex) == P3S16_N2S16_T2H16::Layout::Offset<2>::Value, "P3S16_N2S16_T2H16 must match its layout");
+	static_assert(sizeof(P3H16_T2H16) == P3H16_T2H16::Layout::Stride && offsetof(P3H16_T2H16, tex) == P3H16_T2H16::Layout::Offset<1>::Value, "P3H16_T2H16 must match its layout");
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "tracing.h"
+
+//small fixed size pool of worker threads fed from a single FIFO job queue.
+//Used for work that must never block the frame loop (shader variant compiles etc.).
+//A pool started with zero threads runs every submitted job inline on the caller's thread,
+//which keeps the users of the pool deterministic when run headless.
+class WorkerPool
+{
+public:
+	WorkerPool() : m_Stopping(false), m_Busy(0) {}
+	~WorkerPool() { Stop(); }
+
+	void Start(uint32_t threadCount)
+	{
+		Stop();
+		m_Stopping = false;
+		for (uint32_t i = 0; i < threadCount; ++i)
+		{
+			m_Threads.emplace_back([this]() { WorkerMain(); });
+		}
+	}
+
+	//finishes the jobs already queued, then joins all threads.
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_WakeWorkers.notify_all();
+		for (auto& thread : m_Threads)
+		{
+			thread.join();
+		}
+		m_Threads.clear();
+	}
+
+	void Submit(std::function<void()> job)
+	{
+		if (m_Threads.empty())
+		{
+			job();
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Jobs.push_back(std::move(job));
+		}
+		m_WakeWorkers.notify_one();
+	}
+
+	//blocks until the queue is empty and no worker is running a job.
+	void WaitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Idle.wait(lock, [this]() { return m_Jobs.empty() && m_Busy == 0; });
+	}
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+private:
+	void WorkerMain()
+	{
+		TRACE_THREAD_NAME("Worker");
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_WakeWorkers.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+				if (m_Jobs.empty())
+				{
+					return;
+				}
+				job = std::move(m_Jobs.front());
+				m_Jobs.pop_front();
+				++m_Busy;
+			}
+
+			{
+				TRACE_SCOPE("WorkerJob");
+				job();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				--m_Busy;
+			}
+			m_Idle.notify_all();
+		}
+	}
+
+	std::vector<std::thread> m_Threads;
+	std::deque<std::function<void()>> m_Jobs;
+	std::mutex m_Mutex;
+	std::condition_variable m_WakeWorkers;
+	std::condition_variable m_Idle;
+	bool m_Stopping;
+	uint32_t m_Busy;
+};